@@ -26,7 +26,7 @@ class LogCSV;
 struct iDataConnection : public virtual iBase
 {
 public:
-    SCF_INTERFACE(iDataConnection, 0, 0, 1);
+    SCF_INTERFACE(iDataConnection, 0, 0, 2);
 
     /// Returns whether this object is actually connected to the database.
     virtual int IsValid(void)=0;
@@ -103,6 +103,12 @@ public:
     
     virtual const char* DumpProfile()=0;
     virtual void ResetProfile()=0;
+
+    /**
+     * The time spent per statement as lines of the metrics export,
+     * see psOperProfileSet::Export().
+     */
+    virtual csString ExportProfile()=0;
     
     virtual iRecord* NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line) =0;
     virtual iRecord* NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line) = 0;
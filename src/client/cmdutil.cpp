@@ -73,6 +73,7 @@ psUtilityCommands::psUtilityCommands(ClientMsgHandler *mh,
     cmdsource->Subscribe("/reload",this);
     cmdsource->Subscribe("/graphicbug",this);
     cmdsource->Subscribe("/repaintlabels",this);
+    cmdsource->Subscribe("/entityqueue",this);
     //cmdsource->Subscribe("/dumpmovements",this);
     cmdsource->Subscribe("/testanim",this);
     cmdsource->Subscribe("/version", this);
@@ -89,6 +90,7 @@ psUtilityCommands::~psUtilityCommands()
     cmdsource->Unsubscribe("/reload",this);
     cmdsource->Unsubscribe("/graphicbug",this);
     cmdsource->Unsubscribe("/repaintlabels",this);
+    cmdsource->Unsubscribe("/entityqueue",this);
     //cmdsource->Unsubscribe("/dumpmovements",this);
     cmdsource->Unsubscribe("/testanim",this);
     cmdsource->Unsubscribe("/version", this);
@@ -193,6 +195,12 @@ const char *psUtilityCommands::HandleCommand(const char *cmd)
             return "Labels repainted";
         }
     }
+    else if(words[0] == "/entityqueue")
+    {
+        static csString stats;
+        stats = psengine->GetCelClient()->GetEntityQueueStats();
+        return stats.GetData();
+    }
     else if(words[0] == "/testanim")
     {
         static csString outputstring;
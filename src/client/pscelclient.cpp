@@ -31,6 +31,7 @@
 #include <iutil/stringarray.h>
 #include <iutil/vfs.h>
 #include <ivaria/collider.h>
+#include <iengine/camera.h>
 #include <iengine/engine.h>
 #include <iengine/mesh.h>
 #include <iengine/movable.h>
@@ -103,6 +104,11 @@ psCelClient::psCelClient()
 
     requeststatus = 0;
 
+    entityBudget    = ENTITY_QUEUE_BUDGET;
+    visibleCount    = 0;
+    visibleTotal    = 0;
+    visibleMax      = 0;
+
     clientdr        = NULL;
     gameWorld       = NULL;
     entityLabels    = NULL;
@@ -187,6 +193,7 @@ bool psCelClient::Initialize(iObjectRegistry* object_reg, MsgHandler* newmsghand
     unresSector = psengine->GetEngine()->CreateSector("SectorWhereWeKeepEntitiesResidingInUnloadedMaps");
 
     instantiateItems = psengine->GetConfig()->GetBool("PlaneShift.Items.Instantiate", false);
+    entityBudget = psengine->GetConfig()->GetInt("PlaneShift.Loading.EntityBudget", ENTITY_QUEUE_BUDGET);
 
     LoadEffectItems();
 
@@ -283,6 +290,114 @@ void psCelClient::HandleItem(MsgEntry* me)
     AddEntity(item);
 }
 
+void psCelClient::QueueEntity(MsgEntry* me, bool actor)
+{
+    QueuedEntity entity;
+    entity.me = me;
+    entity.actor = actor;
+    entity.located = false;
+    entity.prefetched = false;
+    entity.queued = csGetTicks();
+    entity.priority = 0;
+
+    // The position is needed to create the nearest first, without the
+    // strings table it can't be read and the entity waits with the far ones.
+    if(GetClientDR()->GetMsgStrings())
+    {
+        NetBase::AccessPointers* accessPointers = psengine->GetNetManager()->GetConnection()->GetAccessPointers();
+        if(actor)
+        {
+            psPersistActor msg(me, accessPointers);
+            entity.eid = msg.entityid;
+            entity.pos = msg.pos;
+            entity.sectorName = msg.sectorName;
+            entity.factName = msg.factname;
+        }
+        else
+        {
+            psPersistItem msg(me, accessPointers);
+            entity.eid = msg.eid;
+            entity.pos = msg.pos;
+            entity.sectorName = msg.sector;
+            entity.factName = msg.factname;
+        }
+        entity.located = true;
+        me->Reset();
+    }
+    else
+    {
+        entity.eid = EID(psPersistActor::PeekEID(me));
+    }
+
+    // Racial meshes are only known when the entity is created
+    if(entity.factName == "nullmesh" || entity.factName.FindFirst('$') != (size_t)-1)
+    {
+        entity.factName.Empty();
+    }
+
+    // A newer message of an entity replaces the queued one, created later
+    // it would have replaced the newer entity.
+    for(size_t i = 0; i < entityQueue.GetSize(); i++)
+    {
+        if(entityQueue[i].eid == entity.eid)
+        {
+            entityQueue.DeleteIndex(i--);
+        }
+    }
+
+    entityQueue.Push(entity);
+}
+
+int psCelClient::CompareQueuedEntities(QueuedEntity const &a, QueuedEntity const &b)
+{
+    // Descending, the first to be created is popped from the end. Equal
+    // priorities are taken in arrival order.
+    if(a.priority > b.priority)
+        return -1;
+    if(a.priority < b.priority)
+        return 1;
+    if(a.queued > b.queued)
+        return -1;
+    if(a.queued < b.queued)
+        return 1;
+    return 0;
+}
+
+void psCelClient::PrioritizeEntityQueue()
+{
+    iSector* cameraSector = NULL;
+    csVector3 cameraPos;
+    psCamera* camera = psengine->GetPSCamera();
+    if(camera && camera->GetICamera())
+    {
+        cameraSector = camera->GetICamera()->GetCamera()->GetSector();
+        cameraPos = camera->GetPosition();
+    }
+
+    for(size_t i = 0; i < entityQueue.GetSize(); i++)
+    {
+        QueuedEntity &entity = entityQueue[i];
+
+        // Looked up each time as the maps are loaded and unloaded meanwhile
+        iSector* sector = NULL;
+        if(entity.located && !entity.sectorName.IsEmpty())
+        {
+            sector = psengine->GetEngine()->GetSectors()->FindByName(entity.sectorName);
+        }
+
+        float distance = ENTITY_QUEUE_FAR;
+        if(sector && cameraSector && gameWorld)
+        {
+            distance = csMin(gameWorld->Distance(cameraPos, cameraSector, entity.pos, sector),
+                             ENTITY_QUEUE_FAR);
+        }
+
+        entity.priority = entity.actor ? distance : distance * ENTITY_QUEUE_ITEM_WEIGHT;
+    }
+
+    entityQueue.Sort(CompareQueuedEntities);
+}
+
 void psCelClient::HandleActionLocation(MsgEntry* me)
 {
     psPersistActionLocation msg(me);
@@ -323,7 +438,14 @@ void psCelClient::HandleObjectRemoval(MsgEntry* me)
 {
     psRemoveObject mesg(me);
 
-    ForceEntityQueues();
+    // The queued messages of the entity are older than its removal
+    for(size_t i = 0; i < entityQueue.GetSize(); i++)
+    {
+        if(entityQueue[i].eid == mesg.objectEID)
+        {
+            entityQueue.DeleteIndex(i--);
+        }
+    }
 
     GEMClientObject* entity = FindObject(mesg.objectEID);
 
@@ -494,6 +616,7 @@ void psCelClient::RemoveObject(GEMClientObject* entity)
         psengine->GetCharManager()->SetTarget(NULL, "select");
     }
 
+    entitiesLoading.DeleteAll(entity->GetEID());
     entityLabels->RemoveObject(entity);
     shadowManager->RemoveShadow(entity);
     psengine->GetPSCamera()->npcTargetReplaceIfEqual(entity, NULL);
@@ -716,34 +839,100 @@ void psCelClient::HandleMecsActivate(MsgEntry* me)
     }
 }
 
-void psCelClient::ForceEntityQueues()
+void psCelClient::CheckEntityQueues()
 {
-    while(!newActorQueue.IsEmpty())
+    if(entityQueue.IsEmpty())
+        return;
+
+    PrioritizeEntityQueue();
+
+    // At least one each frame, then as many as fit the budget
+    csMicroTicks start = csGetMicroTicks();
+    csMicroTicks budget = (csMicroTicks)entityBudget * 1000;
+    do
     {
-        csRef<MsgEntry> me = newActorQueue.Pop();
-        HandleActor(me);
+        CreateQueuedEntity(entityQueue.Pop());
     }
-    if(!newItemQueue.IsEmpty())
+    while(!entityQueue.IsEmpty() && csGetMicroTicks() - start < budget);
+
+    PrefetchEntityFactories();
+}
+
+void psCelClient::PrefetchEntityFactories()
+{
+    // The loader can't find the factories of the maps being loaded yet
+    if(psengine->GetZoneHandler()->IsLoading())
+        return;
+
+    size_t count = 0;
+    for(size_t i = entityQueue.GetSize(); i-- > 0 && count < ENTITY_QUEUE_PREFETCH; count++)
     {
-        csRef<MsgEntry> me = newItemQueue.Pop();
-        HandleItem(me);
+        QueuedEntity &entity = entityQueue[i];
+        if(entity.prefetched || entity.factName.IsEmpty())
+            continue;
+
+        // The entity will load it again, already loaded or on the way.
+        entity.factory = psengine->GetLoader()->LoadFactory(entity.factName);
+        entity.prefetched = true;
     }
 }
 
-void psCelClient::CheckEntityQueues()
+void psCelClient::CreateQueuedEntity(const QueuedEntity &entity)
 {
-    if(newActorQueue.GetSize())
+    if(entity.actor)
     {
-        csRef<MsgEntry> me = newActorQueue.Pop();
-        HandleActor(me);
-        return;
+        HandleActor(entity.me);
     }
-    if(newItemQueue.GetSize())
+    else
     {
-        csRef<MsgEntry> me = newItemQueue.Pop();
-        HandleItem(me);
+        HandleItem(entity.me);
+    }
+
+    GEMClientObject* object = FindObject(entity.eid);
+    if(!object)
         return;
+
+    entitiesLoading.PutUnique(entity.eid, entity.queued);
+
+    // Its mesh was already loaded, or it has none
+    if(!psengine->IsDelayedLoading(object))
+    {
+        EntityVisible(object);
+    }
+}
+
+void psCelClient::EntityVisible(GEMClientObject* entity)
+{
+    csTicks* queued = entitiesLoading.GetElementPointer(entity->GetEID());
+    if(!queued)
+        return;
+
+    csTicks elapsed = csGetTicks() - *queued;
+    entitiesLoading.DeleteAll(entity->GetEID());
+
+    visibleCount++;
+    visibleTotal += elapsed;
+    visibleMax = csMax(visibleMax, elapsed);
+}
+
+csString psCelClient::GetEntityQueueStats()
+{
+    size_t actors = 0;
+    for(size_t i = 0; i < entityQueue.GetSize(); i++)
+    {
+        if(entityQueue[i].actor)
+            actors++;
+    }
+
+    csString stats;
+    stats.Format("%zu actors and %zu items queued, %zu loading, budget %u ms per frame.",
+                 actors, entityQueue.GetSize() - actors, entitiesLoading.GetSize(), entityBudget);
+    if(visibleCount)
+    {
+        stats.AppendFmt(" %zu visible after %u ms on average, %u ms at most.",
+                        visibleCount, (unsigned int)(visibleTotal / visibleCount), visibleMax);
     }
+    return stats;
 }
 
 void psCelClient::Update(bool loaded)
@@ -836,14 +1025,14 @@ void psCelClient::HandleMessage(MsgEntry* me)
             }
             else
             {
-                newActorQueue.Push(me);
+                QueueEntity(me, true);
             }
             break;
         }
 
         case MSGTYPE_PERSIST_ITEM:
         {
-            newItemQueue.Push(me);
+            QueueEntity(me, false);
             break;
 
         }
@@ -2274,6 +2463,7 @@ bool GEMClientActor::CheckLoadStatus()
     }
 
     psengine->UnregisterDelayedLoader(this);
+    cel->EntityVisible(this);
 
     psengine->GetSoundManager()->AddObjectEntity(pcmesh, race);
 
@@ -2580,6 +2770,7 @@ bool GEMClientItem::CheckLoadStatus()
     cel->AttachObject(pcmesh->QueryObject(), this);
 
     psengine->UnregisterDelayedLoader(this);
+    cel->EntityVisible(this);
 
     PostLoad();
 
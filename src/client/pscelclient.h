@@ -39,6 +39,7 @@
 //=============================================================================
 
 #include "net/cmdbase.h"
+#include "util/drsnapshot.h"
 #include "engine/linmove.h"
 
 //=============================================================================
@@ -89,6 +90,18 @@ public:
     }
 };
 
+/// Milliseconds per frame spent creating the queued actors and items, unless configured.
+#define ENTITY_QUEUE_BUDGET 4
+
+/// Number of the first queued entities whose mesh factories are loaded ahead.
+#define ENTITY_QUEUE_PREFETCH 16
+
+/// Items wait as long as actors this many times nearer.
+#define ENTITY_QUEUE_ITEM_WEIGHT 2.0f
+
+/// Distance given to queued entities in a sector not loaded or not connected to the camera.
+#define ENTITY_QUEUE_FAR 100000.0f
+
 struct InstanceObject : public CS::Utility::FastRefCount<InstanceObject>
 {
     csRef<iMeshWrapper> pcmesh;
@@ -109,8 +122,38 @@ private:
     csRef<iObjectRegistry> object_reg;
     csPDelArray<GEMClientObject> entities;
     csHash<GEMClientObject*, EID> entities_hash;
-    csRefArray<MsgEntry> newActorQueue;
-    csRefArray<MsgEntry> newItemQueue;
+
+    /** An actor or item received from the server and waiting to be created.
+      * The queue is ordered each frame by distance to the camera, the nearest
+      * actors first, and the mesh factories of the first ones are loaded
+      * ahead on the threaded loader.
+      */
+    struct QueuedEntity
+    {
+        csRef<MsgEntry> me;
+        EID eid;
+        bool actor;
+        bool located;                   ///< The position could be read from the message.
+        csVector3 pos;
+        csString sectorName;
+        csString factName;              ///< Mesh factory to load ahead, empty if none.
+        csRef<iThreadReturn> factory;   ///< Keeps the factory loaded until the entity is created.
+        bool prefetched;
+        csTicks queued;                 ///< When the message was received.
+        float priority;                 ///< Weighted distance to the camera, the lowest is created first.
+    };
+    csArray<QueuedEntity> entityQueue;
+    static int CompareQueuedEntities(QueuedEntity const &a, QueuedEntity const &b);
+    csTicks entityBudget;               ///< Milliseconds per frame spent creating queued entities.
+
+    /// When the created entities still loading their mesh were queued.
+    csHash<csTicks, EID> entitiesLoading;
+
+    /// Time from the message to the real mesh of the queued entities.
+    size_t visibleCount;
+    csTicks visibleTotal;
+    csTicks visibleMax;
+
     bool instantiateItems;
 
     // Keep seperate for speedups
@@ -244,10 +287,16 @@ public:
         return requeststatus;
     }
 
-    /// Add one new actor or item entity from the queue.
+    /// Add the nearest new actor and item entities from the queue within the frame budget.
     void CheckEntityQueues();
-    /// Add all new entities on the queue.
-    void ForceEntityQueues();
+
+    /** Called by an entity when its real mesh replaced the nullmesh.
+      * Accounts the time since its message was queued.
+      */
+    void EntityVisible(GEMClientObject* entity);
+
+    /// Describe the entity queue and the time to visible of the entities created from it.
+    csString GetEntityQueueStats();
 
     void Update(bool loaded);
 
@@ -342,6 +391,15 @@ protected:
 
     void HandleMecsActivate(MsgEntry* me);
 
+    /// Queue a persist actor or item message to be created in a later frame.
+    void QueueEntity(MsgEntry* me, bool actor);
+    /// Set the priorities of the queued entities and sort the first to be created last.
+    void PrioritizeEntityQueue();
+    /// Start loading the mesh factories of the first queued entities.
+    void PrefetchEntityFactories();
+    /// Create a queued entity and start accounting its time to visible.
+    void CreateQueuedEntity(const QueuedEntity &entity);
+
     void AddEntity(GEMClientObject* obj);
 
     /** Handles a stats message from the server.
@@ -625,6 +683,12 @@ public:
     void SetDRData(psDRMessage &drmsg);
     void StopMoving(bool worldVel = false);
 
+    /// The last keyframe of the compact dead reckoning received for this actor
+    psDRKeyframe &GetDRKeyframe()
+    {
+        return drKeyframe;
+    }
+
     psCharAppearance* CharAppearance()
     {
         return charApp;
@@ -726,6 +790,7 @@ protected:
     csString guildName;
     uint8_t  DRcounter;  ///< increments in loop to prevent out of order packet overwrites of better data
     bool DRcounter_set;
+    psDRKeyframe drKeyframe;
 
     virtual void SwitchToRealMesh(iMeshWrapper* mesh);
 
@@ -70,6 +70,7 @@ psClientDR::~psClientDR()
     if (msghandler)
     {
         msghandler->Unsubscribe(this,MSGTYPE_DEAD_RECKONING);
+        msghandler->Unsubscribe(this,MSGTYPE_WORLD_UPDATE);
         msghandler->Unsubscribe(this,MSGTYPE_FORCE_POSITION);
         msghandler->Unsubscribe(this,MSGTYPE_STATDRUPDATE);
         msghandler->Unsubscribe(this,MSGTYPE_MSGSTRINGS);
@@ -90,6 +91,7 @@ bool psClientDR::Initialize(iObjectRegistry* object_reg, psCelClient* celclient,
     msgstrings = NULL; // will get it in a MSGTYPE_MSGSTRINGS message
 
     msghandler->Subscribe(this,MSGTYPE_DEAD_RECKONING);
+    msghandler->Subscribe(this,MSGTYPE_WORLD_UPDATE);
     msghandler->Subscribe(this,MSGTYPE_FORCE_POSITION);
     msghandler->Subscribe(this,MSGTYPE_STATDRUPDATE);
     msghandler->Subscribe(this,MSGTYPE_MSGSTRINGS);
@@ -171,6 +173,10 @@ void psClientDR::HandleMessage (MsgEntry* me)
     {
         HandleDeadReckon( me );
     }
+    else if (me->GetType() == MSGTYPE_WORLD_UPDATE)
+    {
+        HandleWorldUpdate( me );
+    }
     else if (me->GetType() == MSGTYPE_FORCE_POSITION)
     {
         HandleForcePosition(me);
@@ -231,6 +237,47 @@ void psClientDR::HandleDeadReckon( MsgEntry* me )
     gemActor->SetDRData(drmsg);
 }
 
+void psClientDR::HandleWorldUpdate( MsgEntry* me )
+{
+    NetBase::AccessPointers* accessPointers = psengine->GetNetManager()->GetConnection()->GetAccessPointers();
+    psWorldUpdateMessage msg(me, accessPointers);
+    if (!msg.valid)
+    {
+        Error1("Got unparsable world update message.");
+        return;
+    }
+
+    if (!msgstrings)
+    {
+        Error1("msgstrings not received, cannot handle DR");
+        return;
+    }
+
+    for (size_t i = 0; i < msg.records.GetSize(); i++)
+    {
+        psCompactDRMessage &drmsg = *msg.records[i];
+        GEMClientActor* gemActor = (GEMClientActor*)celclient->FindObject( drmsg.entityid );
+        if (!gemActor)
+        {
+            Error2("Got DR message for unknown entity %s.", ShowID(drmsg.entityid));
+            continue;
+        }
+
+        // Sent against a keyframe we didn't get yet, the next keyframe will fix it
+        if (!drmsg.Resolve(gemActor->GetDRKeyframe(), accessPointers))
+            continue;
+
+        // Ignore any updates to the main player...psForcePositionMessage handles that.
+        if (gemActor == celclient->GetMainPlayer())
+        {
+            psengine->GetModeHandler()->SetModeSounds(drmsg.mode);
+            continue;
+        }
+
+        gemActor->SetDRData(drmsg);
+    }
+}
+
 void psClientDR::HandleForcePosition(MsgEntry *me)
 {
     psForcePositionMessage msg(me, psengine->GetNetManager()->GetConnection()->GetAccessPointers());
@@ -899,7 +899,7 @@ bool psEngine::ProcessLogic(iEvent &ev)
             modehandler->PreProcess();
         }
 
-        // If any objects or actors are enqueued to be created, create the next one this frame.
+        // If any objects or actors are enqueued to be created, create the nearest ones this frame.
         if(celclient)
         {
             celclient->CheckEntityQueues();
@@ -623,6 +623,10 @@ public:
     {
         delayedLoaders.Delete(obj);
     }
+    bool IsDelayedLoading(DelayedLoader* obj)
+    {
+        return delayedLoaders.Find(obj) != csArrayItemNotFound;
+    }
 
     static csString hwRenderer;
     static csString hwVersion;
@@ -29,6 +29,7 @@
 #include <iengine/movable.h>
 #include <iengine/portal.h>
 #include <iengine/portalcontainer.h>
+#include <iutil/cfgmgr.h>
 #include <imesh/object.h>
 
 //=============================================================================
@@ -46,13 +47,13 @@
 #include "psworld.h"
 
 psWorld::psWorld()
+    : warpDepth(1)
 {
     regions.AttachNew(new scfStringArray());
 }
 
 psWorld::~psWorld()
 {
-    transarray.Empty();
 }
 
 bool psWorld::Initialize(iObjectRegistry* objectReg)
@@ -61,6 +62,10 @@ bool psWorld::Initialize(iObjectRegistry* objectReg)
     engine = csQueryRegistry<iEngine>(object_reg);
     loader = csQueryRegistry<iBgLoader>(object_reg);
 
+    csRef<iConfigManager> config = csQueryRegistry<iConfigManager>(object_reg);
+    if(config)
+        warpDepth = csMax(config->GetInt("Planeshift.World.WarpDepth", 1), 1);
+
     return true;
 }
 
@@ -90,21 +95,43 @@ void psWorld::GetAllRegionNames(csString &str)
     }
 }
 
+/**
+ * The warp of crossing 'first' then 'second', from the space of the first
+ * sector to the space of the last.
+ */
+static csReversibleTransform ChainWarps(const csReversibleTransform &first, const csReversibleTransform &second)
+{
+    return csReversibleTransform(second.GetO2T() * first.GetO2T(),
+                                 first.GetO2TTranslation() + first.GetT2O() * second.GetO2TTranslation());
+}
+
 void psWorld::BuildWarpCache()
 {
     int sectorCount = engine->GetSectors()->GetCount();
     Debug2(LOG_STARTUP,0,"Building warp cache for %d sectors...",sectorCount);
 
     /// Clear existing entries
-    transarray.Empty();
-
-    transarray.SetSize(sectorCount);
+    sectors.Empty();
+    sectorIndex.DeleteAll();
+    adjacent.Empty();
+    warps.Empty();
+    warpTable.Empty();
 
     for(int i=0; i<sectorCount; i++)
     {
-        const csSet<csPtrKey<iMeshWrapper> > &portals = engine->GetSectors()->Get(i)->GetPortalMeshes();
+        iSector* sector = engine->GetSectors()->Get(i);
+        sectorIndex.PutUnique(csPtrKey<iSector> (sector), sectors.Push(sector));
+    }
+
+    size_t count = sectors.GetSize();
+    adjacent.SetSize(count);
+    warpTable.SetSize(count * count, SIZET_NOT_FOUND);
+
+    for(size_t i=0; i<count; i++)
+    {
+        const csSet<csPtrKey<iMeshWrapper> > &portals = sectors[i]->GetPortalMeshes();
         Debug3(LOG_STARTUP,0," %zu portal meshes for %s",portals.GetSize(),
-               engine->GetSectors()->Get(i)->QueryObject()->GetName());
+               sectors[i]->QueryObject()->GetName());
 
         csSet<csPtrKey<iMeshWrapper> >::GlobalIterator it = portals.GetIterator();
         while(it.HasNext())
@@ -116,7 +143,8 @@ void psWorld::BuildWarpCache()
                 iPortal* portal = pc->GetPortal(j);
                 if(portal->CompleteSector(0))
                 {
-                    if(engine->GetSectors()->Find(portal->GetSector()) != -1)
+                    size_t to = GetSectorIndex(portal->GetSector());
+                    if(to != SIZET_NOT_FOUND)
                     {
                         const csReversibleTransform warp = portal->GetWarp();
 
@@ -128,48 +156,100 @@ void psWorld::BuildWarpCache()
                                    portal->GetName(),warp.Description().GetData());
                         }
 
-                        // Apply the warp to the chache
-                        transarray[i].Set(portal->GetSector(), warp);
+                        // Apply the warp to the chache, the last portal to a sector wins
+                        size_t &index = warpTable[i * count + to];
+                        if(index == SIZET_NOT_FOUND)
+                        {
+                            index = warps.Push(SectorWarp());
+                            adjacent[i].Push(to);
+                        }
+                        warps[index].transform = warp;
+                        warps[index].hops = 1;
                     }
                 }
             }
         }
     }
+
+    // Chain the portals breadth first, so each pair of sectors gets the
+    // warp through the fewest portals
+    for(int hops = 2; hops <= warpDepth; hops++)
+    {
+        for(size_t from = 0; from < count; from++)
+        {
+            for(size_t via = 0; via < count; via++)
+            {
+                size_t first = warpTable[from * count + via];
+                if(first == SIZET_NOT_FOUND || warps[first].hops != hops - 1)
+                    continue;
+
+                for(size_t a = 0; a < adjacent[via].GetSize(); a++)
+                {
+                    size_t to = adjacent[via][a];
+                    if(to == from || warpTable[from * count + to] != SIZET_NOT_FOUND)
+                        continue;
+
+                    SectorWarp chained;
+                    chained.transform = ChainWarps(warps[first].transform, warps[warpTable[via * count + to]].transform);
+                    chained.hops = hops;
+                    warpTable[from * count + to] = warps.Push(chained);
+                }
+            }
+        }
+    }
+
+    Debug3(LOG_STARTUP,0,"%zu warps through up to %d portals",warps.GetSize(),warpDepth);
 }
 
 void psWorld::DumpWarpCache()
 {
-    for(size_t i=0; i<transarray.GetSize(); i++)
+    size_t count = sectors.GetSize();
+    for(size_t i=0; i<count; i++)
     {
-        csHash<csReversibleTransform*, csPtrKey<iSector> >::GlobalIterator it =  transarray[i].GetIterator();
-        iSector* fromSector = engine->GetSectors()->Get((int)i);
-        CPrintf(CON_CMDOUTPUT,"%s\n",fromSector->QueryObject()->GetName());
-        while(it.HasNext())
+        CPrintf(CON_CMDOUTPUT,"%s\n",sectors[i]->QueryObject()->GetName());
+        for(size_t j=0; j<count; j++)
         {
-            csPtrKey<iSector>  sector;
-            csReversibleTransform* rt = it.Next(sector);
-            CPrintf(CON_CMDOUTPUT,"  %-20s : %s\n",sector->QueryObject()->GetName(),toString(*rt).GetData());
+            size_t index = warpTable[i * count + j];
+            if(index == SIZET_NOT_FOUND)
+                continue;
 
+            if(warps[index].hops == 1)
+            {
+                CPrintf(CON_CMDOUTPUT,"  %-20s : %s\n",sectors[j]->QueryObject()->GetName(),
+                        toString(warps[index].transform).GetData());
+            }
+            else
+            {
+                CPrintf(CON_CMDOUTPUT,"  %-20s : %s (%d portals)\n",sectors[j]->QueryObject()->GetName(),
+                        toString(warps[index].transform).GetData(),warps[index].hops);
+            }
         }
     }
 }
 
+const psWorld::SectorWarp* psWorld::GetWarp(const iSector* from, const iSector* to) const
+{
+    size_t i = GetSectorIndex(from);
+    size_t j = GetSectorIndex(to);
+    if(i == SIZET_NOT_FOUND || j == SIZET_NOT_FOUND)
+        return NULL;
+
+    size_t index = warpTable[i * sectors.GetSize() + j];
+    if(index == SIZET_NOT_FOUND)
+        return NULL;
+
+    return &warps[index];
+}
 
 bool psWorld::WarpSpace(const iSector* from, const iSector* to, csVector3 &pos)
 {
     if(from == to)
         return true; // No need to transform, pos ok.
 
-    int i = engine->GetSectors()->Find((iSector*)from);
-    if(i == -1)
+    const SectorWarp* warp = GetWarp(from, to);
+    if(warp)
     {
-        return false; // Didn't find transformation, pos not ok.
-    }
-
-    csReversibleTransform* transform = transarray[i].Get((iSector*)to);
-    if(transform)
-    {
-        pos = *transform * pos;
+        pos = warp->transform * pos;
         return true; // Position transformed, pos ok.
     }
 
@@ -181,16 +261,10 @@ bool psWorld::WarpSpaceRelative(const iSector* from, const iSector* to, csVector
     if(from == to)
         return true; // No need to transform, pos ok.
 
-    int i = engine->GetSectors()->Find((iSector*)from);
-    if(i == -1)
-    {
-        return false; // Didn't find transformation, pos not ok.
-    }
-
-    csReversibleTransform* transform = transarray[i].Get((iSector*)to);
-    if(transform)
+    const SectorWarp* warp = GetWarp(from, to);
+    if(warp)
     {
-        pos = transform->Other2ThisRelative(pos);
+        pos = warp->transform.Other2ThisRelative(pos);
         return true; // Position transformed, pos ok.
     }
 
@@ -202,18 +276,24 @@ bool psWorld::Connected(const iSector* from, const iSector* to)
     if(from == to)
         return true;
 
-    int i = engine->GetSectors()->Find((iSector*)from);
-    if(i == -1)
-        return false;
-
-    if(transarray.GetSize() == 0)
+    if(sectors.GetSize() == 0)
         return true;
 
-    csReversibleTransform* transform = transarray[i].Get((iSector*)to);
-    if(transform)
-        return true;
+    // Through a single portal
+    const SectorWarp* warp = GetWarp(from, to);
+    return warp && warp->hops == 1;
+}
+
+void psWorld::GetAdjacentSectors(const iSector* from, csArray<iSector*> &adjacentSectors)
+{
+    size_t i = GetSectorIndex(from);
+    if(i == SIZET_NOT_FOUND)
+        return;
 
-    return false;
+    for(size_t a = 0; a < adjacent[i].GetSize(); a++)
+    {
+        adjacentSectors.Push(sectors[adjacent[i][a]]);
+    }
 }
 
 float psWorld::Distance(const csVector3 &from_pos, const iSector* from_sector, csVector3 to_pos, const iSector* to_sector)
@@ -259,6 +339,40 @@ float psWorld::Distance2(const csVector3 &from_pos, const iSector* from_sector,
     }
 }
 
+void psWorld::Distance(const csVector3 &from_pos, const iSector* from_sector, const csArray<csVector3> &to_pos,
+                       const csArray<iSector*> &to_sectors, csArray<float> &distances)
+{
+    distances.SetSize(to_pos.GetSize());
+
+    // The points come mostly in runs of the same sector
+    const iSector* lastSector = from_sector;
+    const SectorWarp* warp = NULL;
+    bool connected = true;
+
+    for(size_t i = 0; i < to_pos.GetSize(); i++)
+    {
+        if(to_sectors[i] != lastSector)
+        {
+            lastSector = to_sectors[i];
+            warp = (lastSector == from_sector) ? NULL : GetWarp(lastSector, from_sector);
+            connected = (lastSector == from_sector) || warp;
+        }
+
+        if(!connected)
+        {
+            distances[i] = INFINITY_DISTANCE; // No transformation found, so just set larg distance.
+        }
+        else if(warp)
+        {
+            distances[i] = (from_pos - warp->transform * to_pos[i]).Norm();
+        }
+        else
+        {
+            distances[i] = (from_pos - to_pos[i]).Norm();
+        }
+    }
+}
+
 
 float psWorld::Distance(iMeshWrapper* ent1, iMeshWrapper* ent2)
 {
@@ -52,50 +52,34 @@ protected:
     csWeakRef<iEngine> engine;
     csRef<iBgLoader> loader;
 
-    class sectorTransformation
+    /// The warp from one sector to another, through one or more portals
+    struct SectorWarp
     {
-        // Transformation
-        csHash<csReversibleTransform*, csPtrKey<iSector> > trans;
-
-    public:
-        csHash<csReversibleTransform*, csPtrKey<iSector> >::GlobalIterator GetIterator()
-        {
-            return trans.GetIterator();
-        }
-
-
-        void Set(iSector* sector, csReversibleTransform transform)
-        {
-            csReversibleTransform* transf = trans.Get(csPtrKey<iSector> (sector), NULL);
-
-            if(!transf)
-            {
-                transf = new csReversibleTransform();
-                trans.Put(csPtrKey<iSector> (sector), transf);
-            }
-
-            *transf = transform;
-        }
-
-        csReversibleTransform* Get(iSector* sector)
-        {
-            csReversibleTransform* got = trans.Get(csPtrKey<iSector> (sector), NULL);
-
-            return got;
-        }
+        csReversibleTransform transform;
+        int hops;                       ///< Portals crossed
+    };
 
-        ~sectorTransformation()
-        {
-            csHash<csReversibleTransform*, csPtrKey<iSector> >::GlobalIterator iter = trans.GetIterator();
-            while(iter.HasNext())
-                delete iter.Next();
+    csArray<iSector*> sectors;                          ///< The sectors by their dense index
+    csHash<size_t, csPtrKey<iSector> > sectorIndex;    ///< The dense index of each sector
+    csArray<csArray<size_t> > adjacent;                 ///< The sectors one portal away, by index
 
-            trans.Empty();
-        }
+    /**
+     * Index in warps of the transform from sector 'from' to sector 'to' at
+     * [from * sectors.GetSize() + to], SIZET_NOT_FOUND if they are more than
+     * warpDepth portals apart.
+     */
+    csArray<size_t> warpTable;
+    csArray<SectorWarp> warps;
+    int warpDepth;                      ///< Most portals a warp is precomputed through
 
-    };
+    /// The dense index of a sector, SIZET_NOT_FOUND if it isn't in the warp cache.
+    size_t GetSectorIndex(const iSector* sector) const
+    {
+        return sectorIndex.Get(csPtrKey<iSector> ((iSector*)sector), SIZET_NOT_FOUND);
+    }
 
-    csArray<sectorTransformation> transarray;
+    /// The warp between two different sectors, NULL if not connected.
+    const SectorWarp* GetWarp(const iSector* from, const iSector* to) const;
 
 public:
 
@@ -111,15 +95,21 @@ public:
     /// This makes a string out of all region names, separated by | chars.
     void GetAllRegionNames(csString &str);
 
-    /// Changes pos according to the warp portal between adjacent sectors from and to.
+    /**
+     * Changes pos according to the warp portals between sectors from and to,
+     * adjacent or up to Planeshift.World.WarpDepth portals apart.
+     */
     bool WarpSpace(const iSector* from, const iSector* to, csVector3 &pos);
 
-    /// Changes pos according to the warp portal between adjacent sectors from and to using a relative transformation
+    /// Changes pos according to the warp portals between sectors from and to using a relative transformation
     bool WarpSpaceRelative(const iSector* from, const iSector* to, csVector3 &pos);
 
     /// Checks whether 2 sectors are connected via a warp portal.
     bool Connected(const iSector* from, const iSector* to);
 
+    /// Appends all sectors that are connected to from via a warp portal.
+    void GetAdjacentSectors(const iSector* from, csArray<iSector*> &sectors);
+
     /// Calculate the distance between two to points either in same or different sectors.
     /// Return INFINITY_DISTANCE if no connection sectors where found
     float Distance(const csVector3 &from_pos, const iSector* from_sector, csVector3 to_pos, const iSector* to_sector);
@@ -128,6 +118,17 @@ public:
     /// Return INFINITY_DISTANCE if no connection sectors where found
     float Distance2(const csVector3 &from_pos, const iSector* from_sector, csVector3 to_pos, const iSector* to_sector);
 
+    /**
+     * Calculate the distances from one point to many, either in the same or
+     * in different sectors. The warp is looked up once per run of points in
+     * the same sector.
+     *
+     * @param distances Set to the distance to each point, INFINITY_DISTANCE
+     *                  for those in sectors not connected.
+     */
+    void Distance(const csVector3 &from_pos, const iSector* from_sector, const csArray<csVector3> &to_pos,
+                  const csArray<iSector*> &to_sectors, csArray<float> &distances);
+
     /// Calculate the distance between two meshes either in same or different sectors.
     float Distance(iMeshWrapper* ent1, iMeshWrapper* ent2);
 
@@ -160,6 +161,12 @@ public:
     }
 
     void DumpWarpCache();
+
+    /**
+     * Give each sector its index and precompute the warps between the
+     * sectors up to Planeshift.World.WarpDepth portals apart. The table
+     * of warps has an entry for each pair of sectors.
+     */
     void BuildWarpCache();
 };
 
@@ -146,8 +146,7 @@ void psNetConnection::DisConnect()
         server = NULL;
     }
     
-    // with proper refcounting this should kill all members of the hash
-    awaitingack.Empty();
+    ClearAwaitingAck();
 }
 
 
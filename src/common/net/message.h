@@ -38,6 +38,7 @@
 #include "net/packing.h"
 #include "net/pstypes.h"
 #include "util/genrefqueue.h"
+#include "util/bufferpool.h"
 
 using namespace CS::Threading;
 
@@ -157,7 +158,7 @@ public:
             datasize=MAX_MESSAGE_SIZE;
         }
 
-        bytes = (psMessageBytes*) cs_malloc(sizeof(psMessageBytes) + datasize);
+        bytes = (psMessageBytes*) BufferPool::Alloc(sizeof(psMessageBytes) + datasize);
         CS_ASSERT(bytes != NULL);
 
         current = 0;
@@ -176,7 +177,7 @@ public:
 
         current = 0;
 
-        bytes = (psMessageBytes*) cs_malloc(msgsize);
+        bytes = (psMessageBytes*) BufferPool::Alloc(msgsize);
         CS_ASSERT(bytes != NULL);
 
         memcpy (bytes, msg, msgsize);
@@ -192,7 +193,7 @@ public:
             Bug2("Call to MsgEntry copy constructor truncated data.  Source data > %u length.\n",MAX_MESSAGE_SIZE);
             msgsize = MAX_MESSAGE_SIZE;
         }
-        bytes = (psMessageBytes*) cs_malloc(msgsize);
+        bytes = (psMessageBytes*) BufferPool::Alloc(msgsize);
         CS_ASSERT(bytes != NULL);
         memcpy (bytes, me->bytes, msgsize);
 
@@ -208,7 +209,18 @@ public:
 
     virtual ~MsgEntry()
     {
-        cs_free ((void*) bytes);
+        BufferPool::Free((void*) bytes);
+    }
+
+    /// Message entries and their bytes come from the size class pools
+    void* operator new(size_t size)
+    {
+        return BufferPool::Alloc(size);
+    }
+
+    void operator delete(void* ptr)
+    {
+        BufferPool::Free(ptr);
     }
 
     void ClipToCurrentSize()
@@ -154,7 +154,8 @@ csString psPreAuthenticationMessage::ToString(NetBase::AccessPointers* /*accessP
 PSF_IMPLEMENT_MSG_FACTORY(psAuthenticationMessage,MSGTYPE_AUTHENTICATE);
 
 psAuthenticationMessage::psAuthenticationMessage(uint32_t clientnum,
-        const char* userid,const char* password, const char* os, const char* gfxcard, const char* gfxversion, const char* password256, uint32_t version)
+        const char* userid,const char* password, const char* os, const char* gfxcard, const char* gfxversion, const char* password256, uint32_t version,
+        uint32_t capabilities)
 {
 
     if(!userid || !password)
@@ -164,7 +165,7 @@ psAuthenticationMessage::psAuthenticationMessage(uint32_t clientnum,
     }
 
 
-    msg.AttachNew(new MsgEntry(strlen(userid)+1+strlen(password)+1+strlen(os)+1+strlen(gfxcard)+1+strlen(gfxversion)+1+strlen(password256)+1+sizeof(uint32_t),PRIORITY_LOW));
+    msg.AttachNew(new MsgEntry(strlen(userid)+1+strlen(password)+1+strlen(os)+1+strlen(gfxcard)+1+strlen(gfxversion)+1+strlen(password256)+1+sizeof(uint32_t)*2,PRIORITY_LOW));
 
     msg->SetType(MSGTYPE_AUTHENTICATE);
     msg->clientnum      = clientnum;
@@ -176,6 +177,7 @@ psAuthenticationMessage::psAuthenticationMessage(uint32_t clientnum,
     msg->Add(gfxcard);
     msg->Add(gfxversion);
     msg->Add(password256);
+    msg->Add(capabilities);
 
     // Sets valid flag based on message overrun state
     valid=!(msg->overrun);
@@ -196,6 +198,7 @@ psAuthenticationMessage::psAuthenticationMessage(MsgEntry* message)
     {
         sPassword256 = message->GetStr();
     }
+    capabilities = message->IsEmpty() ? 0 : message->GetUInt32();
 
     // Sets valid flag based on message overrun state
     valid=!(message->overrun);
@@ -210,8 +213,8 @@ csString psAuthenticationMessage::ToString(NetBase::AccessPointers* /*accessPoin
 {
     csString msgtext;
 
-    msgtext.AppendFmt("NetVersion: %d User: '%s' Passwd: '%s'",
-                      netversion,sUser.GetDataSafe(),sPassword.GetDataSafe());
+    msgtext.AppendFmt("NetVersion: %d User: '%s' Passwd: '%s' Caps: %x",
+                      netversion,sUser.GetDataSafe(),sPassword.GetDataSafe(),capabilities);
 
     return msgtext;
 }
@@ -5045,6 +5048,209 @@ csString psDRMessage::ToString(NetBase::AccessPointers* /*accessPointers*/)
 
 //--------------------------------------------------------------------------------
 
+void psCompactDRMessage::Write(MsgEntry* msg, const psDRRecord &record, csStringID sectorNameStrId)
+{
+    const psDRSnapshot &snapshot = record.snapshot;
+    uint16_t fields = record.fields;
+
+    msg->Add(record.entity.Unbox());
+    msg->Add(record.counter);
+    msg->Add(fields);
+    msg->Add(record.keyframe.id);
+
+    if(fields & psDRSnapshot::KEYFRAME)
+    {
+        msg->Add((uint32_t) sectorNameStrId);
+        if(sectorNameStrId == csInvalidStringID)
+            msg->Add(record.keyframe.sectorName);
+
+        for(int i = 0; i < 3; i++)
+            msg->Add(snapshot.pos[i]);
+    }
+    else if(fields & psDRSnapshot::POSITION)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            int32_t offset = snapshot.pos[i] - record.keyframe.snapshot.pos[i];
+            if(fields & psDRSnapshot::SHORT_OFFSET)
+                msg->Add((int8_t) offset);
+            else
+                msg->Add((int16_t) offset);
+        }
+    }
+
+    if(fields & psDRSnapshot::YROT)
+        msg->Add(snapshot.yrot);
+    if(fields & psDRSnapshot::MODE)
+        msg->Add(snapshot.mode);
+    if(fields & psDRSnapshot::ANG_VELOCITY)
+        msg->Add(snapshot.angVel);
+    for(int i = 0; i < 3; i++)
+    {
+        if(fields & (psDRSnapshot::X_VELOCITY << i))
+            msg->Add(snapshot.vel[i]);
+    }
+    for(int i = 0; i < 3; i++)
+    {
+        if(fields & (psDRSnapshot::X_WORLDVELOCITY << i))
+            msg->Add(snapshot.worldVel[i]);
+    }
+}
+
+psCompactDRMessage::psCompactDRMessage(MsgEntry* me, NetBase::AccessPointers* accessPointers)
+{
+    msg = NULL;
+    sector = NULL;
+
+    entityid = me->GetUInt32();
+    filterNumber = entityid.Unbox();
+    counter = me->GetUInt8();
+    fields = me->GetUInt16();
+    keyframeId = me->GetUInt8();
+
+    if(fields & psDRSnapshot::KEYFRAME)
+    {
+        csStringID sectorNameStrId = (csStringID)me->GetUInt32();
+        sectorName = (sectorNameStrId != csInvalidStringID) ? accessPointers->Request(sectorNameStrId) : me->GetStr();
+
+        for(int i = 0; i < 3; i++)
+            values.pos[i] = me->GetInt32();
+    }
+    else if(fields & psDRSnapshot::POSITION)
+    {
+        for(int i = 0; i < 3; i++)
+            values.pos[i] = (fields & psDRSnapshot::SHORT_OFFSET) ? me->GetInt8() : me->GetInt16();
+    }
+
+    if(fields & psDRSnapshot::YROT)
+        values.yrot = me->GetUInt8();
+    if(fields & psDRSnapshot::MODE)
+        values.mode = me->GetUInt8();
+    if(fields & psDRSnapshot::ANG_VELOCITY)
+        values.angVel = me->GetInt16();
+    for(int i = 0; i < 3; i++)
+    {
+        if(fields & (psDRSnapshot::X_VELOCITY << i))
+            values.vel[i] = me->GetInt16();
+    }
+    for(int i = 0; i < 3; i++)
+    {
+        if(fields & (psDRSnapshot::X_WORLDVELOCITY << i))
+            values.worldVel[i] = me->GetInt16();
+    }
+
+    // Sets valid flag based on message overrun state
+    valid=!(me->overrun);
+}
+
+bool psCompactDRMessage::Resolve(psDRKeyframe &keyframe, NetBase::AccessPointers* accessPointers)
+{
+    if(fields & psDRSnapshot::KEYFRAME)
+    {
+        // A resent keyframe may arrive after a newer one
+        if(!keyframe.IsOlderThan(keyframeId))
+            return false;
+
+        keyframe.snapshot = psDRSnapshot();
+        keyframe.snapshot.Apply(values, fields);
+        keyframe.sectorName = sectorName;
+        keyframe.id = keyframeId;
+        keyframe.valid = true;
+    }
+    else if(!keyframe.valid || keyframe.id != keyframeId)
+    {
+        return false;
+    }
+
+    psDRSnapshot state = keyframe.snapshot;
+    if(!(fields & psDRSnapshot::KEYFRAME))
+        state.Apply(values, fields);
+
+    state.Dequantize(pos, vel, worldVel, ang_vel, yrot, mode, on_ground);
+    sectorName = keyframe.sectorName;
+    sector = (sectorName.Length()) ? accessPointers->engine->GetSectors()->FindByName(sectorName) : NULL;
+    return true;
+}
+
+csString psCompactDRMessage::ToString(NetBase::AccessPointers* /*accessPointers*/)
+{
+    csString msgtext;
+
+    msgtext.AppendFmt("EID: %d C: %d ",entityid.Unbox(),counter);
+    msgtext.AppendFmt("Fields: %x Keyframe: %d ",fields,keyframeId);
+    if(fields & psDRSnapshot::KEYFRAME)
+    {
+        msgtext.AppendFmt("Sector: %s ",sectorName.GetDataSafe());
+        msgtext.AppendFmt("Pos(%.2f,%.2f,%.2f) ",values.pos[0] / DR_POSITION_SCALE,
+                          values.pos[1] / DR_POSITION_SCALE, values.pos[2] / DR_POSITION_SCALE);
+    }
+    else if(fields & psDRSnapshot::POSITION)
+    {
+        msgtext.AppendFmt("Offset(%.2f,%.2f,%.2f) ",values.pos[0] / DR_POSITION_SCALE,
+                          values.pos[1] / DR_POSITION_SCALE, values.pos[2] / DR_POSITION_SCALE);
+    }
+
+    return msgtext;
+}
+
+//--------------------------------------------------------------------------------
+
+PSF_IMPLEMENT_MSG_FACTORY_ACCESS_POINTER(psWorldUpdateMessage,MSGTYPE_WORLD_UPDATE);
+
+psWorldUpdateMessage::psWorldUpdateMessage(uint32_t client, const csArray<psDRRecord> &drRecords, size_t bytes,
+                                           NetBase::AccessPointers* accessPointers)
+{
+    // The keyframes name their sector, by string id when there is one
+    csArray<csStringID> sectorNameStrIds;
+    size_t size = DR_RECORDS_HEADER_SIZE + bytes;
+    for(size_t i = 0; i < drRecords.GetSize(); i++)
+    {
+        csStringID sectorNameStrId = csInvalidStringID;
+        if(drRecords[i].fields & psDRSnapshot::KEYFRAME)
+        {
+            sectorNameStrId = accessPointers->Request(drRecords[i].keyframe.sectorName);
+            if(sectorNameStrId == csInvalidStringID)
+                size += drRecords[i].keyframe.sectorName.Length() + 1;
+        }
+        sectorNameStrIds.Push(sectorNameStrId);
+    }
+
+    msg.AttachNew(new MsgEntry(size));
+
+    msg->SetType(MSGTYPE_WORLD_UPDATE);
+    msg->clientnum = client;
+
+    msg->Add((uint16_t) drRecords.GetSize());
+    for(size_t i = 0; i < drRecords.GetSize(); i++)
+        psCompactDRMessage::Write(msg, drRecords[i], sectorNameStrIds[i]);
+
+    // Sets valid flag based on message overrun state
+    valid=!(msg->overrun);
+}
+
+psWorldUpdateMessage::psWorldUpdateMessage(MsgEntry* me, NetBase::AccessPointers* accessPointers)
+{
+    uint16_t count = me->GetUInt16();
+    for(uint16_t i = 0; i < count && !me->overrun; i++)
+        records.Push(new psCompactDRMessage(me, accessPointers));
+
+    // Sets valid flag based on message overrun state
+    valid=!(me->overrun);
+}
+
+csString psWorldUpdateMessage::ToString(NetBase::AccessPointers* accessPointers)
+{
+    csString msgtext;
+
+    msgtext.AppendFmt("Records: %zu ",records.GetSize());
+    for(size_t i = 0; i < records.GetSize(); i++)
+        msgtext.AppendFmt("[%s] ",records[i]->ToString(accessPointers).GetData());
+
+    return msgtext;
+}
+
+//--------------------------------------------------------------------------------
+
 PSF_IMPLEMENT_MSG_FACTORY_ACCESS_POINTER(psForcePositionMessage, MSGTYPE_FORCE_POSITION);
 
 psForcePositionMessage::psForcePositionMessage(uint32_t client, uint8_t sequenceNumber,
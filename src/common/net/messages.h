@@ -32,6 +32,8 @@
 #include "rpgrules/psmoney.h"
 #include "util/psconst.h"
 #include "util/skillcache.h"
+#include "util/drsnapshot.h"
+#include "util/drqueue.h"
 #include <ivideo/graph3d.h>
 
 #include "bulkobjects/activespell.h"
@@ -52,6 +54,18 @@ class csStringHashReversible;
 #define PS_NETVERSION   0x00B9
 // Remember to bump the version in pscssetup.h, as well.
 
+/**
+ * Optional features of the protocol a client asks for when it authenticates.
+ * Clients asking for none keep the formats of PS_NETVERSION.
+ */
+enum NetCapabilities
+{
+    NETCAPS_COMPACT_DR = 1 << 0     ///< Receives the dead reckoning in psWorldUpdateMessage
+};
+
+/// The features this client supports
+#define PS_NETCAPS  NETCAPS_COMPACT_DR
+
 
 // NPC Networking version is separate so we don't have to break compatibility
 // with clients to enhance the superclients.  Made it a large number to ensure
@@ -292,7 +306,9 @@ enum MSG_TYPES
 
     MSGTYPE_ATTACK_QUEUE,
     MSGTYPE_ATTACK_BOOK,
-    MSGTYPE_SPECCOMBATEVENT
+    MSGTYPE_SPECCOMBATEVENT,
+
+    MSGTYPE_WORLD_UPDATE
 };
 
 class psMessageCracker;
@@ -592,6 +608,7 @@ public:
     csString  sUser,sPassword;
     csString  sPassword256;
     csString  os_, gfxcard_, gfxversion_;
+    uint32_t  capabilities;     ///< NetCapabilities asked for, 0 from older clients
 
     /**
      * This function creates a PS Message struct given a userid and
@@ -599,7 +616,8 @@ public:
      * creation when a user wants to log in.
      */
     psAuthenticationMessage(uint32_t clientnum,const char* userid,
-                            const char* password, const char* os, const char* gfxcard, const char* gfxversion, const char* sPassword256 = "", uint32_t version=PS_NETVERSION);
+                            const char* password, const char* os, const char* gfxcard, const char* gfxversion, const char* sPassword256 = "", uint32_t version=PS_NETVERSION,
+                            uint32_t capabilities = 0);
 
     /**
      * This constructor receives a PS Message struct and cracks it apart
@@ -3186,6 +3204,71 @@ public:
     virtual csString ToString(NetBase::AccessPointers* accessPointers);
 };
 
+/**
+ * Dead reckoning of an entity to a client that asked for NETCAPS_COMPACT_DR,
+ * one of the records of a psWorldUpdateMessage.
+ *
+ * The state is quantized by psDRSnapshot and has only the fields differing
+ * from the last keyframe of the entity that client was sent, see the design
+ * notes of psDRSnapshot. Once cracked, Resolve() with the keyframe kept by
+ * the receiver fills the members of psDRMessage.
+ */
+class psCompactDRMessage : public psDRMessage
+{
+public:
+    uint16_t fields;            ///< psDRSnapshot::Fields in this record
+    uint8_t keyframeId;         ///< Keyframe this record is or is sent against
+    psDRSnapshot values;        ///< Fields as sent, the position is an offset unless a keyframe
+
+    /// Read a record from the current position of a message.
+    psCompactDRMessage(MsgEntry* me, NetBase::AccessPointers* accessPointers);
+
+    /**
+     * Write a record taken from a psDRQueue.
+     *
+     * @param sectorNameStrId The string id of the sector name of a keyframe.
+     */
+    static void Write(MsgEntry* msg, const psDRRecord &record, csStringID sectorNameStrId);
+
+    /**
+     * Apply this record on the keyframe the receiver has of the entity and
+     * set the state of psDRMessage. A keyframe replaces an older one.
+     *
+     * @return False if this record is sent against another keyframe than
+     *         the one received, or is an outdated keyframe.
+     */
+    bool Resolve(psDRKeyframe &keyframe, NetBase::AccessPointers* accessPointers);
+
+    virtual csString ToString(NetBase::AccessPointers* accessPointers);
+};
+
+/**
+ * The dead reckoning updates a client asking for NETCAPS_COMPACT_DR is sent
+ * in a world update tick, see the design notes of psDRQueue.
+ */
+class psWorldUpdateMessage : public psMessageCracker
+{
+public:
+    csPDelArray<psCompactDRMessage> records;
+
+    /**
+     * @param bytes The size of the records, as returned by psDRQueue::Collect().
+     */
+    psWorldUpdateMessage(uint32_t client, const csArray<psDRRecord> &drRecords, size_t bytes,
+                         NetBase::AccessPointers* accessPointers);
+    psWorldUpdateMessage(MsgEntry* me, NetBase::AccessPointers* accessPointers);
+
+    PSF_DECLARE_MSG_FACTORY();
+
+    /**
+     *  Converts the message into human readable string.
+     *
+     * @param accessPointers A struct to a number of access pointers.
+     * @return Return a human readable string for the message.
+     */
+    virtual csString ToString(NetBase::AccessPointers* accessPointers);
+};
+
 //-----------------------------------------------------------------------------
 
 class psForcePositionMessage : public psMessageCracker
@@ -0,0 +1,160 @@
+/*
+ * metricsexporter.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <string.h>
+
+#include <csutil/threading/atomicops.h>
+
+#include "net/metricsexporter.h"
+#include "util/log.h"
+
+psMetricsExporter::psMetricsExporter(iMetricsSource* source)
+    : source(source), sock(INVALID_SOCKET), running(0)
+{
+}
+
+psMetricsExporter::~psMetricsExporter()
+{
+    Stop();
+}
+
+bool psMetricsExporter::Start(int port)
+{
+    if (thread)
+        return true;
+
+    sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (sock == INVALID_SOCKET)
+    {
+        Error1("Could not open the metrics socket");
+        return false;
+    }
+
+    int reuse = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, (const char*) &reuse, sizeof(reuse));
+
+    SOCKADDR_IN addr;
+    memset(&addr, 0, sizeof(SOCKADDR_IN));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (bind(sock, (LPSOCKADDR) &addr, sizeof(SOCKADDR_IN)) < 0 || listen(sock, 4) < 0)
+    {
+        Error2("Could not listen for metrics on port %d", port);
+        SOCK_CLOSE(sock);
+        sock = INVALID_SOCKET;
+        return false;
+    }
+
+    CS::Threading::AtomicOperations::Set(&running, 1);
+    thread.AttachNew(new CS::Threading::Thread(this));
+    thread->Start();
+    return true;
+}
+
+void psMetricsExporter::Stop()
+{
+    if (!thread)
+        return;
+
+    CS::Threading::AtomicOperations::Set(&running, 0);
+    thread->Wait();
+    thread.Invalidate();
+
+    SOCK_CLOSE(sock);
+    sock = INVALID_SOCKET;
+}
+
+void psMetricsExporter::Run()
+{
+    while (CS::Threading::AtomicOperations::Read(&running))
+    {
+        // Wake up now and then to see if the exporter is stopped
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(sock, &set);
+        struct timeval timeout;
+        timeout.tv_sec = METRICS_POLL_INTERVAL / 1000;
+        timeout.tv_usec = (METRICS_POLL_INTERVAL % 1000) * 1000;
+
+        if (SOCK_SELECT(sock + 1, &set, NULL, NULL, &timeout) <= 0)
+            continue;
+
+        SOCKET client = accept(sock, NULL, NULL);
+        if (client == INVALID_SOCKET)
+            continue;
+
+        Serve(client);
+        SOCK_CLOSE(client);
+    }
+}
+
+void psMetricsExporter::Serve(SOCKET client)
+{
+    // Read the request up to the empty line, whatever it asks for
+    char request[1024];
+    size_t length = 0;
+    while (length < sizeof(request) - 1)
+    {
+        fd_set set;
+        FD_ZERO(&set);
+        FD_SET(client, &set);
+        struct timeval timeout;
+        timeout.tv_sec = METRICS_REQUEST_TIMEOUT / 1000;
+        timeout.tv_usec = (METRICS_REQUEST_TIMEOUT % 1000) * 1000;
+
+        if (SOCK_SELECT(client + 1, &set, NULL, NULL, &timeout) <= 0)
+            return;
+
+        int received = recv(client, request + length, (int)(sizeof(request) - 1 - length), 0);
+        if (received <= 0)
+            return;
+
+        length += received;
+        request[length] = '\0';
+        if (strstr(request, "\r\n\r\n") || strstr(request, "\n\n"))
+            break;
+    }
+
+    csString body = source->ExportMetrics();
+    csString response;
+    response.Format("HTTP/1.0 200 OK\r\n"
+                    "Content-Type: text/plain; version=0.0.4\r\n"
+                    "Content-Length: %zu\r\n"
+                    "Connection: close\r\n\r\n", body.Length());
+    response.Append(body);
+
+    // A collector going away must not raise SIGPIPE
+    int flags = 0;
+#ifdef MSG_NOSIGNAL
+    flags = MSG_NOSIGNAL;
+#endif
+
+    const char* data = response.GetData();
+    size_t left = response.Length();
+    while (left)
+    {
+        int sent = send(client, data, (int)left, flags);
+        if (sent <= 0)
+            return;
+        data += sent;
+        left -= sent;
+    }
+}
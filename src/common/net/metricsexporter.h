@@ -0,0 +1,94 @@
+/*
+ * metricsexporter.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ * Serves the profiles of the server as text to a metrics collector
+ */
+#ifndef __METRICSEXPORTER_H__
+#define __METRICSEXPORTER_H__
+
+#include <cstypes.h>
+#include <csutil/csstring.h>
+#include <csutil/ref.h>
+#include <csutil/threading/thread.h>
+
+/* Include platform specific socket settings */
+#ifdef USE_WINSOCK
+#   include "net/sockwin.h"
+#endif
+#ifdef USE_UNISOCK
+#   include "net/sockuni.h"
+#endif
+
+/**
+ * \addtogroup common_net
+ * @{ */
+
+/// Milliseconds between two checks of the exporter for being stopped
+#define METRICS_POLL_INTERVAL 250
+/// Milliseconds a collector has to send its request
+#define METRICS_REQUEST_TIMEOUT 1000
+
+/**
+ * Gives the text served by the psMetricsExporter.
+ */
+class iMetricsSource
+{
+public:
+    virtual ~iMetricsSource() {}
+
+    /**
+     * Return the metrics, one "name{labels} value" per line, see
+     * psOperProfileSet::Export(). Called from the exporter thread.
+     */
+    virtual csString ExportMetrics() = 0;
+};
+
+/**
+ * Answers each HTTP request on a loopback port with the metrics of an
+ * iMetricsSource, so a collector can pull them while the server runs.
+ *
+ * Only the loopback interface is listened on, the metrics are meant for a
+ * collector on the same host. One request is served at a time, from a
+ * thread of its own.
+ */
+class psMetricsExporter : public CS::Threading::Runnable
+{
+public:
+    psMetricsExporter(iMetricsSource* source);
+    virtual ~psMetricsExporter();
+
+    /// Listen on a port of the loopback interface, false if it can't be bound.
+    bool Start(int port);
+
+    /// Stop listening and wait for the thread.
+    void Stop();
+
+    virtual void Run();
+
+private:
+    /// Read the request and answer it with the metrics.
+    void Serve(SOCKET client);
+
+    iMetricsSource* source;
+    SOCKET sock;
+    int32 running;
+    csRef<CS::Threading::Thread> thread;
+};
+
+/** @} */
+
+#endif
@@ -131,6 +131,9 @@ NetBase::NetBase(int outqueuesize)
     logmsgfiltersetting.send = false;
 
     input_buffer = NULL;
+#ifdef NET_HAVE_BATCHED_IO
+    batchedIO = NULL;
+#endif
     for(int i=0;i < NETAVGCOUNT;i++)
     {
         sendStats[i].senders = sendStats[i].messages = sendStats[i].time = 0;
@@ -162,7 +165,13 @@ NetBase::~NetBase()
     delete profs;
 
     if (input_buffer)
-        cs_free(input_buffer);
+        BufferPool::Free(input_buffer);
+
+#ifdef NET_HAVE_BATCHED_IO
+    delete batchedIO;
+#endif
+
+    ClearAwaitingAck();
 }
 
 
@@ -188,6 +197,48 @@ void NetBase::ProcessNetwork (csTicks timeout)
         // Outgoing packets from a queue go on the wire.
         ) && csGetTicks() <= timeout
         );
+
+#ifdef NET_HAVE_BATCHED_IO
+    // Acks queued by the last CheckIn() calls
+    if (batchedIO)
+        batchedIO->Flush();
+#endif
+}
+
+
+bool NetBase::SetBatchedIO(bool enable)
+{
+#ifdef NET_HAVE_BATCHED_IO
+    if (!enable)
+    {
+        delete batchedIO;
+        batchedIO = NULL;
+        return true;
+    }
+
+    if (!batchedIO)
+        batchedIO = new psNetBatchedIO;
+
+    if (!batchedIO->Open(mysocket, pipe_fd[0]))
+    {
+        delete batchedIO;
+        batchedIO = NULL;
+        return false;
+    }
+    return true;
+#else
+    return !enable;
+#endif
+}
+
+
+bool NetBase::IsBatchedIO()
+{
+#ifdef NET_HAVE_BATCHED_IO
+    return batchedIO != NULL;
+#else
+    return false;
+#endif
 }
 
 
@@ -200,11 +251,11 @@ bool NetBase::CheckIn()
 
     if (!input_buffer)
     {
-        input_buffer = (char*) cs_malloc(MAXPACKETSIZE);
+        input_buffer = (char*) BufferPool::Alloc(MAXPACKETSIZE);
 
         if (!input_buffer)
         {
-            Error2("Failed to cs_malloc %d bytes for packet buffer!\n",MAXPACKETSIZE);
+            Error2("Failed to allocate %d bytes for packet buffer!\n",MAXPACKETSIZE);
             return false;
         }
     }
@@ -212,7 +263,21 @@ bool NetBase::CheckIn()
     // Connection must be initialized!
     CS_ASSERT(ready);
     
-    int packetlen = RecvFrom (&addr, &len, (void*) input_buffer, MAXPACKETSIZE);
+    int packetlen;
+#ifdef NET_HAVE_BATCHED_IO
+    if (batchedIO)
+    {
+        // Swaps input_buffer with the buffer holding the next datagram of the batch
+        packetlen = batchedIO->Receive(&addr, input_buffer, timeout.tv_sec * 1000 + timeout.tv_usec / 1000);
+        if (packetlen > 0)
+        {
+            totaltransferin += packetlen;
+            totalcountin++;
+        }
+    }
+    else
+#endif
+        packetlen = RecvFrom (&addr, &len, (void*) input_buffer, MAXPACKETSIZE);
 
     if (packetlen <= 0)
     {
@@ -315,7 +380,7 @@ bool NetBase::CheckIn()
 
         if (packet->offset == 0) 
         {
-            psMessageBytes* msg = (psMessageBytes*) packet->data;
+            const psMessageBytes* msg = (const psMessageBytes*) pkt->GetPacketData();
             type = msg->type;
         }
 
@@ -452,7 +517,7 @@ bool NetBase::HandleAck(psNetPacketEntry* pkt, Connection* connection,
             // printf ("Ping time: %i, average: %i\n", elapsed, netInfos.GetAveragePingTicks());
 
 
-            if (!awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), ack))
+            if (!RemoveAwaitingAck(ack))
             {
 #ifdef PACKETDEBUG
                 Debug2(LOG_NET,0,"No packet in ack queue :%d\n", ack->packet->pktid);
@@ -526,10 +591,131 @@ bool NetBase::CheckDoublePackets(Connection* connection, psNetPacketEntry* pkt)
 }
 
 
+void NetBase::AddAwaitingAck(psNetPacketEntry* pkt)
+{
+    awaitingack.Put(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt);
+    ScheduleResend(pkt);
+}
+
+
+bool NetBase::RemoveAwaitingAck(psNetPacketEntry* pkt)
+{
+    RemoveResend(pkt);
+    return awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt);
+}
+
+
+void NetBase::ScheduleResend(psNetPacketEntry* pkt)
+{
+    pkt->resendDeadline = pkt->timestamp + csMin((csTicks)PKTMAXRTO, pkt->RTO);
+    if (pkt->resendIndex == csArrayItemNotFound)
+    {
+        pkt->resendIndex = resendQueue.Push(pkt);
+        SiftResendUp(pkt->resendIndex);
+    }
+    else
+    {
+        SiftResendUp(pkt->resendIndex);
+        SiftResendDown(pkt->resendIndex);
+    }
+}
+
+
+void NetBase::GetExpiredPackets(csTicks currenttime, csArray<csRef<psNetPacketEntry> > &pkts)
+{
+    while (resendQueue.GetSize())
+    {
+        psNetPacketEntry* pkt = resendQueue[0];
+
+        // Check the connection packet timeout
+        if ((int32)(pkt->resendDeadline - currenttime) >= 0)
+            break;
+
+        pkts.Push(pkt);
+        RemoveResend(pkt);
+    }
+}
+
+
+void NetBase::ClearAwaitingAck()
+{
+    for (size_t i = 0; i < resendQueue.GetSize(); i++)
+    {
+        resendQueue[i]->resendIndex = csArrayItemNotFound;
+    }
+    resendQueue.Empty();
+
+    // with proper refcounting this should kill all members of the hash
+    awaitingack.Empty();
+}
+
+
+void NetBase::RemoveResend(psNetPacketEntry* pkt)
+{
+    size_t i = pkt->resendIndex;
+    if (i == csArrayItemNotFound)
+        return;
+
+    pkt->resendIndex = csArrayItemNotFound;
+    psNetPacketEntry* last = resendQueue.Pop();
+    if (last != pkt)
+    {
+        // The last one takes the place of the removed one
+        resendQueue[i] = last;
+        last->resendIndex = i;
+        SiftResendUp(i);
+        SiftResendDown(last->resendIndex);
+    }
+}
+
+
+void NetBase::SiftResendUp(size_t i)
+{
+    // Compare the difference so the order survives the wrap of the ticks
+    psNetPacketEntry* pkt = resendQueue[i];
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if ((int32)(pkt->resendDeadline - resendQueue[parent]->resendDeadline) >= 0)
+            break;
+
+        resendQueue[i] = resendQueue[parent];
+        resendQueue[i]->resendIndex = i;
+        i = parent;
+    }
+    resendQueue[i] = pkt;
+    pkt->resendIndex = i;
+}
+
+
+void NetBase::SiftResendDown(size_t i)
+{
+    psNetPacketEntry* pkt = resendQueue[i];
+    size_t size = resendQueue.GetSize();
+    while (true)
+    {
+        size_t child = 2 * i + 1;
+        if (child >= size)
+            break;
+
+        if (child + 1 < size &&
+            (int32)(resendQueue[child + 1]->resendDeadline - resendQueue[child]->resendDeadline) < 0)
+            child++;
+
+        if ((int32)(resendQueue[child]->resendDeadline - pkt->resendDeadline) >= 0)
+            break;
+
+        resendQueue[i] = resendQueue[child];
+        resendQueue[i]->resendIndex = i;
+        i = child;
+    }
+    resendQueue[i] = pkt;
+    pkt->resendIndex = i;
+}
+
+
 void NetBase::CheckResendPkts()
 {
-    // NOTE: Globaliterators on csHash do not retrieve keys contiguously.
-    csHash<csRef<psNetPacketEntry> , PacketKey>::GlobalIterator it(awaitingack.GetIterator());
     csRef<psNetPacketEntry> pkt;
     csArray<csRef<psNetPacketEntry> > pkts;
     csArray<Connection*> resentConnections;
@@ -537,13 +723,8 @@ void NetBase::CheckResendPkts()
     csTicks currenttime = csGetTicks();
     unsigned int resentCount = 0;
 
-    while(it.HasNext())
-    {
-        pkt = it.Next();
-        // Check the connection packet timeout
-        if (pkt->timestamp + csMin((csTicks)PKTMAXRTO, pkt->RTO) < currenttime)
-            pkts.Push(pkt);
-    }
+    GetExpiredPackets(currenttime, pkts);
+
     for (size_t i = 0; i < pkts.GetSize(); i++)
     {
         pkt = pkts.Get(i);
@@ -577,7 +758,7 @@ void NetBase::CheckResendPkts()
             //printf("pkt=%p, pkt->packet=%p\n",pkt,pkt->packet);
             // take out of awaiting ack pool.
             // This does NOT delete the pkt mem block itself.
-            if (!awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt))
+            if (!RemoveAwaitingAck(pkt))
             {
 #ifdef PACKETDEBUG
                 Debug2(LOG_NET,0,"No packet in ack queue :%d\n", pkt->packet->pktid);
@@ -588,6 +769,11 @@ void NetBase::CheckResendPkts()
                 connection->RemoveFromWindow(pkt->packet->GetPacketSize());
             }
         }
+        else
+        {
+            // Still awaiting ack, try again when the doubled timeout expires
+            ScheduleResend(pkt);
+        }
     }
 
     if(resentCount > 0)
@@ -707,7 +893,7 @@ bool NetBase::SendSinglePacket(psNetPacketEntry* pkt)
             connection->sends++;
             // Set timeout for resending.
             pkt->RTO = connection->RTO;
-            awaitingack.Put(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt);
+            AddAwaitingAck(pkt);
         }
     }
 
@@ -715,7 +901,7 @@ bool NetBase::SendSinglePacket(psNetPacketEntry* pkt)
 }
 
 
-bool NetBase::SendFinalPacket(psNetPacketEntry* pkt)
+bool NetBase::SendFinalPacket(psNetPacketEntry* pkt, bool direct)
 {
     Connection* connection = GetConnByNum(pkt->clientnum);
     if (!connection)
@@ -731,12 +917,31 @@ bool NetBase::SendFinalPacket(psNetPacketEntry* pkt)
     {
         pkt->packet->pktid = connection->GetNextPacketID();
     }
-    return SendFinalPacket(pkt,&(connection->addr));
+    return SendFinalPacket(pkt,&(connection->addr),direct);
     
 }
 
 
-bool NetBase::SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr)
+int NetBase::WriteDatagram(LPSOCKADDR_IN addr, const void *data, unsigned int size, bool direct)
+{
+#ifdef NET_HAVE_BATCHED_IO
+    if (batchedIO && !direct)
+    {
+        // The datagram is copied into the batch, so the caller may reuse the data
+        int queued = batchedIO->Send(addr, data, size);
+        if (queued > 0)
+        {
+            totaltransferout += size;
+            totalcountout++;
+        }
+        return queued;
+    }
+#endif
+    return SendTo (addr, data, size);
+}
+
+
+bool NetBase::SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr, bool direct)
 {
     // send packet...
 #ifdef PACKETDEBUG
@@ -747,11 +952,28 @@ bool NetBase::SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr)
     // printf("Sending packet sequence %d, length %d on the wire.\n", pkt->packet->GetSequence(),pkt->packet->GetPacketSize() );
 
     uint16_t size = (uint16_t)pkt->packet->GetPacketSize();
+
+    if (pkt->payload)
+    {
+        // The data is shared with the packets of the other recipients, so
+        // assemble the wire format in a local buffer instead of in place.
+        char buffer[MAXPACKETSIZE];
+        pkt->CopyToWire(buffer);
+
+        int err = WriteDatagram (addr, buffer, size, direct);
+        if (err != (int)size )
+        {
+            Error4("Send error %d: %d bytes sent and %d bytes expected to be sent.\n", errno,err,size);
+            return false;
+        }
+        return true;
+    }
+
     void *data = pkt->GetData();
 
     pkt->packet->MarshallEndian();
 
-    int err = SendTo (addr, data, size);
+    int err = WriteDatagram (addr, data, size, direct);
     if (err != (int)size )
     {
         Error4("Send error %d: %d bytes sent and %d bytes expected to be sent.\n", errno,err,size);
@@ -799,6 +1021,11 @@ bool NetBase::SendOut()
     for(size_t i = 0; i < readd.GetSize(); i++)
         senders.Add(readd[i]);
 
+#ifdef NET_HAVE_BATCHED_IO
+    if (batchedIO)
+        batchedIO->Flush();
+#endif
+
     // Statistics updating
     csTicks timeTaken = csGetTicks() - begin;
     sendStats[avgIndex].senders = senderCount;
@@ -953,6 +1180,11 @@ bool NetBase::Bind (const IN_ADDR &addr, int port)
 
 void NetBase::Close(bool force)
 {
+#ifdef NET_HAVE_BATCHED_IO
+    if (batchedIO)
+        batchedIO->Close();
+#endif
+
     if (ready || force)
         SOCK_CLOSE(mysocket); 
 
@@ -1261,6 +1493,43 @@ bool NetBase::SendMessage(MsgEntry* me,NetPacketQueueRefCount *queue)
 }
 
 
+bool NetBase::SendMessage(MsgEntry* me, NetPacketQueueRefCount *queue, psNetPacketPayload* payload)
+{
+    profs->AddSentMsg(me);
+
+    size_t bytesleft = payload->GetSize();
+    size_t offset    = 0;
+    uint32_t id = 0;
+
+    LogMessages('S',me);
+
+    // fragments must have the same packet id
+    if (bytesleft > MAXPACKETSIZE-sizeof(struct psNetPacket))
+        id = GetRandomID();
+
+    while (bytesleft > 0)
+    {
+        size_t pktlen = csMin(MAXPACKETSIZE-sizeof(struct psNetPacket), bytesleft);
+
+        // Only the header is allocated, the bytes are referenced from the payload
+        csRef<psNetPacketEntry> pNewPkt;
+        pNewPkt.AttachNew(new psNetPacketEntry(me->priority, me->clientnum, id, (uint16_t)offset,
+          (uint16_t)payload->GetSize(), (uint16_t)pktlen, payload));
+
+        if (!queue->Add(pNewPkt))
+        {
+            Error2("Target full. Could not add packet with clientnum %d.\n", me->clientnum);
+            return false;
+        }
+
+        bytesleft -= pktlen;
+        offset    += pktlen;
+    }
+
+    return true;
+}
+
+
 void NetBase::CheckFragmentTimeouts(void)
 {
     csRef<psNetPacketEntry> pkt;
@@ -1342,7 +1611,7 @@ bool NetBase::BuildMessage(psNetPacketEntry* pkt, Connection* &connection,
             return false;
         }
 
-        psMessageBytes* msg = (psMessageBytes*) packet->data;
+        const psMessageBytes* msg = (const psMessageBytes*) pkt->GetPacketData();
         // The packet's report of the message size should agree with the message header
         if (packet->msgsize != msg->GetTotalSize())
         {
@@ -1441,7 +1710,7 @@ csPtr<MsgEntry> NetBase::CheckCompleteMessage(uint32_t client, uint32_t id)
 
 
         // Copy the contents into the total message data in the right location
-        memcpy( ((char *)(me->bytes)) + pkt->packet->offset, pkt->packet->data,
+        memcpy( ((char *)(me->bytes)) + pkt->packet->offset, pkt->GetPacketData(),
             pkt->packet->pktsize);
         // Add to our length count
         length += pkt->packet->pktsize;
@@ -25,6 +25,7 @@
 #include "net/pstypes.h"
 #include "net/netinfos.h"
 #include "net/netpacket.h"
+#include "net/netbatchio.h"
 #include "util/genrefqueue.h"
 #include <csutil/ref.h>
 #include <csutil/weakref.h>
@@ -171,6 +172,13 @@ public:
     virtual bool SendMessage (MsgEntry* me);
     virtual bool SendMessage (MsgEntry* me,NetPacketQueueRefCount *queue);
 
+    /**
+     * Put a message into the outgoing queue of one recipient, the packets
+     * reference the bytes in the payload instead of copying them. Used to
+     * send the same message to many clients.
+     */
+    bool SendMessage (MsgEntry* me, NetPacketQueueRefCount *queue, psNetPacketPayload* payload);
+
     /**
      * Broadcast a message, DON'T USE this function, it's only for MsgHandler!
      */
@@ -199,6 +207,23 @@ public:
      */
     bool IsReady()  { return ready; }
 
+    /**
+     * Switch between the select/sendto socket I/O and the batched
+     * epoll/recvmmsg/sendmmsg backend. Must be called after Init() and
+     * before the network thread starts processing.
+     * @return false if the batched backend is not available on this
+     *     platform or could not be set up.
+     */
+    bool SetBatchedIO(bool enable);
+
+    /** Is the batched socket backend in use? */
+    bool IsBatchedIO();
+
+#ifdef NET_HAVE_BATCHED_IO
+    /** Get the batched socket backend for statistics, NULL if not in use */
+    psNetBatchedIO* GetBatchedIO() { return batchedIO; }
+#endif
+
     /**
      * This adds a completed message to any queues that are signed up.
      */
@@ -402,7 +427,7 @@ protected:
          */
         while (retries++ < SENDTO_MAX_RETRIES && sentbytes==-1 && (errno==EAGAIN || errno==WSAEWOULDBLOCK))
         {
-            printf("In while loop on EAGAIN... retry #%d.\n", retries);
+            Debug2(LOG_NET,0,"In while loop on EAGAIN... retry #%d.\n", retries);
 
             // Clear the file descriptor set
             FD_ZERO(&wfds);
@@ -583,12 +608,58 @@ protected:
     /**
      * Send packet to the clientnum given by clientnum in psNetPacketEntry
      */
-    bool SendFinalPacket(psNetPacketEntry* pkt);
+    bool SendFinalPacket(psNetPacketEntry* pkt, bool direct = false);
 
     /**
      * This only sends out a packet
+     *
+     * @param direct Bypass the outgoing batch of the batched backend, must
+     *     be set when not called from the network thread.
+     */
+    bool SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr, bool direct = false);
+
+    /**
+     * Put a datagram on the wire, or in the outgoing batch when the
+     * batched backend is in use and direct is not set.
+     */
+    int WriteDatagram(LPSOCKADDR_IN addr, const void *data, unsigned int size, bool direct);
+
+    /**
+     * Put a sent HIGH priority packet in the awaiting ack pool and schedule
+     * it for resending.
+     */
+    void AddAwaitingAck(psNetPacketEntry* pkt);
+
+    /**
+     * Remove a packet from the awaiting ack pool and from the resend queue.
+     * @return true if the packet was in the pool.
+     */
+    bool RemoveAwaitingAck(psNetPacketEntry* pkt);
+
+    /**
+     * Schedule a packet that stays in the awaiting ack pool for another
+     * resend check at timestamp + RTO.
      */
-    bool SendFinalPacket(psNetPacketEntry* pkt, LPSOCKADDR_IN addr);
+    void ScheduleResend(psNetPacketEntry* pkt);
+
+    /**
+     * Take all the packets whose resend timeout expired before currenttime
+     * out of the resend queue. The packets are still in the awaiting ack
+     * pool, they have to be removed or scheduled again.
+     */
+    void GetExpiredPackets(csTicks currenttime, csArray<csRef<psNetPacketEntry> > &pkts);
+
+    /** Empty the awaiting ack pool and the resend queue */
+    void ClearAwaitingAck();
+
+    /** Take a packet out of the resend queue if it is in it. */
+    void RemoveResend(psNetPacketEntry* pkt);
+
+    /** Move the packet at position i of the resend queue up to its place. */
+    void SiftResendUp(size_t i);
+
+    /** Move the packet at position i of the resend queue down to its place. */
+    void SiftResendDown(size_t i);
 
     /** Outgoing message queue */
     csRef<NetPacketQueueRefCount> NetworkQueue;
@@ -602,6 +673,16 @@ protected:
     /** Packets Awaiting Ack pool */
     csHash<csRef<psNetPacketEntry>, PacketKey> awaitingack;
 
+    /**
+     * The packets of the awaiting ack pool ordered by their resend deadline,
+     * a binary min heap so a check only looks at the expired packets. Each
+     * packet keeps its position, an acked packet is taken out at once and
+     * freed with the last reference of the pool instead of staying until
+     * its deadline. The pool holds the references, a packet is only queued
+     * while it is in the pool.
+     */
+    csArray<psNetPacketEntry*> resendQueue;
+
     /** System Socket lib initialized? */
     static int socklibrefcount;
 
@@ -666,6 +747,11 @@ private:
     LogMsgFilterSetting_t logmsgfiltersetting;
 
     char* input_buffer;
+
+#ifdef NET_HAVE_BATCHED_IO
+    /** The batched socket backend, NULL when select/sendto is used */
+    psNetBatchedIO* batchedIO;
+#endif
 };
 
 
@@ -0,0 +1,266 @@
+/*
+ * netbatchio.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include "net/netbatchio.h"
+
+#ifdef NET_HAVE_BATCHED_IO
+
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <sys/epoll.h>
+
+#include "util/log.h"
+#include "util/bufferpool.h"
+#include "net/netbase.h"
+#include "net/netpacket.h"
+
+psNetBatchedIO::psNetBatchedIO()
+{
+    mysocket = 0;
+    wakeup = 0;
+    epollfd = -1;
+
+    for(int i = 0; i < NET_IO_BATCH_SIZE; i++)
+        recvBuffers[i] = NULL;
+    recvCount = recvNext = 0;
+
+    sendBuffers = (char*) cs_malloc(NET_IO_BATCH_SIZE * MAXPACKETSIZE);
+    sendCount = 0;
+
+    syscalls = packetsIn = packetsOut = droppedOut = 0;
+}
+
+psNetBatchedIO::~psNetBatchedIO()
+{
+    Close();
+
+    for(int i = 0; i < NET_IO_BATCH_SIZE; i++)
+    {
+        if(recvBuffers[i])
+            BufferPool::Free(recvBuffers[i]);
+    }
+    cs_free(sendBuffers);
+}
+
+bool psNetBatchedIO::Open(SOCKET sock, SOCKET wakeupfd)
+{
+    Close();
+
+    epollfd = epoll_create(2);
+    if(epollfd < 0)
+    {
+        Error2("epoll_create failed with errno=%d", errno);
+        return false;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = sock;
+    if(epoll_ctl(epollfd, EPOLL_CTL_ADD, sock, &ev) < 0)
+    {
+        Error2("epoll_ctl failed with errno=%d", errno);
+        close(epollfd);
+        epollfd = -1;
+        return false;
+    }
+
+    if(wakeupfd > 0)
+    {
+        ev.data.fd = wakeupfd;
+        if(epoll_ctl(epollfd, EPOLL_CTL_ADD, wakeupfd, &ev) < 0)
+            Error2("epoll_ctl for the wakeup pipe failed with errno=%d", errno);
+    }
+
+    mysocket = sock;
+    wakeup = wakeupfd;
+    recvCount = recvNext = 0;
+    return true;
+}
+
+void psNetBatchedIO::Close()
+{
+    if(epollfd < 0)
+        return;
+
+    Flush();
+    close(epollfd);
+    epollfd = -1;
+    recvCount = recvNext = 0;
+}
+
+int psNetBatchedIO::ReceiveBatch(int timeout)
+{
+    struct epoll_event events[2];
+
+    syscalls++;
+    int ready = epoll_wait(epollfd, events, 2, timeout);
+    if(ready < 1)
+        return 0;
+
+    bool readable = false;
+    for(int i = 0; i < ready; i++)
+    {
+        if(events[i].data.fd == wakeup)
+        {
+            char throwaway[32];
+            syscalls++;
+            if(read(wakeup, throwaway, 32) == -1)
+            {
+               Error1("Read failed!");
+            }
+        }
+        else
+        {
+            readable = true;
+        }
+    }
+
+    if(!readable)
+        return 0;
+
+    for(int i = 0; i < NET_IO_BATCH_SIZE; i++)
+    {
+        if(!recvBuffers[i])
+        {
+            recvBuffers[i] = (char*) BufferPool::Alloc(MAXPACKETSIZE);
+            if(!recvBuffers[i])
+            {
+                Error2("Failed to allocate %d bytes for packet buffer!\n",MAXPACKETSIZE);
+                return 0;
+            }
+        }
+
+        recvIovs[i].iov_base = recvBuffers[i];
+        recvIovs[i].iov_len = MAXPACKETSIZE;
+
+        memset(&recvMsgs[i], 0, sizeof(struct mmsghdr));
+        recvMsgs[i].msg_hdr.msg_name = &recvAddrs[i];
+        recvMsgs[i].msg_hdr.msg_namelen = sizeof(SOCKADDR_IN);
+        recvMsgs[i].msg_hdr.msg_iov = &recvIovs[i];
+        recvMsgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    syscalls++;
+    int received = recvmmsg(mysocket, recvMsgs, NET_IO_BATCH_SIZE, MSG_DONTWAIT, NULL);
+    if(received < 0)
+    {
+        if(errno != EAGAIN && errno != EWOULDBLOCK)
+            Error2("recvmmsg failed with errno=%d", errno);
+        return 0;
+    }
+
+    packetsIn += received;
+    recvCount = received;
+    recvNext = 0;
+    return received;
+}
+
+int psNetBatchedIO::Receive(LPSOCKADDR_IN addr, char* &buffer, int timeout)
+{
+    if(recvNext >= recvCount && !ReceiveBatch(timeout))
+        return 0;
+
+    unsigned int i = recvNext++;
+
+    memcpy(addr, &recvAddrs[i], sizeof(SOCKADDR_IN));
+
+    // Hand out the filled buffer and keep the one of the caller for the next batch
+    char* filled = recvBuffers[i];
+    recvBuffers[i] = buffer;
+    buffer = filled;
+
+    return (int) recvMsgs[i].msg_len;
+}
+
+int psNetBatchedIO::Send(LPSOCKADDR_IN addr, const void* data, unsigned int size)
+{
+    if(size > MAXPACKETSIZE)
+        return -1;
+
+    if(sendCount == NET_IO_BATCH_SIZE)
+        Flush();
+
+    unsigned int i = sendCount++;
+    char* slot = sendBuffers + i * MAXPACKETSIZE;
+    memcpy(slot, data, size);
+    memcpy(&sendAddrs[i], addr, sizeof(SOCKADDR_IN));
+
+    sendIovs[i].iov_base = slot;
+    sendIovs[i].iov_len = size;
+
+    memset(&sendMsgs[i], 0, sizeof(struct mmsghdr));
+    sendMsgs[i].msg_hdr.msg_name = &sendAddrs[i];
+    sendMsgs[i].msg_hdr.msg_namelen = sizeof(SOCKADDR_IN);
+    sendMsgs[i].msg_hdr.msg_iov = &sendIovs[i];
+    sendMsgs[i].msg_hdr.msg_iovlen = 1;
+
+    return (int) size;
+}
+
+bool psNetBatchedIO::WaitWritable()
+{
+    struct pollfd pfd;
+    pfd.fd = mysocket;
+    pfd.events = POLLOUT;
+    pfd.revents = 0;
+
+    syscalls++;
+    return poll(&pfd, 1, SENDTO_SELECT_TIMEOUT_SEC * 1000 + SENDTO_SELECT_TIMEOUT_USEC / 1000) > 0;
+}
+
+int psNetBatchedIO::Flush()
+{
+    unsigned int sent = 0;
+    unsigned int dropped = 0;
+    int retries = 0;
+
+    while(sent < sendCount)
+    {
+        syscalls++;
+        int err = sendmmsg(mysocket, sendMsgs + sent, sendCount - sent, 0);
+        if(err > 0)
+        {
+            sent += err;
+            continue;
+        }
+
+        if(err < 0 && (errno == EAGAIN || errno == EWOULDBLOCK) && retries++ < SENDTO_MAX_RETRIES)
+        {
+            // The socket buffer is full, wait for the kernel to drain it
+            WaitWritable();
+            continue;
+        }
+
+        // Skip the datagram that could not be sent, UDP gives no guarantee anyway
+        // and the reliable packets are resent when their timeout expires.
+        Error2("psNetBatchedIO::Flush() gave up trying to send a packet with errno=%d.", errno);
+        dropped++;
+        sent++;
+    }
+
+    packetsOut += sent - dropped;
+    droppedOut += dropped;
+    sendCount = 0;
+    return (int) (sent - dropped);
+}
+
+#endif // NET_HAVE_BATCHED_IO
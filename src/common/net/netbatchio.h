@@ -0,0 +1,165 @@
+/*
+ * netbatchio.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ * Batched UDP socket I/O for the network thread
+ */
+#ifndef __NETBATCHIO_H__
+#define __NETBATCHIO_H__
+
+#include <cstypes.h>
+
+/**
+ * \addtogroup common_net
+ * @{ */
+
+/* epoll, recvmmsg and sendmmsg are only available on Linux, other platforms
+ * always use the select/sendto path of NetBase.
+ */
+#ifdef __linux__
+#define NET_HAVE_BATCHED_IO
+#endif
+
+#ifdef NET_HAVE_BATCHED_IO
+
+#include <sys/socket.h>
+#include "net/sockuni.h"
+
+/// Maximum number of datagrams moved by one recvmmsg/sendmmsg call
+#define NET_IO_BATCH_SIZE 64
+
+/**
+ * Socket backend that waits for the socket with epoll and moves up to
+ * NET_IO_BATCH_SIZE datagrams per recvmmsg/sendmmsg call.
+ *
+ * Outgoing datagrams are copied into a batch and go on the wire when the
+ * batch is full or Flush() is called. Received datagrams are handed out one
+ * at a time from the last batch, the buffers are swapped with the caller so
+ * they are not copied again.
+ *
+ * Only the network thread may use an instance.
+ */
+class psNetBatchedIO
+{
+public:
+    psNetBatchedIO();
+    ~psNetBatchedIO();
+
+    /**
+     * Start using the socket.
+     *
+     * @param sock     The non blocking UDP socket.
+     * @param wakeupfd Read end of a pipe that interrupts the wait, or 0.
+     * @return false if epoll could not be set up.
+     */
+    bool Open(SOCKET sock, SOCKET wakeupfd);
+
+    /// Flush the pending datagrams and stop using the socket.
+    void Close();
+
+    bool IsOpen() const
+    {
+        return epollfd >= 0;
+    }
+
+    /**
+     * Get the next received datagram.
+     *
+     * If all datagrams of the last batch were handed out this waits up to
+     * timeout milliseconds for the socket and receives a new batch.
+     *
+     * @param addr   Receives the address of the sender.
+     * @param buffer In: a buffer of MAXPACKETSIZE bytes allocated with
+     *               BufferPool::Alloc or NULL. Out: the buffer holding the
+     *               datagram, the passed in buffer is kept for a later batch.
+     * @return The size of the datagram, 0 if nothing was received.
+     */
+    int Receive(LPSOCKADDR_IN addr, char* &buffer, int timeout);
+
+    /**
+     * Copy a datagram into the outgoing batch, the batch is sent when it
+     * is full.
+     * @return The size queued or -1 if the datagram is too large.
+     */
+    int Send(LPSOCKADDR_IN addr, const void* data, unsigned int size);
+
+    /**
+     * Send all the datagrams in the outgoing batch.
+     * @return The number of datagrams sent.
+     */
+    int Flush();
+
+    /// Number of datagrams waiting in the outgoing batch
+    unsigned int GetPendingSends() const
+    {
+        return sendCount;
+    }
+
+    /// @name Statistics since the creation of the backend
+    /// @{
+    uint64 GetSyscalls() const
+    {
+        return syscalls;
+    }
+    uint64 GetPacketsIn() const
+    {
+        return packetsIn;
+    }
+    uint64 GetPacketsOut() const
+    {
+        return packetsOut;
+    }
+    uint64 GetDroppedOut() const
+    {
+        return droppedOut;
+    }
+    /// @}
+
+private:
+    /// Wait for the socket and fill the receive batch.
+    int ReceiveBatch(int timeout);
+
+    /// Block until the socket can be written or the timeout expires.
+    bool WaitWritable();
+
+    SOCKET mysocket;
+    SOCKET wakeup;
+    int epollfd;
+
+    char* recvBuffers[NET_IO_BATCH_SIZE];
+    SOCKADDR_IN recvAddrs[NET_IO_BATCH_SIZE];
+    struct mmsghdr recvMsgs[NET_IO_BATCH_SIZE];
+    struct iovec recvIovs[NET_IO_BATCH_SIZE];
+    unsigned int recvCount;   ///< Datagrams in the receive batch
+    unsigned int recvNext;    ///< Next datagram to hand out
+
+    char* sendBuffers;        ///< NET_IO_BATCH_SIZE slots of MAXPACKETSIZE bytes
+    SOCKADDR_IN sendAddrs[NET_IO_BATCH_SIZE];
+    struct mmsghdr sendMsgs[NET_IO_BATCH_SIZE];
+    struct iovec sendIovs[NET_IO_BATCH_SIZE];
+    unsigned int sendCount;
+
+    uint64 syscalls;
+    uint64 packetsIn;
+    uint64 packetsOut;
+    uint64 droppedOut;
+};
+
+#endif // NET_HAVE_BATCHED_IO
+
+/** @} */
+
+#endif
@@ -33,6 +33,8 @@ psNetPacketEntry::psNetPacketEntry (psNetPacket* packet, uint32_t cnum,
     timestamp = csGetTicks();
     retransmitted = false;
     RTO = 0;
+    resendIndex = csArrayItemNotFound;
+    resendDeadline = 0;
 }
 
 
@@ -42,7 +44,7 @@ psNetPacketEntry::psNetPacketEntry (uint8_t pri, uint32_t cnum,
                     uint32_t totalsize, uint16_t sz,
                     psMessageBytes *msg)
 {
-    packet = (psNetPacket*) cs_malloc (sizeof(psNetPacket) + sz);
+    packet = (psNetPacket*) BufferPool::Alloc (sizeof(psNetPacket) + sz);
     CS_ASSERT(packet != NULL);
     clientnum = cnum;
     packet->flags = pri;
@@ -53,6 +55,8 @@ psNetPacketEntry::psNetPacketEntry (uint8_t pri, uint32_t cnum,
     timestamp = csGetTicks();
     retransmitted = false;
     RTO = 0;
+    resendIndex = csArrayItemNotFound;
+    resendDeadline = 0;
     if (msg && sz && sz != PKTSIZE_ACK)
         memcpy(packet->data, ((char *)msg) + off, sz);
 }
@@ -62,7 +66,7 @@ psNetPacketEntry::psNetPacketEntry (uint8_t pri, uint32_t cnum,
     uint32_t id, uint32_t off, uint32_t totalsize, uint16_t sz,
     const char *bytes)
 {
-    packet = (psNetPacket*) cs_malloc (sizeof(psNetPacket) + sz);
+    packet = (psNetPacket*) BufferPool::Alloc (sizeof(psNetPacket) + sz);
     CS_ASSERT(packet != NULL);
     clientnum = cnum;
     packet->flags = pri;
@@ -73,15 +77,55 @@ psNetPacketEntry::psNetPacketEntry (uint8_t pri, uint32_t cnum,
     timestamp = csGetTicks();
     retransmitted = false;
     RTO = 0;
+    resendIndex = csArrayItemNotFound;
+    resendDeadline = 0;
     if (bytes && sz && sz != PKTSIZE_ACK)
     memcpy(packet->data, bytes, sz);
 }
 
 
+psNetPacketEntry::psNetPacketEntry (uint8_t pri, uint32_t cnum,
+    uint32_t id, uint32_t off, uint32_t totalsize, uint16_t sz,
+    psNetPacketPayload *payload)
+    : payload(payload)
+{
+    CS_ASSERT(payload != NULL && off + sz <= payload->GetSize());
+
+    // Only the header is owned by this entry, the data stays in the payload
+    packet = (psNetPacket*) BufferPool::Alloc (sizeof(psNetPacket));
+    CS_ASSERT(packet != NULL);
+    clientnum = cnum;
+    packet->flags = pri;
+    packet->pktid = id;
+    packet->offset = off;
+    packet->pktsize = sz;
+    packet->msgsize = totalsize;
+    timestamp = csGetTicks();
+    retransmitted = false;
+    RTO = 0;
+    resendIndex = csArrayItemNotFound;
+    resendDeadline = 0;
+}
+
+
 psNetPacketEntry::~psNetPacketEntry()
 {
     if (packet)
-        cs_free(packet);
+        BufferPool::Free(packet);
+}
+
+
+size_t psNetPacketEntry::CopyToWire(char* dest) const
+{
+    size_t size = packet->GetPacketSize();
+
+    memcpy(dest, packet, sizeof(psNetPacket));
+    ((psNetPacket*) dest)->MarshallEndian();
+
+    if (size > sizeof(psNetPacket))
+        memcpy(dest + sizeof(psNetPacket), GetPacketData(), size - sizeof(psNetPacket));
+
+    return size;
 }
 
 
@@ -121,7 +165,7 @@ bool psNetPacketEntry::Append(psNetPacketEntry* next)
         * or copy data more than once.  Only exact number of bytes will be
         * sent on the wire.
         */
-        merge = (psNetPacket*) cs_malloc (MAXPACKETSIZE);
+        merge = (psNetPacket*) BufferPool::Alloc (MAXPACKETSIZE);
         CS_ASSERT(merge != NULL);
 
         /**
@@ -138,13 +182,11 @@ bool psNetPacketEntry::Append(psNetPacketEntry* next)
         * After marshalling for network, copy entire first packet, with header, into data section
         * of new packet.
         */
-        uint16_t size = (uint16_t)packet->GetPacketSize();
-        packet->MarshallEndian();
-        memcpy(merge->data, packet, size);
-        packet->UnmarshallEndian();
+        CopyToWire(merge->data);
 
-        cs_free(packet);   // done with old packet
+        BufferPool::Free(packet);   // done with old packet
         packet = merge;
+        payload = NULL;    // the data is in the merged packet now
     }
     else
     {
@@ -159,14 +201,10 @@ bool psNetPacketEntry::Append(psNetPacketEntry* next)
     if (next->packet->GetPriority() == PRIORITY_HIGH)
         packet->flags = PRIORITY_HIGH | FLAG_MULTIPACKET; // HIGH overrides LOW but not vice versa
 
-    /* Copy size information temporarily, and pack the next packet for transmission.
-    * Do not reference the next->packet after MarshallEndian() has been called.
-    * copy the entire 2nd packet into 1st packet after existing data
+    /* Copy the entire 2nd packet, packed for transmission, into 1st packet
+    * after existing data
     */
-    uint16_t nextSize = (uint16_t)next->packet->GetPacketSize();
-    next->packet->MarshallEndian();
-    memcpy(packet->data+packet->pktsize, next->packet, nextSize);
-    next->packet->UnmarshallEndian();
+    uint16_t nextSize = (uint16_t)next->CopyToWire(packet->data+packet->pktsize);
 
     /**
     * now update length of outer packet
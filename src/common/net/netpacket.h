@@ -21,6 +21,7 @@
 
 #include <csutil/csendian.h>
 #include <csutil/refcount.h>
+#include <csutil/ref.h>
 #include <csutil/hash.h>
 
 #include "net/packing.h"
@@ -175,6 +176,49 @@ template<> class csHashComputer<PacketKey> : public csHashComputerStruct<PacketK
 //-----------------------------------------------------------------------------
 
 
+/**
+ * The bytes of a message shared by the packets of all its recipients.
+ *
+ * When the same message is sent to many clients the message is copied once
+ * into a payload and every psNetPacketEntry only owns its own header, the
+ * data is read from the payload when the packet is put on the wire.
+ */
+class psNetPacketPayload : public csSyncRefCount
+{
+public:
+    /** copy the bytes of the message */
+    psNetPacketPayload(const psMessageBytes* msg)
+    {
+        size = msg->GetTotalSize();
+        bytes = (char*) BufferPool::Alloc(size);
+        CS_ASSERT(bytes != NULL);
+        memcpy(bytes, msg, size);
+    }
+
+    const char* GetData() const
+    {
+        return bytes;
+    }
+
+    size_t GetSize() const
+    {
+        return size;
+    }
+
+protected:
+    ~psNetPacketPayload()
+    {
+        BufferPool::Free(bytes);
+    }
+
+    char* bytes;
+    size_t size;
+};
+
+
+//-----------------------------------------------------------------------------
+
+
 class psNetPacketEntry : public csSyncRefCount
 {
 public:
@@ -189,13 +233,26 @@ public:
     /** timeout */
     csTicks RTO;
 
+    /** Position in the resend queue of NetBase, csArrayItemNotFound when
+     * the packet isn't scheduled for a resend check.
+     */
+    size_t resendIndex;
+
+    /** When the resend check is due, only used while in the resend queue */
+    csTicks resendDeadline;
+
     /** The Packet like it is returned from reading UDP socket / will be
      * written to socket
      */
     psNetPacket* packet;
 
+    /** Shared message bytes, if set packet only holds the header and the
+     * data starts at packet->offset in the payload
+     */
+    csRef<psNetPacketPayload> payload;
+
     /** construct a new PacketEntry from a packet, not that this classe calls
-     * free on the packet pointer later!
+     * BufferPool::Free on the packet pointer later!
      */
     psNetPacketEntry (psNetPacket* packet, uint32_t cnum, uint16_t sz);
     
@@ -209,22 +266,57 @@ public:
                       uint32_t id, uint32_t off, uint32_t totalsize, uint16_t sz,
                       const char *bytes);
 
+    /** construct a new PacketEntry for a part of a shared payload */
+    psNetPacketEntry (uint8_t pri, uint32_t cnum,
+                      uint32_t id, uint32_t off, uint32_t totalsize, uint16_t sz,
+                      psNetPacketPayload *payload);
+
     psNetPacketEntry (psNetPacketEntry* )
     {
         CS_ASSERT(false);
     }
 
     ~psNetPacketEntry();
+
+    /// Packet entries and their packets come from the size class pools
+    void* operator new(size_t size)
+    {
+        return BufferPool::Alloc(size);
+    }
+
+    void operator delete(void* ptr)
+    {
+        BufferPool::Free(ptr);
+    }
     
     bool Append(psNetPacketEntry* next);
     csPtr<psNetPacketEntry> GetNextPacket(psNetPacket* &packetdata);
 
 
+    /** Get the header and data of the packet as one block, only valid
+     * for packets without a shared payload.
+     */
     void* GetData()
     {
+        CS_ASSERT(!payload);
         return packet;
     }
 
+    /** Get the data following the header of the packet */
+    const char* GetPacketData() const
+    {
+        if (payload)
+            return payload->GetData() + packet->offset;
+        return packet->data;
+    }
+
+    /** Copy the packet like it goes out on the wire (marshalled header
+     * followed by the data) into dest, which must be large enough for
+     * packet->GetPacketSize() bytes.
+     * @return The number of bytes written.
+     */
+    size_t CopyToWire(char* dest) const;
+
     bool operator < (const psNetPacketEntry& other) const
     {
         if (clientnum < other.clientnum)
@@ -18,6 +18,7 @@
  */
 
 #include <psconfig.h>
+#include <csutil/sysfunc.h>
 #include "netprofile.h"
 #include "messages.h"
 
@@ -32,7 +33,8 @@ void psNetMsgProfiles::AddEnoughRecords(csArray<psOperProfile*> & arr, int neede
     profs.SetSize(d + arr.GetSize() - i);
     for (; i < arr.GetSize(); i++, d++)
     {
-        csStringFast<100> fullDesc = GetMsgTypeName((int)arr.GetSize()) + "-" + desc;
+        // The record at index i is the one of message type i
+        csStringFast<100> fullDesc = GetMsgTypeName((int)i) + "-" + desc;
         psOperProfile * newProf = new psOperProfile(fullDesc);
         arr[i] = newProf;
         profs[d] = newProf;
@@ -41,12 +43,14 @@ void psNetMsgProfiles::AddEnoughRecords(csArray<psOperProfile*> & arr, int neede
 
 void psNetMsgProfiles::AddSentMsg(MsgEntry * me)
 {
+    CS::Threading::MutexScopedLock lock(mutex);
     AddEnoughRecords(sentProfs, me->bytes->type, "sent");
     sentProfs[me->bytes->type]->AddConsumption(me->bytes->size);
 }
 
 void psNetMsgProfiles::AddReceivedMsg(MsgEntry * me)
 {
+    CS::Threading::MutexScopedLock lock(mutex);
     AddEnoughRecords(recvProfs, me->bytes->type, "recv");
     recvProfs[me->bytes->type]->AddConsumption(me->bytes->size);
 }
@@ -54,13 +58,52 @@ void psNetMsgProfiles::AddReceivedMsg(MsgEntry * me)
 csString psNetMsgProfiles::Dump()
 {
     csStringFast<50> header, list;
-    
+
+    CS::Threading::MutexScopedLock lock(mutex);
     psOperProfileSet::Dump("byte", header, list);
     return "=================\nBandwidth profile\n=================\n" + header + list;
 }
 
+csString psNetMsgProfiles::Export()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    return psOperProfileSet::Export("ps_net_msg_bytes");
+}
+
+psMsgHandlerProfiles::psMsgHandlerProfiles()
+{
+    for (int type = 0; type < 256; type++)
+        profs.Push(new psOperProfile(GetMsgTypeName(type)));
+}
+
+void psMsgHandlerProfiles::AddHandleTime(msgtype type, csTicks time)
+{
+    profs[type]->AddConsumption(time);
+}
+
+csString psMsgHandlerProfiles::Dump()
+{
+    csStringFast<50> header, list;
+    
+    psOperProfileSet::Dump("usec", header, list);
+    return "=================\nMessage handling profile\n=================\n" + header + list;
+}
+
+csString psMsgHandlerProfiles::Export()
+{
+    return psOperProfileSet::Export("ps_msg_handle_usec");
+}
+
+void psMsgHandlerProfiles::Reset()
+{
+    for (size_t i=0; i < profs.GetSize(); i++)
+        profs[i]->Reset();
+    profStart = csGetTicks();
+}
+
 void psNetMsgProfiles::Reset()
 {
+    CS::Threading::MutexScopedLock lock(mutex);
     recvProfs.DeleteAll();
     sentProfs.DeleteAll();
     
@@ -21,6 +21,7 @@
 #define __NETPROFILE_H__
 
 #include <csutil/parray.h>
+#include <csutil/threading/mutex.h>
 
 #include "message.h"
 #include "util/psprofile.h"
@@ -31,6 +32,9 @@
 
 /**
  * Statistics of receiving or sending of network messages.
+ *
+ * The network thread adds profiles for new message types while the
+ * metrics exporter reads them, all the functions take the mutex.
  */
 class psNetMsgProfiles : public psOperProfileSet
 {
@@ -38,16 +42,46 @@ public:
     void AddSentMsg(MsgEntry * me);
     void AddReceivedMsg(MsgEntry * me);
     csString Dump();
+
+    /** Return the packets, bytes and message sizes per message type for the
+      * metrics export, see psOperProfileSet::Export() */
+    csString Export();
+
     void Reset();
 protected:
     void AddEnoughRecords(csArray<psOperProfile*> & profs, int neededIndex, const char * desc);
-    
+
+    CS::Threading::Mutex mutex;
+
     /**
      * Statistics for receiving and sending of different message types.
      */
     csArray<psOperProfile*> recvProfs, sentProfs;
 };
 
+/**
+ * Time spent handling each type of message, in usec.
+ *
+ * A profile for each of the 256 message types is made up front, so the
+ * statistics can be dumped from another thread than the one handling the
+ * messages.
+ */
+class psMsgHandlerProfiles : public psOperProfileSet
+{
+public:
+    psMsgHandlerProfiles();
+
+    void AddHandleTime(msgtype type, csTicks time);
+    csString Dump();
+
+    /** Return the time spent per message type for the metrics export,
+      * see psOperProfileSet::Export() */
+    csString Export();
+
+    /** Reset the counters, keeping the profiles */
+    void Reset();
+};
+
 /** @} */
 
 #endif
@@ -0,0 +1,389 @@
+/*
+ * asynclog.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <string.h>
+
+#include <csutil/array.h>
+#include <csutil/sysfunc.h>
+#include <csutil/threading/atomicops.h>
+#include <iutil/databuff.h>
+
+#include "util/asynclog.h"
+
+AsyncLog::Record* AsyncLog::records = NULL;
+int32 AsyncLog::enqueuePos = 0;
+uint32 AsyncLog::dequeuePos = 0;
+int32 AsyncLog::running = 0;
+int32 AsyncLog::writers = 0;
+csRef<CS::Threading::Thread> AsyncLog::thread;
+CS::Threading::Mutex AsyncLog::statsMutex;
+AsyncLog::Stats AsyncLog::stats;
+
+//----------------------------------------------------------------------------
+
+VfsLogFile::VfsLogFile(iVFS* vfs, const char* path, const char* header, size_t maxSize)
+    : vfs(vfs), path(path), header(header)
+{
+    this->maxSize = maxSize;
+
+    if (!vfs->Exists(path))
+    {
+        Create();
+        return;
+    }
+
+    file = vfs->Open(path, VFS_FILE_APPEND);
+    if (!file)
+        return;
+
+    size = file->GetSize();
+    if (maxSize && size > maxSize)
+    {
+        Rotate();
+    }
+}
+
+bool VfsLogFile::IsOpen()
+{
+    return file.IsValid();
+}
+
+void VfsLogFile::Create()
+{
+    file = vfs->Open(path, VFS_FILE_WRITE);
+    size = 0;
+    if (file && !header.IsEmpty())
+    {
+        Write(header, header.Length());
+    }
+}
+
+void VfsLogFile::Write(const char* data, size_t length)
+{
+    if (file)
+    {
+        size += file->Write(data, length);
+    }
+}
+
+void VfsLogFile::Flush()
+{
+    if (file)
+    {
+        file->Flush();
+    }
+}
+
+void VfsLogFile::Rotate()
+{
+    file = NULL;
+
+    // Rolling history
+    for (int index = 10; index > 0; index--)
+    {
+        csString src(path), dst(path);
+        src.Append(index);
+        dst.Append(index + 1);
+        // Rotate the files (move file[index] to file[index+1])
+        if (vfs->Exists(src))
+        {
+            csRef<iDataBuffer> existingData = vfs->ReadFile(src, false);
+            vfs->WriteFile(dst, existingData->GetData(), existingData->GetSize());
+        }
+    }
+
+    csRef<iDataBuffer> existingData = vfs->ReadFile(path, false);
+    if (existingData)
+    {
+        vfs->WriteFile(path + "1", existingData->GetData(), existingData->GetSize());
+    }
+
+    Create();
+}
+
+//----------------------------------------------------------------------------
+
+StdioLogFile::StdioLogFile(const char* path, bool append)
+{
+    file = fopen(path, append ? "a" : "w");
+    if (file)
+    {
+        fseek(file, 0, SEEK_END);
+        size = ftell(file);
+    }
+}
+
+StdioLogFile::~StdioLogFile()
+{
+    if (file)
+    {
+        fclose(file);
+    }
+}
+
+bool StdioLogFile::IsOpen()
+{
+    return file != NULL;
+}
+
+void StdioLogFile::Write(const char* data, size_t length)
+{
+    if (file)
+    {
+        size += fwrite(data, 1, length, file);
+    }
+}
+
+void StdioLogFile::Flush()
+{
+    if (file)
+    {
+        fflush(file);
+    }
+}
+
+//----------------------------------------------------------------------------
+
+void AsyncLog::Start()
+{
+    if (thread)
+        return;
+
+    memset(&stats, 0, sizeof(stats));
+
+    records = new Record[ASYNCLOG_RECORDS];
+    for (int32 i = 0; i < ASYNCLOG_RECORDS; i++)
+    {
+        records[i].sequence = i;
+        records[i].heapText = NULL;
+    }
+    enqueuePos = 0;
+    dequeuePos = 0;
+    CS::Threading::AtomicOperations::Set(&running, 1);
+
+    csRef<CS::Threading::Runnable> writer;
+    writer.AttachNew(new AsyncLog);
+    thread.AttachNew(new CS::Threading::Thread(writer));
+    thread->Start();
+}
+
+void AsyncLog::Stop()
+{
+    if (!thread)
+        return;
+
+    CS::Threading::AtomicOperations::Set(&running, 0);
+
+    // Callers who saw the writer running may still be filling their slot
+    while (CS::Threading::AtomicOperations::Read(&writers))
+    {
+        csSleep(0);
+    }
+
+    thread->Wait();
+    thread.Invalidate();
+
+    // Filled after the last batch of the writer
+    WriteRecords();
+
+    delete[] records;
+    records = NULL;
+}
+
+void AsyncLog::Write(AsyncLogFile* file, const char* text, time_t stamp)
+{
+    if (!file)
+        return;
+
+    // Counted before looking at running, so Stop() either waits for this
+    // record to be filled or this sees the writer stopped
+    CS::Threading::AtomicOperations::Increment(&writers);
+    if (!CS::Threading::AtomicOperations::Read(&running))
+    {
+        CS::Threading::AtomicOperations::Decrement(&writers);
+        WriteRecord(file, text, strlen(text), stamp);
+        file->Flush();
+        return;
+    }
+
+    // The positions wrap, they are compared by their difference
+    Record* record;
+    int32 pos = CS::Threading::AtomicOperations::Read(&enqueuePos);
+    while (true)
+    {
+        record = &records[pos & (ASYNCLOG_RECORDS - 1)];
+        int32 diff = (int32)((uint32)CS::Threading::AtomicOperations::Read(&record->sequence) - (uint32)pos);
+        if (diff == 0)
+        {
+            int32 claimed = CS::Threading::AtomicOperations::CompareAndSet(&enqueuePos, (int32)((uint32)pos + 1), pos);
+            if (claimed == pos)
+                break;
+            pos = claimed;
+        }
+        else if (diff < 0)
+        {
+            // The writer hasn't taken the record of the last round yet
+            CS::Threading::AtomicOperations::Decrement(&writers);
+            CS::Threading::MutexScopedLock lock(statsMutex);
+            stats.dropped++;
+            return;
+        }
+        else
+        {
+            pos = CS::Threading::AtomicOperations::Read(&enqueuePos);
+        }
+    }
+
+    record->file = file;
+    record->stamp = stamp;
+    record->length = strlen(text);
+    if (record->length <= ASYNCLOG_RECORD_SIZE)
+    {
+        memcpy(record->text, text, record->length);
+    }
+    else
+    {
+        record->heapText = new char[record->length];
+        memcpy(record->heapText, text, record->length);
+    }
+
+    CS::Threading::AtomicOperations::Set(&record->sequence, (int32)((uint32)pos + 1));
+    CS::Threading::AtomicOperations::Decrement(&writers);
+}
+
+void AsyncLog::GetStats(Stats &result)
+{
+    CS::Threading::MutexScopedLock lock(statsMutex);
+    result = stats;
+}
+
+void AsyncLog::Run()
+{
+    while (true)
+    {
+        bool stopping = !CS::Threading::AtomicOperations::Read(&running);
+
+        size_t count = WriteRecords();
+
+        if (stopping)
+            break;
+
+        // Come back at once when the ring fills up fast
+        if (count < ASYNCLOG_RECORDS / 4)
+        {
+            csSleep(ASYNCLOG_INTERVAL);
+        }
+    }
+}
+
+size_t AsyncLog::WriteRecords()
+{
+    csArray<csRef<AsyncLogFile> > written;
+    size_t count = 0;
+    uint64 bytes = 0;
+    uint64 rotations = 0;
+    uint64 heapRecords = 0;
+
+    while (true)
+    {
+        Record* record = &records[dequeuePos & (ASYNCLOG_RECORDS - 1)];
+        if ((uint32)CS::Threading::AtomicOperations::Read(&record->sequence) != dequeuePos + 1)
+        {
+            // Not filled yet, taken with the next batch
+            break;
+        }
+
+        AsyncLogFile* file = record->file;
+        size_t before = file->size;
+        if (record->heapText)
+        {
+            WriteRecord(file, record->heapText, record->length, record->stamp);
+            delete[] record->heapText;
+            record->heapText = NULL;
+            heapRecords++;
+        }
+        else
+        {
+            WriteRecord(file, record->text, record->length, record->stamp);
+        }
+        bytes += file->size - before;
+        count++;
+
+        // Keeps the file until it is flushed
+        if (written.Find(record->file) == csArrayItemNotFound)
+        {
+            written.Push(record->file);
+        }
+        record->file = NULL;
+
+        if (file->maxSize && file->size > file->maxSize)
+        {
+            file->Rotate();
+            rotations++;
+        }
+
+        CS::Threading::AtomicOperations::Set(&record->sequence, (int32)(dequeuePos + ASYNCLOG_RECORDS));
+        dequeuePos++;
+    }
+
+    if (!count)
+        return 0;
+
+    // Flush once per batch instead of once per line
+    for (size_t i = 0; i < written.GetSize(); i++)
+    {
+        written[i]->Flush();
+    }
+
+    CS::Threading::MutexScopedLock lock(statsMutex);
+    stats.records += count;
+    stats.bytes += bytes;
+    stats.batches++;
+    stats.rotations += rotations;
+    stats.heapRecords += heapRecords;
+    if (count > stats.maxBatch)
+    {
+        stats.maxBatch = count;
+    }
+    return count;
+}
+
+void AsyncLog::WriteRecord(AsyncLogFile* file, const char* text, size_t length, time_t stamp)
+{
+    if (stamp)
+    {
+        // asctime() and localtime() share a buffer with the other threads
+        struct tm loctime;
+        char buf[64];
+#ifdef CS_PLATFORM_WIN32
+        localtime_s(&loctime, &stamp);
+        asctime_s(buf, sizeof(buf), &loctime);
+#else
+        localtime_r(&stamp, &loctime);
+        asctime_r(&loctime, buf);
+#endif
+        csString prefix(buf);
+        prefix.Truncate(prefix.Length() - 1);
+        prefix.Append(", ");
+        file->Write(prefix, prefix.Length());
+    }
+
+    file->Write(text, length);
+}
@@ -0,0 +1,212 @@
+/*
+ * asynclog.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_ASYNCLOG_H
+#define PS_ASYNCLOG_H
+
+#include <stdio.h>
+#include <time.h>
+
+#include <cstypes.h>
+#include <csutil/csstring.h>
+#include <csutil/ref.h>
+#include <csutil/refcount.h>
+#include <csutil/threading/thread.h>
+#include <iutil/vfs.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Slots of the ring of records, a power of two. Once all wait for the writer new records are dropped
+#define ASYNCLOG_RECORDS 8192
+
+/// Bytes of text a slot holds, longer records are copied to the heap
+#define ASYNCLOG_RECORD_SIZE 256
+
+/// Milliseconds between two batches of the writer thread
+#define ASYNCLOG_INTERVAL 100
+
+/**
+ * A file written by the AsyncLog.
+ *
+ * Once records for it are queued only the writer thread uses it, the
+ * records keep a reference so it stays open until they are written. The
+ * reference count is atomic since the records are released by the writer.
+ */
+class AsyncLogFile : public CS::Utility::AtomicRefCount
+{
+public:
+    AsyncLogFile() : maxSize(0), size(0) {}
+    virtual ~AsyncLogFile() {}
+
+    virtual bool IsOpen() = 0;
+    virtual void Write(const char* data, size_t length) = 0;
+    virtual void Flush() = 0;
+
+    /// Move the file aside and start a new one, called once it grew over maxSize.
+    virtual void Rotate() {}
+
+    size_t maxSize;     ///< Rotated once bigger than this, 0 never rotates
+    size_t size;        ///< Bytes in the file
+};
+
+/**
+ * A log file in the VFS, see LogCSV.
+ */
+class VfsLogFile : public AsyncLogFile
+{
+public:
+    /**
+     * Open the file for appending, rotating it first if it's too big.
+     *
+     * @param header  Written at the start of a new file, may be NULL.
+     * @param maxSize Bytes after which the file is rotated, 0 never rotates.
+     */
+    VfsLogFile(iVFS* vfs, const char* path, const char* header = NULL, size_t maxSize = 0);
+
+    virtual bool IsOpen();
+    virtual void Write(const char* data, size_t length);
+    virtual void Flush();
+
+    /// Keep the 10 last files as path1 to path10.
+    virtual void Rotate();
+
+private:
+    /// Start an empty file with the header.
+    void Create();
+
+    csRef<iVFS> vfs;
+    csRef<iFile> file;
+    csString path;
+    csString header;
+};
+
+/**
+ * A log file on the disk, see ConsoleOut.
+ */
+class StdioLogFile : public AsyncLogFile
+{
+public:
+    StdioLogFile(const char* path, bool append);
+    virtual ~StdioLogFile();
+
+    virtual bool IsOpen();
+    virtual void Write(const char* data, size_t length);
+    virtual void Flush();
+
+private:
+    FILE* file;
+};
+
+/*   Design notes:
+ *
+ *  The AsyncLog takes the writing of the log files off the threads doing
+ *  the logging. Write() copies the text into the next slot of a ring of
+ *  ASYNCLOG_RECORDS records allocated by Start(), so logging a line doesn't
+ *  allocate. Only a text longer than ASYNCLOG_RECORD_SIZE is copied to the
+ *  heap.
+ *
+ *  Each slot has a sequence number. A writing thread claims the slot of the
+ *  next position with a compare and set on enqueuePos when its sequence
+ *  says the writer is done with it, fills it and moves its sequence on to
+ *  hand it to the writer. The writer thread takes the slots in the order
+ *  of their positions every ASYNCLOG_INTERVAL milliseconds, or sooner when
+ *  the last batch filled a quarter of the ring, until it meets one not
+ *  filled yet. It writes the records, gives the slots back, flushes each
+ *  file written to once per batch and rotates the files grown over their
+ *  maximum size.
+ *
+ *  The timestamp of a record is taken by Write() and formatted by the
+ *  writer thread.
+ *
+ *  When every slot waits for the writer new records are dropped and
+ *  counted, the logging never blocks. Before Start() and after
+ *  Stop() Write() writes and flushes the file at once, so the tools and the
+ *  client which never start the writer log as before. Stop() waits for the
+ *  calls to Write() which saw the writer running to push their record
+ *  before writing what is left.
+ *
+ *  The error log of ConsoleOut is not written through the AsyncLog, its
+ *  lines are flushed at once to survive a crash.
+ */
+class AsyncLog : public CS::Threading::Runnable
+{
+public:
+    /// Counters since the writer started
+    struct Stats
+    {
+        uint64 records;         ///< Records written
+        uint64 bytes;
+        uint64 batches;
+        size_t maxBatch;        ///< Most records written in one batch
+        uint64 rotations;
+        uint64 dropped;         ///< Records dropped because too many were waiting
+        uint64 heapRecords;     ///< Records too long for a slot
+    };
+
+    /// Start the writer thread.
+    static void Start();
+
+    /// Write everything queued and stop the writer thread.
+    static void Stop();
+
+    /**
+     * Queue text to be written to a file.
+     *
+     * @param stamp If not 0 the line is prefixed with this time, like "Mon Jan  7 10:00:00 2013, ".
+     */
+    static void Write(AsyncLogFile* file, const char* text, time_t stamp = 0);
+
+    static void GetStats(Stats &stats);
+
+    virtual void Run();
+
+private:
+    /// A slot of the ring
+    struct Record
+    {
+        int32 sequence;         ///< Position it can be claimed for, or that position + 1 once filled
+        csRef<AsyncLogFile> file;
+        time_t stamp;
+        size_t length;
+        char* heapText;         ///< The text if too long for the slot
+        char text[ASYNCLOG_RECORD_SIZE];
+    };
+
+    /// Write the filled slots in order and give them back, returns how many there were.
+    static size_t WriteRecords();
+
+    /// Write one record to its file.
+    static void WriteRecord(AsyncLogFile* file, const char* text, size_t length, time_t stamp);
+
+    static Record* records;                 ///< The ring, ASYNCLOG_RECORDS slots
+    static int32 enqueuePos;                ///< Next position to claim
+    static uint32 dequeuePos;               ///< Next position to write, only used by the writer
+    static int32 running;
+    static int32 writers;                   ///< Calls to Write() between checking running and pushing
+    static csRef<CS::Threading::Thread> thread;
+
+    static CS::Threading::Mutex statsMutex;
+    static Stats stats;
+};
+
+/** @} */
+
+#endif
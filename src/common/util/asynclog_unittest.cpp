@@ -0,0 +1,250 @@
+/*
+ * asynclog_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/asynclog.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <csutil/sysfunc.h>
+#include <csutil/threading/thread.h>
+
+/**
+ * Keeps what is written in memory and counts the flushes.
+ */
+class MemoryLogFile : public AsyncLogFile
+{
+public:
+    MemoryLogFile(size_t maxSize = 0) : flushes(0), rotations(0)
+    {
+        this->maxSize = maxSize;
+    }
+
+    virtual bool IsOpen()
+    {
+        return true;
+    }
+    virtual void Write(const char* data, size_t length)
+    {
+        text.Append(data, length);
+        size += length;
+    }
+    virtual void Flush()
+    {
+        flushes++;
+    }
+    virtual void Rotate()
+    {
+        rotations++;
+        text.Empty();
+        size = 0;
+    }
+
+    csString text;
+    int flushes;
+    int rotations;
+};
+
+TEST(AsyncLogTest, WritesAtOnceWithoutWriter)
+{
+    csRef<MemoryLogFile> file;
+    file.AttachNew(new MemoryLogFile);
+
+    AsyncLog::Write(file, "one\n");
+    EXPECT_STREQ(file->text.GetData(), "one\n");
+    EXPECT_EQ(file->flushes, 1);
+}
+
+TEST(AsyncLogTest, KeepsOrderAndFlushesPerBatch)
+{
+    csRef<MemoryLogFile> file;
+    file.AttachNew(new MemoryLogFile);
+
+    AsyncLog::Start();
+    csString expected;
+    for (int i = 0; i < 1000; i++)
+    {
+        csString line;
+        line.Format("line %d\n", i);
+        AsyncLog::Write(file, line);
+        expected.Append(line);
+    }
+    AsyncLog::Stop();
+
+    EXPECT_STREQ(file->text.GetData(), expected.GetData());
+    EXPECT_LT(file->flushes, 1000);
+
+    AsyncLog::Stats stats;
+    AsyncLog::GetStats(stats);
+    EXPECT_EQ(stats.records, (uint64)1000);
+    EXPECT_EQ(stats.bytes, (uint64)expected.Length());
+    EXPECT_EQ(stats.dropped, (uint64)0);
+}
+
+TEST(AsyncLogTest, LongRecords)
+{
+    csRef<MemoryLogFile> file;
+    file.AttachNew(new MemoryLogFile);
+
+    csString fits, longer;
+    while (fits.Length() < ASYNCLOG_RECORD_SIZE)
+    {
+        fits.Append("x");
+    }
+    longer = fits;
+    longer.Append("y\n");
+
+    AsyncLog::Start();
+    AsyncLog::Write(file, fits);
+    AsyncLog::Write(file, longer);
+    AsyncLog::Write(file, "short\n");
+    AsyncLog::Stop();
+
+    csString expected(fits);
+    expected.Append(longer);
+    expected.Append("short\n");
+    EXPECT_STREQ(file->text.GetData(), expected.GetData());
+
+    AsyncLog::Stats stats;
+    AsyncLog::GetStats(stats);
+    EXPECT_EQ(stats.records, (uint64)3);
+    EXPECT_EQ(stats.heapRecords, (uint64)1);
+}
+
+TEST(AsyncLogTest, RingWraps)
+{
+    csRef<MemoryLogFile> file;
+    file.AttachNew(new MemoryLogFile);
+
+    // Half a ring at a time, waiting for the writer, goes round it twice
+    AsyncLog::Start();
+    csString expected;
+    int line = 0;
+    for (int round = 0; round < 4; round++)
+    {
+        for (int i = 0; i < ASYNCLOG_RECORDS / 2; i++)
+        {
+            csString text;
+            text.Format("%d\n", line++);
+            AsyncLog::Write(file, text);
+            expected.Append(text);
+        }
+
+        AsyncLog::Stats stats;
+        do
+        {
+            csSleep(10);
+            AsyncLog::GetStats(stats);
+        }
+        while (stats.records < (uint64)line);
+    }
+    AsyncLog::Stop();
+
+    EXPECT_STREQ(file->text.GetData(), expected.GetData());
+
+    AsyncLog::Stats stats;
+    AsyncLog::GetStats(stats);
+    EXPECT_EQ(stats.records, (uint64)line);
+    EXPECT_EQ(stats.dropped, (uint64)0);
+}
+
+TEST(AsyncLogTest, Rotates)
+{
+    csRef<MemoryLogFile> file;
+    file.AttachNew(new MemoryLogFile(100));
+
+    AsyncLog::Start();
+    for (int i = 0; i < 100; i++)
+    {
+        AsyncLog::Write(file, "0123456789\n");
+    }
+    AsyncLog::Stop();
+
+    // 11 bytes per line, rotated once the 10th line took it over 100
+    EXPECT_EQ(file->rotations, 10);
+    EXPECT_EQ(file->size, (size_t)0);
+}
+
+class LogWriter : public CS::Threading::Runnable
+{
+public:
+    LogWriter(AsyncLogFile* file, int id, int count) : file(file), id(id), count(count) {}
+
+    virtual void Run()
+    {
+        for (int i = 0; i < count; i++)
+        {
+            csString line;
+            line.Format("%d %d\n", id, i);
+            AsyncLog::Write(file, line);
+        }
+    }
+
+private:
+    AsyncLogFile* file;
+    int id;
+    int count;
+};
+
+TEST(AsyncLogTest, ManyWriters)
+{
+    const int writers = 4;
+    const int lines = 20000;
+
+    csRef<MemoryLogFile> file;
+    file.AttachNew(new MemoryLogFile);
+
+    AsyncLog::Start();
+    csRef<CS::Threading::Thread> threads[writers];
+    for (int i = 0; i < writers; i++)
+    {
+        csRef<CS::Threading::Runnable> writer;
+        writer.AttachNew(new LogWriter(file, i, lines));
+        threads[i].AttachNew(new CS::Threading::Thread(writer));
+        threads[i]->Start();
+    }
+    for (int i = 0; i < writers; i++)
+    {
+        threads[i]->Wait();
+    }
+    AsyncLog::Stop();
+
+    AsyncLog::Stats stats;
+    AsyncLog::GetStats(stats);
+    EXPECT_EQ(stats.records + stats.dropped, (uint64)(writers * lines));
+
+    // The lines of each writer are in the order it wrote them
+    int next[writers] = { 0 };
+    const char* text = file->text.GetData();
+    int id, index, read;
+    while (sscanf(text, "%d %d\n%n", &id, &index, &read) == 2)
+    {
+        ASSERT_TRUE(id >= 0 && id < writers);
+        EXPECT_GE(index, next[id]);
+        next[id] = index + 1;
+        text += read;
+    }
+    EXPECT_EQ(*text, '\0');
+}
@@ -0,0 +1,335 @@
+/*
+ * bufferpool.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <stdlib.h>
+#include <csutil/threading/mutex.h>
+
+#include "util/bufferpool.h"
+
+#if defined(CS_COMPILER_MSVC)
+#define BUFFERPOOL_TLS __declspec(thread)
+#else
+#define BUFFERPOOL_TLS __thread
+#endif
+
+/// Marks a buffer that was too large for the pool and came from the heap
+#define BUFFERPOOL_HEAP BUFFERPOOL_CLASSES
+
+namespace
+{
+
+/// Size class properties, blocks are moved between the caches and the pool in batches
+struct ClassInfo
+{
+    size_t blockSize;
+    uint32 batch;
+};
+
+const ClassInfo classInfo[BUFFERPOOL_CLASSES] =
+{
+    {    64, 32 },
+    {   256, 32 },
+    {  1024, 32 },
+    {  2048, 16 },
+    {  4096,  8 },
+    {  8192,  4 },
+    { 16384,  2 }
+};
+
+/// Stored in front of every buffer, padded to keep the buffer 16 byte aligned
+union BlockHeader
+{
+    struct
+    {
+        uint32 sizeClass;
+        uint32 size;      ///< Requested size, used for the heap buffers
+    } info;
+    char padding[16];
+};
+
+/// Free blocks are linked through their own memory
+struct FreeBlock
+{
+    FreeBlock* next;
+};
+
+struct ThreadCache
+{
+    FreeBlock* free[BUFFERPOOL_CLASSES];
+    uint32 count[BUFFERPOOL_CLASSES];
+
+    // Index BUFFERPOOL_HEAP counts the buffers too large for the pool
+    uint64 hits[BUFFERPOOL_CLASSES+1];
+    uint64 misses[BUFFERPOOL_CLASSES+1];
+    uint64 allocs[BUFFERPOOL_CLASSES+1];
+    uint64 frees[BUFFERPOOL_CLASSES+1];
+
+    ThreadCache* next;
+};
+
+struct SizeClass
+{
+    CS::Threading::Mutex mutex;
+    FreeBlock* free;
+    size_t count;
+    size_t created;
+};
+
+struct PoolGlobals
+{
+    SizeClass classes[BUFFERPOOL_CLASSES];
+
+    /// All thread caches, only used to sum the counters
+    CS::Threading::Mutex cachesMutex;
+    ThreadCache* caches;
+
+    PoolGlobals()
+    {
+        for(int i = 0; i < BUFFERPOOL_CLASSES; i++)
+        {
+            classes[i].free = NULL;
+            classes[i].count = 0;
+            classes[i].created = 0;
+        }
+        caches = NULL;
+    }
+};
+
+// Constructed on first use, buffers may be allocated by static constructors.
+PoolGlobals &Globals()
+{
+    static PoolGlobals globals;
+    return globals;
+}
+
+BUFFERPOOL_TLS ThreadCache* threadCache = NULL;
+
+ThreadCache* GetThreadCache()
+{
+    if(threadCache)
+        return threadCache;
+
+    ThreadCache* cache = (ThreadCache*) calloc(1, sizeof(ThreadCache));
+    CS_ASSERT(cache != NULL);
+
+    PoolGlobals &globals = Globals();
+    CS::Threading::MutexScopedLock lock(globals.cachesMutex);
+    cache->next = globals.caches;
+    globals.caches = cache;
+
+    threadCache = cache;
+    return cache;
+}
+
+int GetSizeClass(size_t size)
+{
+    for(int i = 0; i < BUFFERPOOL_CLASSES; i++)
+    {
+        if(size <= classInfo[i].blockSize)
+            return i;
+    }
+    return BUFFERPOOL_HEAP;
+}
+
+/**
+ * Move a batch of blocks from the pool to the cache, new blocks are
+ * allocated if the pool is empty.
+ * @return true if a slab had to be allocated.
+ */
+bool Refill(ThreadCache* cache, int sizeClass)
+{
+    SizeClass &pool = Globals().classes[sizeClass];
+    const ClassInfo &info = classInfo[sizeClass];
+    bool miss = false;
+
+    CS::Threading::MutexScopedLock lock(pool.mutex);
+
+    if(!pool.free)
+    {
+        // One slab holds two batches
+        size_t stride = sizeof(BlockHeader) + info.blockSize;
+        uint32 blocks = info.batch * 2;
+        char* slab = (char*) malloc(stride * blocks);
+        if(!slab)
+            return true;
+
+        for(uint32 i = 0; i < blocks; i++)
+        {
+            BlockHeader* header = (BlockHeader*) (slab + i * stride);
+            header->info.sizeClass = sizeClass;
+            header->info.size = (uint32) info.blockSize;
+
+            FreeBlock* block = (FreeBlock*) (header + 1);
+            block->next = pool.free;
+            pool.free = block;
+        }
+        pool.count += blocks;
+        pool.created += blocks;
+        miss = true;
+    }
+
+    for(uint32 i = 0; i < info.batch && pool.free; i++)
+    {
+        FreeBlock* block = pool.free;
+        pool.free = block->next;
+        pool.count--;
+
+        block->next = cache->free[sizeClass];
+        cache->free[sizeClass] = block;
+        cache->count[sizeClass]++;
+    }
+
+    return miss;
+}
+
+/// Return a batch of blocks from the cache to the pool
+void Spill(ThreadCache* cache, int sizeClass)
+{
+    SizeClass &pool = Globals().classes[sizeClass];
+    const ClassInfo &info = classInfo[sizeClass];
+
+    CS::Threading::MutexScopedLock lock(pool.mutex);
+
+    for(uint32 i = 0; i < info.batch && cache->free[sizeClass]; i++)
+    {
+        FreeBlock* block = cache->free[sizeClass];
+        cache->free[sizeClass] = block->next;
+        cache->count[sizeClass]--;
+
+        block->next = pool.free;
+        pool.free = block;
+        pool.count++;
+    }
+}
+
+}
+
+void* BufferPool::Alloc(size_t size)
+{
+    ThreadCache* cache = GetThreadCache();
+    int sizeClass = GetSizeClass(size);
+
+    if(sizeClass == BUFFERPOOL_HEAP)
+    {
+        BlockHeader* header = (BlockHeader*) malloc(sizeof(BlockHeader) + size);
+        if(!header)
+            return NULL;
+
+        header->info.sizeClass = BUFFERPOOL_HEAP;
+        header->info.size = (uint32) size;
+        cache->misses[BUFFERPOOL_HEAP]++;
+        cache->allocs[BUFFERPOOL_HEAP]++;
+        return header + 1;
+    }
+
+    if(!cache->free[sizeClass])
+    {
+        if(Refill(cache, sizeClass))
+            cache->misses[sizeClass]++;
+        else
+            cache->hits[sizeClass]++;
+
+        if(!cache->free[sizeClass])
+            return NULL;
+    }
+    else
+    {
+        cache->hits[sizeClass]++;
+    }
+
+    FreeBlock* block = cache->free[sizeClass];
+    cache->free[sizeClass] = block->next;
+    cache->count[sizeClass]--;
+    cache->allocs[sizeClass]++;
+
+    return block;
+}
+
+void BufferPool::Free(void* ptr)
+{
+    if(!ptr)
+        return;
+
+    ThreadCache* cache = GetThreadCache();
+    BlockHeader* header = ((BlockHeader*) ptr) - 1;
+    uint32 sizeClass = header->info.sizeClass;
+
+    if(sizeClass == BUFFERPOOL_HEAP)
+    {
+        cache->frees[BUFFERPOOL_HEAP]++;
+        free(header);
+        return;
+    }
+
+    CS_ASSERT_MSG("Buffer not allocated by BufferPool", sizeClass < BUFFERPOOL_CLASSES);
+
+    FreeBlock* block = (FreeBlock*) ptr;
+    block->next = cache->free[sizeClass];
+    cache->free[sizeClass] = block;
+    cache->count[sizeClass]++;
+    cache->frees[sizeClass]++;
+
+    // Keep at most two batches, the rest goes back for the other threads
+    if(cache->count[sizeClass] > classInfo[sizeClass].batch * 2)
+        Spill(cache, sizeClass);
+}
+
+size_t BufferPool::GetSize(const void* ptr)
+{
+    const BlockHeader* header = ((const BlockHeader*) ptr) - 1;
+    return header->info.size;
+}
+
+void BufferPool::GetStats(csArray<Stats> &stats)
+{
+    PoolGlobals &globals = Globals();
+
+    stats.SetSize(BUFFERPOOL_CLASSES + 1);
+    for(int i = 0; i <= BUFFERPOOL_CLASSES; i++)
+    {
+        Stats &s = stats[i];
+        s.blockSize = i < BUFFERPOOL_CLASSES ? classInfo[i].blockSize : 0;
+        s.hits = s.misses = 0;
+        s.inUse = 0;
+
+        if(i < BUFFERPOOL_CLASSES)
+        {
+            CS::Threading::MutexScopedLock lock(globals.classes[i].mutex);
+            s.highWater = globals.classes[i].created;
+        }
+        else
+        {
+            s.highWater = 0;
+        }
+    }
+
+    // The counters of the other threads are read without locking, they are
+    // only used for statistics so a slightly old value is fine.
+    CS::Threading::MutexScopedLock lock(globals.cachesMutex);
+    for(ThreadCache* cache = globals.caches; cache; cache = cache->next)
+    {
+        for(int i = 0; i <= BUFFERPOOL_CLASSES; i++)
+        {
+            stats[i].hits += cache->hits[i];
+            stats[i].misses += cache->misses[i];
+            stats[i].inUse += (int64) cache->allocs[i] - (int64) cache->frees[i];
+        }
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * bufferpool.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_BUFFERPOOL_H
+#define PS_BUFFERPOOL_H
+
+#include <cstypes.h>
+#include <csutil/array.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Number of size classes, larger requests go directly to the heap
+#define BUFFERPOOL_CLASSES 7
+
+/*   Design notes:
+ *
+ *  BufferPool hands out variable sized buffers from slabs of fixed size
+ *  blocks, one list of free blocks per size class (64, 256, 1K, 2K, 4K, 8K,
+ *  16K). The 2K class holds a full network packet, the larger classes the
+ *  messages split over a few packets. Anything above 16K is rare and goes
+ *  straight to malloc() and free(), so a few large messages don't pin 64K
+ *  blocks in the pool for the lifetime of the server.
+ *
+ *  Every thread has its own cache of free blocks per class, so allocating
+ *  and releasing a buffer is normally a pop or push on a thread local list
+ *  without locking. The caches exchange blocks with the global lists of the
+ *  pool in batches, this is the only place where a mutex is taken. This way
+ *  a buffer allocated in the main thread may be released by the network
+ *  thread and the block finds its way back.
+ *
+ *  Limitations:
+ *  1) Slabs are never returned to the heap, the pool keeps the high-water
+ *     mark of the memory used by the small classes.
+ *  2) The cached blocks of a thread that exits are not returned to the pool.
+ *     The pool is meant for the long living server threads.
+ */
+class BufferPool
+{
+public:
+    /// Counters of one size class
+    struct Stats
+    {
+        size_t blockSize;   ///< Usable size of the blocks of this class, 0 for the heap
+        uint64 hits;        ///< Allocations served from a free block
+        uint64 misses;      ///< Allocations that had to get memory from the heap
+        int64 inUse;        ///< Buffers allocated and not released yet
+        size_t highWater;   ///< Blocks ever created for this class
+    };
+
+    /**
+     * Allocate a buffer of at least size bytes.
+     *
+     * The buffer must be released with Free(), never with cs_free() or free().
+     */
+    static void* Alloc(size_t size);
+
+    /**
+     * Release a buffer allocated with Alloc(), NULL is ignored.
+     */
+    static void Free(void* ptr);
+
+    /**
+     * Get the usable size of a buffer allocated with Alloc().
+     */
+    static size_t GetSize(const void* ptr);
+
+    /**
+     * Get the counters of all size classes, summed over all threads.
+     *
+     * The last entry holds the requests too large for the pool.
+     */
+    static void GetStats(csArray<Stats> &stats);
+};
+
+/** @} */
+
+#endif
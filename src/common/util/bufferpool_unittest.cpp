@@ -0,0 +1,120 @@
+/*
+ * bufferpool_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/bufferpool.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <string.h>
+
+TEST(BufferPoolTest, SizeClasses)
+{
+    void* small = BufferPool::Alloc(10);
+    void* packet = BufferPool::Alloc(1400);
+    void* message = BufferPool::Alloc(3000);
+    void* large = BufferPool::Alloc(16384);
+    void* huge = BufferPool::Alloc(16385);
+
+    EXPECT_EQ(BufferPool::GetSize(small), (size_t)64);
+    EXPECT_EQ(BufferPool::GetSize(packet), (size_t)2048);
+    EXPECT_EQ(BufferPool::GetSize(message), (size_t)4096);
+    EXPECT_EQ(BufferPool::GetSize(large), (size_t)16384);
+    EXPECT_EQ(BufferPool::GetSize(huge), (size_t)16385);
+
+    // The buffers are usable up to the size of their class
+    memset(small, 1, 64);
+    memset(packet, 1, 2048);
+    memset(message, 1, 4096);
+    memset(large, 1, 16384);
+    memset(huge, 1, 16385);
+
+    BufferPool::Free(small);
+    BufferPool::Free(packet);
+    BufferPool::Free(message);
+    BufferPool::Free(large);
+    BufferPool::Free(huge);
+    BufferPool::Free(NULL);
+}
+
+TEST(BufferPoolTest, ReusesBlocks)
+{
+    void* first = BufferPool::Alloc(200);
+    BufferPool::Free(first);
+
+    // The thread cache hands out the block released last
+    void* second = BufferPool::Alloc(250);
+    EXPECT_EQ(first, second);
+    BufferPool::Free(second);
+}
+
+TEST(BufferPoolTest, Stats)
+{
+    csArray<BufferPool::Stats> before;
+    BufferPool::GetStats(before);
+
+    void* buffers[100];
+    for(int i = 0; i < 100; i++)
+        buffers[i] = BufferPool::Alloc(1000);
+
+    csArray<BufferPool::Stats> during;
+    BufferPool::GetStats(during);
+
+    for(int i = 0; i < 100; i++)
+        BufferPool::Free(buffers[i]);
+
+    csArray<BufferPool::Stats> after;
+    BufferPool::GetStats(after);
+
+    // 1000 bytes are served by the 1K class
+    ASSERT_EQ(during[2].blockSize, (size_t)1024);
+    EXPECT_EQ(during[2].inUse - before[2].inUse, 100);
+    EXPECT_EQ(after[2].inUse, before[2].inUse);
+    EXPECT_EQ((during[2].hits + during[2].misses) - (before[2].hits + before[2].misses), (uint64)100);
+    EXPECT_GE(during[2].highWater, (size_t)100);
+}
+
+TEST(BufferPoolTest, LargeBuffersUseTheHeap)
+{
+    csArray<BufferPool::Stats> before;
+    BufferPool::GetStats(before);
+
+    void* message = BufferPool::Alloc(65000);
+    EXPECT_EQ(BufferPool::GetSize(message), (size_t)65000);
+
+    csArray<BufferPool::Stats> during;
+    BufferPool::GetStats(during);
+    BufferPool::Free(message);
+
+    csArray<BufferPool::Stats> after;
+    BufferPool::GetStats(after);
+
+    // The last entry counts the heap buffers, they are released at once
+    size_t heap = during.GetSize() - 1;
+    ASSERT_EQ(during[heap].blockSize, (size_t)0);
+    EXPECT_EQ(during[heap].inUse - before[heap].inUse, 1);
+    EXPECT_EQ(after[heap].inUse, before[heap].inUse);
+    EXPECT_EQ(after[heap].highWater, (size_t)0);
+}
@@ -0,0 +1,91 @@
+/*
+ * chathistory.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include "util/chathistory.h"
+
+ChatLine::ChatLine(const char* text, time_t time)
+    : time(time ? time : ::time(0)), text(text)
+{
+}
+
+const csString &ChatLine::GetLogLine() const
+{
+    if (logLine.IsEmpty())
+    {
+        struct tm gmtm;
+#ifdef CS_PLATFORM_WIN32
+        gmtime_s(&gmtm, &time);
+#else
+        gmtime_r(&time, &gmtm);
+#endif
+        logLine.Format("[%d-%02d-%02d %02d:%02d:%02d] %s\n",
+                       gmtm.tm_year+1900, gmtm.tm_mon+1, gmtm.tm_mday,
+                       gmtm.tm_hour, gmtm.tm_min, gmtm.tm_sec, text.GetData());
+    }
+    return logLine;
+}
+
+//----------------------------------------------------------------------------
+
+ChatHistory::ChatHistory(size_t capacity)
+    : capacity(capacity), first(0), count(0)
+{
+}
+
+void ChatHistory::Push(ChatLine* line)
+{
+    if (lines.IsEmpty())
+    {
+        lines.SetSize(capacity);
+    }
+
+    if (count == lines.GetSize())
+    {
+        // Full, the new line takes the place of the oldest
+        lines[first] = line;
+        first = (first + 1) % lines.GetSize();
+    }
+    else
+    {
+        lines[(first + count) % lines.GetSize()] = line;
+        count++;
+    }
+}
+
+void ChatHistory::Expire(time_t before, size_t minimum)
+{
+    while (count > minimum && lines[first]->GetTime() < before)
+    {
+        lines[first] = NULL;
+        first = (first + 1) % lines.GetSize();
+        count--;
+    }
+}
+
+void ChatHistory::Empty()
+{
+    // Keeps the ring, the actor is likely to chat again
+    for (size_t i = 0; i < count; i++)
+    {
+        lines[(first + i) % lines.GetSize()] = NULL;
+    }
+    first = 0;
+    count = 0;
+}
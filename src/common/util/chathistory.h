@@ -0,0 +1,119 @@
+/*
+ * chathistory.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_CHATHISTORY_H
+#define PS_CHATHISTORY_H
+
+#include <time.h>
+
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+#include <csutil/ref.h>
+#include <csutil/refcount.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Lines kept in a chat history before the oldest are overwritten
+#define CHAT_HISTORY_SIZE 100
+
+/**
+ * A line of chat, formatted once and shared by the histories of everyone
+ * who heard it. It never changes once created.
+ */
+class ChatLine : public csRefCount
+{
+public:
+    /// When no time is given, current time is used.
+    ChatLine(const char* text, time_t time = 0);
+
+    time_t GetTime() const
+    {
+        return time;
+    }
+
+    const csString &GetText() const
+    {
+        return text;
+    }
+
+    /**
+     * The line as written to a log file: the time it was said, the text and
+     * a new line. It is formatted the first time it is asked for.
+     */
+    const csString &GetLogLine() const;
+
+private:
+    time_t time;
+    csString text;
+    mutable csString logLine;
+};
+
+/*   Design notes:
+ *
+ *  Everyone around hears what is said or shouted and keeps it in their
+ *  chat history, in case one of them reports the speaker. The line is
+ *  formatted once into a ChatLine and each ChatHistory only keeps a
+ *  reference to it in a ring of CHAT_HISTORY_SIZE references, allocated
+ *  when the first line is added. Adding a line or dropping the oldest one
+ *  never moves the others.
+ *
+ *  The history is not thread safe, neither is the reference count of the
+ *  lines: they are used by the thread handling the chat.
+ */
+class ChatHistory
+{
+public:
+    ChatHistory(size_t capacity = CHAT_HISTORY_SIZE);
+
+    /// Add a line, overwriting the oldest one when the history is full.
+    void Push(ChatLine* line);
+
+    /**
+     * Drop the lines said before a time.
+     *
+     * @param minimum Number of lines kept however old they are.
+     */
+    void Expire(time_t before, size_t minimum);
+
+    /// Drop all the lines.
+    void Empty();
+
+    size_t GetSize() const
+    {
+        return count;
+    }
+
+    /// Get a line, 0 is the oldest.
+    ChatLine* Get(size_t index) const
+    {
+        return lines[(first + index) % lines.GetSize()];
+    }
+
+private:
+    csArray<csRef<ChatLine> > lines;
+    size_t capacity;
+    size_t first;       ///< Index of the oldest line
+    size_t count;
+};
+
+/** @} */
+
+#endif
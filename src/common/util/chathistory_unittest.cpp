@@ -0,0 +1,178 @@
+/*
+ * chathistory_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/chathistory.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+TEST(ChatHistoryTest, OverwritesTheOldest)
+{
+    ChatHistory history(3);
+    for (int i = 0; i < 5; i++)
+    {
+        csRef<ChatLine> line;
+        line.AttachNew(new ChatLine(csString().Format("line %d", i), 1000 + i));
+        history.Push(line);
+    }
+
+    ASSERT_EQ(history.GetSize(), (size_t)3);
+    EXPECT_STREQ(history.Get(0)->GetText().GetData(), "line 2");
+    EXPECT_STREQ(history.Get(2)->GetText().GetData(), "line 4");
+}
+
+TEST(ChatHistoryTest, Expire)
+{
+    ChatHistory history(10);
+    for (int i = 0; i < 8; i++)
+    {
+        csRef<ChatLine> line;
+        line.AttachNew(new ChatLine("line", 1000 + i));
+        history.Push(line);
+    }
+
+    // Keeps the minimum even if older
+    history.Expire(1006, 3);
+    ASSERT_EQ(history.GetSize(), (size_t)3);
+    EXPECT_EQ(history.Get(0)->GetTime(), 1005);
+
+    history.Expire(1006, 1);
+    ASSERT_EQ(history.GetSize(), (size_t)2);
+    EXPECT_EQ(history.Get(0)->GetTime(), 1006);
+
+    history.Empty();
+    EXPECT_EQ(history.GetSize(), (size_t)0);
+}
+
+TEST(ChatHistoryTest, SharedLine)
+{
+    csRef<ChatLine> line;
+    line.AttachNew(new ChatLine("Someone shouts: hello", 0));
+
+    ChatHistory first, second;
+    first.Push(line);
+    second.Push(line);
+    EXPECT_EQ(first.Get(0), second.Get(0));
+    EXPECT_EQ(line->GetRefCount(), 3);
+
+    // "[2013-01-07 10:00:00] Someone shouts: hello\n"
+    const char* log = line->GetLogLine();
+    EXPECT_EQ(log[0], '[');
+    EXPECT_STREQ(log + 20, "] Someone shouts: hello\n");
+
+    first.Empty();
+    EXPECT_EQ(line->GetRefCount(), 2);
+}
+
+/// How the history was kept before: one formatted copy per listener
+struct CopiedChatLine
+{
+    time_t time;
+    csString line;
+};
+
+/**
+ * 150 players in a town, hearing 2000 shouts of 60 characters, kept in
+ * each one's history the way gemActor does it. The bytes kept are checked,
+ * the CPU time per message is only reported.
+ */
+TEST(ChatHistoryTest, ShoutInTown)
+{
+    const size_t listeners = 150;
+    const size_t messages = 2000;
+    const time_t now = 1357552800;
+    const char* text = "Selling a fine steel longsword, come to the Hydlaa plaza!!";
+
+    // One copy per listener, the oldest deleted from the front
+    csArray<CopiedChatLine>* copies = new csArray<CopiedChatLine>[listeners];
+    clock_t start = clock();
+    for (size_t m = 0; m < messages; m++)
+    {
+        for (size_t l = 0; l < listeners; l++)
+        {
+            CopiedChatLine entry;
+            entry.time = now;
+            entry.line.Format("%s shouts: %s", "Someone", text);
+            copies[l].Push(entry);
+            if (copies[l].GetSize() > CHAT_HISTORY_SIZE)
+                copies[l].DeleteIndex(0);
+        }
+    }
+    double copiedCpu = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    size_t copiedBytes = 0;
+    for (size_t l = 0; l < listeners; l++)
+    {
+        copiedBytes += copies[l].Capacity() * sizeof(CopiedChatLine);
+        for (size_t i = 0; i < copies[l].GetSize(); i++)
+        {
+            copiedBytes += copies[l][i].line.GetCapacity() + 1;
+        }
+    }
+    delete[] copies;
+
+    // One shared line, a reference in the ring of each listener
+    ChatHistory* histories = new ChatHistory[listeners];
+    start = clock();
+    for (size_t m = 0; m < messages; m++)
+    {
+        csRef<ChatLine> line;
+        line.AttachNew(new ChatLine(csString().Format("%s shouts: %s", "Someone", text), now));
+        for (size_t l = 0; l < listeners; l++)
+        {
+            histories[l].Push(line);
+        }
+    }
+    double sharedCpu = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    // The lines still referenced are the last CHAT_HISTORY_SIZE ones
+    size_t sharedBytes = listeners * CHAT_HISTORY_SIZE * sizeof(csRef<ChatLine>);
+    sharedBytes += CHAT_HISTORY_SIZE * (sizeof(ChatLine) + histories[0].Get(0)->GetText().GetCapacity() + 1);
+    for (size_t l = 0; l < listeners; l++)
+    {
+        EXPECT_EQ(histories[l].GetSize(), (size_t)CHAT_HISTORY_SIZE);
+    }
+    delete[] histories;
+
+    EXPECT_LT(sharedBytes, copiedBytes);
+
+    printf("%zu listeners, %zu messages: copied %.3f us per message and %zu KB kept, "
+           "shared %.3f us per message and %zu KB kept\n",
+           listeners, messages,
+           copiedCpu * 1000000.0 / messages, copiedBytes / 1024,
+           sharedCpu * 1000000.0 / messages, sharedBytes / 1024);
+
+    char value[32];
+    snprintf(value, sizeof(value), "%.3f", copiedCpu * 1000000.0 / messages);
+    ::testing::Test::RecordProperty("copied_us_per_message", value);
+    snprintf(value, sizeof(value), "%.3f", sharedCpu * 1000000.0 / messages);
+    ::testing::Test::RecordProperty("shared_us_per_message", value);
+    ::testing::Test::RecordProperty("copied_bytes", (int)copiedBytes);
+    ::testing::Test::RecordProperty("shared_bytes", (int)sharedBytes);
+}
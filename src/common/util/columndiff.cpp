@@ -0,0 +1,55 @@
+/*
+ * columndiff.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <string.h>
+
+#include "util/columndiff.h"
+
+uint32 DiffColumns(const csStringArray* saved, const csStringArray &values, csStringArray &changed)
+{
+    CS_ASSERT(values.GetSize() <= COLUMN_DIFF_MAX_COLUMNS);
+    CS_ASSERT(!saved || saved->GetSize() == values.GetSize());
+
+    uint32 columns = 0;
+    for(size_t i = 0; i < values.GetSize(); i++)
+    {
+        if(!saved || strcmp(saved->Get(i), values[i]))
+        {
+            columns |= 1u << i;
+            changed.Push(values[i]);
+        }
+    }
+    return columns;
+}
+
+void GroupByColumns(const csArray<uint32> &masks, csArray<uint32> &groupMasks,
+                    csArray<csArray<size_t> > &groupRows)
+{
+    for(size_t i = 0; i < masks.GetSize(); i++)
+    {
+        size_t group = groupMasks.Find(masks[i]);
+        if(group == csArrayItemNotFound)
+        {
+            group = groupMasks.Push(masks[i]);
+            groupRows.Push(csArray<size_t>());
+        }
+        groupRows[group].Push(i);
+    }
+}
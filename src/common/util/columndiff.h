@@ -0,0 +1,60 @@
+/*
+ * columndiff.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_COLUMNDIFF_H
+#define PS_COLUMNDIFF_H
+
+#include <cstypes.h>
+#include <csutil/array.h>
+#include <csutil/stringarray.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Columns a row may have, one bit each in a column mask.
+#define COLUMN_DIFF_MAX_COLUMNS 32
+
+/**
+ * Compare the columns of a row with the ones written last time.
+ *
+ * @param saved   The values written last time, NULL if nothing is known
+ *                about the row.
+ * @param values  The values of the row now, at most
+ *                COLUMN_DIFF_MAX_COLUMNS of them.
+ * @param changed The values differing from saved are appended, in the
+ *                order of their columns.
+ * @return A bit per column differing from saved, all the columns without saved.
+ */
+uint32 DiffColumns(const csStringArray* saved, const csStringArray &values, csStringArray &changed);
+
+/**
+ * Group rows by the columns they change, so each group can be written
+ * with the same statement.
+ *
+ * @param masks      The columns of each row as returned by DiffColumns().
+ * @param groupMasks The distinct masks, in the order they are first found.
+ * @param groupRows  The indexes in masks of the rows of each group.
+ */
+void GroupByColumns(const csArray<uint32> &masks, csArray<uint32> &groupMasks,
+                    csArray<csArray<size_t> > &groupRows);
+
+/** @} */
+
+#endif
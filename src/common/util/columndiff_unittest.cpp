@@ -0,0 +1,114 @@
+/*
+ * columndiff_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/columndiff.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+TEST(ColumnDiffTest, NothingSaved)
+{
+    csStringArray values;
+    values.Push("1");
+    values.Push("'sword'");
+    values.Push("NULL");
+
+    csStringArray changed;
+    EXPECT_EQ(0x7u, DiffColumns(NULL, values, changed));
+    ASSERT_EQ(3u, changed.GetSize());
+    EXPECT_STREQ("'sword'", changed[1]);
+}
+
+TEST(ColumnDiffTest, ChangedColumns)
+{
+    csStringArray saved;
+    saved.Push("1");
+    saved.Push("'sword'");
+    saved.Push("NULL");
+    saved.Push("5");
+
+    csStringArray values(saved);
+    values.Put(1, "'axe'");
+    values.Put(3, "6");
+
+    csStringArray changed;
+    EXPECT_EQ(0xAu, DiffColumns(&saved, values, changed));
+    ASSERT_EQ(2u, changed.GetSize());
+    EXPECT_STREQ("'axe'", changed[0]);
+    EXPECT_STREQ("6", changed[1]);
+
+    changed.Empty();
+    EXPECT_EQ(0u, DiffColumns(&saved, saved, changed));
+    EXPECT_EQ(0u, changed.GetSize());
+}
+
+TEST(ColumnDiffTest, LastColumn)
+{
+    csStringArray saved;
+    for(int i = 0; i < COLUMN_DIFF_MAX_COLUMNS; i++)
+    {
+        saved.Push("0");
+    }
+    csStringArray values(saved);
+    values.Put(COLUMN_DIFF_MAX_COLUMNS - 1, "1");
+
+    csStringArray changed;
+    EXPECT_EQ(0x80000000u, DiffColumns(&saved, values, changed));
+    ASSERT_EQ(1u, changed.GetSize());
+
+    changed.Empty();
+    EXPECT_EQ(0xFFFFFFFFu, DiffColumns(NULL, values, changed));
+    EXPECT_EQ((size_t)COLUMN_DIFF_MAX_COLUMNS, changed.GetSize());
+}
+
+TEST(ColumnDiffTest, GroupByColumns)
+{
+    csArray<uint32> masks;
+    masks.Push(0x1);
+    masks.Push(0x6);
+    masks.Push(0x1);
+    masks.Push(0x80000000u);
+    masks.Push(0x6);
+
+    csArray<uint32> groupMasks;
+    csArray<csArray<size_t> > groupRows;
+    GroupByColumns(masks, groupMasks, groupRows);
+
+    ASSERT_EQ(3u, groupMasks.GetSize());
+    ASSERT_EQ(3u, groupRows.GetSize());
+    EXPECT_EQ(0x1u, groupMasks[0]);
+    EXPECT_EQ(0x6u, groupMasks[1]);
+    EXPECT_EQ(0x80000000u, groupMasks[2]);
+
+    ASSERT_EQ(2u, groupRows[0].GetSize());
+    EXPECT_EQ(0u, groupRows[0][0]);
+    EXPECT_EQ(2u, groupRows[0][1]);
+    ASSERT_EQ(2u, groupRows[1].GetSize());
+    EXPECT_EQ(1u, groupRows[1][0]);
+    EXPECT_EQ(4u, groupRows[1][1]);
+    ASSERT_EQ(1u, groupRows[2].GetSize());
+    EXPECT_EQ(3u, groupRows[2][0]);
+}
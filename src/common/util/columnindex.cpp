@@ -0,0 +1,66 @@
+/*
+ * columnindex.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <ctype.h>
+#include <csutil/csstring.h>
+
+#include "util/columnindex.h"
+
+/// Longest name lowered on the stack, SQL column names are at most 64 characters
+#define COLUMN_NAME_BUFFER 65
+
+void ColumnIndex::Add(const char* name, int column)
+{
+    if (!name)
+        return;
+
+    csString key(name);
+    key.Downcase();
+    if (!columns.In(key.GetData()))
+    {
+        // The array keeps its own copy, the pointer stays valid as it grows
+        size_t index = names.Push(key);
+        columns.Put(names[index], column);
+    }
+}
+
+int ColumnIndex::Find(const char* name) const
+{
+    if (!name)
+        return -1;
+
+    char key[COLUMN_NAME_BUFFER];
+    size_t length = 0;
+    while (name[length] && length < COLUMN_NAME_BUFFER - 1)
+    {
+        key[length] = tolower((unsigned char) name[length]);
+        length++;
+    }
+    key[length] = '\0';
+
+    if (name[length])
+    {
+        // Longer than any SQL column name, lowered in a csString then
+        csString longKey(name);
+        longKey.Downcase();
+        return columns.Get(longKey.GetData(), -1);
+    }
+    return columns.Get(key, -1);
+}
@@ -0,0 +1,61 @@
+/*
+ * columnindex.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_COLUMNINDEX_H
+#define PS_COLUMNINDEX_H
+
+#include <csutil/hash.h>
+#include <csutil/stringarray.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/*   Design notes:
+ *
+ *  The loaders read the columns of a result set by name, row after row.
+ *  The DAL plugins used to compare the name with every column name of the
+ *  result until one matched. ColumnIndex is built once per result set from
+ *  the column names and finds the column of a name with one hash lookup.
+ *  Names are compared without case, as SQL does. The names of the columns
+ *  are kept in lower case and Find() lowers the name looked up into a
+ *  buffer on the stack, so a lookup doesn't allocate anything.
+ */
+class ColumnIndex
+{
+public:
+    /// Add a column, a name already added keeps its first column.
+    void Add(const char* name, int column);
+
+    /// Find the column of a name, -1 if there is none.
+    int Find(const char* name) const;
+
+    size_t GetSize() const
+    {
+        return columns.GetSize();
+    }
+
+private:
+    csStringArray names;                ///< The lower case names, owning the keys
+    csHash<int, const char*> columns;   ///< Column by lower case name
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * columnindex_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/columnindex.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+TEST(ColumnIndexTest, Find)
+{
+    ColumnIndex index;
+    index.Add("id", 0);
+    index.Add("Name", 1);
+    index.Add("loc_x", 2);
+    index.Add("ID", 3);
+
+    EXPECT_EQ(index.Find("id"), 0);
+    EXPECT_EQ(index.Find("Id"), 0);
+    EXPECT_EQ(index.Find("name"), 1);
+    EXPECT_EQ(index.Find("LOC_X"), 2);
+    EXPECT_EQ(index.Find("loc_y"), -1);
+    EXPECT_EQ(index.GetSize(), (size_t)3);
+    EXPECT_EQ(index.Find(NULL), -1);
+}
+
+TEST(ColumnIndexTest, LongNames)
+{
+    // Longer than the buffer Find() lowers the names in
+    csString name;
+    for (int i = 0; i < 10; i++)
+    {
+        name.Append("Long_Column_");
+    }
+
+    ColumnIndex index;
+    index.Add(name, 4);
+    EXPECT_EQ(index.Find(name), 4);
+    name.Downcase();
+    EXPECT_EQ(index.Find(name), 4);
+    name.Truncate(64);
+    EXPECT_EQ(index.Find(name), -1);
+}
+
+/**
+ * The 60 columns of a characters row, each read by name on each row the way
+ * psCharacterLoader reads them, give the same columns as comparing each
+ * name, as the DAL plugins did.
+ *
+ * The time per row of both is reported, it is not checked.
+ */
+TEST(ColumnIndexTest, CharacterRows)
+{
+    const int count = 60;
+    const int rows = 2000;
+
+    csString names[count];
+    for (int i = 0; i < count; i++)
+    {
+        names[i].Format("Column_%02d", i);
+    }
+
+    // Compared with each column name, as the DAL plugins did
+    clock_t start = clock();
+    long found = 0;
+    for (int r = 0; r < rows; r++)
+    {
+        for (int c = 0; c < count; c++)
+        {
+            for (int i = 0; i < count; i++)
+            {
+                if (!strcasecmp(names[i], names[c]))
+                {
+                    found += i;
+                    break;
+                }
+            }
+        }
+    }
+    double scanCpu = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    start = clock();
+    ColumnIndex index;
+    for (int i = 0; i < count; i++)
+    {
+        index.Add(names[i], i);
+    }
+    long indexed = 0;
+    for (int r = 0; r < rows; r++)
+    {
+        for (int c = 0; c < count; c++)
+        {
+            indexed += index.Find(names[c]);
+        }
+    }
+    double indexCpu = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    EXPECT_EQ(found, indexed);
+
+    printf("%d rows of %d columns: %.3f us per row scanning the names, %.3f us per row with the index\n",
+           rows, count, scanCpu * 1000000.0 / rows, indexCpu * 1000000.0 / rows);
+
+    char value[32];
+    snprintf(value, sizeof(value), "%.3f", scanCpu * 1000000.0 / rows);
+    ::testing::Test::RecordProperty("scan_us_per_row", value);
+    snprintf(value, sizeof(value), "%.3f", indexCpu * 1000000.0 / rows);
+    ::testing::Test::RecordProperty("index_us_per_row", value);
+}
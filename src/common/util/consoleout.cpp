@@ -62,9 +62,10 @@
 #include "consoleout.h"
 #include "command.h"
 #include "util/pserror.h"
+#include "util/asynclog.h"
 
 FILE* errorLog = NULL;
-static FILE* outputfile = NULL;
+static csRef<AsyncLogFile> outputfile;
 static ConsoleOutMsgClass maxoutput_stdout = CON_SPAM;
 static ConsoleOutMsgClass maxoutput_file = CON_SPAM;
 
@@ -103,14 +104,13 @@ ConsoleOutMsgClass ConsoleOut::GetMaximumOutputClassFile()
 
 void ConsoleOut::SetOutputFile (const char* filename, bool append)
 {
-    if (outputfile)
-    {
-        fclose (outputfile);
-        outputfile = NULL;
-    }
+    // Closed once the records queued for it are written
+    outputfile = NULL;
     if (filename)
     {
-        outputfile = fopen (filename, append ? "a" : "w");
+        outputfile.AttachNew(new StdioLogFile(filename, append));
+        if (!outputfile->IsOpen())
+            outputfile = NULL;
     }
 }
 
@@ -182,12 +182,13 @@ void ConsoleOut::Intern_VPrintf (ConsoleOutMsgClass con, const char* string, va_
     // Check for output file
     if (outputfile && con <= maxoutput_file)
     {
-        fprintf(outputfile, "%s", output.GetDataSafe());
+        AsyncLog::Write(outputfile, output.GetDataSafe());
     }
     // Check for error log
     if (con == CON_ERROR ||
         con == CON_BUG)
     {
+        // Written at once, an error is often the last thing before a crash
         if(!errorLog)
         {
             errorLog = fopen("errorlog.txt","w");
@@ -220,12 +221,13 @@ void ConsoleOut::Intern_VPrintf_LogOnly(ConsoleOutMsgClass con,
 {
     if (outputfile && con <= maxoutput_file)
     {
+        csString output;
         for (int i=0; i < shift; i++)
         {
-            vfprintf (outputfile, "  ", args);
+            output.Append("  ");
         }
-        vfprintf (outputfile, string, args);
-        fflush (outputfile);
+        output.AppendFmtV(string, args);
+        AsyncLog::Write(outputfile, output.GetDataSafe());
     }
 }
 
@@ -27,8 +27,6 @@
  * \addtogroup common_util
  * @{ */
 
-extern FILE * errorLog;
-
 /**
  * Different message classes.
  */
@@ -18,6 +18,7 @@
  */
 
 #include <psconfig.h>
+#include <string.h>
 #include "util/psstring.h"
 #include "dbprofile.h"
 #include "util/log.h"
@@ -47,18 +48,53 @@ void psDBProfiles::StripConstantsFromSQL(psString & sql)
     }
 }
 
-void psDBProfiles::AddSQLTime(const csString & sql, csTicks time)
+bool psDBProfiles::IsTemplate(const char * statement)
 {
+    if (!statement)
+        return false;
+
+    const char * conversion = strchr(statement, '%');
+    if (!conversion)
+        return false;
+
+    // "%s" alone only passes a statement built elsewhere
+    return strcmp(statement, "%s") != 0;
+}
+
+void psDBProfiles::AddSQLTime(const char * statement, const csString & sql, csTicks time)
+{
+    // The format has no constants in it, it's enough to tell the statements apart
+    if (IsTemplate(statement))
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        AddCons(statement, time);
+        return;
+    }
+
     psString strippedSQL(sql.GetData());
     
     strippedSQL.Downcase();
     StripConstantsFromSQL(strippedSQL);
-    
+
+    CS::Threading::MutexScopedLock lock(mutex);
     AddCons(strippedSQL.GetData(), time);
 }
 
 csString psDBProfiles::Dump()
 {
-    return psNamedProfiles::Dump("msec", "Database profile");
+    CS::Threading::MutexScopedLock lock(mutex);
+    return psNamedProfiles::Dump("usec", "Database profile");
+}
+
+csString psDBProfiles::Export(const char * metric)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    return psOperProfileSet::Export(metric);
+}
+
+void psDBProfiles::Reset()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    psNamedProfiles::Reset();
 }
 
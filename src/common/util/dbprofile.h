@@ -21,6 +21,7 @@
 #define __DBPROFILE_H__
 
 #include <csutil/parray.h>
+#include <csutil/threading/mutex.h>
 #include "util/psprofile.h"
 
 class psString;
@@ -29,18 +30,34 @@ class psString;
  * \addtogroup common_util
  * @{ */
 
-/**  Statistics of time consumed by SQL statements */
+/**  Statistics of time consumed by SQL statements.
+  *  A connection may be used from several threads and is exported from the
+  *  one of the metrics exporter, all the functions take the mutex. */
 class psDBProfiles : public psNamedProfiles
 {
 public:
 
-    virtual void AddSQLTime(const csString & sql, csTicks time);
+    /** Add the time taken by a statement, in usec.
+      * 'statement' is the format 'sql' was built from, e.g. "select * from items where id=%u".
+      * It names the statement as it is; when it's NULL or has no conversions, e.g. "%s" or a
+      * statement built by the caller, the constants are stripped from 'sql' instead */
+    virtual void AddSQLTime(const char * statement, const csString & sql, csTicks time);
     csString Dump();
-    
+
+    /** Return the statistics for the metrics export, see psOperProfileSet::Export() */
+    csString Export(const char * metric = "ps_db_query_usec");
+
+    void Reset();
+
 protected:
 
+    /** Return true if a statement format has a conversion besides a lone "%s" */
+    static bool IsTemplate(const char * statement);
+
     void StripConstantsFromSQL(psString & sql);
 
+    CS::Threading::Mutex mutex;
+
 };
 
 /** @} */
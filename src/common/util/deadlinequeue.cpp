@@ -0,0 +1,83 @@
+/*
+ * deadlinequeue.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include "util/deadlinequeue.h"
+
+DeadlineQueue::DeadlineQueue()
+{
+}
+
+DeadlineQueue::~DeadlineQueue()
+{
+    while (heap.Length())
+    {
+        delete heap.DeleteMin();
+    }
+}
+
+void DeadlineQueue::Schedule(uint32 id, csTicks deadline)
+{
+    const csTicks* current = deadlines.GetElementPointer(id);
+    if (current)
+    {
+        // The entry in the heap still matches
+        if (*current == deadline)
+            return;
+
+        deadlines.PutUnique(id, deadline);
+    }
+    else
+    {
+        deadlines.Put(id, deadline);
+    }
+
+    Entry* entry = new Entry;
+    entry->id = id;
+    entry->deadline = deadline;
+    heap.Insert(entry);
+}
+
+void DeadlineQueue::Remove(uint32 id)
+{
+    // The entry in the heap is skipped once it expires
+    deadlines.DeleteAll(id);
+}
+
+void DeadlineQueue::PopExpired(csTicks now, csArray<uint32> &ids)
+{
+    Entry* entry;
+    while ((entry = heap.FindMin()))
+    {
+        if ((int32)(entry->deadline - now) >= 0)
+            break;
+
+        heap.DeleteMin();
+
+        // Skip the ids removed or scheduled again since
+        const csTicks* current = deadlines.GetElementPointer(entry->id);
+        if (current && *current == entry->deadline)
+        {
+            deadlines.DeleteAll(entry->id);
+            ids.Push(entry->id);
+        }
+
+        delete entry;
+    }
+}
@@ -0,0 +1,95 @@
+/*
+ * deadlinequeue.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_DEADLINEQUEUE_H
+#define PS_DEADLINEQUEUE_H
+
+#include <cstypes.h>
+#include <csutil/array.h>
+#include <csutil/hash.h>
+
+#include "util/heap.h"
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/*   Design notes:
+ *
+ *  DeadlineQueue keeps ids, like client numbers, ordered by the time they
+ *  have to be looked at next. Taking the expired ids only touches those, no
+ *  matter how many ids are scheduled.
+ *
+ *  The ids are kept in a Heap. Scheduling an id again doesn't search the
+ *  heap, the current deadline of every id is kept in a hash and the entries
+ *  of the heap not matching it are skipped once they expire. The owner is
+ *  expected to schedule an id again only when its deadline comes up, so
+ *  the heap holds about one entry per id.
+ *
+ *  Deadlines are compared by their difference, the order survives the wrap
+ *  of the ticks. The queue is not thread safe.
+ */
+class DeadlineQueue
+{
+public:
+    DeadlineQueue();
+    ~DeadlineQueue();
+
+    /// Schedule an id, replacing the deadline it had.
+    void Schedule(uint32 id, csTicks deadline);
+
+    /// Forget an id.
+    void Remove(uint32 id);
+
+    /**
+     * Take the ids whose deadline is before now, the earliest first.
+     *
+     * They are not scheduled anymore.
+     */
+    void PopExpired(csTicks now, csArray<uint32> &ids);
+
+    /// Number of ids scheduled.
+    size_t GetSize() const
+    {
+        return deadlines.GetSize();
+    }
+
+private:
+    struct Entry
+    {
+        uint32 id;
+        csTicks deadline;
+
+        bool operator<(const Entry &other) const
+        {
+            return (int32)(deadline - other.deadline) < 0;
+        }
+        bool operator>(const Entry &other) const
+        {
+            return (int32)(deadline - other.deadline) > 0;
+        }
+    };
+
+    Heap<Entry> heap;
+    csHash<csTicks, uint32> deadlines;  ///< Current deadline by id
+};
+
+/** @} */
+
+#endif
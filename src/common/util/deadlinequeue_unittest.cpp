@@ -0,0 +1,197 @@
+/*
+ * deadlinequeue_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/deadlinequeue.h"
+#include "util/linkcheck.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <stdio.h>
+#include <time.h>
+
+TEST(DeadlineQueueTest, EarliestFirst)
+{
+    DeadlineQueue queue;
+    queue.Schedule(1, 300);
+    queue.Schedule(2, 100);
+    queue.Schedule(3, 200);
+
+    csArray<uint32> ids;
+    queue.PopExpired(250, ids);
+    ASSERT_EQ(ids.GetSize(), (size_t)2);
+    EXPECT_EQ(ids[0], (uint32)2);
+    EXPECT_EQ(ids[1], (uint32)3);
+    EXPECT_EQ(queue.GetSize(), (size_t)1);
+
+    // Not before the deadline passed
+    ids.Empty();
+    queue.PopExpired(300, ids);
+    EXPECT_EQ(ids.GetSize(), (size_t)0);
+    queue.PopExpired(301, ids);
+    ASSERT_EQ(ids.GetSize(), (size_t)1);
+    EXPECT_EQ(ids[0], (uint32)1);
+}
+
+TEST(DeadlineQueueTest, ScheduleAgainAndRemove)
+{
+    DeadlineQueue queue;
+    queue.Schedule(1, 100);
+    queue.Schedule(2, 100);
+    queue.Schedule(1, 500);
+    queue.Schedule(2, 100);
+    queue.Remove(2);
+
+    csArray<uint32> ids;
+    queue.PopExpired(200, ids);
+    EXPECT_EQ(ids.GetSize(), (size_t)0);
+
+    // Scheduled again after being removed
+    queue.Schedule(2, 100);
+    queue.PopExpired(200, ids);
+    ASSERT_EQ(ids.GetSize(), (size_t)1);
+    EXPECT_EQ(ids[0], (uint32)2);
+
+    ids.Empty();
+    queue.PopExpired(600, ids);
+    ASSERT_EQ(ids.GetSize(), (size_t)1);
+    EXPECT_EQ(ids[0], (uint32)1);
+    EXPECT_EQ(queue.GetSize(), (size_t)0);
+}
+
+TEST(DeadlineQueueTest, TicksWrap)
+{
+    DeadlineQueue queue;
+    queue.Schedule(1, 0xFFFFFF00);
+    queue.Schedule(2, 0x00000100);
+
+    csArray<uint32> ids;
+    queue.PopExpired(0x00000010, ids);
+    ASSERT_EQ(ids.GetSize(), (size_t)1);
+    EXPECT_EQ(ids[0], (uint32)1);
+}
+
+/**
+ * 5000 connected clients, idle but for the acks keeping their connection
+ * alive, checked the way NetManager::CheckLinkDead() does it: every 3
+ * seconds, with a 15 second timeout. The CPU time per check is reported
+ * next to the one of looking at every client at every check, as before the
+ * queue; it is not checked.
+ */
+TEST(DeadlineQueueTest, IdleConnections)
+{
+    const uint32 clients = 5000;
+    const csTicks timeout = 15000;
+    const csTicks linkCheck = 3000;
+    const csTicks packetInterval = 2000;
+    const csTicks duration = 10 * 60 * 1000;
+
+    csArray<LinkCheckClient> state;
+    LinkCheckClient idle = { 0, 0, false, false, true };
+    state.SetSize(clients, idle);
+
+    // Every client at every check
+    clock_t scanClock = 0;
+    size_t scanned = 0;
+    for (csTicks now = linkCheck; now <= duration; now += linkCheck)
+    {
+        for (uint32 i = 0; i < clients; i++)
+        {
+            csTicks received = now - (i % packetInterval);
+            if (received - state[i].lastRecvPacketTime >= packetInterval)
+                state[i].lastRecvPacketTime = received;
+        }
+
+        clock_t start = clock();
+        csTicks next;
+        for (uint32 i = 0; i < clients; i++)
+        {
+            if (CheckLink(state[i], now, timeout, linkCheck, next) != LINKCHECK_WAIT)
+                scanned++;
+        }
+        scanClock += clock() - start;
+    }
+    double scanCpu = (double)scanClock / CLOCKS_PER_SEC;
+    EXPECT_EQ(scanned, (size_t)0);
+
+    for (uint32 i = 0; i < clients; i++)
+    {
+        state[i] = idle;
+    }
+
+    clock_t queueClock = 0;
+    DeadlineQueue queue;
+    for (uint32 i = 0; i < clients; i++)
+    {
+        queue.Schedule(i, timeout);
+    }
+
+    uint64 touched = 0;
+    size_t checks = 0;
+    size_t linkDead = 0;
+    csArray<uint32> due;
+
+    for (csTicks now = linkCheck; now <= duration; now += linkCheck)
+    {
+        // A packet from every client since the last check, spread over it
+        for (uint32 i = 0; i < clients; i++)
+        {
+            csTicks received = now - (i % packetInterval);
+            if (received - state[i].lastRecvPacketTime >= packetInterval)
+                state[i].lastRecvPacketTime = received;
+        }
+
+        clock_t start = clock();
+        due.Empty();
+        queue.PopExpired(now, due);
+        for (size_t i = 0; i < due.GetSize(); i++)
+        {
+            csTicks next;
+            if (CheckLink(state[due[i]], now, timeout, linkCheck, next) != LINKCHECK_WAIT)
+                linkDead++;
+            queue.Schedule(due[i], next);
+        }
+        queueClock += clock() - start;
+        touched += due.GetSize();
+        checks++;
+    }
+    double queueCpu = (double)queueClock / CLOCKS_PER_SEC;
+
+    // Each client comes up once per timeout, not at every check
+    double perCheck = (double)touched / checks;
+    EXPECT_EQ(linkDead, (size_t)0);
+    EXPECT_LE(perCheck, clients * linkCheck / (double)timeout * 1.1);
+    EXPECT_EQ(queue.GetSize(), (size_t)clients);
+
+    printf("%u idle clients, %zu link checks: %.0f clients looked at per check, "
+           "%.3f ms CPU per check, %.3f ms looking at every client\n",
+           clients, checks, perCheck, queueCpu * 1000.0 / checks, scanCpu * 1000.0 / checks);
+
+    char value[32];
+    snprintf(value, sizeof(value), "%.3f", queueCpu * 1000.0 / checks);
+    ::testing::Test::RecordProperty("cpu_ms_per_check", value);
+    snprintf(value, sizeof(value), "%.3f", scanCpu * 1000.0 / checks);
+    ::testing::Test::RecordProperty("scan_cpu_ms_per_check", value);
+}
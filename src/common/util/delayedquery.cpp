@@ -0,0 +1,390 @@
+/*
+ * delayedquery.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <csutil/sysfunc.h>
+
+#include "util/delayedquery.h"
+#include "util/log.h"
+
+/// Transactions worth of statements read back from the spill file at once
+#define UNSPILL_TRANSACTIONS 4
+
+/// Milliseconds between attempts to connect
+#define CONNECT_RETRY 1000
+
+DelayedQueryManager::DelayedQueryManager(iDelayedQueryConnection* connection, size_t highWater,
+                                         size_t transactionSize, const char* spillFile)
+    :connection(connection),highWater(highWater ? highWater : 1),
+     transactionSize(transactionSize ? transactionSize : 1),spillFile(spillFile),
+     taken(0),stop(false),spillWrite(NULL),spillRead(NULL),spillBroken(false)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+DelayedQueryManager::~DelayedQueryManager()
+{
+    if (spillWrite)
+    {
+        fclose(spillWrite);
+        fclose(spillRead);
+        if (stats.spilled)
+        {
+            Error3("%zu delayed queries left in %s.", stats.spilled, spillFile.GetData());
+        }
+        else
+        {
+            remove(spillFile);
+        }
+    }
+    delete connection;
+}
+
+void DelayedQueryManager::Run()
+{
+    while (!connection->Connect())
+    {
+        Error2("Delayed query thread could not connect to the database: %s", connection->GetLastError());
+
+        // Keep the statements until the database is back
+        {
+            CS::Threading::MutexScopedLock lock(mutex);
+            if (stop)
+            {
+                Error2("Dropping %zu delayed queries.", queue.GetSize() + stats.spilled);
+                return;
+            }
+        }
+        csSleep(CONNECT_RETRY);
+    }
+
+    csArray<csString> queries;
+    while (Take(queries))
+    {
+        for (size_t begin = 0; begin < queries.GetSize(); begin += transactionSize)
+        {
+            size_t end = (queries.GetSize() - begin > transactionSize) ? begin + transactionSize : queries.GetSize();
+            RunTransaction(queries, begin, end);
+        }
+        queries.Empty();
+    }
+
+    connection->Disconnect();
+}
+
+void DelayedQueryManager::Push(const char* query)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    stats.pushed++;
+
+    // Once one statement is spilled all of them are until the file is read
+    // back, the ones in memory must stay older than the ones in the file.
+    if (stats.spilled || queue.GetSize() + taken >= highWater)
+    {
+        if (!spillFile.IsEmpty() && Spill(query))
+        {
+            workCondition.NotifyOne();
+            return;
+        }
+
+        stats.blocked++;
+        csTicks start = csGetTicks();
+        while (!stop && (stats.spilled || queue.GetSize() + taken >= highWater))
+        {
+            spaceCondition.Wait(mutex);
+        }
+        stats.blockedTime += csGetTicks() - start;
+    }
+
+    queue.Push(query);
+
+    size_t depth = queue.GetSize() + taken + stats.spilled;
+    if (depth > stats.maxDepth)
+    {
+        stats.maxDepth = depth;
+    }
+    workCondition.NotifyOne();
+}
+
+void DelayedQueryManager::Stop()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    stop = true;
+    workCondition.NotifyAll();
+    spaceCondition.NotifyAll();
+}
+
+bool DelayedQueryManager::Take(csArray<csString> &queries)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    while (!stop && queue.IsEmpty() && !stats.spilled)
+    {
+        workCondition.Wait(mutex);
+    }
+
+    // The ones in memory are older than the spilled ones
+    if (!queue.IsEmpty())
+    {
+        queue.TransferTo(queries);
+    }
+    else if (stats.spilled)
+    {
+        Unspill(queries);
+    }
+    else
+    {
+        return false;
+    }
+
+    taken = queries.GetSize();
+    return true;
+}
+
+void DelayedQueryManager::RunTransaction(csArray<csString> &queries, size_t begin, size_t end)
+{
+    csTicks start = csGetTicks();
+    size_t executed = 0;
+    size_t failed = 0;
+    bool rollback = false;
+
+    size_t next = begin;
+    while (next < end)
+    {
+        if (end - next == 1)
+        {
+            if (RunQuery(queries[next]))
+            {
+                executed++;
+            }
+            else
+            {
+                Error3("Delayed query failed: %s\nQuery: %s", connection->GetLastError(), queries[next].GetData());
+                failed++;
+            }
+            break;
+        }
+
+        bool ok = connection->Execute("BEGIN");
+        size_t i = next;
+        for (; ok && i < end; i++)
+        {
+            ok = RunQuery(queries[i]);
+        }
+        if (ok)
+        {
+            if (connection->Execute("COMMIT"))
+            {
+                executed += end - next;
+                break;
+            }
+        }
+        else if (i > next && connection->FailureKeepsTransaction())
+        {
+            // Keep the ones before the bad one and go on after it
+            i--;
+            Error3("Delayed query failed: %s\nQuery: %s", connection->GetLastError(), queries[i].GetData());
+            failed++;
+            if (connection->Execute("COMMIT"))
+            {
+                executed += i - next;
+                next = i + 1;
+                continue;
+            }
+            // Which of them made it is unknown, the bad one is not run again
+            queries[i].Empty();
+        }
+
+        // Rerun them one by one, only the bad ones get lost
+        rollback = true;
+        connection->Execute("ROLLBACK");
+        for (i = next; i < end; i++)
+        {
+            if (queries[i].IsEmpty())
+            {
+                continue;
+            }
+            if (RunQuery(queries[i]))
+            {
+                executed++;
+            }
+            else
+            {
+                Error3("Delayed query failed: %s\nQuery: %s", connection->GetLastError(), queries[i].GetData());
+                failed++;
+            }
+        }
+        break;
+    }
+
+    csTicks time = csGetTicks() - start;
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    stats.executed += executed;
+    stats.failed += failed;
+    stats.transactions++;
+    if (rollback)
+    {
+        stats.rollbacks++;
+    }
+    stats.commitTime += time;
+    if (time > stats.maxCommitTime)
+    {
+        stats.maxCommitTime = time;
+    }
+    taken -= end - begin;
+    spaceCondition.NotifyAll();
+}
+
+bool DelayedQueryManager::RunQuery(const char* query)
+{
+    csMicroTicks start = csGetMicroTicks();
+    if (!connection->Execute(query))
+    {
+        return false;
+    }
+
+    profs.AddSQLTime(NULL, query, (csTicks)(csGetMicroTicks() - start));
+    return true;
+}
+
+bool DelayedQueryManager::Spill(const char* query)
+{
+    if (spillBroken)
+    {
+        return false;
+    }
+
+    if (!spillWrite)
+    {
+        spillWrite = fopen(spillFile, "wb");
+        spillRead = spillWrite ? fopen(spillFile, "rb") : NULL;
+        if (!spillRead)
+        {
+            Error2("Could not open the delayed query spill file %s.", spillFile.GetData());
+            if (spillWrite)
+            {
+                fclose(spillWrite);
+                spillWrite = NULL;
+            }
+            return false;
+        }
+    }
+
+    uint32 length = (uint32)strlen(query);
+    if (fwrite(&length, sizeof(length), 1, spillWrite) != 1 ||
+        fwrite(query, 1, length, spillWrite) != length ||
+        fflush(spillWrite))
+    {
+        // A statement partly written would break the ones after it, the
+        // file is only used again once it is read back and started over.
+        Error2("Could not write to the delayed query spill file %s.", spillFile.GetData());
+        spillBroken = true;
+        return false;
+    }
+
+    stats.spilled++;
+    stats.spills++;
+    size_t depth = queue.GetSize() + taken + stats.spilled;
+    if (depth > stats.maxDepth)
+    {
+        stats.maxDepth = depth;
+    }
+    return true;
+}
+
+void DelayedQueryManager::Unspill(csArray<csString> &queries)
+{
+    size_t count = transactionSize * UNSPILL_TRANSACTIONS;
+    if (count > stats.spilled)
+    {
+        count = stats.spilled;
+    }
+
+    clearerr(spillRead);
+    csArray<char> buffer;
+    for (size_t i = 0; i < count; i++)
+    {
+        uint32 length;
+        if (fread(&length, sizeof(length), 1, spillRead) != 1)
+        {
+            break;
+        }
+        buffer.SetSize(length + 1);
+        if (fread(buffer.GetArray(), 1, length, spillRead) != length)
+        {
+            break;
+        }
+        buffer[length] = '\0';
+        queries.Push(buffer.GetArray());
+    }
+
+    if (queries.GetSize() < count)
+    {
+        Error3("Lost %zu delayed queries reading back %s.", stats.spilled - queries.GetSize(), spillFile.GetData());
+        stats.spilled = queries.GetSize();
+    }
+    stats.spilled -= queries.GetSize();
+
+    // Start over with an empty file next time
+    if (!stats.spilled)
+    {
+        fclose(spillWrite);
+        fclose(spillRead);
+        spillWrite = spillRead = NULL;
+        spillBroken = false;
+        remove(spillFile);
+    }
+}
+
+void DelayedQueryManager::GetStats(Stats &result)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    result = stats;
+    result.depth = queue.GetSize() + taken + stats.spilled;
+}
+
+csString DelayedQueryManager::Dump()
+{
+    Stats current;
+    GetStats(current);
+
+    csString dump;
+    dump.Format("Delayed queries: %zu queued (max %zu, %zu spilled), %llu pushed, %llu run, %llu failed\n"
+                "  %llu transactions, %llu rerun one by one, %.2f ms average, %u ms max\n"
+                "  %llu pushes blocked for %u ms, %llu spilled to disk\n\n",
+                current.depth, current.maxDepth, current.spilled, (unsigned long long)current.pushed,
+                (unsigned long long)current.executed, (unsigned long long)current.failed,
+                (unsigned long long)current.transactions, (unsigned long long)current.rollbacks,
+                current.transactions ? (float)current.commitTime / current.transactions : 0.0f,
+                current.maxCommitTime, (unsigned long long)current.blocked, current.blockedTime,
+                (unsigned long long)current.spills);
+
+    dump.Append(profs.Dump());
+    return dump;
+}
+
+csString DelayedQueryManager::Export()
+{
+    return profs.Export("ps_db_delayed_query_usec");
+}
+
+void DelayedQueryManager::ResetProfile()
+{
+    profs.Reset();
+}
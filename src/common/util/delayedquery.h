@@ -0,0 +1,185 @@
+/*
+ * delayedquery.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_DELAYEDQUERY_H
+#define PS_DELAYEDQUERY_H
+
+#include <stdio.h>
+
+#include <cstypes.h>
+#include <csutil/array.h>
+#include <csutil/csstring.h>
+#include <csutil/threading/condition.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/thread.h>
+
+#include "util/dbprofile.h"
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Default number of queries queued before Push() blocks or spills.
+#define DELAYED_QUERY_HIGH_WATER 10000
+
+/// Default number of queries run in one transaction.
+#define DELAYED_QUERY_TRANSACTION_SIZE 50
+
+/**
+ * The database specific part of a DelayedQueryManager.
+ *
+ * All the functions are called from the thread of the manager.
+ */
+class iDelayedQueryConnection
+{
+public:
+    virtual ~iDelayedQueryConnection() {}
+
+    /// Open the connection, called again after a while if it fails.
+    virtual bool Connect() = 0;
+
+    /// Run a statement, false if it failed.
+    virtual bool Execute(const char* sql) = 0;
+
+    virtual const char* GetLastError() = 0;
+
+    /**
+     * Called after a statement failed in a transaction: whether the
+     * statements run before it in the transaction are still there to be
+     * committed, or the failure undid them.
+     */
+    virtual bool FailureKeepsTransaction() = 0;
+
+    virtual void Disconnect() = 0;
+};
+
+/*   Design notes:
+ *
+ *  The DelayedQueryManager runs the statements passed to
+ *  iDataConnection::CommandPump() on a thread with its own connection, so
+ *  the caller doesn't wait for statements it doesn't need the result of.
+ *
+ *  Push() appends to a growable array under a mutex, any number of threads
+ *  may push. The thread swaps the whole array out at once and runs the
+ *  statements in transactions of up to transactionSize statements, which
+ *  saves the database a log flush per statement. Statements are run in the
+ *  order they were pushed. One bad statement only loses itself, like it
+ *  would without the transactions. When a statement fails and the
+ *  connection says the ones before it are still in the transaction, they
+ *  are committed and the transaction goes on after the failed one. Tables
+ *  which can't roll back, like MyISAM ones, never see a statement twice.
+ *  Otherwise the transaction is rolled back and its statements are run
+ *  again one at a time.
+ *
+ *  No statement is dropped. Once highWater statements are waiting Push()
+ *  either blocks until the thread catches up or, with a spill file, appends
+ *  the statements to the file. While there are statements in the file all
+ *  the new ones go there too, so the order is kept, and the thread reads
+ *  them back once the ones in memory are done.
+ */
+class DelayedQueryManager : public CS::Threading::Runnable
+{
+public:
+    /// Counters since the manager was created
+    struct Stats
+    {
+        size_t depth;           ///< Statements not run yet, in memory and spilled
+        size_t maxDepth;
+        size_t spilled;         ///< Statements in the spill file now
+        uint64 pushed;
+        uint64 executed;
+        uint64 failed;
+        uint64 transactions;
+        uint64 rollbacks;       ///< Transactions rerun one statement at a time
+        uint64 blocked;         ///< Pushes which waited for the thread
+        csTicks blockedTime;
+        uint64 spills;          ///< Statements written to the spill file
+        csTicks commitTime;     ///< Running the transactions
+        csTicks maxCommitTime;
+    };
+
+    /**
+     * @param connection      Opened and used by the thread only, deleted with the manager.
+     * @param highWater       Statements queued before Push() blocks or spills.
+     * @param transactionSize Statements per transaction, 1 runs each on its own.
+     * @param spillFile       File for the statements over the high water mark,
+     *                        NULL or empty to block instead.
+     */
+    DelayedQueryManager(iDelayedQueryConnection* connection, size_t highWater = DELAYED_QUERY_HIGH_WATER,
+                        size_t transactionSize = DELAYED_QUERY_TRANSACTION_SIZE, const char* spillFile = NULL);
+    virtual ~DelayedQueryManager();
+
+    virtual void Run();
+
+    /// Queue a statement, never drops it.
+    void Push(const char* query);
+
+    /// Let Run() return once all the statements are run.
+    void Stop();
+
+    void GetStats(Stats &stats);
+
+    /// Describe the counters and the time spent per statement.
+    csString Dump();
+
+    /// The time spent per statement for the metrics export.
+    csString Export();
+
+    /// Reset the time spent per statement.
+    void ResetProfile();
+
+private:
+    /// Take the next statements to run, false when stopped and done.
+    bool Take(csArray<csString> &queries);
+
+    /// Run the statements in one transaction.
+    void RunTransaction(csArray<csString> &queries, size_t begin, size_t end);
+
+    /// Run a statement, counting it and its time.
+    bool RunQuery(const char* query);
+
+    /// Append to the spill file, with the mutex held.
+    bool Spill(const char* query);
+
+    /// Read from the spill file, with the mutex held.
+    void Unspill(csArray<csString> &queries);
+
+    iDelayedQueryConnection* connection;
+    size_t highWater;
+    size_t transactionSize;
+    csString spillFile;
+
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition workCondition;
+    CS::Threading::Condition spaceCondition;
+    csArray<csString> queue;
+    size_t taken;               ///< Statements taken by the thread and not run yet
+    bool stop;
+    FILE* spillWrite;
+    FILE* spillRead;
+    bool spillBroken;           ///< A write failed, don't append until the file is read back
+
+    psDBProfiles profs;
+
+    Stats stats;
+};
+
+/** @} */
+
+#endif
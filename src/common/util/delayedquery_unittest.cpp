@@ -0,0 +1,311 @@
+/*
+ * delayedquery_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/refarr.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/delayedquery.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+/// Keeps the statements of committed transactions, fails the ones saying FAIL
+class FakeConnection : public iDelayedQueryConnection
+{
+public:
+    FakeConnection(bool keepsTransaction = false)
+        : keepsTransaction(keepsTransaction), inTransaction(false), begins(0) {}
+
+    virtual bool Connect()
+    {
+        return true;
+    }
+
+    virtual bool Execute(const char* sql)
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        csString query(sql);
+        if (query == "BEGIN")
+        {
+            inTransaction = true;
+            begins++;
+        }
+        else if (query == "COMMIT")
+        {
+            for (size_t i = 0; i < pending.GetSize(); i++)
+            {
+                committed.Push(pending[i]);
+            }
+            pending.Empty();
+            inTransaction = false;
+        }
+        else if (query == "ROLLBACK")
+        {
+            pending.Empty();
+            inTransaction = false;
+        }
+        else if (query == "FAIL")
+        {
+            return false;
+        }
+        else if (inTransaction)
+        {
+            pending.Push(query);
+        }
+        else
+        {
+            committed.Push(query);
+        }
+        return true;
+    }
+
+    virtual const char* GetLastError()
+    {
+        return "FAIL";
+    }
+
+    virtual bool FailureKeepsTransaction()
+    {
+        return keepsTransaction;
+    }
+
+    virtual void Disconnect()
+    {
+    }
+
+    CS::Threading::Mutex mutex;
+    bool keepsTransaction;
+    bool inTransaction;
+    int begins;
+    csArray<csString> pending;
+    csArray<csString> committed;
+};
+
+/// Pushes numbered statements
+class Producer : public CS::Threading::Runnable
+{
+public:
+    Producer(DelayedQueryManager* manager, int id, int count) : manager(manager), id(id), count(count) {}
+
+    virtual void Run()
+    {
+        for (int i = 0; i < count; i++)
+        {
+            csString query;
+            query.Format("%d %d", id, i);
+            manager->Push(query);
+        }
+    }
+
+    DelayedQueryManager* manager;
+    int id;
+    int count;
+};
+
+/// Runs the manager on a thread and stops it once everything is run
+static void RunManager(csRef<DelayedQueryManager> manager, csRef<CS::Threading::Thread> &thread)
+{
+    thread.AttachNew(new CS::Threading::Thread(manager));
+    thread->Start();
+}
+
+static void StopManager(csRef<DelayedQueryManager> manager, csRef<CS::Threading::Thread> thread)
+{
+    manager->Stop();
+    thread->Wait();
+}
+
+TEST(DelayedQueryTest, NothingLostUnderLoad)
+{
+    FakeConnection* connection = new FakeConnection;
+    csRef<DelayedQueryManager> manager;
+    manager.AttachNew(new DelayedQueryManager(connection, 100, 10));
+    csRef<CS::Threading::Thread> thread;
+    RunManager(manager, thread);
+
+    const int producers = 4;
+    const int count = 2000;
+    csRefArray<CS::Threading::Thread> threads;
+    for (int i = 0; i < producers; i++)
+    {
+        csRef<CS::Threading::Runnable> producer;
+        producer.AttachNew(new Producer(manager, i, count));
+        csRef<CS::Threading::Thread> producerThread;
+        producerThread.AttachNew(new CS::Threading::Thread(producer));
+        producerThread->Start();
+        threads.Push(producerThread);
+    }
+    for (size_t i = 0; i < threads.GetSize(); i++)
+    {
+        threads[i]->Wait();
+    }
+    StopManager(manager, thread);
+
+    // All of them, each producer in its order
+    ASSERT_EQ(connection->committed.GetSize(), (size_t)(producers * count));
+    int next[producers] = { 0 };
+    for (size_t i = 0; i < connection->committed.GetSize(); i++)
+    {
+        int id, n;
+        ASSERT_EQ(sscanf(connection->committed[i], "%d %d", &id, &n), 2);
+        EXPECT_EQ(n, next[id]);
+        next[id] = n + 1;
+    }
+
+    DelayedQueryManager::Stats stats;
+    manager->GetStats(stats);
+    EXPECT_EQ(stats.pushed, (uint64)(producers * count));
+    EXPECT_EQ(stats.executed, (uint64)(producers * count));
+    EXPECT_EQ(stats.failed, (uint64)0);
+    EXPECT_EQ(stats.depth, (size_t)0);
+    EXPECT_LE(stats.maxDepth, (size_t)100);
+}
+
+TEST(DelayedQueryTest, Transactions)
+{
+    FakeConnection* connection = new FakeConnection;
+    csRef<DelayedQueryManager> manager;
+    manager.AttachNew(new DelayedQueryManager(connection, 100, 10));
+
+    // Queued before the thread runs, they are taken at once
+    for (int i = 0; i < 25; i++)
+    {
+        csString query;
+        query.Format("0 %d", i);
+        manager->Push(query);
+    }
+
+    csRef<CS::Threading::Thread> thread;
+    RunManager(manager, thread);
+    StopManager(manager, thread);
+
+    EXPECT_EQ(connection->committed.GetSize(), (size_t)25);
+    EXPECT_EQ(connection->begins, 3);
+
+    DelayedQueryManager::Stats stats;
+    manager->GetStats(stats);
+    EXPECT_EQ(stats.transactions, (uint64)3);
+    EXPECT_EQ(stats.maxDepth, (size_t)25);
+}
+
+TEST(DelayedQueryTest, FailedStatementOnlyLosesItself)
+{
+    FakeConnection* connection = new FakeConnection;
+    csRef<DelayedQueryManager> manager;
+    manager.AttachNew(new DelayedQueryManager(connection, 100, 10));
+
+    manager->Push("a");
+    manager->Push("FAIL");
+    manager->Push("b");
+
+    csRef<CS::Threading::Thread> thread;
+    RunManager(manager, thread);
+    StopManager(manager, thread);
+
+    ASSERT_EQ(connection->committed.GetSize(), (size_t)2);
+    EXPECT_STREQ(connection->committed[0], "a");
+    EXPECT_STREQ(connection->committed[1], "b");
+
+    DelayedQueryManager::Stats stats;
+    manager->GetStats(stats);
+    EXPECT_EQ(stats.executed, (uint64)2);
+    EXPECT_EQ(stats.failed, (uint64)1);
+    EXPECT_EQ(stats.rollbacks, (uint64)1);
+}
+
+TEST(DelayedQueryTest, FailedStatementKeepsTheOnesBefore)
+{
+    // Like MySQL, where a failed statement leaves the transaction open
+    FakeConnection* connection = new FakeConnection(true);
+    csRef<DelayedQueryManager> manager;
+    manager.AttachNew(new DelayedQueryManager(connection, 100, 10));
+
+    manager->Push("a");
+    manager->Push("FAIL");
+    manager->Push("b");
+    manager->Push("c");
+
+    csRef<CS::Threading::Thread> thread;
+    RunManager(manager, thread);
+    StopManager(manager, thread);
+
+    // Each statement once, the ones before the failure are not run again
+    ASSERT_EQ(connection->committed.GetSize(), (size_t)3);
+    EXPECT_STREQ(connection->committed[0], "a");
+    EXPECT_STREQ(connection->committed[1], "b");
+    EXPECT_STREQ(connection->committed[2], "c");
+    EXPECT_EQ(connection->begins, 2);
+
+    DelayedQueryManager::Stats stats;
+    manager->GetStats(stats);
+    EXPECT_EQ(stats.executed, (uint64)3);
+    EXPECT_EQ(stats.failed, (uint64)1);
+    EXPECT_EQ(stats.rollbacks, (uint64)0);
+}
+
+TEST(DelayedQueryTest, SpillKeepsOrder)
+{
+    const char* spillFile = "delayedquery_unittest.spill";
+
+    FakeConnection* connection = new FakeConnection;
+    csRef<DelayedQueryManager> manager;
+    manager.AttachNew(new DelayedQueryManager(connection, 10, 4, spillFile));
+
+    // Without the thread running everything over the high water mark spills
+    for (int i = 0; i < 100; i++)
+    {
+        csString query;
+        query.Format("0 %d", i);
+        manager->Push(query);
+    }
+
+    DelayedQueryManager::Stats stats;
+    manager->GetStats(stats);
+    EXPECT_EQ(stats.spilled, (size_t)90);
+    EXPECT_EQ(stats.depth, (size_t)100);
+    EXPECT_EQ(stats.blocked, (uint64)0);
+
+    csRef<CS::Threading::Thread> thread;
+    RunManager(manager, thread);
+    StopManager(manager, thread);
+
+    ASSERT_EQ(connection->committed.GetSize(), (size_t)100);
+    for (size_t i = 0; i < connection->committed.GetSize(); i++)
+    {
+        csString expected;
+        expected.Format("0 %zu", i);
+        EXPECT_STREQ(connection->committed[i], expected);
+    }
+
+    manager->GetStats(stats);
+    EXPECT_EQ(stats.spilled, (size_t)0);
+    EXPECT_EQ(stats.spills, (uint64)90);
+
+    // Removed once read back
+    EXPECT_EQ(fopen(spillFile, "rb"), (FILE*)NULL);
+}
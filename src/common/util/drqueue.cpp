@@ -0,0 +1,157 @@
+/*
+ * drqueue.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include "util/drqueue.h"
+
+void psDRQueue::Push(EID entity, uint8 counter, const psDRSnapshot &snapshot, const char* sectorName, float distance)
+{
+    size_t* index = pendingIndex.GetElementPointer(entity);
+    if (!index)
+    {
+        pendingIndex.Put(entity, pending.GetSize());
+        Pending &added = pending.GetExtend(pending.GetSize());
+        added.entity = entity;
+        added.waited = 0;
+        index = pendingIndex.GetElementPointer(entity);
+    }
+
+    // A replaced update keeps the ticks it waited
+    Pending &update = pending[*index];
+    update.counter = counter;
+    update.snapshot = snapshot;
+    update.sectorName = sectorName;
+    update.distance = distance;
+}
+
+void psDRQueue::Forget(EID entity)
+{
+    keyframes.DeleteAll(entity);
+
+    size_t* index = pendingIndex.GetElementPointer(entity);
+    if (!index)
+        return;
+
+    size_t removed = *index;
+    pendingIndex.DeleteAll(entity);
+    pending.DeleteIndexFast(removed);
+    if (removed < pending.GetSize())
+        pendingIndex.PutUnique(pending[removed].entity, removed);
+}
+
+namespace
+{
+struct Priority
+{
+    float value;
+    size_t index;
+};
+
+int ComparePriority(Priority const &a, Priority const &b)
+{
+    if (a.value < b.value)
+        return -1;
+    if (a.value > b.value)
+        return 1;
+    return 0;
+}
+}
+
+size_t psDRQueue::Collect(size_t budget, csArray<psDRRecord> &records)
+{
+    if (pending.IsEmpty())
+        return 0;
+
+    csArray<Priority> order;
+    order.SetCapacity(pending.GetSize());
+    for (size_t i = 0; i < pending.GetSize(); i++)
+    {
+        Priority priority;
+        priority.value = pending[i].distance / (1 + pending[i].waited);
+        priority.index = i;
+        order.Push(priority);
+    }
+    order.Sort(ComparePriority);
+
+    csArray<bool> taken;
+    taken.SetSize(pending.GetSize(), false);
+
+    size_t bytes = 0;
+    size_t first = records.GetSize();
+    for (size_t i = 0; i < order.GetSize(); i++)
+    {
+        Pending &update = pending[order[i].index];
+        psDRKeyframe* keyframe = keyframes.GetElementPointer(update.entity);
+
+        uint16 fields = 0;
+        bool newKeyframe = !keyframe || !keyframe->valid || keyframe->updates >= DR_KEYFRAME_INTERVAL ||
+                           keyframe->sectorName != update.sectorName ||
+                           !update.snapshot.GetDeltaFields(keyframe->snapshot, fields);
+        if (newKeyframe)
+            fields = update.snapshot.GetKeyframeFields();
+
+        size_t size = psDRSnapshot::GetSize(fields);
+        if (records.GetSize() > first && bytes + size > budget)
+            break;
+
+        if (!keyframe)
+        {
+            keyframes.Put(update.entity, psDRKeyframe());
+            keyframe = keyframes.GetElementPointer(update.entity);
+        }
+        if (newKeyframe)
+        {
+            keyframe->snapshot = update.snapshot;
+            keyframe->sectorName = update.sectorName;
+            keyframe->id++;
+            keyframe->updates = 0;
+            keyframe->valid = true;
+        }
+        else
+        {
+            keyframe->updates++;
+        }
+
+        psDRRecord record;
+        record.entity = update.entity;
+        record.counter = update.counter;
+        record.fields = fields;
+        record.snapshot = update.snapshot;
+        record.keyframe = *keyframe;
+        records.Push(record);
+
+        taken[order[i].index] = true;
+        bytes += size;
+    }
+
+    // The updates left wait for the next tick with a higher priority
+    csArray<Pending> left;
+    pendingIndex.DeleteAll();
+    for (size_t i = 0; i < pending.GetSize(); i++)
+    {
+        if (taken[i])
+            continue;
+        pending[i].waited++;
+        pendingIndex.Put(pending[i].entity, left.GetSize());
+        left.Push(pending[i]);
+    }
+    pending = left;
+
+    return bytes;
+}
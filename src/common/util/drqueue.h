@@ -0,0 +1,117 @@
+/*
+ * drqueue.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_DRQUEUE_H
+#define PS_DRQUEUE_H
+
+#include <csutil/array.h>
+#include <csutil/hash.h>
+
+#include "util/psconst.h"
+#include "util/drsnapshot.h"
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Bytes of a world update before its records, the count of records
+#define DR_RECORDS_HEADER_SIZE 2
+
+/*   Design notes:
+ *
+ *  Each moving entity multicast its own dead reckoning message, so a client
+ *  in a crowd was sent one small message, with its own header, per entity
+ *  and update. The server now queues the updates for each client asking
+ *  for the compact dead reckoning and sends them all in one message per
+ *  world update tick.
+ *
+ *  A newer update of an entity replaces its pending one, only the latest
+ *  state is worth sending. The pending updates are taken by priority until
+ *  the byte budget of the client for the tick is spent: the nearest first,
+ *  the distance divided by the ticks the update has waited so a far entity
+ *  isn't left behind forever. The rest wait for the next tick, so when the
+ *  budget is tight the distant entities are updated less often.
+ *
+ *  The queue also keeps the keyframes sent to the client, as the fields and
+ *  the size of an update are only known against the keyframe when it is
+ *  sent.
+ */
+
+/**
+ * An update taken from a psDRQueue to be sent.
+ */
+struct psDRRecord
+{
+    EID entity;
+    uint8 counter;              ///< Sequence of the dead reckoning of the entity
+    uint16 fields;              ///< psDRSnapshot::Fields sent
+    psDRSnapshot snapshot;
+    psDRKeyframe keyframe;      ///< The keyframe it is sent against, or that it is
+};
+
+/**
+ * The dead reckoning updates waiting to be sent to one client and the
+ * keyframes that client was sent.
+ */
+class psDRQueue
+{
+public:
+    /// Queue the state of an entity, replacing its pending update.
+    void Push(EID entity, uint8 counter, const psDRSnapshot &snapshot, const char* sectorName, float distance);
+
+    /// Forget the pending update and the keyframe of an entity the client removed.
+    void Forget(EID entity);
+
+    bool IsEmpty() const
+    {
+        return pending.IsEmpty();
+    }
+
+    size_t GetSize() const
+    {
+        return pending.GetSize();
+    }
+
+    /**
+     * Take the updates by priority while they fit 'budget' bytes, always
+     * at least one. The keyframes are the ones sent from now on.
+     *
+     * @return The bytes of the records taken, see psDRSnapshot::GetSize().
+     */
+    size_t Collect(size_t budget, csArray<psDRRecord> &records);
+
+private:
+    struct Pending
+    {
+        EID entity;
+        uint8 counter;
+        psDRSnapshot snapshot;
+        csString sectorName;
+        float distance;
+        uint32 waited;      ///< Ticks it was left for others
+    };
+
+    csArray<Pending> pending;
+    csHash<size_t, EID> pendingIndex;       ///< Index in pending of each entity
+    csHash<psDRKeyframe, EID> keyframes;
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,289 @@
+/*
+ * drqueue_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/drqueue.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static psDRSnapshot Walking(float x, float z)
+{
+    psDRSnapshot snapshot;
+    snapshot.Quantize(csVector3(x, 0, z), csVector3(0, 0, -4), csVector3(0, 0, 4), 0, 0, 0, true);
+    return snapshot;
+}
+
+TEST(DRQueueTest, Replace)
+{
+    psDRQueue queue;
+    queue.Push(EID(1), 7, Walking(0, 0), "sector", 5.0f);
+    queue.Push(EID(2), 3, Walking(0, 0), "sector", 9.0f);
+    queue.Push(EID(1), 8, Walking(0, 1), "sector", 5.0f);
+    EXPECT_EQ(queue.GetSize(), (size_t)2);
+
+    csArray<psDRRecord> records;
+    queue.Collect(1000, records);
+    ASSERT_EQ(records.GetSize(), (size_t)2);
+    EXPECT_EQ(records[0].entity, EID(1));
+    EXPECT_EQ(records[0].counter, 8);
+    EXPECT_TRUE(records[0].snapshot == Walking(0, 1));
+    EXPECT_TRUE(queue.IsEmpty());
+}
+
+TEST(DRQueueTest, Keyframes)
+{
+    psDRQueue queue;
+    csArray<psDRRecord> records;
+
+    queue.Push(EID(1), 1, Walking(0, 0), "sector", 5.0f);
+    queue.Collect(1000, records);
+    ASSERT_EQ(records.GetSize(), (size_t)1);
+    EXPECT_TRUE(records[0].fields & psDRSnapshot::KEYFRAME);
+    uint8 id = records[0].keyframe.id;
+
+    // Against the keyframe
+    records.Empty();
+    queue.Push(EID(1), 2, Walking(0, 0.8f), "sector", 5.0f);
+    queue.Collect(1000, records);
+    ASSERT_EQ(records.GetSize(), (size_t)1);
+    EXPECT_EQ(records[0].fields, psDRSnapshot::POSITION);
+    EXPECT_EQ(records[0].keyframe.id, id);
+
+    // Another sector needs a keyframe
+    records.Empty();
+    queue.Push(EID(1), 3, Walking(0, 1.6f), "other", 5.0f);
+    queue.Collect(1000, records);
+    ASSERT_EQ(records.GetSize(), (size_t)1);
+    EXPECT_TRUE(records[0].fields & psDRSnapshot::KEYFRAME);
+    EXPECT_EQ(records[0].keyframe.id, (uint8)(id + 1));
+
+    // Forgotten, as when the client removed the entity
+    records.Empty();
+    queue.Forget(EID(1));
+    queue.Push(EID(1), 4, Walking(0, 2.4f), "other", 5.0f);
+    queue.Collect(1000, records);
+    ASSERT_EQ(records.GetSize(), (size_t)1);
+    EXPECT_TRUE(records[0].fields & psDRSnapshot::KEYFRAME);
+}
+
+TEST(DRQueueTest, Budget)
+{
+    psDRQueue queue;
+    csArray<psDRRecord> records;
+
+    for (int i = 1; i <= 10; i++)
+    {
+        queue.Push(EID(i), 1, Walking(i, 0), "sector", (float)(11 - i));
+    }
+
+    // Room for three keyframes, the nearest go first
+    size_t keyframe = psDRSnapshot::GetSize(Walking(1, 0).GetKeyframeFields());
+    size_t bytes = queue.Collect(keyframe * 3 + keyframe / 2, records);
+    ASSERT_EQ(records.GetSize(), (size_t)3);
+    EXPECT_EQ(bytes, keyframe * 3);
+    EXPECT_EQ(records[0].entity, EID(10));
+    EXPECT_EQ(records[1].entity, EID(9));
+    EXPECT_EQ(records[2].entity, EID(8));
+    EXPECT_EQ(queue.GetSize(), (size_t)7);
+
+    // At least one even over the budget
+    records.Empty();
+    queue.Collect(1, records);
+    EXPECT_EQ(records.GetSize(), (size_t)1);
+
+    // The near ones keep moving, the far one still gets its turn
+    bool farSent = false;
+    for (int tick = 0; tick < 20 && !farSent; tick++)
+    {
+        for (int i = 7; i <= 10; i++)
+        {
+            queue.Push(EID(i), 2, Walking(i, tick), "sector", (float)(11 - i));
+        }
+        records.Empty();
+        queue.Collect(keyframe * 3, records);
+        for (size_t r = 0; r < records.GetSize(); r++)
+        {
+            if (records[r].entity == EID(1))
+                farSent = true;
+        }
+    }
+    EXPECT_TRUE(farSent);
+}
+
+TEST(DRQueueTest, Forget)
+{
+    psDRQueue queue;
+    queue.Push(EID(1), 1, Walking(0, 0), "sector", 1.0f);
+    queue.Push(EID(2), 1, Walking(0, 0), "sector", 2.0f);
+    queue.Push(EID(3), 1, Walking(0, 0), "sector", 3.0f);
+    queue.Forget(EID(1));
+    queue.Forget(EID(4));
+    EXPECT_EQ(queue.GetSize(), (size_t)2);
+
+    // The entity moved in place of the forgotten one is still replaced
+    queue.Push(EID(3), 2, Walking(0, 0), "sector", 3.0f);
+    EXPECT_EQ(queue.GetSize(), (size_t)2);
+
+    csArray<psDRRecord> records;
+    queue.Collect(1000, records);
+    ASSERT_EQ(records.GetSize(), (size_t)2);
+    EXPECT_EQ(records[0].entity, EID(2));
+    EXPECT_EQ(records[1].entity, EID(3));
+    EXPECT_EQ(records[1].counter, 2);
+}
+
+/**
+ * One client seeing 10 entities, each moving twice within a world update
+ * tick: 20 messages when each update is sent on its own, one queued world
+ * update holding the latest state of each entity.
+ */
+TEST(DRQueueTest, OneMessagePerTick)
+{
+    const int entities = 10;
+    psDRQueue queue;
+    csArray<psDRRecord> records;
+
+    size_t singleMessages = 0;
+    size_t queuedMessages = 0;
+    for (int tick = 0; tick < 5; tick++)
+    {
+        for (int update = 0; update < 2; update++)
+        {
+            for (int i = 1; i <= entities; i++)
+            {
+                queue.Push(EID(i), (uint8)(tick * 2 + update), Walking(i, tick * 2 + update), "sector", (float)i);
+                singleMessages++;
+            }
+        }
+
+        records.Empty();
+        queue.Collect(1000, records);
+        queuedMessages++;
+
+        ASSERT_EQ(records.GetSize(), (size_t)entities);
+        for (size_t r = 0; r < records.GetSize(); r++)
+        {
+            EXPECT_EQ(records[r].counter, (uint8)(tick * 2 + 1));
+        }
+        EXPECT_TRUE(queue.IsEmpty());
+    }
+
+    EXPECT_EQ(singleMessages, (size_t)100);
+    EXPECT_EQ(queuedMessages, (size_t)5);
+}
+
+/**
+ * 100 players walking in a crowd, each moving 5 times a second. Without the
+ * queue each update is a message to each of the 99 others, counted in a
+ * packet of its own as when they are not merged. With the queue each
+ * client gets one message per 50 ms tick. Packets are 15 bytes of header,
+ * messages 3 bytes.
+ */
+TEST(DRQueueTest, CrowdMessages)
+{
+    const int players = 100;
+    const int seconds = 20;
+    const int ticksPerSecond = 20;
+    const int updateEvery = 4;          // Ticks between two updates of a walker
+    const size_t packetHeader = 15;
+    const size_t messageHeader = 3;
+
+    psDRQueue* queues = new psDRQueue[players];
+    csVector3* positions = new csVector3[players];
+    srand(1);
+    for (int i = 0; i < players; i++)
+    {
+        positions[i] = csVector3(rand() % 50, 0, rand() % 50);
+    }
+
+    double singleBytes = 0, singleMessages = 0;
+    double queuedBytes = 0, queuedMessages = 0;
+    for (int tick = 0; tick < seconds * ticksPerSecond; tick++)
+    {
+        for (int i = 0; i < players; i++)
+        {
+            if ((tick + i) % updateEvery)
+                continue;
+
+            positions[i].z += 0.8f;
+            psDRSnapshot snapshot;
+            snapshot.Quantize(positions[i], csVector3(0, 0, -4), csVector3(0, 0, 4), 0, 0, 0, true);
+
+            for (int r = 0; r < players; r++)
+            {
+                if (r == i)
+                    continue;
+
+                float dx = positions[i].x - positions[r].x;
+                float dz = positions[i].z - positions[r].z;
+                queues[r].Push(EID(i + 1), (uint8)tick, snapshot, "sector", sqrtf(dx * dx + dz * dz));
+            }
+        }
+
+        for (int r = 0; r < players; r++)
+        {
+            if (queues[r].IsEmpty())
+                continue;
+
+            csArray<psDRRecord> records;
+            size_t bytes = queues[r].Collect(1400 - packetHeader - messageHeader - DR_RECORDS_HEADER_SIZE, records);
+            queuedBytes += packetHeader + messageHeader + DR_RECORDS_HEADER_SIZE + bytes;
+            queuedMessages++;
+
+            for (size_t i = 0; i < records.GetSize(); i++)
+            {
+                singleBytes += packetHeader + messageHeader + psDRSnapshot::GetSize(records[i].fields);
+                singleMessages++;
+            }
+        }
+    }
+    delete [] queues;
+    delete [] positions;
+
+    double singleRate = singleBytes / seconds / players;
+    double queuedRate = queuedBytes / seconds / players;
+    printf("%d players: %.0f messages and %.0f bytes/s per player one update a message, "
+           "%.0f messages and %.0f bytes/s queued\n", players, singleMessages / seconds / players, singleRate,
+           queuedMessages / seconds / players, queuedRate);
+
+    // At most one message per client and tick
+    EXPECT_LE(queuedMessages, (double)players * seconds * ticksPerSecond);
+    EXPECT_LT(queuedMessages, singleMessages);
+    EXPECT_LT(queuedRate, singleRate);
+
+    char value[32];
+    snprintf(value, sizeof(value), "%.0f", singleRate);
+    ::testing::Test::RecordProperty("single_bytes_per_player_second", value);
+    snprintf(value, sizeof(value), "%.0f", queuedRate);
+    ::testing::Test::RecordProperty("queued_bytes_per_player_second", value);
+    snprintf(value, sizeof(value), "%.0f", singleMessages / seconds / players);
+    ::testing::Test::RecordProperty("single_messages_per_player_second", value);
+    snprintf(value, sizeof(value), "%.0f", queuedMessages / seconds / players);
+    ::testing::Test::RecordProperty("queued_messages_per_player_second", value);
+}
@@ -0,0 +1,215 @@
+/*
+ * drsnapshot.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <math.h>
+
+#include "util/drsnapshot.h"
+
+#ifndef TWO_PI
+#define TWO_PI (3.14159265358979323846f * 2)
+#endif
+
+/// Round to the nearest integer, false if outside [-limit, limit]
+static bool Fix(float value, float scale, float limit, int32 &result)
+{
+    float scaled = floorf(value * scale + 0.5f);
+    // NaN fails both tests
+    if (!(scaled >= -limit && scaled <= limit))
+        return false;
+    result = (int32)scaled;
+    return true;
+}
+
+static bool Fix16(float value, float scale, int16 &result)
+{
+    int32 fixed;
+    if (!Fix(value, scale, 32767.0f, fixed))
+        return false;
+    result = (int16)fixed;
+    return true;
+}
+
+psDRSnapshot::psDRSnapshot()
+    : angVel(0), yrot(0), mode(DR_ON_GROUND)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        pos[i] = 0;
+        vel[i] = 0;
+        worldVel[i] = 0;
+    }
+}
+
+bool psDRSnapshot::Quantize(const csVector3 &position, const csVector3 &velocity, const csVector3 &worldVelocity,
+                            float angularVelocity, float yRotation, uint8 actorMode, bool onGround)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (!Fix(position[i], DR_POSITION_SCALE, 2147483520.0f, pos[i]) ||
+            !Fix16(velocity[i], DR_VELOCITY_SCALE, vel[i]) ||
+            !Fix16(worldVelocity[i], DR_VELOCITY_SCALE, worldVel[i]))
+            return false;
+    }
+    if (!Fix16(angularVelocity, DR_ANGVEL_SCALE, angVel))
+        return false;
+
+    // The same 256 steps per turn as psDRMessage, read back as signed
+    int32 steps;
+    if (!Fix(yRotation * 256 / TWO_PI, 1.0f, 2147483520.0f, steps))
+        return false;
+    yrot = (uint8)(steps & 0xFF);
+
+    mode = actorMode & ~DR_ON_GROUND;
+    if (onGround)
+        mode |= DR_ON_GROUND;
+    return true;
+}
+
+void psDRSnapshot::Dequantize(csVector3 &position, csVector3 &velocity, csVector3 &worldVelocity,
+                              float &angularVelocity, float &yRotation, uint8 &actorMode, bool &onGround) const
+{
+    for (int i = 0; i < 3; i++)
+    {
+        position[i] = pos[i] / DR_POSITION_SCALE;
+        velocity[i] = vel[i] / DR_VELOCITY_SCALE;
+        worldVelocity[i] = worldVel[i] / DR_VELOCITY_SCALE;
+    }
+    angularVelocity = angVel / DR_ANGVEL_SCALE;
+    yRotation = (int8)yrot * TWO_PI / 256;
+    actorMode = mode & ~DR_ON_GROUND;
+    onGround = (mode & DR_ON_GROUND) != 0;
+}
+
+/// The fields other than the position which differ between two states
+static uint16 GetChangedFields(const psDRSnapshot &state, const psDRSnapshot &base)
+{
+    uint16 fields = 0;
+    if (state.yrot != base.yrot)
+        fields |= psDRSnapshot::YROT;
+    if (state.mode != base.mode)
+        fields |= psDRSnapshot::MODE;
+    if (state.angVel != base.angVel)
+        fields |= psDRSnapshot::ANG_VELOCITY;
+    for (int i = 0; i < 3; i++)
+    {
+        if (state.vel[i] != base.vel[i])
+            fields |= psDRSnapshot::X_VELOCITY << i;
+        if (state.worldVel[i] != base.worldVel[i])
+            fields |= psDRSnapshot::X_WORLDVELOCITY << i;
+    }
+    return fields;
+}
+
+uint16 psDRSnapshot::GetKeyframeFields() const
+{
+    return KEYFRAME | POSITION | GetChangedFields(*this, psDRSnapshot());
+}
+
+bool psDRSnapshot::GetDeltaFields(const psDRSnapshot &keyframe, uint16 &fields) const
+{
+    fields = GetChangedFields(*this, keyframe);
+
+    bool moved = false;
+    bool small = true;
+    for (int i = 0; i < 3; i++)
+    {
+        // In 64 bits, the positions may be far apart
+        int64 offset = (int64)pos[i] - keyframe.pos[i];
+        if (offset < -32768 || offset > 32767)
+            return false;
+        if (offset)
+            moved = true;
+        if (offset < -128 || offset > 127)
+            small = false;
+    }
+
+    if (moved)
+    {
+        fields |= POSITION;
+        if (small)
+            fields |= SHORT_OFFSET;
+    }
+    return true;
+}
+
+void psDRSnapshot::Apply(const psDRSnapshot &values, uint16 fields)
+{
+    if (fields & POSITION)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            if (fields & KEYFRAME)
+                pos[i] = values.pos[i];
+            else
+                pos[i] += values.pos[i];
+        }
+    }
+    if (fields & YROT)
+        yrot = values.yrot;
+    if (fields & MODE)
+        mode = values.mode;
+    if (fields & ANG_VELOCITY)
+        angVel = values.angVel;
+    for (int i = 0; i < 3; i++)
+    {
+        if (fields & (X_VELOCITY << i))
+            vel[i] = values.vel[i];
+        if (fields & (X_WORLDVELOCITY << i))
+            worldVel[i] = values.worldVel[i];
+    }
+}
+
+size_t psDRSnapshot::GetSize(uint16 fields)
+{
+    // Entity, counter, fields and keyframe id
+    size_t size = sizeof(uint32) + sizeof(uint8) + sizeof(uint16) + sizeof(uint8);
+
+    if (fields & KEYFRAME)
+        size += sizeof(uint32) + 3 * sizeof(int32);     // Sector string id and position
+    else if (fields & SHORT_OFFSET)
+        size += 3 * sizeof(int8);
+    else if (fields & POSITION)
+        size += 3 * sizeof(int16);
+
+    if (fields & YROT)
+        size += sizeof(uint8);
+    if (fields & MODE)
+        size += sizeof(uint8);
+    if (fields & ANG_VELOCITY)
+        size += sizeof(int16);
+    for (int i = 0; i < 3; i++)
+    {
+        if (fields & (X_VELOCITY << i))
+            size += sizeof(int16);
+        if (fields & (X_WORLDVELOCITY << i))
+            size += sizeof(int16);
+    }
+    return size;
+}
+
+bool psDRSnapshot::operator==(const psDRSnapshot &other) const
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (pos[i] != other.pos[i] || vel[i] != other.vel[i] || worldVel[i] != other.worldVel[i])
+            return false;
+    }
+    return angVel == other.angVel && yrot == other.yrot && mode == other.mode;
+}
@@ -0,0 +1,141 @@
+/*
+ * drsnapshot.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_DRSNAPSHOT_H
+#define PS_DRSNAPSHOT_H
+
+#include <cstypes.h>
+#include <csutil/csstring.h>
+#include <csgeom/vector3.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Position units per meter of a psDRSnapshot
+#define DR_POSITION_SCALE 256.0f
+/// Velocity units per meter per second
+#define DR_VELOCITY_SCALE 256.0f
+/// Angular velocity units per radian per second
+#define DR_ANGVEL_SCALE 1024.0f
+/// Updates sent against a keyframe before the next one is a keyframe again
+#define DR_KEYFRAME_INTERVAL 32
+/// Bit of the mode telling the actor is on the ground, as psDRMessage packs it
+#define DR_ON_GROUND 128
+
+/*   Design notes:
+ *
+ *  A psDRMessage sends the position and the velocities as floats, whatever
+ *  changed. The compact dead reckoning quantizes them to fixed point, the
+ *  position in the coordinates of its sector to 1/256 m, and sends to each
+ *  client the fields that differ from the last keyframe that client was sent
+ *  for the entity. A keyframe has the sector and the absolute position and is
+ *  sent when the client has none, the sector changes, the position moved too
+ *  far for a 16 bit offset or DR_KEYFRAME_INTERVAL updates went by. The
+ *  updates in between name their keyframe, a client missing it ignores them
+ *  until the next keyframe.
+ */
+
+/**
+ * Dead reckoning state of an entity in fixed point.
+ */
+class psDRSnapshot
+{
+public:
+    /// Fields sent in a compact update
+    enum Fields
+    {
+        POSITION        = 1 << 0,   ///< Position, absolute or as an offset from the keyframe
+        SHORT_OFFSET    = 1 << 1,   ///< The offset fits 8 bits per axis
+        YROT            = 1 << 2,
+        MODE            = 1 << 3,
+        ANG_VELOCITY    = 1 << 4,
+        X_VELOCITY      = 1 << 5,
+        Y_VELOCITY      = 1 << 6,
+        Z_VELOCITY      = 1 << 7,
+        X_WORLDVELOCITY = 1 << 8,
+        Y_WORLDVELOCITY = 1 << 9,
+        Z_WORLDVELOCITY = 1 << 10,
+        KEYFRAME        = 1 << 11   ///< Absolute position and sector, the fields differing from a still actor
+    };
+
+    int32 pos[3];
+    int16 vel[3];
+    int16 worldVel[3];
+    int16 angVel;
+    uint8 yrot;
+    uint8 mode;         ///< Mode with DR_ON_GROUND
+
+    /// A still actor on the ground at the origin, what keyframes are compared with.
+    psDRSnapshot();
+
+    /// Quantize the state, false if a value doesn't fit the fixed point range.
+    bool Quantize(const csVector3 &position, const csVector3 &velocity, const csVector3 &worldVelocity,
+                  float angularVelocity, float yRotation, uint8 actorMode, bool onGround);
+
+    /// Return the state in floats.
+    void Dequantize(csVector3 &position, csVector3 &velocity, csVector3 &worldVelocity,
+                    float &angularVelocity, float &yRotation, uint8 &actorMode, bool &onGround) const;
+
+    /// The fields of a keyframe of this state.
+    uint16 GetKeyframeFields() const;
+
+    /**
+     * The fields of an update of this state against a keyframe, false if the
+     * position is too far from it for an offset.
+     */
+    bool GetDeltaFields(const psDRSnapshot &keyframe, uint16 &fields) const;
+
+    /**
+     * Set the fields of an update on this state. The position of 'values' is
+     * absolute in a keyframe and an offset otherwise.
+     */
+    void Apply(const psDRSnapshot &values, uint16 fields);
+
+    /// Bytes of a compact update with these fields, but for a sector sent by name.
+    static size_t GetSize(uint16 fields);
+
+    bool operator==(const psDRSnapshot &other) const;
+};
+
+/**
+ * The last keyframe of an entity, kept by the server for each client and by
+ * the client for each entity.
+ */
+struct psDRKeyframe
+{
+    psDRSnapshot snapshot;
+    csString sectorName;    ///< Sector of the position
+    uint8 id;               ///< Sequence of the keyframe, named by the updates against it
+    uint8 updates;          ///< Updates sent against it
+    bool valid;
+
+    psDRKeyframe() : id(0), updates(0), valid(false) { }
+
+    /// True if a keyframe with this id is newer than this one.
+    bool IsOlderThan(uint8 other) const
+    {
+        uint8 ahead = (uint8)(other - id);
+        return !valid || (ahead > 0 && ahead < 128);
+    }
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,213 @@
+/*
+ * drsnapshot_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/drsnapshot.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+TEST(DRSnapshotTest, Quantize)
+{
+    psDRSnapshot snapshot;
+    ASSERT_TRUE(snapshot.Quantize(csVector3(-1234.567f, 12.3f, 98765.4f), csVector3(0, 0, -4.2f),
+                                  csVector3(1.5f, -9.8f, 3.1f), 1.57f, -2.0f, 3, false));
+
+    csVector3 pos, vel, worldVel;
+    float angVel, yrot;
+    uint8 mode;
+    bool onGround;
+    snapshot.Dequantize(pos, vel, worldVel, angVel, yrot, mode, onGround);
+
+    EXPECT_NEAR(pos.x, -1234.567f, 0.5f / DR_POSITION_SCALE + 0.001f);
+    EXPECT_NEAR(pos.y, 12.3f, 0.5f / DR_POSITION_SCALE);
+    EXPECT_NEAR(pos.z, 98765.4f, 0.5f / DR_POSITION_SCALE + 0.01f);
+    EXPECT_NEAR(vel.z, -4.2f, 0.5f / DR_VELOCITY_SCALE);
+    EXPECT_NEAR(worldVel.y, -9.8f, 0.5f / DR_VELOCITY_SCALE);
+    EXPECT_NEAR(angVel, 1.57f, 0.5f / DR_ANGVEL_SCALE);
+    EXPECT_NEAR(yrot, -2.0f, 3.2f / 256);
+    EXPECT_EQ(mode, 3);
+    EXPECT_FALSE(onGround);
+
+    // Beyond the fixed point ranges
+    EXPECT_FALSE(snapshot.Quantize(csVector3(0), csVector3(0, 0, 200.0f), csVector3(0), 0, 0, 0, true));
+    EXPECT_FALSE(snapshot.Quantize(csVector3(1e8f, 0, 0), csVector3(0), csVector3(0), 0, 0, 0, true));
+    EXPECT_FALSE(snapshot.Quantize(csVector3(0, sqrtf(-1.0f), 0), csVector3(0), csVector3(0), 0, 0, 0, true));
+}
+
+TEST(DRSnapshotTest, Delta)
+{
+    psDRSnapshot keyframe;
+    ASSERT_TRUE(keyframe.Quantize(csVector3(100, 5, 100), csVector3(0, 0, -4), csVector3(4, 0, 0), 0, 1.0f, 0, true));
+
+    uint16 fields = keyframe.GetKeyframeFields();
+    EXPECT_TRUE(fields & psDRSnapshot::KEYFRAME);
+    EXPECT_TRUE(fields & psDRSnapshot::Z_VELOCITY);
+    EXPECT_FALSE(fields & psDRSnapshot::X_VELOCITY);
+    EXPECT_FALSE(fields & psDRSnapshot::MODE);
+
+    // A keyframe applied on a still actor gives the keyframe
+    psDRSnapshot decoded;
+    decoded.Apply(keyframe, fields);
+    EXPECT_TRUE(decoded == keyframe);
+
+    // Walked on, only the position changed
+    psDRSnapshot state;
+    ASSERT_TRUE(state.Quantize(csVector3(100.8f, 5, 100), csVector3(0, 0, -4), csVector3(4, 0, 0), 0, 1.0f, 0, true));
+    ASSERT_TRUE(state.GetDeltaFields(keyframe, fields));
+    EXPECT_EQ(fields, psDRSnapshot::POSITION);
+
+    psDRSnapshot values = state;
+    for (int i = 0; i < 3; i++)
+    {
+        values.pos[i] = state.pos[i] - keyframe.pos[i];
+    }
+    decoded = keyframe;
+    decoded.Apply(values, fields);
+    EXPECT_TRUE(decoded == state);
+
+    // A short step and a turn
+    ASSERT_TRUE(state.Quantize(csVector3(100.2f, 5, 100.1f), csVector3(0, 0, -4), csVector3(0, 0, 4), 0, 2.0f, 0, true));
+    ASSERT_TRUE(state.GetDeltaFields(keyframe, fields));
+    EXPECT_EQ(fields, psDRSnapshot::POSITION | psDRSnapshot::SHORT_OFFSET | psDRSnapshot::YROT |
+              psDRSnapshot::X_WORLDVELOCITY | psDRSnapshot::Z_WORLDVELOCITY);
+
+    // Too far for an offset
+    ASSERT_TRUE(state.Quantize(csVector3(300, 5, 100), csVector3(0), csVector3(0), 0, 0, 0, true));
+    EXPECT_FALSE(state.GetDeltaFields(keyframe, fields));
+}
+
+TEST(DRSnapshotTest, KeyframeOrder)
+{
+    psDRKeyframe keyframe;
+    EXPECT_TRUE(keyframe.IsOlderThan(7));
+
+    keyframe.valid = true;
+    keyframe.id = 250;
+    EXPECT_TRUE(keyframe.IsOlderThan(251));
+    EXPECT_TRUE(keyframe.IsOlderThan(3));
+    EXPECT_FALSE(keyframe.IsOlderThan(250));
+    EXPECT_FALSE(keyframe.IsOlderThan(249));
+}
+
+/**
+ * 100 players walking in a crowd, each sending an update 5 times a second
+ * which the server sends to the 99 others. The legacy size is the one of
+ * psDRMessage::WriteDRInfo with a sector string id; message and packet
+ * headers, the same for both, are left out. Both rates are reported.
+ */
+TEST(DRSnapshotTest, CrowdBandwidth)
+{
+    const int players = 100;
+    const int seconds = 60;
+    const int rate = 5;
+    const float speed = 4.0f;
+
+    struct Walker
+    {
+        csVector3 pos;
+        float yrot;
+        float angVel;
+    };
+    Walker walkers[players];
+    srand(1);
+    for (int i = 0; i < players; i++)
+    {
+        walkers[i].pos = csVector3(rand() % 50, 0, rand() % 50);
+        walkers[i].yrot = (rand() % 628) / 100.0f;
+        walkers[i].angVel = 0;
+    }
+
+    // The keyframe each receiver has of each walker
+    psDRKeyframe* keyframes = new psDRKeyframe[players * players];
+
+    double legacyBytes = 0;
+    double compactBytes = 0;
+    int keyframeCount = 0;
+    for (int tick = 0; tick < seconds * rate; tick++)
+    {
+        for (int i = 0; i < players; i++)
+        {
+            Walker &w = walkers[i];
+
+            // Turn now and then
+            w.angVel = (rand() % 10 == 0) ? ((rand() % 200) - 100) / 50.0f : 0;
+            w.yrot += w.angVel / rate;
+            csVector3 vel(0, 0, -speed);
+            csVector3 worldVel(-sinf(w.yrot) * speed, 0, -cosf(w.yrot) * speed);
+            w.pos += worldVel / rate;
+
+            size_t legacy = sizeof(uint32) + 2 * sizeof(uint8) + 3 * sizeof(float) + sizeof(uint8) + sizeof(uint32);
+            legacy += sizeof(float) * ((w.angVel != 0) + 1 + (fabsf(worldVel.x) > 0.001f) + (fabsf(worldVel.z) > 0.001f));
+
+            psDRSnapshot snapshot;
+            ASSERT_TRUE(snapshot.Quantize(w.pos, vel, worldVel, w.angVel, w.yrot, 0, true));
+
+            for (int r = 0; r < players; r++)
+            {
+                if (r == i)
+                    continue;
+
+                legacyBytes += legacy;
+
+                psDRKeyframe &keyframe = keyframes[r * players + i];
+                uint16 fields;
+                if (!keyframe.valid || keyframe.updates >= DR_KEYFRAME_INTERVAL ||
+                    !snapshot.GetDeltaFields(keyframe.snapshot, fields))
+                {
+                    keyframe.snapshot = snapshot;
+                    keyframe.valid = true;
+                    keyframe.updates = 0;
+                    fields = snapshot.GetKeyframeFields();
+                    keyframeCount++;
+                }
+                else
+                {
+                    keyframe.updates++;
+                }
+                compactBytes += psDRSnapshot::GetSize(fields);
+            }
+        }
+    }
+    delete [] keyframes;
+
+    double legacyRate = legacyBytes / seconds / players;
+    double compactRate = compactBytes / seconds / players;
+    printf("%d players: %.0f bytes/s per player with psDRMessage, %.0f bytes/s compact (%d keyframes)\n",
+           players, legacyRate, compactRate, keyframeCount);
+
+    // Every receiver starts with a keyframe of every walker
+    EXPECT_GE(keyframeCount, players * (players - 1));
+    EXPECT_LT(compactRate, legacyRate * 0.75);
+
+    char value[32];
+    snprintf(value, sizeof(value), "%.0f", legacyRate);
+    ::testing::Test::RecordProperty("legacy_bytes_per_player_second", value);
+    snprintf(value, sizeof(value), "%.0f", compactRate);
+    ::testing::Test::RecordProperty("compact_bytes_per_player_second", value);
+}
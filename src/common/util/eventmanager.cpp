@@ -21,7 +21,10 @@
 #include "gameevent.h"
 #include "util/consoleout.h"
 
+#include <csutil/threading/atomicops.h>
+
 #include "net/messages.h"
+#include "net/netprofile.h"
 #include "eventmanager.h"
 
 // Number of recent events to use when calculating moving average
@@ -30,40 +33,189 @@
 /*---------------------------------------------------------------------------*/
 
 EventManager::EventManager()
+    : wheel(csGetTicks())
 {
     // Setting up the static pointer in psGameEvent. Used so
     // that an event can be fired without needing to look up 
     // the event manager first.
-    lastTick = 0;
+    lastTick = csGetTicks();
     stop = false;
     psGameEvent::eventmanager = this;
+    posted = NULL;
+    handlerProfs = new psMsgHandlerProfiles();
 }
 
 EventManager::~EventManager()
 {
     // Clean up the event queue
-    while (eventqueue.Length())
+    psGameEvent* event = (psGameEvent*) CS::Threading::AtomicOperations::Set((void**) &posted, NULL);
+    while (event)
+    {
+        psGameEvent* next = event->next;
+        delete event;
+        event = next;
+    }
+    wheel.DeleteAll();
+
+    csHash<psEventTypeStats*, csString>::GlobalIterator it(eventStats.GetIterator());
+    while (it.HasNext())
     {
-        delete eventqueue.DeleteMin();
+        delete it.Next();
     }
+    delete handlerProfs;
 }
 
 void EventManager::Push(psGameEvent *event)
 {
-    CS::Threading::MutexScopedLock lock(mutex);
+    // Lock free push to the front of the posted list, the list is moved
+    // to the wheel by the main game thread.
+    event->state = EVENT_POSTED;
 
-    // This inserts the event into the priority queue, sorted by timestamp
-    eventqueue.Insert(event);
+    psGameEvent* head;
+    do
+    {
+        head = (psGameEvent*) CS::Threading::AtomicOperations::Read((void**) &posted);
+        event->next = head;
+    }
+    while (CS::Threading::AtomicOperations::CompareAndSet((void**) &posted, event, head) != head);
+}
 
-    /*check if events are inserted late*/
-    if (event->triggerticks < lastTick)
+bool EventManager::Cancel(psGameEvent *event)
+{
+    switch (event->state)
     {
-        // yelp and adjust lastTick to avoid wrong warning
-        CPrintf(
-                CON_DEBUG,
-                "Event %d scheduled at %d is being inserted late. Last processed event was scheduled for %d.\n",
-                event->id, event->triggerticks, lastTick);
-        lastTick = event->triggerticks;
+        case EVENT_QUEUED:
+            wheel.Remove(event);
+            CS::Threading::AtomicOperations::Increment(&GetStats(event)->cancelled);
+            delete event;
+            return true;
+
+        case EVENT_POSTED:
+            // Can't be taken out of the lock free list, it is deleted
+            // when the list is moved to the wheel.
+            event->state = EVENT_CANCELLED;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+bool EventManager::Reschedule(psGameEvent *event, csTicks triggerticks)
+{
+    switch (event->state)
+    {
+        case EVENT_QUEUED:
+            wheel.Remove(event);
+            event->triggerticks = triggerticks;
+            if ((int32) (triggerticks - lastTick) < 0)
+            {
+                lastTick = triggerticks;
+            }
+            Insert(event);
+            return true;
+
+        case EVENT_POSTED:
+            event->triggerticks = triggerticks;
+            return true;
+
+        default:
+            return false;
+    }
+}
+
+void EventManager::TakePosted()
+{
+    psGameEvent* event = (psGameEvent*) CS::Threading::AtomicOperations::Set((void**) &posted, NULL);
+
+    // The list is newest first, reverse it to keep the order of the pushes
+    psGameEvent* ordered = NULL;
+    while (event)
+    {
+        psGameEvent* next = event->next;
+        event->next = ordered;
+        ordered = event;
+        event = next;
+    }
+
+    while (ordered)
+    {
+        event = ordered;
+        ordered = event->next;
+        event->next = NULL;
+
+        psEventTypeStats* stats = GetStats(event);
+        CS::Threading::AtomicOperations::Increment(&stats->queued);
+
+        if (event->state == EVENT_CANCELLED)
+        {
+            CS::Threading::AtomicOperations::Increment(&stats->cancelled);
+            delete event;
+            continue;
+        }
+
+        /*check if events are inserted late*/
+        if ((int32) (event->triggerticks - lastTick) < 0)
+        {
+            // yelp and adjust lastTick to avoid wrong warning
+            CPrintf(
+                    CON_DEBUG,
+                    "Event %d scheduled at %d is being inserted late. Last processed event was scheduled for %d.\n",
+                    event->id, event->triggerticks, lastTick);
+            lastTick = event->triggerticks;
+        }
+
+        Insert(event);
+    }
+}
+
+void EventManager::Insert(psGameEvent *event)
+{
+    event->state = EVENT_QUEUED;
+    wheel.Insert(event);
+}
+
+psEventTypeStats* EventManager::GetStats(psGameEvent *event)
+{
+    if (!event->stats)
+    {
+        CS::Threading::MutexScopedLock lock(statsMutex);
+        csString type(event->GetType());
+        event->stats = eventStats.Get(type, NULL);
+        if (!event->stats)
+        {
+            event->stats = new psEventTypeStats;
+            event->stats->type = type;
+            event->stats->queued = 0;
+            event->stats->fired = 0;
+            event->stats->cancelled = 0;
+            for (int i = 0; i < EVENT_LATE_BUCKETS; i++)
+            {
+                event->stats->late[i] = 0;
+            }
+            eventStats.Put(type, event->stats);
+        }
+    }
+    return event->stats;
+}
+
+void EventManager::GetEventStats(csArray<psEventTypeStats> &stats)
+{
+    CS::Threading::MutexScopedLock lock(statsMutex);
+    csHash<psEventTypeStats*, csString>::GlobalIterator it(eventStats.GetIterator());
+    while (it.HasNext())
+    {
+        psEventTypeStats* counters = it.Next();
+        psEventTypeStats copy;
+        copy.type = counters->type;
+        copy.queued = CS::Threading::AtomicOperations::Read(&counters->queued);
+        copy.fired = CS::Threading::AtomicOperations::Read(&counters->fired);
+        copy.cancelled = CS::Threading::AtomicOperations::Read(&counters->cancelled);
+        for (int i = 0; i < EVENT_LATE_BUCKETS; i++)
+        {
+            copy.late[i] = CS::Threading::AtomicOperations::Read(&counters->late[i]);
+        }
+        stats.Push(copy);
     }
 }
 
@@ -75,6 +227,7 @@ csTicks EventManager::ProcessEventQueue()
     csTicks now = csGetTicks();
 
     static int lastid;
+    static const csTicks lateLimits[EVENT_LATE_BUCKETS] = EVENT_LATE_LIMITS;
 
     psGameEvent *event = NULL;
     int events = 0;
@@ -82,46 +235,66 @@ csTicks EventManager::ProcessEventQueue()
 
     while (true)
     {
+        TakePosted();
 
+        if (!wheel.HasDue())
         {
-            CS::Threading::MutexScopedLock lock(mutex);
-
-            event = eventqueue.FindMin();
-
-            if (!event || event->triggerticks > now)
+            if ((int32) (now - wheel.GetTime()) <= 0)
             {
-                // Empty event queue or not time for event yet
+                // Nothing more to do until now
                 break;
             }
-            eventqueue.DeleteMin();
-
-            /*check if events arrive in order*/
-            if (event->triggerticks < lastTick)
+            if (!wheel.GetCount())
             {
-                /* this should not happen at all */
-                CPrintf(
-                        CON_DEBUG,
-                        "Event %s:%s (%d) scheduled at %d is being processed out of order at time %d! Last processed event was scheduled for %d.\n",
-                        event->GetType(), 
-                        event->ToString().GetDataSafe(),
-                        event->id, event->triggerticks, now, lastTick);
-                CS_ASSERT_MSG("Event trigger time is inconsistent", false);
-            }
-            else
-            {
-                lastTick = event->triggerticks;
+                // Nothing queued, no need to step through the empty slots
+                wheel.SetTime(now);
+                break;
             }
+            wheel.Advance();
+            continue;
+        }
+
+        event = wheel.PopDue();
+        event->state = EVENT_FIRED;
 
+        /*check if events arrive in order*/
+        if ((int32) (event->triggerticks - lastTick) < 0)
+        {
+            /* this should not happen at all */
+            CPrintf(
+                    CON_DEBUG,
+                    "Event %s:%s (%d) scheduled at %d is being processed out of order at time %d! Last processed event was scheduled for %d.\n",
+                    event->GetType(), 
+                    event->ToString().GetDataSafe(),
+                    event->id, event->triggerticks, now, lastTick);
+            CS_ASSERT_MSG("Event trigger time is inconsistent", false);
+        }
+        else
+        {
+            lastTick = event->triggerticks;
         }
-        
 
         events++;
         csTicks start = csGetTicks();
+        psEventTypeStats* stats = GetStats(event);
 
         if (event->CheckTrigger())
         {
+            csTicks late = start - event->triggerticks;
+            int bucket = 0;
+            while (bucket < EVENT_LATE_BUCKETS - 1 && late >= lateLimits[bucket])
+            {
+                bucket++;
+            }
+            CS::Threading::AtomicOperations::Increment(&stats->late[bucket]);
+            CS::Threading::AtomicOperations::Increment(&stats->fired);
+
             event->Trigger();
         }
+        else
+        {
+            CS::Threading::AtomicOperations::Increment(&stats->cancelled);
+        }
 
         csTicks timeTaken = csGetTicks() - start;
 
@@ -142,24 +315,13 @@ csTicks EventManager::ProcessEventQueue()
         lastid    = event->id;
 
         count++;
-//        if (count % 100 == 0)
-//        {
-//            CPrintf(CON_DEBUG, "Went through event loop 100 times in one timeslice for %d events.  This means we either have duplicate events, "
-//                "bugs in event generation or bugs in deleting events from the event tree. "
-//                "Last event: %s:%s took %u time\n", events, event->GetType(), event->ToString().GetDataSafe(), timeTaken);
-//        }
 
         delete event;
     }
 
-    if (event)
-    {
-        // We have a event so report when we would like to be
-        // called again
-        return csMin(event->triggerticks, PROCESS_EVENT + now);
-    }
-
-    return PROCESS_EVENT; // Process events at least every PROCESS_EVENT ticks
+    // Report when we would like to be called again, at least every
+    // PROCESS_EVENT ticks to pick up the events pushed by other threads.
+    return now + wheel.NextEventIn(PROCESS_EVENT);
 }
 
 void EventManager::TrackEventTimes(csTicks timeTaken,MsgEntry *msg)
@@ -219,9 +381,11 @@ void EventManager::Run ()
         if (msg)
         {
             csTicks start = csGetTicks();
+            csMicroTicks startMicro = csGetMicroTicks();
 
             Publish(msg);
 
+            handlerProfs->AddHandleTime(msg->GetType(), (csTicks)(csGetMicroTicks() - startMicro));
             csTicks timeTaken = csGetTicks() - start;
 
             // Ignore messages that take no time to process.
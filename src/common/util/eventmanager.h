@@ -20,38 +20,63 @@
 #ifndef __EVENTMANAGER_H__
 #define __EVENTMANAGER_H__
 
-#include "util/heap.h"
+#include <csutil/csstring.h>
+#include <csutil/hash.h>
+#include <csutil/threading/mutex.h>
+
 #include "net/msghandler.h"
+#include "util/timingwheel.h"
 
 class psGameEvent;
 class MsgHandler;
+class psMsgHandlerProfiles;
 
 /**
  * \addtogroup common_util
  * @{ */
 
+/// Upper bounds in ticks of the buckets of the lateness histogram
+#define EVENT_LATE_BUCKETS 8
+#define EVENT_LATE_LIMITS { 1, 5, 10, 50, 100, 250, 1000, 0 }
+
+/**
+ * Counters of one type of event.
+ */
+struct psEventTypeStats
+{
+    csString type;
+    int32 queued;           ///< Events added to the queue
+    int32 fired;            ///< Events triggered
+    int32 cancelled;        ///< Events cancelled or found invalid when due
+    int32 late[EVENT_LATE_BUCKETS]; ///< Fired events by ticks they were late
+};
+
 /**
  * This class handles all queueing and invoking of timed events, such as
  * combat, spells, NPC dialog responses, range weapons, or NPC respawning.
- * It maintains a queue ordered by trigger time and is polled by the engine
- * periodically to clear any queued events with trigger times less than the
- * current ticks time.
+ * It is polled by the engine periodically to trigger any queued events
+ * with trigger times less than the current ticks time.
+ *
+ * The events are kept in a hierarchical timing wheel, see psTimingWheel.
+ * Adding, cancelling and rescheduling an event are O(1).
+ *
+ * Only the thread running Run() touches the wheel. Push() may be called
+ * from any thread, it adds the event to a lock free list that is moved to
+ * the wheel when the events are processed.
  */
 class EventManager : public MsgHandler, public Singleton<EventManager>
 {
-protected:
-    CS::Threading::Mutex mutex;
-    Heap<psGameEvent> eventqueue;
-
-    csTicks lastTick;
-
-    /// A flag indicating the server is shutting down.
-    bool stop;
-    
-	/// Helper function to keep a running average of the last 50 events.
-	void TrackEventTimes(csTicks timeTaken,MsgEntry *msg);
-
 public:
+    /// Where an event is, kept in psGameEvent::state
+    enum EventState
+    {
+        EVENT_NEW,          ///< Not queued yet
+        EVENT_POSTED,       ///< In the list of events pushed
+        EVENT_QUEUED,       ///< In the timing wheel
+        EVENT_CANCELLED,    ///< Cancelled while in the list of events pushed
+        EVENT_FIRED         ///< Taken off the wheel to be triggered
+    };
+
     EventManager();
     virtual ~EventManager();
 
@@ -61,14 +86,71 @@ public:
     // Called by external threads to make the Run() loop stop.
     void Stop() { stop = true; }
 
-    /// Add new event to scheduler queue.
+    /// Add new event to scheduler queue. May be called from any thread.
     void Push(psGameEvent *event);
 
+    /**
+     * Remove an event from the queue and delete it.
+     *
+     * Only to be called from the main game thread, the event must not be
+     * used afterwards if this succeeds.
+     *
+     * @return false if the event isn't queued, it is being triggered or
+     *         was never pushed. The event is not deleted then.
+     */
+    bool Cancel(psGameEvent *event);
+
+    /**
+     * Move a queued event to another trigger time.
+     *
+     * Only to be called from the main game thread.
+     *
+     * @return false if the event isn't queued.
+     */
+    bool Reschedule(psGameEvent *event, csTicks triggerticks);
+
     /// Check Event Queue for scheduled events which are due
     csTicks ProcessEventQueue();
 
     /// Allows sending of a message not immediately, but after a short delay
     virtual void SendMessageDelayed(MsgEntry *msg,csTicks msecDelay);
+
+    /**
+     * Get a copy of the counters of each type of event.
+     *
+     * May be called from any thread.
+     */
+    void GetEventStats(csArray<psEventTypeStats> &stats);
+
+    /// Time spent handling each type of message.
+    psMsgHandlerProfiles* GetHandlerProfs() { return handlerProfs; }
+
+protected:
+    psTimingWheel<psGameEvent> wheel;
+
+    psGameEvent* volatile posted;   ///< Events pushed since the last processing, newest first
+
+    CS::Threading::Mutex statsMutex;
+    csHash<psEventTypeStats*, csString> eventStats;
+
+    psMsgHandlerProfiles* handlerProfs;
+
+    csTicks lastTick;
+
+    /// A flag indicating the server is shutting down.
+    bool stop;
+    
+	/// Helper function to keep a running average of the last 50 events.
+	void TrackEventTimes(csTicks timeTaken,MsgEntry *msg);
+
+    /// Move the pushed events to the wheel.
+    void TakePosted();
+
+    /// Put an event on the wheel.
+    void Insert(psGameEvent *event);
+
+    /// Get the counters of the type of an event.
+    psEventTypeStats* GetStats(psGameEvent *event);
 };
 
 /** @} */
@@ -46,6 +46,12 @@ psGameEvent::psGameEvent(csTicks ticks,int offsetticks, const char* newType)
     type[31] = '\0';
     id =  CS::Threading::AtomicOperations::Increment(&nextid);
     valid = true;
+
+    next = NULL;
+    prev = NULL;
+    list = NULL;
+    stats = NULL;
+    state = EventManager::EVENT_NEW;
 }
 
 psGameEvent::~psGameEvent()
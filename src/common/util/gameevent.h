@@ -23,6 +23,8 @@
 #include <csutil/csstring.h>
 
 class EventManager;
+template<class T> struct psTimingList;
+struct psEventTypeStats;
 
 /**
  * \addtogroup common_util
@@ -150,6 +152,17 @@ public:
             return true;
         return false;
     };
+
+private:
+    friend class EventManager;
+    template<class T> friend class psTimingWheel;
+
+    // Scheduling data of the EventManager
+    psGameEvent* next;          ///< Next event in the same list
+    psGameEvent* prev;          ///< Previous event in the same list
+    psTimingList<psGameEvent>* list; ///< The slot of the timing wheel holding the event
+    psEventTypeStats* stats;    ///< Counters of the type of the event
+    int state;                  ///< Where the event is, see EventManager
 };
 
 /** @} */
@@ -0,0 +1,273 @@
+/*
+ * jobsystem.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include "util/jobsystem.h"
+
+/// Jobs per thread when no grain is given
+#define JOBS_PER_THREAD 4
+
+class JobSystem::Worker : public CS::Threading::Runnable
+{
+public:
+    Worker(JobSystem* parent, size_t index)
+        :parent(parent),index(index)
+    {
+    }
+
+    virtual void Run()
+    {
+        uint32 lastBatch = 0;
+        while (parent->WaitForBatch(lastBatch))
+        {
+            parent->RunJobs(index);
+        }
+    }
+
+private:
+    JobSystem* parent;
+    size_t index;           ///< Queue of this worker
+};
+
+JobSystem::JobSystem()
+    :batch(0),stop(false),running(false),pending(0),range(NULL),
+     batches(0),inlined(0),jobs(0),steals(0)
+{
+}
+
+JobSystem::~JobSystem()
+{
+    Stop();
+}
+
+void JobSystem::Start(size_t count)
+{
+    Stop();
+
+    if (!count)
+    {
+        return;
+    }
+
+    // The caller takes the last queue
+    for (size_t i = 0; i <= count; i++)
+    {
+        queues.Push(new Queue);
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        csRef<CS::Threading::Runnable> worker;
+        worker.AttachNew(new Worker(this, i));
+        workers.Push(worker);
+
+        csRef<CS::Threading::Thread> thread;
+        thread.AttachNew(new CS::Threading::Thread(worker));
+        thread->Start();
+        threads.Push(thread);
+    }
+}
+
+void JobSystem::Stop()
+{
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        stop = true;
+        batchCondition.NotifyAll();
+    }
+
+    for (size_t i = 0; i < threads.GetSize(); i++)
+    {
+        threads[i]->Wait();
+    }
+    threads.Empty();
+    workers.Empty();
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    for (size_t i = 0; i < queues.GetSize(); i++)
+    {
+        jobs += queues[i]->run;
+        steals += queues[i]->stolen;
+        delete queues[i];
+    }
+    queues.Empty();
+    stop = false;
+}
+
+void JobSystem::ParallelFor(size_t count, iJobRange &work, size_t grain)
+{
+    if (!count)
+    {
+        return;
+    }
+
+    bool runInline = false;
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        batches++;
+
+        // Nested or concurrent batches run in the calling thread
+        if (running || queues.IsEmpty())
+        {
+            inlined++;
+            runInline = true;
+        }
+        else
+        {
+            if (!grain)
+            {
+                grain = count / (queues.GetSize() * JOBS_PER_THREAD);
+                if (!grain)
+                {
+                    grain = 1;
+                }
+            }
+
+            running = true;
+            range = &work;
+            pending = (count + grain - 1) / grain;
+        }
+    }
+
+    if (runInline)
+    {
+        work.Run(0, count);
+        return;
+    }
+
+    // Deal the jobs. Workers still looking for jobs of the last batch may
+    // already take some, the batch is set up for them.
+    size_t jobIndex = 0;
+    for (size_t begin = 0; begin < count; begin += grain, jobIndex++)
+    {
+        Job job;
+        job.begin = begin;
+        job.end = (count - begin > grain) ? begin + grain : count;
+
+        Queue* queue = queues[jobIndex % queues.GetSize()];
+        CS::Threading::MutexScopedLock lock(queue->mutex);
+        queue->jobs.Push(job);
+    }
+
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        batch++;
+        batchCondition.NotifyAll();
+    }
+
+    // The caller takes the last queue
+    RunJobs(queues.GetSize() - 1);
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    while (pending)
+    {
+        doneCondition.Wait(mutex);
+    }
+    running = false;
+    range = NULL;
+}
+
+void JobSystem::RunJobs(size_t self)
+{
+    Job job;
+    while (TakeJob(self, job))
+    {
+        range->Run(job.begin, job.end);
+
+        CS::Threading::MutexScopedLock lock(mutex);
+        if (!--pending)
+        {
+            doneCondition.NotifyAll();
+        }
+    }
+}
+
+bool JobSystem::TakeJob(size_t self, Job &job)
+{
+    // Own jobs first, newest first as their items are most likely cached
+    {
+        Queue* queue = queues[self];
+        CS::Threading::MutexScopedLock lock(queue->mutex);
+        if (queue->jobs.GetSize() > queue->first)
+        {
+            job = queue->jobs.Pop();
+            queue->run++;
+            if (queue->jobs.GetSize() == queue->first)
+            {
+                queue->jobs.Empty();
+                queue->first = 0;
+            }
+            return true;
+        }
+    }
+
+    // Then steal the oldest job of another thread
+    for (size_t i = 1; i < queues.GetSize(); i++)
+    {
+        Queue* queue = queues[(self + i) % queues.GetSize()];
+        CS::Threading::MutexScopedLock lock(queue->mutex);
+        if (queue->jobs.GetSize() > queue->first)
+        {
+            job = queue->jobs[queue->first++];
+            queue->run++;
+            queue->stolen++;
+            if (queue->jobs.GetSize() == queue->first)
+            {
+                queue->jobs.Empty();
+                queue->first = 0;
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool JobSystem::WaitForBatch(uint32 &lastBatch)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    while (!stop && batch == lastBatch)
+    {
+        batchCondition.Wait(mutex);
+    }
+
+    if (stop)
+    {
+        return false;
+    }
+
+    lastBatch = batch;
+    return true;
+}
+
+void JobSystem::GetStats(Stats &stats)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    stats.threads = threads.GetSize();
+    stats.batches = batches;
+    stats.inlined = inlined;
+    stats.jobs = jobs;
+    stats.steals = steals;
+    for (size_t i = 0; i < queues.GetSize(); i++)
+    {
+        CS::Threading::MutexScopedLock queueLock(queues[i]->mutex);
+        stats.jobs += queues[i]->run;
+        stats.steals += queues[i]->stolen;
+    }
+}
@@ -0,0 +1,167 @@
+/*
+ * jobsystem.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_JOBSYSTEM_H
+#define PS_JOBSYSTEM_H
+
+#include <cstypes.h>
+#include <csutil/array.h>
+#include <csutil/refarr.h>
+#include <csutil/threading/condition.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/thread.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/**
+ * Work split over the threads of a JobSystem.
+ */
+class iJobRange
+{
+public:
+    virtual ~iJobRange() {}
+
+    /**
+     * Process the items [begin, end).
+     *
+     * Called from several threads at once with ranges that don't overlap.
+     */
+    virtual void Run(size_t begin, size_t end) = 0;
+};
+
+/*   Design notes:
+ *
+ *  The JobSystem runs the items of a ParallelFor() on a fixed pool of
+ *  threads and the calling thread. The items are cut in jobs of a few items
+ *  each and dealt out round robin to one queue per thread. A thread takes
+ *  the jobs of its own queue from the back and, once that is empty, steals
+ *  from the front of the queues of the other threads. This keeps the
+ *  threads busy when some items are much more expensive than others, like
+ *  the actors of a crowded town compared to the ones in the wilderness.
+ *
+ *  ParallelFor() returns once all the items are done, so the caller may
+ *  continue with the serial work that depends on the results. The queues
+ *  are short lived and only touched a few times per job, they are guarded
+ *  by a mutex each.
+ *
+ *  Limitations:
+ *  1) One ParallelFor() runs at a time. A ParallelFor() called while another
+ *     one runs, from a job or from another thread, runs all its items in the
+ *     calling thread.
+ *  2) The jobs must only read the state shared with other jobs. Anything
+ *     changing shared state has to be done after ParallelFor() returns.
+ */
+class JobSystem
+{
+public:
+    /// Counters since the job system was created
+    struct Stats
+    {
+        size_t threads;     ///< Worker threads, not counting the caller
+        uint64 batches;     ///< Calls to ParallelFor()
+        uint64 inlined;     ///< Calls run in the calling thread only
+        uint64 jobs;        ///< Jobs run
+        uint64 steals;      ///< Jobs taken from the queue of another thread
+    };
+
+    JobSystem();
+    ~JobSystem();
+
+    /**
+     * Start the worker threads.
+     *
+     * @param threads Number of threads besides the caller, 0 runs all the
+     *                work in the calling thread.
+     */
+    void Start(size_t threads);
+
+    /// Stop the worker threads.
+    void Stop();
+
+    /// Get the number of worker threads.
+    size_t GetThreadCount() const
+    {
+        return threads.GetSize();
+    }
+
+    /**
+     * Run range.Run() over the items [0, count) and wait for all of them.
+     *
+     * @param grain Number of items per job, 0 picks a size giving each
+     *              thread a few jobs to balance the load.
+     */
+    void ParallelFor(size_t count, iJobRange &range, size_t grain = 0);
+
+    void GetStats(Stats &stats);
+
+private:
+    class Worker;
+    friend class Worker;
+
+    struct Job
+    {
+        size_t begin;
+        size_t end;
+    };
+
+    /// The jobs dealt to one thread
+    struct Queue
+    {
+        CS::Threading::Mutex mutex;
+        csArray<Job> jobs;
+        size_t first;       ///< Jobs before this one were stolen
+        uint64 run;
+        uint64 stolen;
+
+        Queue() : first(0),run(0),stolen(0) {}
+    };
+
+    /// Run the jobs of a batch until there are none left to take.
+    void RunJobs(size_t self);
+
+    /// Take a job from the own queue or steal one.
+    bool TakeJob(size_t self, Job &job);
+
+    /// Wait for the next batch, false when stopped.
+    bool WaitForBatch(uint32 &lastBatch);
+
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition batchCondition;
+    CS::Threading::Condition doneCondition;
+    uint32 batch;               ///< Incremented for each batch
+    bool stop;
+    bool running;               ///< A batch is running
+    size_t pending;             ///< Jobs of the batch not done yet
+    iJobRange* range;           ///< The work of the running batch
+
+    csArray<Queue*> queues;     ///< One per worker and the last one for the caller
+    csRefArray<CS::Threading::Runnable> workers;
+    csRefArray<CS::Threading::Thread> threads;
+
+    uint64 batches;
+    uint64 inlined;
+    uint64 jobs;                ///< Jobs run by queues deleted in Stop()
+    uint64 steals;
+};
+
+/** @} */
+
+#endif
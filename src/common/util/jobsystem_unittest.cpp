@@ -0,0 +1,177 @@
+/*
+ * jobsystem_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/threading/atomicops.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/jobsystem.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+/// Counts how often each item was run
+class CountingRange : public iJobRange
+{
+public:
+    CountingRange(size_t count)
+    {
+        counts.SetSize(count, 0);
+    }
+
+    virtual void Run(size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            CS::Threading::AtomicOperations::Increment(&counts[i]);
+        }
+    }
+
+    bool AllOnce()
+    {
+        for (size_t i = 0; i < counts.GetSize(); i++)
+        {
+            if (CS::Threading::AtomicOperations::Read(&counts[i]) != 1)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    csArray<int32> counts;
+};
+
+/// Runs a ParallelFor from inside each item
+class NestedRange : public iJobRange
+{
+public:
+    NestedRange(JobSystem &jobs, size_t count) : jobs(jobs), inner(count * count), count(count) {}
+
+    virtual void Run(size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            Offset offset(inner, i * count);
+            jobs.ParallelFor(count, offset);
+        }
+    }
+
+    class Offset : public iJobRange
+    {
+    public:
+        Offset(CountingRange &range, size_t offset) : range(range), offset(offset) {}
+
+        virtual void Run(size_t begin, size_t end)
+        {
+            range.Run(begin + offset, end + offset);
+        }
+
+        CountingRange &range;
+        size_t offset;
+    };
+
+    JobSystem &jobs;
+    CountingRange inner;
+    size_t count;
+};
+
+TEST(JobSystemTest, EachItemOnce)
+{
+    JobSystem jobs;
+    jobs.Start(3);
+    EXPECT_EQ(jobs.GetThreadCount(), (size_t)3);
+
+    CountingRange range(10007);
+    jobs.ParallelFor(10007, range);
+    EXPECT_TRUE(range.AllOnce());
+
+    // Explicit grain larger than the count
+    CountingRange small(5);
+    jobs.ParallelFor(5, small, 16);
+    EXPECT_TRUE(small.AllOnce());
+
+    JobSystem::Stats stats;
+    jobs.GetStats(stats);
+    EXPECT_EQ(stats.threads, (size_t)3);
+    EXPECT_EQ(stats.batches, (uint64)2);
+    EXPECT_EQ(stats.inlined, (uint64)0);
+}
+
+TEST(JobSystemTest, WithoutThreads)
+{
+    JobSystem jobs;
+
+    CountingRange range(100);
+    jobs.ParallelFor(100, range);
+    EXPECT_TRUE(range.AllOnce());
+
+    JobSystem::Stats stats;
+    jobs.GetStats(stats);
+    EXPECT_EQ(stats.batches, (uint64)1);
+    EXPECT_EQ(stats.inlined, (uint64)1);
+}
+
+TEST(JobSystemTest, Nested)
+{
+    JobSystem jobs;
+    jobs.Start(2);
+
+    NestedRange range(jobs, 50);
+    jobs.ParallelFor(50, range, 1);
+    EXPECT_TRUE(range.inner.AllOnce());
+
+    JobSystem::Stats stats;
+    jobs.GetStats(stats);
+    EXPECT_EQ(stats.batches, (uint64)51);
+    EXPECT_EQ(stats.inlined, (uint64)50);
+    EXPECT_EQ(stats.jobs, (uint64)50);
+}
+
+TEST(JobSystemTest, RepeatedBatches)
+{
+    JobSystem jobs;
+    jobs.Start(4);
+
+    for (int i = 0; i < 200; i++)
+    {
+        CountingRange range(i);
+        jobs.ParallelFor(i, range);
+        EXPECT_TRUE(range.AllOnce());
+    }
+
+    // Restarting keeps the counters
+    jobs.Start(1);
+    CountingRange range(1000);
+    jobs.ParallelFor(1000, range);
+    EXPECT_TRUE(range.AllOnce());
+
+    JobSystem::Stats stats;
+    jobs.GetStats(stats);
+    EXPECT_EQ(stats.threads, (size_t)1);
+    EXPECT_EQ(stats.batches, (uint64)200);
+}
@@ -0,0 +1,51 @@
+/*
+ * linkcheck.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include "util/linkcheck.h"
+
+LinkCheckResult CheckLink(const LinkCheckClient &client, csTicks now, csTicks timeout,
+                          csTicks interval, csTicks &next)
+{
+    // Checked again with the next link check
+    next = now + interval - 1;
+
+    // Shortcut here so zombies may immediately disconnect
+    if (client.zombie && client.zombieAllowDisconnect)
+        return LINKCHECK_ZOMBIE;
+
+    if (client.lastRecvPacketTime + timeout < now)
+    {
+        if (client.heartbeat < LINKCHECK_MAX_HEARTBEATS && client.lastRecvPacketTime + timeout * 10 > now)
+            return LINKCHECK_HEARTBEAT;
+
+        if (client.allowDisconnect)
+            return LINKCHECK_LINKDEAD;
+
+        return LINKCHECK_WAIT;
+    }
+
+    if (!client.zombie)
+    {
+        // Packets received meanwhile don't reschedule the client, the time
+        // of its last packet is looked at when it comes up
+        next = client.lastRecvPacketTime + timeout;
+    }
+    return LINKCHECK_WAIT;
+}
@@ -0,0 +1,72 @@
+/*
+ * linkcheck.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef PS_LINKCHECK_H
+#define PS_LINKCHECK_H
+
+#include <cstypes.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Heartbeats sent to a silent client before it is link dead
+#define LINKCHECK_MAX_HEARTBEATS 10
+
+/// What the link check does with a client whose check came up
+enum LinkCheckResult
+{
+    LINKCHECK_WAIT,         ///< Nothing to do until the next check
+    LINKCHECK_HEARTBEAT,    ///< Send a heartbeat to the silent client
+    LINKCHECK_LINKDEAD,     ///< Disconnect the client, it went link dead
+    LINKCHECK_ZOMBIE        ///< Disconnect the zombie right away
+};
+
+/// The state of a client the link check looks at
+struct LinkCheckClient
+{
+    csTicks lastRecvPacketTime;
+    int heartbeat;              ///< Heartbeats sent since the last packet
+    bool zombie;
+    bool zombieAllowDisconnect;
+    bool allowDisconnect;
+};
+
+/**
+ * Decide what to do with a client whose link check came up, and when to
+ * look at it again.
+ *
+ * A client which sent a packet within the timeout is checked again when
+ * the timeout after that packet ends. A silent client gets a heartbeat at
+ * every check, up to LINKCHECK_MAX_HEARTBEATS within ten timeouts, and is
+ * then link dead. Silent clients which may not be disconnected and zombies
+ * waiting to be allowed to leave are looked at with every check.
+ *
+ * @param client   The client.
+ * @param now      The time of the check.
+ * @param timeout  Time without a packet before a client is silent.
+ * @param interval Time between the link checks.
+ * @param next     Set to the time to check the client again, unless it is
+ *                 disconnected.
+ */
+LinkCheckResult CheckLink(const LinkCheckClient &client, csTicks now, csTicks timeout,
+                          csTicks interval, csTicks &next);
+
+/** @} */
+
+#endif
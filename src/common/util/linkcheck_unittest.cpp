@@ -0,0 +1,150 @@
+/*
+ * linkcheck_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/linkcheck.h"
+#include "util/deadlinequeue.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+static const csTicks timeout = 15000;
+static const csTicks linkCheck = 3000;
+
+static LinkCheckClient MakeClient(csTicks lastRecv)
+{
+    LinkCheckClient client;
+    client.lastRecvPacketTime = lastRecv;
+    client.heartbeat = 0;
+    client.zombie = false;
+    client.zombieAllowDisconnect = false;
+    client.allowDisconnect = true;
+    return client;
+}
+
+TEST(LinkCheckTest, ActiveClientWaitsForTimeout)
+{
+    LinkCheckClient client = MakeClient(10000);
+
+    csTicks next;
+    EXPECT_EQ(LINKCHECK_WAIT, CheckLink(client, 20000, timeout, linkCheck, next));
+    EXPECT_EQ(next, (csTicks)25000);
+}
+
+TEST(LinkCheckTest, HeartbeatEveryCheck)
+{
+    LinkCheckClient client = MakeClient(0);
+
+    // Silent after the timeout, a heartbeat with every check until the
+    // last one was sent
+    csTicks now = timeout + 1;
+    csTicks next;
+    int heartbeats = 0;
+    LinkCheckResult result;
+    while ((result = CheckLink(client, now, timeout, linkCheck, next)) == LINKCHECK_HEARTBEAT)
+    {
+        EXPECT_EQ(next, now + linkCheck - 1);
+        client.heartbeat++;
+        heartbeats++;
+        now = next + 1;
+    }
+    EXPECT_EQ(heartbeats, LINKCHECK_MAX_HEARTBEATS);
+    EXPECT_EQ(result, LINKCHECK_LINKDEAD);
+
+    // A packet in reply makes it an active client again
+    client = MakeClient(now - 100);
+    EXPECT_EQ(LINKCHECK_WAIT, CheckLink(client, now, timeout, linkCheck, next));
+    EXPECT_EQ(next, now - 100 + timeout);
+}
+
+TEST(LinkCheckTest, LinkDeadAfterTenTimeouts)
+{
+    // Heartbeats left, but silent for ten timeouts
+    LinkCheckClient client = MakeClient(0);
+    client.heartbeat = 3;
+
+    csTicks next;
+    EXPECT_EQ(LINKCHECK_LINKDEAD, CheckLink(client, timeout * 10, timeout, linkCheck, next));
+}
+
+TEST(LinkCheckTest, DisconnectNotAllowed)
+{
+    LinkCheckClient client = MakeClient(0);
+    client.heartbeat = LINKCHECK_MAX_HEARTBEATS;
+    client.allowDisconnect = false;
+
+    // Looked at with every check until it may be disconnected
+    csTicks now = timeout * 20;
+    csTicks next;
+    EXPECT_EQ(LINKCHECK_WAIT, CheckLink(client, now, timeout, linkCheck, next));
+    EXPECT_EQ(next, now + linkCheck - 1);
+
+    client.allowDisconnect = true;
+    EXPECT_EQ(LINKCHECK_LINKDEAD, CheckLink(client, next + 1, timeout, linkCheck, next));
+}
+
+TEST(LinkCheckTest, Zombie)
+{
+    // An active zombie not allowed to leave yet is looked at with every check
+    LinkCheckClient client = MakeClient(10000);
+    client.zombie = true;
+
+    csTicks next;
+    EXPECT_EQ(LINKCHECK_WAIT, CheckLink(client, 11000, timeout, linkCheck, next));
+    EXPECT_EQ(next, (csTicks)(11000 + linkCheck - 1));
+
+    // Disconnected as soon as it may, silent or not
+    client.zombieAllowDisconnect = true;
+    EXPECT_EQ(LINKCHECK_ZOMBIE, CheckLink(client, 14000, timeout, linkCheck, next));
+    client.lastRecvPacketTime = 0;
+    EXPECT_EQ(LINKCHECK_ZOMBIE, CheckLink(client, 14000, timeout, linkCheck, next));
+}
+
+/**
+ * A client scheduled for the end of its timeout comes up with the next
+ * check when asked for with CheckLinkDeadSoon(), which schedules it just
+ * before the time of that check.
+ */
+TEST(LinkCheckTest, CheckLinkDeadSoon)
+{
+    DeadlineQueue queue;
+    LinkCheckClient client = MakeClient(1000);
+    client.zombie = true;
+    client.zombieAllowDisconnect = true;
+    queue.Schedule(1, client.lastRecvPacketTime + timeout);
+
+    csArray<uint32> due;
+    csTicks now = 4000;
+    queue.PopExpired(now, due);
+    EXPECT_EQ(due.GetSize(), (size_t)0);
+
+    queue.Schedule(1, now - 1);
+    queue.PopExpired(now, due);
+    ASSERT_EQ(due.GetSize(), (size_t)1);
+    EXPECT_EQ(due[0], (uint32)1);
+
+    csTicks next;
+    EXPECT_EQ(LINKCHECK_ZOMBIE, CheckLink(client, now, timeout, linkCheck, next));
+}
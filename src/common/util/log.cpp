@@ -364,89 +364,19 @@ LogCSV::LogCSV(iConfigManager* configmanager, iVFS* vfs)
 
     for(int i = 0;i < MAX_CSV;i++)
     {
-        StartLog(logs[i].first, vfs, logs[i].second, maxSize, csvFile[i]);
+        csvFile[i].AttachNew(new VfsLogFile(vfs, logs[i].first, logs[i].second, maxSize));
+        if(!csvFile[i]->IsOpen())
+            csvFile[i] = NULL;
     }
 }
-             
-void LogCSV::StartLog(const char* logfile, iVFS* vfs, const char* header, size_t maxSize, csRef<iFile>& csvFile)
-{
-        bool writeHeader = false;
-        if (!vfs->Exists(logfile))
-        {
-            csvFile = vfs->Open(logfile,VFS_FILE_WRITE);
-            writeHeader = true;            
-        }
-        else
-        {            
-            csvFile = vfs->Open(logfile,VFS_FILE_APPEND);
-            
-            // Need to rotate log
-            if (csvFile && csvFile->GetSize() > maxSize)
-            {
-                CPrintf(CON_ERROR, "Log File %s is too big! Current size is: %u. Rotating log.", logfile, csvFile->GetSize());
-                
-                csvFile = NULL;
-                
-                // Rolling history
-                for (int index = 10; index > 0; index--)
-                {
-                    csString src(logfile), dst(logfile);
-                    src.Append(index);
-                    dst.Append(index + 1);
-                    // Rotate the files (move file[index] to file[index+1])
-                    if (vfs->Exists(src))
-                    {
-                        csRef<iDataBuffer> existingData = vfs->ReadFile(src, false);
-                        vfs->WriteFile(dst, existingData->GetData(), existingData->GetSize());
-                    }
-                }
-                
-                csRef<iDataBuffer> existingData = vfs->ReadFile(logfile, false);
-                
-                csString temp(logfile);
-                vfs->WriteFile(temp + "1", existingData->GetData(), existingData->GetSize());
-                csvFile = vfs->Open(logfile,VFS_FILE_WRITE);
-                
-                writeHeader = true;
-            }
-        }
-        if(csvFile.IsValid() && writeHeader)
-        {
-            csvFile->Write(header, strlen(header));
-            csvFile->Flush();
-        }
-}
 
 void LogCSV::Write(int type, csString& text)
 {
     if (!csvFile[type])
         return;
 
-
-    time_t curtime = time(NULL);
-    struct tm *loctime;
-    loctime = localtime (&curtime);
-    csString buf(asctime(loctime));
-    buf.Truncate(buf.Length()-1);
-
-    buf.Append(", ");
-    buf.Append(text);
+    // Stamped and flushed by the writer thread
+    csString buf(text);
     buf.Append("\n");
-
-    csvFile[type]->Write(buf, buf.Length());
-
-    static unsigned count = 0;
-
-    if (type == CSV_STATUS)
-        csvFile[type]->Flush();
-    else
-    {
-        // Unfair flushing mechanism for the time being.
-        count++;
-        if(count % 16 == 0)
-        {
-            count = 0;
-            csvFile[type]->Flush();
-        }
-    }
+    AsyncLog::Write(csvFile[type], buf, time(NULL));
 }
@@ -21,6 +21,7 @@
 #define __PSUTIL_LOG_H__
 
 #include "util/singleton.h"
+#include "util/asynclog.h"
 #include "ivaria/reporter.h"
 #include <iutil/vfs.h>
 
@@ -305,8 +306,8 @@ const char* GetSettingName(int id);
 // consistent, readable format. Warnings and errors should go through pslog.
 class LogCSV : public Singleton<LogCSV>
 {
-    csRef<iFile> csvFile[MAX_CSV];
-    void StartLog(const char* logfile, iVFS* vfs, const char* header, size_t maxSize, csRef<iFile>& csvFile);
+    /// Written by the AsyncLog, rotated once bigger than PlaneShift.LogCSV.MaxSize
+    csRef<AsyncLogFile> csvFile[MAX_CSV];
 
 public:
     LogCSV(iConfigManager* configmanager, iVFS* vfs);
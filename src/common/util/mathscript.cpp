@@ -33,6 +33,7 @@
 #include "util/log.h"
 #include <csutil/randomgen.h>
 #include <csutil/xmltiny.h>
+#include <csutil/threading/mutex.h>
 
 #include "psdatabase.h"
 
@@ -47,6 +48,37 @@ double round(double value)
 }
 #endif
 
+namespace
+{
+/**
+ * The names of all the variables ever used. IDs are never released, so
+ * scripts and environments can keep them for as long as they want.
+ */
+struct VariableNames
+{
+    CS::Threading::Mutex mutex;
+    csStringSet names;
+
+    // used by every environment and script
+    MathVarID environment;
+    MathVarID exit;
+
+    VariableNames()
+    {
+        environment = names.Request("environment");
+        exit = names.Request("exit");
+    }
+};
+
+VariableNames& GetVariableNames()
+{
+    static VariableNames variableNames;
+    return variableNames;
+}
+}
+
+//----------------------------------------------------------------------------
+
 csString MathVar::ToString() const
 {
     switch (Type())
@@ -139,15 +171,15 @@ void MathEnvironment::Init()
     // don't use Define here as it'd check the parent
     MathVar* env = new MathVar(this);
     env->SetValue(converter.value);
-    variables.Put("environment", env);
+    Variable variable = { GetVariableNames().environment, env };
+    variables.Push(variable);
 }
 
 MathEnvironment::~MathEnvironment()
 {
-    csHash<MathVar*, csString>::GlobalIterator it(variables.GetIterator());
-    while (it.HasNext())
+    for (size_t i = 0; i < variables.GetSize(); i++)
     {
-        delete it.Next();
+        delete variables[i].var;
     }
 
     if(!parent)
@@ -156,34 +188,63 @@ MathEnvironment::~MathEnvironment()
     }
 }
 
+MathVar* MathEnvironment::Find(MathVarID id) const
+{
+    // binary search, environments hold a few dozen variables at most
+    size_t low = 0;
+    size_t high = variables.GetSize();
+    while (low < high)
+    {
+        size_t mid = (low + high) / 2;
+        MathVarID midID = variables[mid].id;
+        if (midID == id)
+            return variables[mid].var;
+        if (midID < id)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return NULL;
+}
+
 MathVar* MathEnvironment::Lookup(const char *name) const
 {
-    MathVar *var = variables.Get(name, NULL);
-    if (!var && parent)
-        var = parent->Lookup(name);
+    MathVarID id = MathScriptEngine::FindVariableID(name);
+    if (id == csInvalidStringID)
+        return NULL;
 
-    return var;
+    return Lookup(id);
 }
 
-MathVar* MathEnvironment::GetVar(const char* name)
+MathVar* MathEnvironment::GetVar(MathVarID id)
 {
-    MathVar *var = Lookup(name);
+    MathVar *var = Lookup(id);
     if (!var)
     {
         var = new MathVar(this);
-        variables.Put(name,var);
+
+        // keep the variables sorted by ID
+        size_t pos = 0;
+        while (pos < variables.GetSize() && variables[pos].id < id)
+            pos++;
+
+        Variable variable = { id, var };
+        variables.Insert(pos, variable);
     }
     return var;
 }
 
+MathVar* MathEnvironment::GetVar(const char* name)
+{
+    return GetVar(MathScriptEngine::GetVariableID(name));
+}
+
 void MathEnvironment::DumpAllVars() const
 {
-    csString name;
-    csHash<MathVar*, csString>::ConstGlobalIterator it(variables.GetIterator());
-    while (it.HasNext())
+    for (size_t i = 0; i < variables.GetSize(); i++)
     {
-        MathVar *var = it.Next(name);
-        CPrintf(CON_DEBUG, "%25s = %s\n", name.GetData(), var->Dump().GetData());
+        CPrintf(CON_DEBUG, "%25s = %s\n", MathScriptEngine::GetVariableName(variables[i].id),
+                variables[i].var->Dump().GetData());
     }
 }
 
@@ -227,6 +288,24 @@ void MathEnvironment::Define(const char *name, const char* str)
     var->SetString(str);
 }
 
+void MathEnvironment::Define(MathVarID id, double value)
+{
+    MathVar* var = GetVar(id);
+    var->SetValue(value);
+}
+
+void MathEnvironment::Define(MathVarID id, iScriptableVar* obj)
+{
+    MathVar* var = GetVar(id);
+    var->SetObject(obj);
+}
+
+void MathEnvironment::Define(MathVarID id, const char* str)
+{
+    MathVar* var = GetVar(id);
+    var->SetString(str);
+}
+
 bool MathEnvironment::HasString(const char* p) const
 {
     bool result = false;
@@ -409,6 +488,7 @@ MathStatement* MathStatement::Create(const csString & line, const char *name)
         delete stmt;
         return NULL;
     }
+    stmt->assigneeID = MathScriptEngine::GetVariableID(assignee);
 
     csString expression;
     line.SubString(expression, assignAt+1);
@@ -425,10 +505,16 @@ MathStatement* MathStatement::Create(const csString & line, const char *name)
 double MathStatement::Evaluate(MathEnvironment *env) const
 {
     double result = MathExpression::Evaluate(env);
-    env->Define(assignee, result);
+    env->Define(assigneeID, result);
     return result;
 }
 
+void MathStatement::CollectVariables(csSet<MathVarID>& read, csSet<MathVarID>& assigned) const
+{
+    MathExpression::CollectVariables(read, assigned);
+    assigned.Add(assigneeID);
+}
+
 //----------------------------------------------------------------------------
 
 MathScript* MathScript::Create(const char *name, const csString & script)
@@ -638,9 +724,33 @@ void MathScript::CopyAndDestroy(MathScript* other)
     delete other;
 }
 
+void MathScript::CollectVariables(csSet<MathVarID>& read, csSet<MathVarID>& assigned) const
+{
+    for (size_t i = 0; i < scriptLines.GetSize(); i++)
+    {
+        scriptLines[i]->CollectVariables(read, assigned);
+    }
+}
+
+void MathScript::GetInputs(csArray<MathVarID>& inputs) const
+{
+    csSet<MathVarID> read;
+    csSet<MathVarID> assigned;
+    CollectVariables(read, assigned);
+
+    csSet<MathVarID>::GlobalIterator it(read.GetIterator());
+    while (it.HasNext())
+    {
+        MathVarID id = it.Next();
+        if (id != GetVariableNames().environment)
+            inputs.Push(id);
+    }
+}
+
 double MathScript::Evaluate(MathEnvironment *env) const
 {
-    MathVar *exitsignal = env->Lookup("exit");
+    MathVarID exitID = GetVariableNames().exit;
+    MathVar *exitsignal = env->Lookup(exitID);
     if (exitsignal)
     {
         exitsignal->SetValue(0); // clear exit condition before running
@@ -648,8 +758,8 @@ double MathScript::Evaluate(MathEnvironment *env) const
     else
     {
         // create exit signal if it doesn't exist
-        env->Define("exit",0.f);
-        exitsignal = env->Lookup("exit");
+        env->Define(exitID, 0.0);
+        exitsignal = env->Lookup(exitID);
     }
 
     for (size_t i = 0; i < scriptLines.GetSize(); i++)
@@ -858,6 +968,30 @@ double MathScriptEngine::CustomCompoundFunc(const double * parms)
     }
 }
 
+MathVarID MathScriptEngine::GetVariableID(const char* name)
+{
+    VariableNames& variableNames = GetVariableNames();
+    CS::Threading::MutexScopedLock lock(variableNames.mutex);
+    return variableNames.names.Request(name);
+}
+
+MathVarID MathScriptEngine::FindVariableID(const char* name)
+{
+    VariableNames& variableNames = GetVariableNames();
+    CS::Threading::MutexScopedLock lock(variableNames.mutex);
+    if (!variableNames.names.Contains(name))
+        return csInvalidStringID;
+    return variableNames.names.Request(name);
+}
+
+const char* MathScriptEngine::GetVariableName(MathVarID id)
+{
+    VariableNames& variableNames = GetVariableNames();
+    CS::Threading::MutexScopedLock lock(variableNames.mutex);
+    const char* name = variableNames.names.Request(id);
+    return name ? name : "";
+}
+
 csString MathScriptEngine::FormatMessage(const csString& format, size_t arg_count, const double* parms)
 {
     if(format.IsEmpty() || arg_count == 0)
@@ -916,6 +1050,10 @@ bool MathExpression::Parse(const char *exp)
 {
     CS_ASSERT(exp);
 
+    csSet<csString> requiredVars; // variables required to execute this expression
+    csSet<csString> requiredObjs; // a subset of requiredVars which are known to be objects
+    csSet<PropertyRef> propertyRefs; // properties that have to be resolved prior to evaluation
+
     // SCANNER: creates a list of tokens.
     csArray<csString> tokens;
     size_t start = SIZET_NOT_FOUND;
@@ -1100,15 +1238,26 @@ bool MathExpression::Parse(const char *exp)
     // make sure environment will be resolved upon execution
     requiredVars.Add("environment");
 
-    // Parse the formula.
+    // Parse the formula. The variables are bound to their IDs here, in the
+    // order the parser expects their values.
     csString fpVars;
     {
         // add all required variables
         csSet<csString>::GlobalIterator it(requiredVars.GetIterator());
         while (it.HasNext())
         {
-            fpVars.Append(it.Next());
+            const csString& var = it.Next();
+            fpVars.Append(var);
             fpVars.Append(',');
+            variables.Push(MathScriptEngine::GetVariableID(var));
+        }
+    }
+
+    {
+        csSet<csString>::GlobalIterator it(requiredObjs.GetIterator());
+        while (it.HasNext())
+        {
+            objects.Push(MathScriptEngine::GetVariableID(it.Next()));
         }
     }
 
@@ -1122,6 +1271,9 @@ bool MathExpression::Parse(const char *exp)
             var.Format("%s_%s", ref.object.GetData(), ref.property.GetData());
             fpVars.Append(var);
             fpVars.Append(',');
+
+            PropertyBinding binding = { MathScriptEngine::GetVariableID(ref.object), ref.property };
+            properties.Push(binding);
         }
     }
 
@@ -1151,23 +1303,22 @@ bool MathExpression::Parse(const char *exp)
 
 double MathExpression::Evaluate(MathEnvironment *env) const
 {
-    double *values = new double [requiredVars.GetSize() + propertyRefs.GetSize()];
+    // evaluated very often, so avoid the heap
+    CS_ALLOC_STACK_ARRAY(double, values, variables.GetSize() + properties.GetSize() + 1);
     size_t i = 0;
 
     // retrieve the values of all required variables
-    csSet<csString>::GlobalIterator it(requiredVars.GetIterator());
-    while (it.HasNext())
+    for (size_t v = 0; v < variables.GetSize(); v++)
     {
-        const csString & varName = it.Next();
-        MathVar *var = env->Lookup(varName);
+        MathVar *var = env->Lookup(variables[v]);
 
         if (!var) // invalid variable
         {
             csString msg;
-            msg.Format("Error in >%s<: Required variable >%s< not supplied in environment.", name, varName.GetData());
+            msg.Format("Error in >%s<: Required variable >%s< not supplied in environment.", name,
+                       MathScriptEngine::GetVariableName(variables[v]));
             CS_ASSERT_MSG(msg.GetData(),false);
             Error2("%s",msg.GetData());
-            delete [] values;
             return 0.0;
         }
         values[i++] = var->GetValue();
@@ -1175,51 +1326,55 @@ double MathExpression::Evaluate(MathEnvironment *env) const
 
     // retrieve the objects requried to retrieve
     // calculated values or properties
-    it = requiredObjs.GetIterator();
-    while (it.HasNext())
+    for (size_t o = 0; o < objects.GetSize(); o++)
     {
-        const csString & objName = it.Next();
-        MathVar *var = env->Lookup(objName);
+        MathVar *var = env->Lookup(objects[o]);
 
-        CS_ASSERT(var); // checked as part of requiredVars
+        CS_ASSERT(var); // checked as part of variables
 
         if (var->Type() != VARTYPE_OBJ) // invalid type
         {
             csString msg;
-            msg.Format("Error in >%s<: Type inference requires >%s< to be an iScriptableVar, but it isn't.", name, objName.GetData());
+            msg.Format("Error in >%s<: Type inference requires >%s< to be an iScriptableVar, but it isn't.", name,
+                       MathScriptEngine::GetVariableName(objects[o]));
             CS_ASSERT_MSG(msg.GetData(),false);
             Error2("%s",msg.GetData());
-            delete [] values;
             return 0.0;
         }
         else if (!var->GetObject()) // invalid object
         {
             csString msg;
-            msg.Format("Error in >%s<: Given a NULL iScriptableVar* for >%s<.", name, objName.GetData());
+            msg.Format("Error in >%s<: Given a NULL iScriptableVar* for >%s<.", name,
+                       MathScriptEngine::GetVariableName(objects[o]));
             CS_ASSERT_MSG(msg.GetData(),false);
             Error2("%s",msg.GetData());
-            delete [] values;
             return 0.0;
         }
     }
 
     // retrieve the required properties
-    csSet<PropertyRef>::GlobalIterator propIt(propertyRefs.GetIterator());
-    while (propIt.HasNext())
+    for (size_t p = 0; p < properties.GetSize(); p++)
     {
-        const PropertyRef& ref = propIt.Next();
+        const PropertyBinding& binding = properties[p];
 
-        MathVar *var = env->Lookup(ref.object);
-        CS_ASSERT(var); // checked as part of requiredVars
+        MathVar *var = env->Lookup(binding.object);
+        CS_ASSERT(var); // checked as part of variables
 
         iScriptableVar *obj = var->GetObject();
-        CS_ASSERT(obj); // checked as part of requiredObjs
+        CS_ASSERT(obj); // checked as part of objects
 
-        values[i++] = obj->GetProperty(env,ref.property.GetData());
+        values[i++] = obj->GetProperty(env,binding.property.GetData());
     }
 
-    double ret = fp.Eval(values);
-    delete [] values;
-    return ret;
+    return fp.Eval(values);
 }
 
+void MathExpression::CollectVariables(csSet<MathVarID>& read, csSet<MathVarID>& assigned) const
+{
+    for (size_t i = 0; i < variables.GetSize(); i++)
+    {
+        // only a value the script didn't compute itself comes from outside
+        if (!assigned.Contains(variables[i]))
+            read.Add(variables[i]);
+    }
+}
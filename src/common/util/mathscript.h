@@ -37,6 +37,14 @@ class MathScript;
 class MathVar;
 struct iDataConnection;
 
+/**
+ * Index of a variable name.
+ *
+ * Variable names are bound to an ID once, when a script is parsed or the
+ * first time a name is defined. Scripts then find their variables by ID.
+ */
+typedef uint32 MathVarID;
+
 /**
  * \addtogroup common_util
  * @{ */
@@ -178,6 +186,39 @@ public:
 
     /// format a message using csString's Format given a string ID and a number of floating points.
     static csString FormatMessage(const csString& formatString, size_t arg_count, const double* parms);
+
+    /// get the ID of a variable name, registering the name if needed.
+    static MathVarID GetVariableID(const char* name);
+
+    /// get the ID of a variable name or csInvalidStringID if no variable ever had that name.
+    static MathVarID FindVariableID(const char* name);
+
+    /// get the name of a variable ID.
+    static const char* GetVariableName(MathVarID id);
+};
+
+/**
+ * A variable name and its ID, requested once when this is constructed.
+ *
+ * Defining or looking up a variable by name takes the lock of the shared
+ * name table and hashes the name each time. Code run for every attack or
+ * skill practice keeps the names it uses as statics instead:
+ *
+ *     static const MathVarName attackerVar("Attacker");
+ *     env.Define(attackerVar, attacker);
+ */
+class MathVarName
+{
+public:
+    MathVarName(const char* name) : id(MathScriptEngine::GetVariableID(name)) {}
+
+    operator MathVarID() const
+    {
+        return id;
+    }
+
+private:
+    MathVarID id;
 };
 
 /**
@@ -201,7 +242,19 @@ private:
     csStringSet stringLiterals;
 
     const MathEnvironment *parent;
-    csHash<MathVar*, csString> variables;
+
+    /// a variable defined in this environment
+    struct Variable
+    {
+        MathVarID id;
+        MathVar* var;
+    };
+    /// the variables of this environment, sorted by ID
+    csArray<Variable> variables;
+
+    /// find a variable of this environment, ignoring the parents
+    MathVar* Find(MathVarID id) const;
+    MathVar* GetVar(MathVarID id);
 
     void Init();
 
@@ -229,6 +282,15 @@ public:
     /// define a string variable in the environment
     void Define(const char *name, const char* str);
 
+    /// define a regular variable in the environment by ID
+    void Define(MathVarID id, double value);
+
+    /// define an object variable in the environment by ID
+    void Define(MathVarID id, iScriptableVar* obj);
+
+    /// define a string variable in the environment by ID
+    void Define(MathVarID id, const char* str);
+
     /// test whether we have an ID for a string.
     bool HasString(const char* p) const;
 
@@ -248,6 +310,21 @@ public:
     double GetValue(const char* p);
 
     MathVar* Lookup(const char *name) const;
+
+    /// find a variable by ID in this environment or its parents.
+    MathVar* Lookup(MathVarID id) const
+    {
+        const MathEnvironment* env = this;
+        do
+        {
+            MathVar* var = env->Find(id);
+            if (var)
+                return var;
+            env = env->parent;
+        } while (env);
+        return NULL;
+    }
+
     void DumpAllVars() const;
 
     /// Perform string interpolation, i.e. replacing ${...} with the appropriate variable.
@@ -369,9 +446,19 @@ protected:
         }
     };
 
-    csSet<csString> requiredVars; ///< variables required to execute this expression
-    csSet<csString> requiredObjs; ///< a subset of requiredVars which are known to be objects; for type checking
-    csSet<PropertyRef> propertyRefs; ///< properties that have to be resolved prior to evaluation
+    /// a property of an object variable passed to the parser
+    struct PropertyBinding
+    {
+        MathVarID object;
+        csString property;
+    };
+
+    /// variables passed to the parser, in the order of the parser variables
+    csArray<MathVarID> variables;
+    /// a subset of variables which are known to be objects; for type checking
+    csArray<MathVarID> objects;
+    /// properties passed to the parser after the variables
+    csArray<PropertyBinding> properties;
     mutable FunctionParser fp;
 
     const char *name; // used for debugging
@@ -382,6 +469,9 @@ public:
     
     virtual double Evaluate(MathEnvironment *env) const;
 
+    /// add the variables this expression reads before they are assigned and those it assigns.
+    virtual void CollectVariables(csSet<MathVarID>& read, csSet<MathVarID>& assigned) const;
+
     size_t GetOpcode() const
     {
         return opcode;
@@ -407,6 +497,9 @@ protected:
     MathStatement() { } // may only be constructed via MathStatement::Create
 
     csString assignee; ///< variable the result will be assinged to
+    MathVarID assigneeID;
+
+    virtual void CollectVariables(csSet<MathVarID>& read, csSet<MathVarID>& assigned) const;
 
 public:
     static MathStatement* Create(const csString & expression, const char *name);
@@ -446,6 +539,8 @@ protected:
     csString name;
     csArray<MathExpression*> scriptLines;
 
+    virtual void CollectVariables(csSet<MathVarID>& read, csSet<MathVarID>& assigned) const;
+
 public:
     static MathScript* Create(const char *name, const csString & script);
     static void Destroy(MathScript* &mathScript);
@@ -459,6 +554,9 @@ public:
 
     void CopyAndDestroy(MathScript* other);
 
+    /// get the variables the script reads before it assigns them.
+    void GetInputs(csArray<MathVarID>& inputs) const;
+
     double Evaluate(MathEnvironment *env) const;
 };
 
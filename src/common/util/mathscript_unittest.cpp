@@ -72,6 +72,69 @@ TEST(MathScriptTest, BasicScript)
     MathScript::Destroy(script);
 }
 
+TEST(MathScriptTest, VariableIDs)
+{
+    MathVarID id = MathScriptEngine::GetVariableID("Base");
+    EXPECT_EQ(id, MathScriptEngine::FindVariableID("Base"));
+    EXPECT_EQ(csInvalidStringID, MathScriptEngine::FindVariableID("NeverDefinedAnywhere"));
+    EXPECT_STREQ("Base", MathScriptEngine::GetVariableName(id));
+
+    MathEnvironment parent;
+    parent.Define("Base", 10.0);
+    MathEnvironment env(&parent);
+    env.Define("Bonus", 1.0);
+    ASSERT_NE(env.Lookup(id), NULL);
+    EXPECT_EQ(parent.Lookup(id), env.Lookup("Base"));
+}
+
+TEST(MathScriptTest, VariableNames)
+{
+    static const MathVarName baseVar("Base");
+    static const MathVarName labelVar("Label");
+    EXPECT_EQ(MathScriptEngine::GetVariableID("Base"), (MathVarID)baseVar);
+
+    // defined by ID, found by name and the other way round
+    MathEnvironment env;
+    env.Define(baseVar, 10.0);
+    env.Define(labelVar, "text");
+    env.Define("Bonus", 1.0);
+    ASSERT_NE(env.Lookup("Base"), NULL);
+    EXPECT_EQ(10.0, env.Lookup("Base")->GetValue());
+    EXPECT_EQ(VARTYPE_STR, env.Lookup("Label")->Type());
+    EXPECT_EQ(env.Lookup("Bonus"), env.Lookup(MathVarName("Bonus")));
+}
+
+TEST(MathScriptTest, ParentEnvironment)
+{
+    MathScript *script = MathScript::Create("ParentEnvironment", "Base = Base * 2; Result = Base + Bonus;");
+    ASSERT_NE(script, NULL);
+
+    // Base is read before it is assigned, so it is an input as well
+    csArray<MathVarID> inputs;
+    script->GetInputs(inputs);
+    ASSERT_EQ((size_t)2, inputs.GetSize());
+    EXPECT_NE(csArrayItemNotFound, inputs.Find(MathScriptEngine::GetVariableID("Base")));
+    EXPECT_NE(csArrayItemNotFound, inputs.Find(MathScriptEngine::GetVariableID("Bonus")));
+    EXPECT_EQ(csArrayItemNotFound, inputs.Find(MathScriptEngine::GetVariableID("Result")));
+
+    MathEnvironment parent;
+    parent.Define("Base", 10.0);
+    MathEnvironment env(&parent);
+    env.Define("Bonus", 1.0);
+    script->Evaluate(&env);
+
+    // variables of the parent are assigned in the parent, new ones in the child
+    EXPECT_EQ(20.0, parent.Lookup("Base")->GetValue());
+    EXPECT_EQ(21.0, env.Lookup("Result")->GetValue());
+    EXPECT_EQ(NULL, parent.Lookup("Result"));
+
+    // evaluating again reuses the variables
+    script->Evaluate(&env);
+    EXPECT_EQ(40.0, parent.Lookup("Base")->GetValue());
+    EXPECT_EQ(41.0, env.Lookup("Result")->GetValue());
+    MathScript::Destroy(script);
+}
+
 class Foo : public iScriptableVar
 {
 public:
@@ -0,0 +1,49 @@
+/*
+ * pendingloads.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include "util/pendingloads.h"
+
+bool psPendingLoads::Start(uint32_t clientnum, PID pid)
+{
+    if(loads.Contains(clientnum))
+    {
+        return false;
+    }
+
+    loads.Put(clientnum, pid);
+    return true;
+}
+
+void psPendingLoads::Cancel(uint32_t clientnum)
+{
+    loads.DeleteAll(clientnum);
+}
+
+bool psPendingLoads::Finish(uint32_t clientnum, PID pid)
+{
+    const PID* pending = loads.GetElementPointer(clientnum);
+    if(!pending || *pending != pid)
+    {
+        return false;
+    }
+
+    loads.DeleteAll(clientnum);
+    return true;
+}
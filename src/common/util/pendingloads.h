@@ -0,0 +1,79 @@
+/*
+ * pendingloads.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_PENDINGLOADS_H
+#define PS_PENDINGLOADS_H
+
+#include <csutil/hash.h>
+
+#include "util/psconst.h"
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/**
+ * The characters the clients are waiting for.
+ *
+ * A character loaded in the background may come back after its client
+ * left or asked for another character. Only the load a client is still
+ * waiting for is accepted, the others have to be dropped.
+ */
+class psPendingLoads
+{
+public:
+    /**
+     * Remember that a client waits for a character.
+     *
+     * @return false if the client already waits for a character.
+     */
+    bool Start(uint32_t clientnum, PID pid);
+
+    /**
+     * Forget the load of a client, for instance when it leaves. The load
+     * is dropped once it is done.
+     */
+    void Cancel(uint32_t clientnum);
+
+    /**
+     * Called when the load of a character is done.
+     *
+     * @return true if the client still waits for this character.
+     */
+    bool Finish(uint32_t clientnum, PID pid);
+
+    /// Check if a client waits for a character.
+    bool IsPending(uint32_t clientnum) const
+    {
+        return loads.Contains(clientnum);
+    }
+
+    /// Number of clients waiting for a character.
+    size_t GetCount() const
+    {
+        return loads.GetSize();
+    }
+
+private:
+    csHash<PID, uint32_t> loads;
+};
+
+/** @} */
+
+#endif
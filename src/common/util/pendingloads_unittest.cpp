@@ -0,0 +1,81 @@
+/*
+ * pendingloads_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/pendingloads.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+TEST(PendingLoadsTest, Finish)
+{
+    psPendingLoads loads;
+    EXPECT_TRUE(loads.Start(1, PID(10)));
+    EXPECT_TRUE(loads.IsPending(1));
+    EXPECT_TRUE(loads.Finish(1, PID(10)));
+    EXPECT_FALSE(loads.IsPending(1));
+    EXPECT_EQ(0u, loads.GetCount());
+}
+
+TEST(PendingLoadsTest, OneLoadPerClient)
+{
+    psPendingLoads loads;
+    EXPECT_TRUE(loads.Start(1, PID(10)));
+    EXPECT_FALSE(loads.Start(1, PID(10)));
+    EXPECT_TRUE(loads.Start(2, PID(20)));
+    EXPECT_EQ(2u, loads.GetCount());
+}
+
+TEST(PendingLoadsTest, ClientLeftBeforeTheLoad)
+{
+    psPendingLoads loads;
+    loads.Start(1, PID(10));
+    loads.Cancel(1);
+
+    // The character comes back after the client is gone
+    EXPECT_FALSE(loads.Finish(1, PID(10)));
+    EXPECT_FALSE(loads.IsPending(1));
+}
+
+TEST(PendingLoadsTest, OtherCharacter)
+{
+    psPendingLoads loads;
+    loads.Start(1, PID(10));
+    loads.Cancel(1);
+    loads.Start(1, PID(11));
+
+    // The first load is dropped, the client waits for the second one
+    EXPECT_FALSE(loads.Finish(1, PID(10)));
+    EXPECT_TRUE(loads.IsPending(1));
+    EXPECT_TRUE(loads.Finish(1, PID(11)));
+}
+
+TEST(PendingLoadsTest, FinishedTwice)
+{
+    psPendingLoads loads;
+    loads.Start(1, PID(10));
+    EXPECT_TRUE(loads.Finish(1, PID(10)));
+    EXPECT_FALSE(loads.Finish(1, PID(10)));
+}
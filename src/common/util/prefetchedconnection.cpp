@@ -0,0 +1,192 @@
+/*
+ * prefetchedconnection.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <stdarg.h>
+
+#include "util/prefetchedconnection.h"
+
+psPrefetchedResults::~psPrefetchedResults()
+{
+    // Results not used by the load
+    csHash<iResultSet*, csString>::GlobalIterator iter(results.GetIterator());
+    while(iter.HasNext())
+    {
+        iResultSet* result = iter.Next();
+        result->Release();
+    }
+}
+
+void psPrefetchedResults::Add(const csString &query, iResultSet* result)
+{
+    iResultSet* old = results.Get(query, NULL);
+    if(old)
+    {
+        old->Release();
+    }
+    results.PutUnique(query, result);
+}
+
+iResultSet* psPrefetchedResults::Take(const csString &query)
+{
+    iResultSet* result = results.Get(query, NULL);
+    if(result)
+    {
+        results.Delete(query, result);
+    }
+    return result;
+}
+
+//-----------------------------------------------------------------------------
+
+psPrefetchedConnection::psPrefetchedConnection(iDataConnection* connection, psPrefetchedResults* prefetch)
+    :scfImplementationType(this),connection(connection),prefetch(prefetch),hits(0)
+{
+}
+
+psPrefetchedConnection::~psPrefetchedConnection()
+{
+}
+
+int psPrefetchedConnection::IsValid(void)
+{
+    return connection->IsValid();
+}
+
+bool psPrefetchedConnection::Initialize(const char* host, unsigned int port, const char* database,
+                                        const char* user, const char* pwd, LogCSV* logcsv)
+{
+    return connection->Initialize(host, port, database, user, pwd, logcsv);
+}
+
+bool psPrefetchedConnection::Close()
+{
+    return connection->Close();
+}
+
+void psPrefetchedConnection::Escape(csString &to, const char* from)
+{
+    connection->Escape(to, from);
+}
+
+iResultSet* psPrefetchedConnection::Select(const char* sql, ...)
+{
+    csString query;
+    va_list args;
+    va_start(args, sql);
+    query.FormatV(sql, args);
+    va_end(args);
+
+    iResultSet* result = prefetch->Take(query);
+    if(result)
+    {
+        hits++;
+        return result;
+    }
+
+    return connection->Select("%s", query.GetData());
+}
+
+int psPrefetchedConnection::SelectSingleNumber(const char* sql, ...)
+{
+    csString query;
+    va_list args;
+    va_start(args, sql);
+    query.FormatV(sql, args);
+    va_end(args);
+
+    return connection->SelectSingleNumber("%s", query.GetData());
+}
+
+unsigned long psPrefetchedConnection::Command(const char* sql, ...)
+{
+    csString query;
+    va_list args;
+    va_start(args, sql);
+    query.FormatV(sql, args);
+    va_end(args);
+
+    return connection->Command("%s", query.GetData());
+}
+
+unsigned long psPrefetchedConnection::CommandPump(const char* sql, ...)
+{
+    csString query;
+    va_list args;
+    va_start(args, sql);
+    query.FormatV(sql, args);
+    va_end(args);
+
+    return connection->CommandPump("%s", query.GetData());
+}
+
+uint64 psPrefetchedConnection::GenericInsertWithID(const char* table,const char** fieldnames,psStringArray &fieldvalues)
+{
+    return connection->GenericInsertWithID(table, fieldnames, fieldvalues);
+}
+
+bool psPrefetchedConnection::GenericUpdateWithID(const char* table,const char* idfield,const char* id,const char** fieldnames,psStringArray &fieldvalues)
+{
+    return connection->GenericUpdateWithID(table, idfield, id, fieldnames, fieldvalues);
+}
+
+const char* psPrefetchedConnection::GetLastError(void)
+{
+    return connection->GetLastError();
+}
+
+const char* psPrefetchedConnection::GetLastQuery(void)
+{
+    return connection->GetLastQuery();
+}
+
+uint64 psPrefetchedConnection::GetLastInsertID()
+{
+    return connection->GetLastInsertID();
+}
+
+const char* psPrefetchedConnection::uint64tostring(uint64 value,csString &recv)
+{
+    return connection->uint64tostring(value, recv);
+}
+
+const char* psPrefetchedConnection::DumpProfile()
+{
+    return connection->DumpProfile();
+}
+
+void psPrefetchedConnection::ResetProfile()
+{
+    connection->ResetProfile();
+}
+
+csString psPrefetchedConnection::ExportProfile()
+{
+    return connection->ExportProfile();
+}
+
+iRecord* psPrefetchedConnection::NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line)
+{
+    return connection->NewUpdatePreparedStatement(table, idfield, count, file, line);
+}
+
+iRecord* psPrefetchedConnection::NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line)
+{
+    return connection->NewInsertPreparedStatement(table, count, file, line);
+}
@@ -0,0 +1,110 @@
+/*
+ * prefetchedconnection.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef PS_PREFETCHEDCONNECTION_H
+#define PS_PREFETCHEDCONNECTION_H
+
+#include <csutil/csstring.h>
+#include <csutil/hash.h>
+#include <csutil/scf_implementation.h>
+
+#include <idal.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/**
+ * Result sets fetched in advance by another connection, keyed by the
+ * formatted text of their select.
+ */
+class psPrefetchedResults
+{
+public:
+    virtual ~psPrefetchedResults();
+
+    /// Store the result of a query, the prefetch owns the result set.
+    void Add(const csString &query, iResultSet* result);
+
+    /**
+     * Take the result of a query out of the prefetch.
+     * @return The result set owned by the caller or NULL if the query wasn't prefetched.
+     */
+    iResultSet* Take(const csString &query);
+
+    /// Number of results not taken yet.
+    size_t GetCount() const
+    {
+        return results.GetSize();
+    }
+
+private:
+    csHash<iResultSet*, csString> results;
+};
+
+/**
+ * Database connection answering the selects found in a psPrefetchedResults.
+ *
+ * Everything else, including the selects that weren't prefetched, goes to
+ * the connection it wraps. Code loading from a connection doesn't need to
+ * know about the prefetch, a query missing from it only costs the time of
+ * the query.
+ */
+class psPrefetchedConnection : public scfImplementation1<psPrefetchedConnection, iDataConnection>
+{
+public:
+    psPrefetchedConnection(iDataConnection* connection, psPrefetchedResults* prefetch);
+    virtual ~psPrefetchedConnection();
+
+    virtual int IsValid(void);
+    virtual bool Initialize(const char* host, unsigned int port, const char* database,
+                            const char* user, const char* pwd, LogCSV* logcsv);
+    virtual bool Close();
+    virtual void Escape(csString &to, const char* from);
+    virtual iResultSet* Select(const char* sql,...);
+    virtual int SelectSingleNumber(const char* sql, ...);
+    virtual unsigned long Command(const char* sql,...);
+    virtual unsigned long CommandPump(const char* sql,...);
+    virtual uint64 GenericInsertWithID(const char* table,const char** fieldnames,psStringArray &fieldvalues);
+    virtual bool GenericUpdateWithID(const char* table,const char* idfield,const char* id,const char** fieldnames,psStringArray &fieldvalues);
+    virtual const char* GetLastError(void);
+    virtual const char* GetLastQuery(void);
+    virtual uint64 GetLastInsertID();
+    virtual const char* uint64tostring(uint64 value,csString &recv);
+    virtual const char* DumpProfile();
+    virtual void ResetProfile();
+    virtual csString ExportProfile();
+    virtual iRecord* NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line);
+    virtual iRecord* NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line);
+
+    /// Number of selects answered from the prefetch
+    unsigned int GetHits() const
+    {
+        return hits;
+    }
+
+private:
+    csRef<iDataConnection> connection;
+    psPrefetchedResults* prefetch;
+    unsigned int hits;
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * prefetchedconnection_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/prefetchedconnection.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <stdarg.h>
+
+/// Result set counting how often it is released
+class FakeResultSet : public iResultSet
+{
+public:
+    FakeResultSet(int* released, unsigned long count) : released(released), count(count) {}
+
+    /// The rows are never read by the tests
+    virtual iResultRow& operator[](unsigned long /*whichrow*/)
+    {
+        return *(iResultRow*)NULL;
+    }
+
+    virtual unsigned long Count(void)
+    {
+        return count;
+    }
+
+    virtual void Release(void)
+    {
+        (*released)++;
+        delete this;
+    }
+
+    int* released;
+    unsigned long count;
+};
+
+/// Answers every select with an empty result and remembers the queries
+class FakeDataConnection : public scfImplementation1<FakeDataConnection, iDataConnection>
+{
+public:
+    FakeDataConnection(int* released) : scfImplementationType(this), released(released) {}
+
+    virtual int IsValid(void)
+    {
+        return 1;
+    }
+    virtual bool Initialize(const char*, unsigned int, const char*, const char*, const char*, LogCSV*)
+    {
+        return true;
+    }
+    virtual bool Close()
+    {
+        return true;
+    }
+    virtual void Escape(csString &to, const char* from)
+    {
+        to = from;
+    }
+    virtual iResultSet* Select(const char* sql, ...)
+    {
+        csString query;
+        va_list args;
+        va_start(args, sql);
+        query.FormatV(sql, args);
+        va_end(args);
+        selects.Push(query);
+        return new FakeResultSet(released, 0);
+    }
+    virtual int SelectSingleNumber(const char* sql, ...)
+    {
+        selects.Push(sql);
+        return 0;
+    }
+    virtual unsigned long Command(const char* sql, ...)
+    {
+        csString query;
+        va_list args;
+        va_start(args, sql);
+        query.FormatV(sql, args);
+        va_end(args);
+        commands.Push(query);
+        return 1;
+    }
+    virtual unsigned long CommandPump(const char* sql, ...)
+    {
+        commands.Push(sql);
+        return 1;
+    }
+    virtual uint64 GenericInsertWithID(const char*, const char**, psStringArray &)
+    {
+        return 0;
+    }
+    virtual bool GenericUpdateWithID(const char*, const char*, const char*, const char**, psStringArray &)
+    {
+        return true;
+    }
+    virtual const char* GetLastError(void)
+    {
+        return "";
+    }
+    virtual const char* GetLastQuery(void)
+    {
+        return "";
+    }
+    virtual uint64 GetLastInsertID()
+    {
+        return 0;
+    }
+    virtual const char* uint64tostring(uint64, csString &recv)
+    {
+        return recv;
+    }
+    virtual const char* DumpProfile()
+    {
+        return "";
+    }
+    virtual void ResetProfile()
+    {
+    }
+    virtual csString ExportProfile()
+    {
+        return csString();
+    }
+    virtual iRecord* NewUpdatePreparedStatement(const char*, const char*, unsigned int, const char*, unsigned int)
+    {
+        return NULL;
+    }
+    virtual iRecord* NewInsertPreparedStatement(const char*, unsigned int, const char*, unsigned int)
+    {
+        return NULL;
+    }
+
+    int* released;
+    csArray<csString> selects;
+    csArray<csString> commands;
+};
+
+TEST(PrefetchedConnectionTest, AnswersPrefetchedSelects)
+{
+    int released = 0;
+    csRef<FakeDataConnection> main;
+    main.AttachNew(new FakeDataConnection(&released));
+
+    psPrefetchedResults prefetch;
+    prefetch.Add("SELECT * FROM characters WHERE id=5", new FakeResultSet(&released, 1));
+
+    csRef<psPrefetchedConnection> connection;
+    connection.AttachNew(new psPrefetchedConnection(main, &prefetch));
+
+    // Formatted the same way the prefetch was
+    iResultSet* result = connection->Select("SELECT * FROM characters WHERE id=%u", 5);
+    ASSERT_TRUE(result != NULL);
+    EXPECT_EQ(1u, result->Count());
+    EXPECT_EQ(1u, connection->GetHits());
+    EXPECT_EQ(0u, main->selects.GetSize());
+    EXPECT_EQ(0u, prefetch.GetCount());
+    result->Release();
+    EXPECT_EQ(1, released);
+}
+
+TEST(PrefetchedConnectionTest, ForwardsEverythingElse)
+{
+    int released = 0;
+    csRef<FakeDataConnection> main;
+    main.AttachNew(new FakeDataConnection(&released));
+
+    psPrefetchedResults prefetch;
+    prefetch.Add("SELECT * FROM characters WHERE id=5", new FakeResultSet(&released, 1));
+
+    csRef<psPrefetchedConnection> connection;
+    connection.AttachNew(new psPrefetchedConnection(main, &prefetch));
+
+    iResultSet* result = connection->Select("SELECT * FROM characters WHERE id=%u", 6);
+    ASSERT_TRUE(result != NULL);
+    result->Release();
+    connection->Command("UPDATE characters SET x=1 WHERE id=%u", 5);
+
+    EXPECT_EQ(0u, connection->GetHits());
+    ASSERT_EQ(1u, main->selects.GetSize());
+    EXPECT_STREQ("SELECT * FROM characters WHERE id=6", main->selects[0]);
+    ASSERT_EQ(1u, main->commands.GetSize());
+    EXPECT_STREQ("UPDATE characters SET x=1 WHERE id=5", main->commands[0]);
+
+    // A prefetched select is only answered once, the next one is run
+    result = connection->Select("SELECT * FROM characters WHERE id=%u", 5);
+    result->Release();
+    result = connection->Select("SELECT * FROM characters WHERE id=%u", 5);
+    result->Release();
+    EXPECT_EQ(1u, connection->GetHits());
+    EXPECT_EQ(2u, main->selects.GetSize());
+}
+
+TEST(PrefetchedConnectionTest, ReleasesUnusedResults)
+{
+    int released = 0;
+    {
+        psPrefetchedResults prefetch;
+        prefetch.Add("a", new FakeResultSet(&released, 1));
+        prefetch.Add("b", new FakeResultSet(&released, 1));
+
+        // Fetched twice, the first result is dropped
+        prefetch.Add("b", new FakeResultSet(&released, 2));
+        EXPECT_EQ(1, released);
+        EXPECT_EQ(2u, prefetch.GetCount());
+    }
+    EXPECT_EQ(3, released);
+}
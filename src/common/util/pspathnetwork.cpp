@@ -23,6 +23,9 @@
 //====================================================================================
 #include <iengine/engine.h>
 #include <iengine/sector.h>
+#include <csutil/hash.h>
+
+#include <typeinfo>
 
 //====================================================================================
 // Project Includes
@@ -36,6 +39,7 @@
 #include "engine/psworld.h"
 #include "util/waypoint.h"
 #include "util/consoleout.h"
+#include "util/routesearch.h"
 
 //====================================================================================
 // Local Includes
@@ -477,89 +481,176 @@ psPath *psPathNetwork::FindNearestPoint(const csVector3& v,iSector *sector, floa
     return found;
 }
 
-csList<Waypoint*> psPathNetwork::FindWaypointRoute(Waypoint * start, Waypoint * end, const psPathNetwork::RouteFilter* routeFilter)
+//====================================================================================
+// Route search
+//====================================================================================
+
+namespace
 {
-    csList<Waypoint*> waypoint_list;
-    csList<Waypoint*> priority; // Should have been a priority queue
-    csPDelArray<Waypoint>::Iterator iter(waypoints.GetIterator());
-    Waypoint *wp;
-    
-    // Using Dijkstra's algorithm to find shortest way
 
-    // Initialize
-    while (iter.HasNext())
+/**
+ * The waypoint links as seen by psRouteSearch.
+ *
+ * The heuristic is the straight line distance to the end, it is only used
+ * when the waypoint is in the same sector as the end. Positions in different
+ * sectors can't be compared so the search falls back to Dijkstra there.
+ * A route that takes a shortcut through a warping portal and comes back to
+ * the sector of the end may not be found as the shortest one.
+ */
+class WaypointGraph
+{
+public:
+    WaypointGraph(Waypoint* end, const psPathNetwork::RouteFilter* routeFilter)
+        :end(end),routeFilter(routeFilter)
     {
-        wp = iter.Next();
+    }
 
-        // Filter the waypoints with exception of the start and end point.
-        if ((wp != start) && (wp != end) && routeFilter->Filter(wp))
-        {
-            wp->excluded = true;
-            continue; // No need to think more about this waypoint
-        }
-        else    
+    size_t GetLinkCount(Waypoint* wp) const
+    {
+        return wp->links.GetSize();
+    }
+
+    Waypoint* GetLink(Waypoint* wp, size_t link) const
+    {
+        return wp->links[link];
+    }
+
+    float GetDistance(Waypoint* wp, size_t link) const
+    {
+        return wp->dists[link];
+    }
+
+    bool Filter(Waypoint* wp) const
+    {
+        return routeFilter->Filter(wp);
+    }
+
+    float Estimate(Waypoint* wp) const
+    {
+        if (wp->loc.sectorName != end->loc.sectorName)
         {
-            wp->excluded = false;
+            return 0.0;
         }
+        return (wp->loc.pos - end->loc.pos).Norm();
+    }
 
-        wp->distance = INFINITY_DISTANCE;
-        wp->pi = NULL;
-        
-        // Insert WP into priority queue
-        priority.PushBack(wp);
+private:
+    Waypoint* end;
+    const psPathNetwork::RouteFilter* routeFilter;
+};
+
+}
+
+psPathNetwork::~psPathNetwork()
+{
+    for (size_t i = 0; i < routeSearches.GetSize(); i++)
+    {
+        delete routeSearches[i];
     }
-    start->distance = 0;
+}
 
-    while (!priority.IsEmpty())
+psRouteSearch<Waypoint>* psPathNetwork::GetRouteSearch()
+{
+    CS::Threading::MutexScopedLock lock(routeSearchesMutex);
+    if (routeSearches.IsEmpty())
     {
-        Waypoint *wp_u = NULL;
-        Waypoint *pri_wp = NULL;
+        return new psRouteSearch<Waypoint>();
+    }
+    return routeSearches.Pop();
+}
 
-        // Extract min from priority queue
-        csList<Waypoint*>::Iterator pri(priority);
-        csList<Waypoint*>::Iterator pri_loc;
-        while (pri.HasNext())
-        {
-            pri_wp = pri.Next();
+void psPathNetwork::ReleaseRouteSearch(psRouteSearch<Waypoint>* search)
+{
+    CS::Threading::MutexScopedLock lock(routeSearchesMutex);
+    routeSearches.Push(search);
+}
 
-            if (!wp_u || pri_wp->distance < wp_u->distance)
-            {
-                wp_u = pri_wp;
-                pri_loc = pri;
-            }
-        }
-        priority.Delete(pri_loc);
-        size_t v;
-        for (v = 0; v < wp_u->links.GetSize(); v++)
-        {
-            Waypoint * wp_v = wp_u->links[v];
+csPtr<psRoute> psPathNetwork::SearchRoute(Waypoint * start, Waypoint * end, const psPathNetwork::RouteFilter* routeFilter)
+{
+    csRef<psRoute> route;
+    route.AttachNew(new psRoute());
 
-            // Is the target waypoint excluded, in that case continue on.
-            if (wp_v->excluded)
-            {
-                continue;
-            }
+    if (start == end)
+    {
+        return csPtr<psRoute>(route);
+    }
 
-            // Relax
-            if (wp_v->distance > wp_u->distance + wp_u->dists[v])
-            {
-                wp_v->distance = wp_u->distance + wp_u->dists[v];
-                wp_v->pi = wp_u;
-            }
-        }
-        // if wp == end, we should be done!!!!!!
+    psRouteSearch<Waypoint>* search = GetRouteSearch();
+    size_t n = search->Run(start, end, WaypointGraph(end, routeFilter));
+    if (n == SIZET_NOT_FOUND)
+    {
+        ReleaseRouteSearch(search);
+        return csPtr<psRoute>(route);
     }
 
-    wp = end;
+    // Walk back from the end, each node knows the link it was reached by
+    // so the edges need no lookup.
+    for (; search->GetNode(n).pi != SIZET_NOT_FOUND; n = search->GetNode(n).pi)
+    {
+        const psRouteSearch<Waypoint>::Node& node = search->GetNode(n);
+        route->waypoints.Push(node.item);
+        route->edges.Push(search->GetNode(node.pi).item->edges[node.link]);
+    }
+    route->waypoints.Push(start);
+    ReleaseRouteSearch(search);
 
-    if (end->pi)
+    // Reverse to get the route from start to end
+    size_t count = route->waypoints.GetSize();
+    for (size_t i = 0; i < count / 2; i++)
     {
-        wp = end;
-        while (wp)
-        {
-            waypoint_list.PushFront(wp);
-            wp = wp->pi;
-        }
+        Waypoint* wp = route->waypoints[i];
+        route->waypoints[i] = route->waypoints[count - 1 - i];
+        route->waypoints[count - 1 - i] = wp;
+    }
+    count = route->edges.GetSize();
+    for (size_t i = 0; i < count / 2; i++)
+    {
+        Edge* edge = route->edges[i];
+        route->edges[i] = route->edges[count - 1 - i];
+        route->edges[count - 1 - i] = edge;
+    }
+
+    return csPtr<psRoute>(route);
+}
+
+csPtr<psRoute> psPathNetwork::FindRoute(Waypoint * start, Waypoint * end, const psPathNetwork::RouteFilter* routeFilter)
+{
+    uint32 filterKey;
+    if (!routeFilter->GetCacheKey(filterKey))
+    {
+        routeCache.CountUncached();
+        return SearchRoute(start, end, routeFilter);
+    }
+
+    psRouteKey key(start, end, &typeid(*routeFilter), filterKey);
+
+    csRef<psRoute> route = routeCache.Get(key);
+    if (route.IsValid())
+    {
+        return csPtr<psRoute>(route);
+    }
+
+    uint32 generation = routeCache.GetGeneration();
+    route = SearchRoute(start, end, routeFilter);
+    routeCache.Put(key, route, generation);
+
+    return csPtr<psRoute>(route);
+}
+
+void psPathNetwork::InvalidateRoutes()
+{
+    routeCache.Invalidate();
+}
+
+csList<Waypoint*> psPathNetwork::FindWaypointRoute(Waypoint * start, Waypoint * end, const psPathNetwork::RouteFilter* routeFilter)
+{
+    csList<Waypoint*> waypoint_list;
+
+    csRef<psRoute> route = FindRoute(start, end, routeFilter);
+    const csArray<Waypoint*>& waypoints = route->GetWaypoints();
+    for (size_t i = 0; i < waypoints.GetSize(); i++)
+    {
+        waypoint_list.PushBack(waypoints[i]);
     }
 
     return waypoint_list;
@@ -568,23 +659,16 @@ csList<Waypoint*> psPathNetwork::FindWaypointRoute(Waypoint * start, Waypoint *
 
 csList<Edge*> psPathNetwork::FindEdgeRoute(Waypoint * start, Waypoint * end, const psPathNetwork::RouteFilter* routeFilter)
 {
-    csList<Edge*> edges;
+    csList<Edge*> edge_list;
 
-    csList<Waypoint*> waypoints = FindWaypointRoute(start, end, routeFilter);
-    csList<Waypoint*>::Iterator iter(waypoints);
-    Waypoint* last = NULL;
-    while (iter.HasNext())
+    csRef<psRoute> route = FindRoute(start, end, routeFilter);
+    const csArray<Edge*>& edges = route->GetEdges();
+    for (size_t i = 0; i < edges.GetSize(); i++)
     {
-        Waypoint* wp = iter.Next();
-        if (last)
-        {
-            Edge* edge = FindEdge(last,wp);
-            edges.PushBack(edge);
-        }
-
-        last = wp;
+        edge_list.PushBack(edges[i]);
     }
-    return edges;
+
+    return edge_list;
 }
 
 
@@ -593,17 +677,16 @@ void psPathNetwork::ListWaypoints(const char * pattern)
     csPDelArray<Waypoint>::Iterator iter(waypoints.GetIterator());
     Waypoint *wp;
     CPrintf(CON_CMDOUTPUT, "Waypoints\n");
-    CPrintf(CON_CMDOUTPUT, "%9s %-30s %-45s %-6s %-6s %-30s\n", "WP", "Name", "Position","Radius","Dist","PI");
+    CPrintf(CON_CMDOUTPUT, "%9s %-30s %-45s %-6s\n", "WP", "Name", "Position","Radius");
     while (iter.HasNext())
     {
         wp = iter.Next();
 
         if (!pattern || strstr(wp->GetName(),pattern))
         {
-            CPrintf(CON_CMDOUTPUT, "%9d %-30s %-45s %6.2f %6.1f %-30s" ,
+            CPrintf(CON_CMDOUTPUT, "%9d %-30s %-45s %6.2f" ,
                     wp->loc.id,wp->GetName(),toString(wp->loc.pos,wp->loc.sector).GetDataSafe(),
-                    wp->loc.radius,wp->distance,
-                    (wp->pi?wp->pi->GetName():""));
+                    wp->loc.radius);
 
             for (size_t i = 0; i < wp->links.GetSize(); i++)
             {
@@ -783,6 +866,8 @@ psPath* psPathNetwork::CreatePath(psPath * path)
         path->end->AddLink(path,path->start,psPath::REVERSE,dist); // bi-directional link is implied
     }
 
+    InvalidateRoutes();
+
     return path;
 }
 
@@ -824,6 +909,9 @@ bool psPathNetwork::Delete(psPath * path)
 
     delete path;
 
+    // The links are gone and the waypoints below may be deleted as well
+    InvalidateRoutes();
+
     // Now delete any waypoints that dosn't have any links anymore.
     if (start->links.GetSize() == 0)
     {
@@ -21,16 +21,19 @@
 
 #include <csutil/array.h>
 #include <csutil/list.h>
+#include <csutil/threading/mutex.h>
 
 #include <idal.h>
 
 #include "util/pspath.h"
+#include "util/psroutecache.h"
 
 class Edge;
 class Waypoint;
 class WaypointAlias;
 class psPath;
 class psWorld;
+template<class T> class psRouteSearch;
 
 /**
  * \addtogroup common_util
@@ -53,6 +56,16 @@ public:
         * Called to check if a waypoint should be filters.
         */
         virtual bool Filter(const Waypoint* wp) const = 0;
+
+       /**
+        * Get the parameters of this filter for the route cache.
+        *
+        * Two filters of the same class returning the same key must filter
+        * the same waypoints.
+        *
+        * @return false if the routes found with this filter can't be cached.
+        */
+        virtual bool GetCacheKey(uint32& /*key*/) const { return false; }
     };
 
 
@@ -66,7 +79,8 @@ public:
     csWeakRef<iDataConnection> db;
     psWorld * world;
     
-    
+    ~psPathNetwork();
+
     /**
      * Load all waypoins and paths from db
      */
@@ -203,14 +217,46 @@ public:
     
     /**
      * Find the shortest route between waypoint start and stop.
+     *
+     * Uses an A* search that keeps its state outside the waypoints, so
+     * several routes can be searched at the same time from different
+     * threads as long as the network isn't changed meanwhile.
+     *
+     * @return The waypoints of the route including start and end, empty
+     *         if there is no route or start and end are the same.
      */
     csList<Waypoint*> FindWaypointRoute(Waypoint * start, Waypoint * end, const RouteFilter* routeFilter);
 
     /**
      * Find the shortest route between waypoint start and stop.
+     *
+     * Same search as FindWaypointRoute() returning the edges taken.
      */
     csList<Edge*> FindEdgeRoute(Waypoint * start, Waypoint * end, const RouteFilter* routeFilter);
 
+    /**
+     * Find the shortest route between waypoint start and stop.
+     *
+     * Routes are kept in a cache shared by everyone asking for the same
+     * route with the same kind of filter, the returned route must not be
+     * changed.
+     *
+     * @return The route, empty if there is no route or start and end are the same.
+     */
+    csPtr<psRoute> FindRoute(Waypoint * start, Waypoint * end, const RouteFilter* routeFilter);
+
+    /**
+     * Drop all the cached routes.
+     *
+     * Called whenever links or flags in the network are changed.
+     */
+    void InvalidateRoutes();
+
+    /**
+     * Get the cache of the routes found in this network.
+     */
+    psRouteCache& GetRouteCache() { return routeCache; }
+
     /**
      * Get a list of points in a sector
      */
@@ -282,6 +328,26 @@ public:
      * Delete the given path from the db.
      */
     bool Delete(psPath * path);
+
+private:
+    /**
+     * Search a route without looking in the cache.
+     */
+    csPtr<psRoute> SearchRoute(Waypoint * start, Waypoint * end, const RouteFilter* routeFilter);
+
+    /**
+     * Take an idle search from the pool, or make a new one. Its storage
+     * is reused from one query to the next.
+     */
+    psRouteSearch<Waypoint>* GetRouteSearch();
+
+    /// Give a search back to the pool.
+    void ReleaseRouteSearch(psRouteSearch<Waypoint>* search);
+
+    psRouteCache routeCache;
+
+    csArray<psRouteSearch<Waypoint>*> routeSearches;   ///< Idle searches, one is made per concurrent query
+    CS::Threading::Mutex routeSearchesMutex;
 };
 
 /** @} */
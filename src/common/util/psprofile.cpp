@@ -21,10 +21,12 @@
 #include <csutil/sysfunc.h>
 #include "psprofile.h"
 #include <math.h>
+#include <string.h>
 
 void psStopWatch::Start()
 {
     start = csGetTicks();
+    startMicro = csGetMicroTicks();
 }
 
 unsigned psStopWatch::Stop()
@@ -32,6 +34,86 @@ unsigned psStopWatch::Stop()
     return csGetTicks() - start;
 }
 
+csMicroTicks psStopWatch::StopMicro()
+{
+    return csGetMicroTicks() - startMicro;
+}
+
+/***************************************************************
+*
+*                   psLatencyHistogram
+*
+****************************************************************/
+
+psLatencyHistogram::psLatencyHistogram()
+{
+    Reset();
+}
+
+size_t psLatencyHistogram::GetBucket(uint32 value)
+{
+    if (value < PSHISTOGRAM_SUBS)
+        return value;
+
+    // Highest bit set
+    int bit = 0;
+    for (int shift = 16; shift; shift >>= 1)
+    {
+        if (value >> (bit + shift))
+            bit += shift;
+    }
+
+    int below = bit - PSHISTOGRAM_SUB_BITS;
+    return (below + 1) * PSHISTOGRAM_SUBS + ((value >> below) & (PSHISTOGRAM_SUBS - 1));
+}
+
+uint32 psLatencyHistogram::GetBucketMax(size_t bucket)
+{
+    if (bucket < PSHISTOGRAM_SUBS)
+        return (uint32)bucket;
+
+    int below = (int)(bucket / PSHISTOGRAM_SUBS) - 1;
+    uint32 low = (uint32)(PSHISTOGRAM_SUBS + bucket % PSHISTOGRAM_SUBS) << below;
+    return low + ((1u << below) - 1);
+}
+
+void psLatencyHistogram::Add(uint32 value)
+{
+    buckets[GetBucket(value)]++;
+    count++;
+    if (value > max)
+        max = value;
+}
+
+void psLatencyHistogram::Reset()
+{
+    memset(buckets, 0, sizeof(buckets));
+    count = 0;
+    max = 0;
+}
+
+uint32 psLatencyHistogram::GetPercentile(double fraction) const
+{
+    if (!count)
+        return 0;
+
+    uint32 rank = (uint32)ceil(fraction * count);
+    if (rank < 1)
+        rank = 1;
+
+    uint32 seen = 0;
+    for (size_t i = 0; i < PSHISTOGRAM_BUCKETS; i++)
+    {
+        seen += buckets[i];
+        if (seen >= rank)
+        {
+            uint32 value = GetBucketMax(i);
+            return value < max ? value : max;
+        }
+    }
+    return max;
+}
+
 /***************************************************************
 *
 *                   psOperProfile
@@ -50,6 +132,7 @@ void psOperProfile::AddConsumption(double cons)
     consumption += cons;
     if (cons > maxCons)
         maxCons = cons;
+    histogram.Add(cons < 4294967295.0 ? (uint32)cons : 0xFFFFFFFF);
 }
 
 csString psOperProfile::Dump(double totalConsumption, const csString & unitName)
@@ -57,18 +140,48 @@ csString psOperProfile::Dump(double totalConsumption, const csString & unitName)
     double perc = consumption/totalConsumption*100;
     if (perc > 0)
         return csString().Format(
-                "count=%-5u perc=%.1lf %s=%-2i avg-%s=%.3f max=%.3f Name=%s\n",
+                "count=%-5u perc=%.1lf %s=%-2i avg-%s=%.3f max=%.3f p50=%u p99=%u p999=%u Name=%s\n",
                 unsigned(count), perc, unitName.GetData(), int(consumption),
-                unitName.GetData(), consumption/count, maxCons, desc.GetData());
+                unitName.GetData(), consumption/count, maxCons,
+                histogram.GetPercentile(0.5), histogram.GetPercentile(0.99),
+                histogram.GetPercentile(0.999), desc.GetData());
     else
         return "";
 }
 
+csString psOperProfile::Export(const char * metric)
+{
+    if (count == 0)
+        return "";
+
+    // The name may be an SQL statement, escape it as a label value
+    csString name;
+    for (const char * c = desc.GetData(); *c; c++)
+    {
+        if (*c == '"' || *c == '\\')
+            name.Append('\\');
+        if (*c == '\n')
+            name.Append("\\n");
+        else
+            name.Append(*c);
+    }
+
+    csString result;
+    result.AppendFmt("%s_count{name=\"%s\"} %.0f\n", metric, name.GetData(), count);
+    result.AppendFmt("%s_sum{name=\"%s\"} %.0f\n", metric, name.GetData(), consumption);
+    result.AppendFmt("%s_max{name=\"%s\"} %.0f\n", metric, name.GetData(), maxCons);
+    result.AppendFmt("%s{name=\"%s\",quantile=\"0.5\"} %u\n", metric, name.GetData(), histogram.GetPercentile(0.5));
+    result.AppendFmt("%s{name=\"%s\",quantile=\"0.99\"} %u\n", metric, name.GetData(), histogram.GetPercentile(0.99));
+    result.AppendFmt("%s{name=\"%s\",quantile=\"0.999\"} %u\n", metric, name.GetData(), histogram.GetPercentile(0.999));
+    return result;
+}
+
 void psOperProfile::Reset()
 {
     count       = 0;
     consumption = 0;
     maxCons  =  0;
+    histogram.Reset();
 }
 
 double psOperProfile::GetConsumption()
@@ -125,6 +238,14 @@ void psOperProfileSet::Dump(const csStringFast<50> & unitName, csStringFast<50>
     delete [] sortedProfs;
 }
 
+csString psOperProfileSet::Export(const char * metric)
+{
+    csString result;
+    for (size_t i=0; i < profs.GetSize(); i++)
+        result += profs[i]->Export(metric);
+    return result;
+}
+
 void psOperProfileSet::Reset()
 {
     profStart = csGetTicks();
@@ -44,6 +44,50 @@
 * for most purposes.
 *****************************************************************************************/
 
+/// Buckets per power of two of a psLatencyHistogram, as a power of two
+#define PSHISTOGRAM_SUB_BITS 3
+#define PSHISTOGRAM_SUBS (1 << PSHISTOGRAM_SUB_BITS)
+/// Buckets covering the values from 0 to 2^32-1
+#define PSHISTOGRAM_BUCKETS ((32 - PSHISTOGRAM_SUB_BITS + 1) * PSHISTOGRAM_SUBS)
+
+/**
+ * Distribution of the values of an operation, like the time it took.
+ *
+ * The values below PSHISTOGRAM_SUBS have a bucket each, above each power of
+ * two is split in PSHISTOGRAM_SUBS buckets. Adding a value only finds its
+ * highest bit, the percentiles are within 1/PSHISTOGRAM_SUBS of the value.
+ */
+class psLatencyHistogram
+{
+public:
+    psLatencyHistogram();
+
+    void Add(uint32 value);
+
+    void Reset();
+
+    /** Return the value 'fraction' of the values are lower or equal to,
+      * e.g. 0.99 for the 99th percentile, 0 if there are no values */
+    uint32 GetPercentile(double fraction) const;
+
+    uint32 GetCount() const { return count; }
+    uint32 GetMax() const { return max; }
+
+    /** Return the number of values in a bucket */
+    uint32 GetBucketCount(size_t bucket) const { return buckets[bucket]; }
+
+    /** Return the bucket of a value */
+    static size_t GetBucket(uint32 value);
+
+    /** Return the highest value in a bucket */
+    static uint32 GetBucketMax(size_t bucket);
+
+protected:
+    uint32 buckets[PSHISTOGRAM_BUCKETS];
+    uint32 count;
+    uint32 max;
+};
+
 /**  Statistics for one operation */
 class psOperProfile
 {
@@ -60,6 +104,10 @@ public:
       * where 'totalConsumption' is total consumption of resources by all kinds of operations 
       * and   'unitName' contains name of consumption unit (e.g. "millisecond") */
     csString Dump(double totalConsumption, const csString & unitName);
+
+    /** Return the statistics as lines of the metrics export, like
+      * "metric_count{name="desc"} 12", see psOperProfileSet::Export() */
+    csString Export(const char * metric);
     
     double GetConsumption();
     
@@ -72,6 +120,7 @@ protected:
     double consumption ;   /// total resource consumption by this kind of operation
     double maxCons; // the maximum resource consumption per operation 
                     //     that we witnessed
+    psLatencyHistogram histogram; /// distribution of the consumption per operation
 };
 
 /**  Statistics for all kinds of operations 
@@ -87,6 +136,15 @@ public:
     /** Builds textual description of all profilling statistics and returns it in two 
       * separate parts */
     void Dump(const csStringFast<50> & unitName, csStringFast<50> & header, csStringFast<50> & list);
+
+    /** Builds the statistics of all operations as text to be pulled by a
+      * metrics collector, one value per line:
+      *   metric_count{name="operation"} 12
+      *   metric_sum{name="operation"} 340
+      *   metric_max{name="operation"} 95
+      *   metric{name="operation",quantile="0.99"} 88
+      * 'metric' names the consumption with its unit, e.g. "ps_db_query_usec" */
+    csString Export(const char * metric);
     
     void Reset();
     
@@ -130,8 +188,11 @@ public:
     void Start();
     /** Measure the time interval from marked start (in msec) */
     csTicks Stop();
+    /** Measure the time interval from marked start (in usec) */
+    csMicroTicks StopMicro();
 protected:
     csTicks start;
+    csMicroTicks startMicro;
 };
 
 /** @} */
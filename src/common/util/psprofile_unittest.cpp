@@ -0,0 +1,139 @@
+/*
+ * psprofile_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/psprofile.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+TEST(LatencyHistogramTest, Buckets)
+{
+    // Each bucket starts right after the previous one ends
+    EXPECT_EQ(psLatencyHistogram::GetBucketMax(0), (uint32)0);
+    for (size_t i = 1; i < PSHISTOGRAM_BUCKETS; i++)
+    {
+        uint32 low = psLatencyHistogram::GetBucketMax(i - 1) + 1;
+        uint32 high = psLatencyHistogram::GetBucketMax(i);
+        ASSERT_LE(low, high);
+        EXPECT_EQ(psLatencyHistogram::GetBucket(low), i);
+        EXPECT_EQ(psLatencyHistogram::GetBucket(high), i);
+    }
+    EXPECT_EQ(psLatencyHistogram::GetBucketMax(PSHISTOGRAM_BUCKETS - 1), (uint32)0xFFFFFFFF);
+}
+
+TEST(LatencyHistogramTest, Percentiles)
+{
+    psLatencyHistogram histogram;
+    EXPECT_EQ(histogram.GetPercentile(0.99), (uint32)0);
+
+    std::vector<uint32> values;
+    srand(1);
+    for (int i = 0; i < 100000; i++)
+    {
+        // Mostly short, with a long tail as the handlers have
+        uint32 value = (rand() % 100 == 0) ? 1000 + rand() % 100000 : rand() % 500;
+        values.push_back(value);
+        histogram.Add(value);
+    }
+    std::sort(values.begin(), values.end());
+
+    EXPECT_EQ(histogram.GetCount(), (uint32)values.size());
+    EXPECT_EQ(histogram.GetMax(), values.back());
+
+    const double fractions[] = { 0.5, 0.9, 0.99, 0.999 };
+    for (size_t i = 0; i < sizeof(fractions) / sizeof(fractions[0]); i++)
+    {
+        uint32 exact = values[(size_t)(fractions[i] * values.size()) - 1];
+        uint32 estimate = histogram.GetPercentile(fractions[i]);
+        EXPECT_GE(estimate, exact);
+        EXPECT_LE(estimate, exact + exact / PSHISTOGRAM_SUBS + 1);
+    }
+
+    histogram.Reset();
+    EXPECT_EQ(histogram.GetCount(), (uint32)0);
+    EXPECT_EQ(histogram.GetPercentile(0.5), (uint32)0);
+}
+
+/**
+ * Known latencies: the bucket each one lands in, the percentiles and the
+ * lines of the metrics export.
+ */
+TEST(LatencyHistogramTest, KnownLatencies)
+{
+    const uint32 latencies[] = { 0, 3, 3, 7, 8, 15, 16, 17, 100, 100, 1000 };
+    const size_t count = sizeof(latencies) / sizeof(latencies[0]);
+
+    psLatencyHistogram histogram;
+    psNamedProfiles profiles;
+    for (size_t i = 0; i < count; i++)
+    {
+        histogram.Add(latencies[i]);
+        profiles.AddCons("SELECT \"name\"\nFROM items", latencies[i]);
+    }
+    profiles.AddCons("COMMIT", 42);
+
+    // Up to 15 a bucket per value, from 16 up to 31 two values a bucket,
+    // from 64 up to 127 eight and from 512 up to 1023 sixty-four
+    uint32 expected[PSHISTOGRAM_BUCKETS] = { 0 };
+    expected[0] = 1;
+    expected[3] = 2;
+    expected[7] = 1;
+    expected[8] = 1;
+    expected[15] = 1;
+    expected[16] = 2;       // 16 and 17
+    expected[36] = 2;       // 96 to 103
+    expected[63] = 1;       // 960 to 1023
+    for (size_t i = 0; i < PSHISTOGRAM_BUCKETS; i++)
+    {
+        EXPECT_EQ(histogram.GetBucketCount(i), expected[i]) << "bucket " << i;
+    }
+    EXPECT_EQ(psLatencyHistogram::GetBucketMax(36), (uint32)103);
+    EXPECT_EQ(psLatencyHistogram::GetBucketMax(63), (uint32)1023);
+
+    EXPECT_EQ(histogram.GetCount(), (uint32)count);
+    EXPECT_EQ(histogram.GetMax(), (uint32)1000);
+    EXPECT_EQ(histogram.GetPercentile(0.5), (uint32)15);
+    EXPECT_EQ(histogram.GetPercentile(0.9), (uint32)103);
+    EXPECT_EQ(histogram.GetPercentile(0.99), (uint32)1000);     // Not above the max
+
+    // Sum 1269, the name escaped as a label value
+    EXPECT_STREQ(profiles.Export("ps_db_query_msec").GetData(),
+                 "ps_db_query_msec_count{name=\"SELECT \\\"name\\\"\\nFROM items\"} 11\n"
+                 "ps_db_query_msec_sum{name=\"SELECT \\\"name\\\"\\nFROM items\"} 1269\n"
+                 "ps_db_query_msec_max{name=\"SELECT \\\"name\\\"\\nFROM items\"} 1000\n"
+                 "ps_db_query_msec{name=\"SELECT \\\"name\\\"\\nFROM items\",quantile=\"0.5\"} 15\n"
+                 "ps_db_query_msec{name=\"SELECT \\\"name\\\"\\nFROM items\",quantile=\"0.99\"} 1000\n"
+                 "ps_db_query_msec{name=\"SELECT \\\"name\\\"\\nFROM items\",quantile=\"0.999\"} 1000\n"
+                 "ps_db_query_msec_count{name=\"COMMIT\"} 1\n"
+                 "ps_db_query_msec_sum{name=\"COMMIT\"} 42\n"
+                 "ps_db_query_msec_max{name=\"COMMIT\"} 42\n"
+                 "ps_db_query_msec{name=\"COMMIT\",quantile=\"0.5\"} 42\n"
+                 "ps_db_query_msec{name=\"COMMIT\",quantile=\"0.99\"} 42\n"
+                 "ps_db_query_msec{name=\"COMMIT\",quantile=\"0.999\"} 42\n");
+}
@@ -0,0 +1,164 @@
+/*
+ * psroutecache.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#include <psconfig.h>
+
+#include <string.h>
+
+#include "util/psroutecache.h"
+
+psRouteCache::psRouteCache(size_t capacity)
+    :first(NULL),last(NULL),capacity(capacity),generation(0)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+psRouteCache::~psRouteCache()
+{
+    Trim(0);
+}
+
+void psRouteCache::SetCapacity(size_t capacity)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    this->capacity = capacity;
+    Trim(capacity);
+}
+
+csPtr<psRoute> psRouteCache::Get(const psRouteKey& key)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    Entry* entry = entries.Get(key, NULL);
+    if (!entry)
+    {
+        return csPtr<psRoute>(NULL);
+    }
+
+    stats.hits++;
+
+    Unlink(entry);
+    LinkFirst(entry);
+
+    csRef<psRoute> route = entry->route;
+    return csPtr<psRoute>(route);
+}
+
+void psRouteCache::Put(const psRouteKey& key, psRoute* route, uint32 searchGeneration)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    stats.misses++;
+
+    // The network was edited while the route was searched
+    if (searchGeneration != generation || capacity == 0)
+    {
+        return;
+    }
+
+    // Another thread may have searched the same route meanwhile
+    Entry* entry = entries.Get(key, NULL);
+    if (entry)
+    {
+        entry->route = route;
+        Unlink(entry);
+        LinkFirst(entry);
+        return;
+    }
+
+    Trim(capacity - 1);
+
+    entry = new Entry(key, route);
+    entries.Put(key, entry);
+    LinkFirst(entry);
+}
+
+void psRouteCache::CountUncached()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    stats.uncached++;
+}
+
+void psRouteCache::Invalidate()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    generation++;
+    stats.invalidations++;
+
+    while (first)
+    {
+        Entry* entry = first;
+        Unlink(entry);
+        delete entry;
+    }
+    entries.DeleteAll();
+}
+
+uint32 psRouteCache::GetGeneration()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    return generation;
+}
+
+void psRouteCache::GetStats(Stats& stats)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    stats = this->stats;
+    stats.entries = entries.GetSize();
+    stats.capacity = capacity;
+}
+
+void psRouteCache::Unlink(Entry* entry)
+{
+    if (entry->prev)
+        entry->prev->next = entry->next;
+    else
+        first = entry->next;
+
+    if (entry->next)
+        entry->next->prev = entry->prev;
+    else
+        last = entry->prev;
+
+    entry->prev = entry->next = NULL;
+}
+
+void psRouteCache::LinkFirst(Entry* entry)
+{
+    entry->prev = NULL;
+    entry->next = first;
+    if (first)
+        first->prev = entry;
+    else
+        last = entry;
+    first = entry;
+}
+
+void psRouteCache::Trim(size_t size)
+{
+    while (last && entries.GetSize() > size)
+    {
+        Entry* entry = last;
+        Unlink(entry);
+        entries.Delete(entry->key, entry);
+        delete entry;
+        stats.evictions++;
+    }
+}
@@ -0,0 +1,197 @@
+/*
+ * psroutecache.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __PSROUTECACHE_H__
+#define __PSROUTECACHE_H__
+
+#include <csutil/array.h>
+#include <csutil/hash.h>
+#include <csutil/threading/mutex.h>
+
+#include "net/message.h"   // For csSyncRefCount
+
+class Waypoint;
+class Edge;
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/**
+ * A route found in the path network.
+ *
+ * Routes are shared between all the NPCs asking for the same route and
+ * are never changed once found.
+ */
+class psRoute : public csSyncRefCount
+{
+public:
+    /// The waypoints of the route, including the start and the end.
+    const csArray<Waypoint*>& GetWaypoints() const
+    {
+        return waypoints;
+    }
+
+    /// The edges between the waypoints of the route.
+    const csArray<Edge*>& GetEdges() const
+    {
+        return edges;
+    }
+
+    bool IsEmpty() const
+    {
+        return waypoints.IsEmpty();
+    }
+
+protected:
+    friend class psPathNetwork;
+
+    csArray<Waypoint*> waypoints;
+    csArray<Edge*>     edges;
+};
+
+/**
+ * Key of a cached route.
+ *
+ * The filter is identified by its class and the parameters returned by
+ * psPathNetwork::RouteFilter::GetCacheKey().
+ */
+class psRouteKey
+{
+public:
+    psRouteKey(const Waypoint* start, const Waypoint* end, const void* filterClass, uint32 filterKey)
+        :start(start),end(end),filterClass(filterClass),filterKey(filterKey),padding(0)
+    {
+    }
+
+    bool operator<(const psRouteKey& other) const
+    {
+        if (start != other.start)
+            return start < other.start;
+        if (end != other.end)
+            return end < other.end;
+        if (filterClass != other.filterClass)
+            return filterClass < other.filterClass;
+        return filterKey < other.filterKey;
+    }
+
+private:
+    const Waypoint* start;
+    const Waypoint* end;
+    const void*     filterClass;
+    uint32          filterKey;
+    uint32          padding;     ///< Hashed with the rest of the key, keep it 0
+};
+
+template<> class csHashComputer<psRouteKey> : public csHashComputerStruct<psRouteKey>
+{
+};
+
+/**
+ * Least recently used cache of the routes found in a path network.
+ *
+ * All the routes are dropped when the network is edited. A new link or
+ * a changed flag can make a shorter route available between any two
+ * waypoints, so there is no way to tell which routes are still valid.
+ *
+ * The cache is safe to use from several threads.
+ */
+class psRouteCache
+{
+public:
+    /// Counters since the cache was created
+    struct Stats
+    {
+        uint64 hits;            ///< Routes served from the cache
+        uint64 misses;          ///< Routes searched and added to the cache
+        uint64 uncached;        ///< Routes searched with a filter that can't be cached
+        uint64 evictions;       ///< Routes dropped to make room
+        uint64 invalidations;   ///< Number of times the cache was cleared by an edit
+        size_t entries;         ///< Routes in the cache now
+        size_t capacity;        ///< Maximum number of routes
+    };
+
+    psRouteCache(size_t capacity = 1024);
+    ~psRouteCache();
+
+    /**
+     * Set the maximum number of routes kept, 0 disables the cache.
+     */
+    void SetCapacity(size_t capacity);
+
+    /**
+     * Find a cached route and mark it as the most recently used one.
+     *
+     * @return The route or NULL if it is not in the cache.
+     */
+    csPtr<psRoute> Get(const psRouteKey& key);
+
+    /**
+     * Add a route to the cache.
+     *
+     * @param generation The value of GetGeneration() taken before the route
+     *                   was searched. The route is dropped if the network was
+     *                   edited meanwhile.
+     */
+    void Put(const psRouteKey& key, psRoute* route, uint32 generation);
+
+    /// Count a route that was searched without using the cache.
+    void CountUncached();
+
+    /// Drop all the routes, called whenever the network is edited.
+    void Invalidate();
+
+    /// Get the number of times the cache was invalidated.
+    uint32 GetGeneration();
+
+    void GetStats(Stats& stats);
+
+private:
+    /// A cached route, linked in the order of use
+    struct Entry
+    {
+        psRouteKey      key;
+        csRef<psRoute>  route;
+        Entry*          prev;
+        Entry*          next;
+
+        Entry(const psRouteKey& key, psRoute* route)
+            :key(key),route(route),prev(NULL),next(NULL)
+        {
+        }
+    };
+
+    void Unlink(Entry* entry);
+    void LinkFirst(Entry* entry);
+    void Trim(size_t size);
+
+    CS::Threading::Mutex mutex;
+
+    csHash<Entry*, psRouteKey> entries;
+    Entry*  first;              ///< Most recently used
+    Entry*  last;               ///< Least recently used, evicted first
+    size_t  capacity;
+    uint32  generation;
+
+    Stats   stats;
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,121 @@
+/*
+ * psroutecache_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/psroutecache.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+
+// Only the addresses are used as keys
+static char waypoints[4];
+static char filterClass;
+
+static psRouteKey Key(int start, int end, uint32 filterKey = 0)
+{
+    return psRouteKey((const Waypoint*) &waypoints[start], (const Waypoint*) &waypoints[end],
+                      &filterClass, filterKey);
+}
+
+static csRef<psRoute> NewRoute()
+{
+    csRef<psRoute> route;
+    route.AttachNew(new psRoute());
+    return route;
+}
+
+TEST(RouteCacheTest, HitAndMiss)
+{
+    psRouteCache cache(10);
+    csRef<psRoute> route = NewRoute();
+
+    csRef<psRoute> found = cache.Get(Key(0, 1));
+    EXPECT_FALSE(found.IsValid());
+
+    cache.Put(Key(0, 1), route, cache.GetGeneration());
+    found = cache.Get(Key(0, 1));
+    EXPECT_EQ(found, route);
+
+    // Other end or other filter parameters are different routes
+    found = cache.Get(Key(1, 0));
+    EXPECT_FALSE(found.IsValid());
+    found = cache.Get(Key(0, 1, 7));
+    EXPECT_FALSE(found.IsValid());
+
+    psRouteCache::Stats stats;
+    cache.GetStats(stats);
+    EXPECT_EQ(stats.hits, (uint64)1);
+    EXPECT_EQ(stats.misses, (uint64)1);
+    EXPECT_EQ(stats.entries, (size_t)1);
+}
+
+TEST(RouteCacheTest, EvictsLeastRecentlyUsed)
+{
+    psRouteCache cache(2);
+
+    cache.Put(Key(0, 1), NewRoute(), cache.GetGeneration());
+    cache.Put(Key(0, 2), NewRoute(), cache.GetGeneration());
+
+    // Use the first route so the second is the oldest
+    csRef<psRoute> found = cache.Get(Key(0, 1));
+    EXPECT_TRUE(found.IsValid());
+
+    cache.Put(Key(0, 3), NewRoute(), cache.GetGeneration());
+
+    found = cache.Get(Key(0, 1));
+    EXPECT_TRUE(found.IsValid());
+    found = cache.Get(Key(0, 2));
+    EXPECT_FALSE(found.IsValid());
+    found = cache.Get(Key(0, 3));
+    EXPECT_TRUE(found.IsValid());
+
+    psRouteCache::Stats stats;
+    cache.GetStats(stats);
+    EXPECT_EQ(stats.evictions, (uint64)1);
+    EXPECT_EQ(stats.entries, (size_t)2);
+}
+
+TEST(RouteCacheTest, Invalidate)
+{
+    psRouteCache cache(10);
+
+    cache.Put(Key(0, 1), NewRoute(), cache.GetGeneration());
+    cache.Invalidate();
+
+    csRef<psRoute> found = cache.Get(Key(0, 1));
+    EXPECT_FALSE(found.IsValid());
+
+    // A route searched before an edit is not added
+    uint32 generation = cache.GetGeneration();
+    cache.Invalidate();
+    cache.Put(Key(0, 2), NewRoute(), generation);
+    found = cache.Get(Key(0, 2));
+    EXPECT_FALSE(found.IsValid());
+
+    psRouteCache::Stats stats;
+    cache.GetStats(stats);
+    EXPECT_EQ(stats.invalidations, (uint64)2);
+    EXPECT_EQ(stats.entries, (size_t)0);
+}
@@ -0,0 +1,251 @@
+/*
+ * routesearch.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __ROUTESEARCH_H__
+#define __ROUTESEARCH_H__
+
+#include <csutil/array.h>
+#include <csutil/hash.h>
+
+#include "util/psconst.h"
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/**
+ * A* search over an indexed binary min heap.
+ *
+ * The graph is given to Run() as a class with these members:
+ *  - size_t GetLinkCount(T* item) const
+ *  - T* GetLink(T* item, size_t link) const
+ *  - float GetDistance(T* item, size_t link) const
+ *  - bool Filter(T* item) const, true to leave the item out of routes
+ *  - float Estimate(T* item) const, never more than the distance left to the end
+ *
+ * The items are only read, all the state of a search is kept here. One
+ * search object is used by one query at a time. Its nodes, heap and index
+ * are kept between the queries so a query only allocates when it reaches
+ * more items than any before it.
+ *
+ * The index is not emptied between queries. An entry left by an earlier
+ * query is recognised as its node doesn't hold the item, so the pointers
+ * of items since deleted are never followed.
+ */
+template<class T>
+class psRouteSearch
+{
+public:
+    /// Search state of one item reached by the query
+    struct Node
+    {
+        T*     item;
+        float  g;           ///< Shortest distance found so far from the start
+        float  h;           ///< Estimated distance to the end
+        float  f;           ///< g + h, the key of the open heap
+        size_t pi;          ///< Predecessor node, SIZET_NOT_FOUND for the start
+        size_t link;        ///< Link of the predecessor that leads to this node
+        size_t heapIndex;   ///< Position in the open heap, SIZET_NOT_FOUND if not queued
+        bool   excluded;    ///< Removed by the filter
+    };
+
+    /**
+     * Search the shortest route from start to end. Start and end are never
+     * filtered.
+     *
+     * @return The node of end, walk back along Node::pi to get the route,
+     *         or SIZET_NOT_FOUND if end can't be reached.
+     */
+    template<class Graph>
+    size_t Run(T* start, T* end, const Graph& graph)
+    {
+        nodes.SetSize(0);
+        heap.SetSize(0);
+
+        size_t s = GetNode(start, start, end, graph);
+        nodes[s].g = 0.0f;
+        nodes[s].f = nodes[s].h;
+        Push(s);
+
+        while (heap.GetSize())
+        {
+            size_t u = Pop();
+            T* item = nodes[u].item;
+
+            if (item == end)
+            {
+                return u;
+            }
+
+            size_t count = graph.GetLinkCount(item);
+            for (size_t v = 0; v < count; v++)
+            {
+                size_t n = GetNode(graph.GetLink(item, v), start, end, graph);
+                if (nodes[n].excluded)
+                {
+                    continue;
+                }
+
+                // Relax
+                float g = nodes[u].g + graph.GetDistance(item, v);
+                if (g < nodes[n].g)
+                {
+                    nodes[n].g = g;
+                    nodes[n].f = g + nodes[n].h;
+                    nodes[n].pi = u;
+                    nodes[n].link = v;
+
+                    if (nodes[n].heapIndex == SIZET_NOT_FOUND)
+                    {
+                        Push(n);
+                    }
+                    else
+                    {
+                        SiftUp(nodes[n].heapIndex);
+                    }
+                }
+            }
+        }
+
+        return SIZET_NOT_FOUND;
+    }
+
+    /// Get a node of the last query.
+    const Node& GetNode(size_t n) const
+    {
+        return nodes[n];
+    }
+
+    /// Get the number of items the last query reached.
+    size_t GetNodeCount() const
+    {
+        return nodes.GetSize();
+    }
+
+private:
+    /// Get the node of an item, the node is created on the first visit.
+    template<class Graph>
+    size_t GetNode(T* item, T* start, T* end, const Graph& graph)
+    {
+        size_t* known = index.GetElementPointer(item);
+        if (known && *known < nodes.GetSize() && nodes[*known].item == item)
+        {
+            return *known;
+        }
+
+        Node node;
+        node.item = item;
+        node.pi = SIZET_NOT_FOUND;
+        node.link = SIZET_NOT_FOUND;
+        node.heapIndex = SIZET_NOT_FOUND;
+        node.excluded = (item != start) && (item != end) && graph.Filter(item);
+        node.g = INFINITY_DISTANCE;
+        node.h = node.excluded ? 0.0f : graph.Estimate(item);
+        node.f = INFINITY_DISTANCE;
+
+        size_t n = nodes.Push(node);
+        if (known)
+        {
+            *known = n;
+        }
+        else
+        {
+            index.Put(item, n);
+        }
+        return n;
+    }
+
+    bool Less(size_t a, size_t b) const
+    {
+        return nodes[a].f < nodes[b].f;
+    }
+
+    void Push(size_t n)
+    {
+        nodes[n].heapIndex = heap.Push(n);
+        SiftUp(nodes[n].heapIndex);
+    }
+
+    size_t Pop()
+    {
+        size_t top = heap[0];
+        size_t last = heap.Pop();
+        nodes[top].heapIndex = SIZET_NOT_FOUND;
+        if (heap.GetSize())
+        {
+            heap[0] = last;
+            nodes[last].heapIndex = 0;
+            SiftDown(0);
+        }
+        return top;
+    }
+
+    void SiftUp(size_t i)
+    {
+        size_t n = heap[i];
+        while (i > 0)
+        {
+            size_t parent = (i - 1) / 2;
+            if (!Less(n, heap[parent]))
+            {
+                break;
+            }
+            heap[i] = heap[parent];
+            nodes[heap[i]].heapIndex = i;
+            i = parent;
+        }
+        heap[i] = n;
+        nodes[n].heapIndex = i;
+    }
+
+    void SiftDown(size_t i)
+    {
+        size_t n = heap[i];
+        size_t size = heap.GetSize();
+        while (true)
+        {
+            size_t child = 2 * i + 1;
+            if (child >= size)
+            {
+                break;
+            }
+            if (child + 1 < size && Less(heap[child + 1], heap[child]))
+            {
+                child++;
+            }
+            if (!Less(heap[child], n))
+            {
+                break;
+            }
+            heap[i] = heap[child];
+            nodes[heap[i]].heapIndex = i;
+            i = child;
+        }
+        heap[i] = n;
+        nodes[n].heapIndex = i;
+    }
+
+    csArray<Node> nodes;
+    csHash<size_t, T*> index;   ///< Node of each item reached, may be stale
+    csArray<size_t> heap;       ///< Open nodes, binary min heap on f
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ * routesearch_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/routesearch.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <math.h>
+#include <stdlib.h>
+
+/// A point on a line with links to other points
+struct TestPoint
+{
+    float x;
+    bool blocked;
+    csArray<TestPoint*> links;
+    csArray<float> dists;
+};
+
+/// Straight line distance to the end as the estimate
+struct TestGraph
+{
+    TestPoint* end;
+
+    size_t GetLinkCount(TestPoint* p) const { return p->links.GetSize(); }
+    TestPoint* GetLink(TestPoint* p, size_t link) const { return p->links[link]; }
+    float GetDistance(TestPoint* p, size_t link) const { return p->dists[link]; }
+    bool Filter(TestPoint* p) const { return p->blocked; }
+    float Estimate(TestPoint* p) const { return fabsf(p->x - end->x); }
+};
+
+static void Link(TestPoint &a, TestPoint &b, float dist)
+{
+    a.links.Push(&b);
+    a.dists.Push(dist);
+    b.links.Push(&a);
+    b.dists.Push(dist);
+}
+
+static void InitPoints(TestPoint* points, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        points[i].x = (float)i;
+        points[i].blocked = false;
+    }
+}
+
+/// The points of the route from the start to 'n', as indices in 'points'.
+static csString Route(const psRouteSearch<TestPoint> &search, size_t n, TestPoint* points)
+{
+    csString route;
+    for (; n != SIZET_NOT_FOUND; n = search.GetNode(n).pi)
+    {
+        route.Insert(0, csString().Format("%d ", (int)(search.GetNode(n).item - points)));
+    }
+    route.RTrim();
+    return route;
+}
+
+TEST(RouteSearchTest, Shortest)
+{
+    // 0 - 1 - 2 - 3 is longer than the detour 0 - 4 - 3
+    TestPoint points[5];
+    InitPoints(points, 5);
+    points[4].x = 1.5f;
+    Link(points[0], points[1], 1.0f);
+    Link(points[1], points[2], 1.0f);
+    Link(points[2], points[3], 3.0f);
+    Link(points[0], points[4], 2.0f);
+    Link(points[4], points[3], 2.0f);
+
+    psRouteSearch<TestPoint> search;
+    TestGraph graph = { &points[3] };
+    size_t n = search.Run(&points[0], &points[3], graph);
+    ASSERT_NE(n, SIZET_NOT_FOUND);
+    EXPECT_FLOAT_EQ(search.GetNode(n).g, 4.0f);
+    EXPECT_STREQ(Route(search, n, points), "0 4 3");
+}
+
+TEST(RouteSearchTest, StartIsEnd)
+{
+    TestPoint points[2];
+    InitPoints(points, 2);
+    Link(points[0], points[1], 1.0f);
+
+    psRouteSearch<TestPoint> search;
+    TestGraph graph = { &points[0] };
+    size_t n = search.Run(&points[0], &points[0], graph);
+    ASSERT_NE(n, SIZET_NOT_FOUND);
+    EXPECT_EQ(search.GetNode(n).pi, SIZET_NOT_FOUND);
+    EXPECT_EQ(search.GetNode(n).g, 0.0f);
+    EXPECT_EQ(search.GetNodeCount(), (size_t)1);
+}
+
+TEST(RouteSearchTest, Unreachable)
+{
+    // 0 - 1   2 - 3, and 4 only behind a blocked point
+    TestPoint points[6];
+    InitPoints(points, 6);
+    Link(points[0], points[1], 1.0f);
+    Link(points[2], points[3], 1.0f);
+    Link(points[1], points[5], 1.0f);
+    Link(points[5], points[4], 1.0f);
+    points[5].blocked = true;
+
+    psRouteSearch<TestPoint> search;
+    TestGraph graph = { &points[3] };
+    EXPECT_EQ(search.Run(&points[0], &points[3], graph), SIZET_NOT_FOUND);
+
+    graph.end = &points[4];
+    EXPECT_EQ(search.Run(&points[0], &points[4], graph), SIZET_NOT_FOUND);
+
+    // The start and the end are never filtered
+    graph.end = &points[5];
+    size_t n = search.Run(&points[0], &points[5], graph);
+    ASSERT_NE(n, SIZET_NOT_FOUND);
+    EXPECT_STREQ(Route(search, n, points), "0 1 5");
+}
+
+TEST(RouteSearchTest, EqualCostTies)
+{
+    // A square: 0 - 1 - 3 and 0 - 2 - 3 are just as long
+    TestPoint points[4];
+    InitPoints(points, 4);
+    points[1].x = points[2].x = 1.0f;
+    points[3].x = 2.0f;
+    Link(points[0], points[1], 1.0f);
+    Link(points[0], points[2], 1.0f);
+    Link(points[1], points[3], 1.0f);
+    Link(points[2], points[3], 1.0f);
+
+    psRouteSearch<TestPoint> search;
+    TestGraph graph = { &points[3] };
+    size_t n = search.Run(&points[0], &points[3], graph);
+    ASSERT_NE(n, SIZET_NOT_FOUND);
+    EXPECT_FLOAT_EQ(search.GetNode(n).g, 2.0f);
+    csString first = Route(search, n, points);
+    EXPECT_TRUE(first == "0 1 3" || first == "0 2 3");
+
+    // A tie is not relaxed again, the same query gives the same route
+    for (int i = 0; i < 3; i++)
+    {
+        n = search.Run(&points[0], &points[3], graph);
+        EXPECT_STREQ(Route(search, n, points), first);
+    }
+}
+
+/**
+ * Random graphs searched with one search object, the distances checked
+ * against Bellman-Ford. Reusing the search exercises the stale index
+ * entries of the earlier queries.
+ */
+TEST(RouteSearchTest, RandomGraphs)
+{
+    const size_t count = 60;
+    psRouteSearch<TestPoint> search;
+    srand(1);
+
+    for (int round = 0; round < 20; round++)
+    {
+        TestPoint* points = new TestPoint[count];
+        for (size_t i = 0; i < count; i++)
+        {
+            points[i].x = (float)(rand() % 100);
+            points[i].blocked = false;
+        }
+        for (size_t i = 0; i < count * 2; i++)
+        {
+            size_t a = rand() % count;
+            size_t b = rand() % count;
+            if (a != b)
+            {
+                // Never shorter than the straight line, the estimate stays admissible
+                Link(points[a], points[b], fabsf(points[a].x - points[b].x) + (rand() % 10));
+            }
+        }
+
+        TestPoint* end = &points[rand() % count];
+        float dist[count];
+        for (size_t i = 0; i < count; i++)
+        {
+            dist[i] = (&points[i] == end) ? 0.0f : INFINITY_DISTANCE;
+        }
+        for (size_t pass = 0; pass < count; pass++)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                for (size_t l = 0; l < points[i].links.GetSize(); l++)
+                {
+                    size_t j = points[i].links[l] - points;
+                    if (dist[j] + points[i].dists[l] < dist[i])
+                        dist[i] = dist[j] + points[i].dists[l];
+                }
+            }
+        }
+
+        TestGraph graph = { end };
+        for (size_t i = 0; i < count; i++)
+        {
+            size_t n = search.Run(&points[i], end, graph);
+            if (dist[i] == INFINITY_DISTANCE)
+            {
+                EXPECT_EQ(n, SIZET_NOT_FOUND);
+            }
+            else
+            {
+                ASSERT_NE(n, SIZET_NOT_FOUND);
+                EXPECT_NEAR(search.GetNode(n).g, dist[i], 0.001f);
+            }
+        }
+        delete [] points;
+    }
+}
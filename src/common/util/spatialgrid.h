@@ -0,0 +1,484 @@
+/*
+ * spatialgrid.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef __SPATIALGRID_H__
+#define __SPATIALGRID_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <cstypes.h>
+#include <csgeom/vector3.h>
+#include <csutil/array.h>
+#include <csutil/hash.h>
+#include <csutil/scf_implementation.h>
+#include <iengine/mesh.h>
+#include <iengine/movable.h>
+#include <iengine/sector.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "engine/psworld.h"
+#include "util/psconst.h"
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Edge length of one cell of the spatial grid, in meters.
+#define PS_SPATIAL_CELL_SIZE 16.0f
+
+/// Cell coordinates are clamped to +/- this so far positions don't overflow an int.
+#define PS_SPATIAL_MAX_CELL 0x40000000
+
+/// Cells along one axis before the cell keys wrap.
+#define PS_SPATIAL_KEY_CELLS 0x10000
+
+/**
+ * Spatial index of the entities of the server or the npcclient.
+ *
+ * The index holds one uniform grid per (sector, instance) pair. The grid is
+ * 2D in the x/z plane since the sectors are much wider than they are high,
+ * the y coordinate is only used for the final distance test. Entries are
+ * updated incrementally whenever the movable of an object changes so a
+ * nearby query never has to walk the CS mesh lists or look up the attached
+ * object on each mesh.
+ *
+ * T is the entity class, it has to provide GetMeshWrapper().
+ */
+template<class T>
+class psSpatialGrid
+{
+public:
+    psSpatialGrid(float cellSize = PS_SPATIAL_CELL_SIZE)
+    {
+        this->cellSize = cellSize;
+        invCellSize = 1.0f / cellSize;
+        cellCount = 0;
+        world = NULL;
+    }
+
+    ~psSpatialGrid()
+    {
+        typename csHash<Entry*, csPtrKey<T> >::GlobalIterator entryIter(entries.GetIterator());
+        while(entryIter.HasNext())
+        {
+            delete entryIter.Next();
+        }
+        entries.Empty();
+
+        typename csHash<SectorGrids*, csPtrKey<iSector> >::GlobalIterator sectorIter(sectors.GetIterator());
+        while(sectorIter.HasNext())
+        {
+            SectorGrids* sectorGrids = sectorIter.Next();
+            typename csHash<Grid*, InstanceID>::GlobalIterator gridIter(sectorGrids->instances.GetIterator());
+            while(gridIter.HasNext())
+            {
+                Grid* grid = gridIter.Next();
+                typename csHash<Cell*, uint32>::GlobalIterator cellIter(grid->cells.GetIterator());
+                while(cellIter.HasNext())
+                {
+                    delete cellIter.Next();
+                }
+                delete grid;
+            }
+            delete sectorGrids;
+        }
+        sectors.Empty();
+    }
+
+    /**
+     * Set the world used to find the sectors connected to the query sector.
+     *
+     * Without a world the queries will not cross portals.
+     */
+    void SetWorld(psWorld* world)
+    {
+        this->world = world;
+    }
+
+    /**
+     * Insert an object or move it to a new location in the index.
+     *
+     * @param object   The object that moved.
+     * @param sector   The new sector of the object, NULL removes the object.
+     * @param pos      The new position of the object.
+     * @param instance The new instance of the object.
+     */
+    void Update(T* object, iSector* sector, const csVector3 &pos, InstanceID instance)
+    {
+        if(!sector)
+        {
+            Remove(object);
+            return;
+        }
+
+        Entry* entry = entries.Get(csPtrKey<T>(object), NULL);
+        if(!entry)
+        {
+            entry = new Entry;
+            entry->object = object;
+            entry->sector = sector;
+            entry->instance = instance;
+            entry->pos = pos;
+            entry->cell = NULL;
+            entries.Put(csPtrKey<T>(object), entry);
+            Link(entry);
+            return;
+        }
+
+        bool relink = entry->sector != sector || entry->instance != instance ||
+                      entry->cellKey != CellKey(CellCoord(pos.x), CellCoord(pos.z));
+
+        if(relink)
+        {
+            Unlink(entry);
+            entry->sector = sector;
+            entry->instance = instance;
+            entry->pos = pos;
+            Link(entry);
+        }
+        else
+        {
+            entry->pos = pos;
+        }
+    }
+
+    /**
+     * Remove an object from the index.
+     */
+    void Remove(T* object)
+    {
+        Entry* entry = entries.Get(csPtrKey<T>(object), NULL);
+        if(!entry)
+            return;
+
+        Unlink(entry);
+        entries.DeleteAll(csPtrKey<T>(object));
+        delete entry;
+    }
+
+    /**
+     * Find all objects within radius of the given position.
+     *
+     * The instance is matched the same way as the mesh based search did,
+     * objects in INSTANCE_ALL are seen from all instances and a query in
+     * INSTANCE_ALL sees all instances.
+     *
+     * A negative or NaN radius finds nothing. A huge one is fine, the
+     * query then looks at each allocated cell once.
+     *
+     * @param list Found objects are appended to this list.
+     */
+    void FindNearby(iSector* sector, const csVector3 &pos, InstanceID instance, float radius,
+                    bool doInvisible, csArray<T*> &list)
+    {
+        if(!sector)
+            return;
+
+        QuerySector(sector, pos, instance, radius, doInvisible, list);
+
+        if(!world)
+            return;
+
+        // Objects on the other side of a portal are found using the position
+        // warped into the space of the connected sector.
+        csArray<iSector*> adjacent;
+        world->GetAdjacentSectors(sector, adjacent);
+        for(size_t i = 0; i < adjacent.GetSize(); i++)
+        {
+            csVector3 warpedPos = pos;
+            if(world->WarpSpace(sector, adjacent[i], warpedPos))
+            {
+                QuerySector(adjacent[i], warpedPos, instance, radius, doInvisible, list);
+            }
+        }
+    }
+
+    /**
+     * Get the number of objects in the index.
+     */
+    size_t GetCount() const
+    {
+        return entries.GetSize();
+    }
+
+    /**
+     * Get the number of allocated grid cells over all grids.
+     */
+    size_t GetCellCount() const
+    {
+        return cellCount;
+    }
+
+private:
+    struct Cell;
+
+    /// The location of one object in the index.
+    struct Entry
+    {
+        T* object;
+        iSector* sector;
+        InstanceID instance;
+        csVector3 pos;
+        uint32 cellKey;
+        Cell* cell;
+        size_t slot;    ///< Index of this entry in cell->entries
+    };
+
+    struct Cell
+    {
+        csArray<Entry*> entries;
+    };
+
+    /// The grid for one (sector, instance).
+    struct Grid
+    {
+        csHash<Cell*, uint32> cells;
+    };
+
+    /// All the grids of one sector.
+    struct SectorGrids
+    {
+        csHash<Grid*, InstanceID> instances;
+    };
+
+    uint32 CellKey(int cx, int cz) const
+    {
+        return (uint32(uint16(cx)) << 16) | uint32(uint16(cz));
+    }
+
+    int CellCoord(float v) const
+    {
+        // Written so NaN ends up clamped too
+        float c = floorf(v * invCellSize);
+        if(!(c > -PS_SPATIAL_MAX_CELL))
+            return -PS_SPATIAL_MAX_CELL;
+        if(c > PS_SPATIAL_MAX_CELL)
+            return PS_SPATIAL_MAX_CELL;
+        return (int)c;
+    }
+
+    Grid* GetGrid(iSector* sector, InstanceID instance, bool create)
+    {
+        SectorGrids* sectorGrids = sectors.Get(csPtrKey<iSector>(sector), NULL);
+        if(!sectorGrids)
+        {
+            if(!create)
+                return NULL;
+
+            sectorGrids = new SectorGrids;
+            sectors.Put(csPtrKey<iSector>(sector), sectorGrids);
+        }
+
+        Grid* grid = sectorGrids->instances.Get(instance, NULL);
+        if(!grid && create)
+        {
+            grid = new Grid;
+            sectorGrids->instances.Put(instance, grid);
+        }
+
+        return grid;
+    }
+
+    void Link(Entry* entry)
+    {
+        Grid* grid = GetGrid(entry->sector, entry->instance, true);
+
+        entry->cellKey = CellKey(CellCoord(entry->pos.x), CellCoord(entry->pos.z));
+        Cell* cell = grid->cells.Get(entry->cellKey, NULL);
+        if(!cell)
+        {
+            cell = new Cell;
+            grid->cells.Put(entry->cellKey, cell);
+            cellCount++;
+        }
+
+        entry->cell = cell;
+        entry->slot = cell->entries.Push(entry);
+    }
+
+    void Unlink(Entry* entry)
+    {
+        Cell* cell = entry->cell;
+        if(!cell)
+            return;
+
+        // Swap the last entry of the cell into the hole to keep removal O(1).
+        Entry* last = cell->entries.Pop();
+        if(last != entry)
+        {
+            cell->entries[entry->slot] = last;
+            last->slot = entry->slot;
+        }
+        entry->cell = NULL;
+
+        // Empty cells are kept, entities tend to come back to the same places
+        // and the number of cells is bounded by the area of the sectors.
+    }
+
+    void QueryGrid(Grid* grid, const csVector3 &pos, float radius, bool doInvisible,
+                   csArray<T*> &list)
+    {
+        // Negative or NaN
+        if(!(radius >= 0.0f))
+            return;
+
+        float sqRadius = radius * radius;
+
+        int minX = CellCoord(pos.x - radius);
+        int maxX = CellCoord(pos.x + radius);
+        int minZ = CellCoord(pos.z - radius);
+        int maxZ = CellCoord(pos.z + radius);
+
+        // When the range covers more cells than the grid has, look at the
+        // cells there are instead. This bounds a query with a huge radius,
+        // and a range as wide as the key space would visit a key twice.
+        uint64 spanX = uint64(int64(maxX) - minX + 1);
+        uint64 spanZ = uint64(int64(maxZ) - minZ + 1);
+        if(spanX >= PS_SPATIAL_KEY_CELLS || spanZ >= PS_SPATIAL_KEY_CELLS ||
+           spanX * spanZ > grid->cells.GetSize())
+        {
+            typename csHash<Cell*, uint32>::GlobalIterator cellIter(grid->cells.GetIterator());
+            while(cellIter.HasNext())
+            {
+                QueryCell(cellIter.Next(), pos, sqRadius, doInvisible, list);
+            }
+            return;
+        }
+
+        for(int cx = minX; cx <= maxX; cx++)
+        {
+            for(int cz = minZ; cz <= maxZ; cz++)
+            {
+                Cell* cell = grid->cells.Get(CellKey(cx, cz), NULL);
+                if(cell)
+                {
+                    QueryCell(cell, pos, sqRadius, doInvisible, list);
+                }
+            }
+        }
+    }
+
+    void QueryCell(Cell* cell, const csVector3 &pos, float sqRadius, bool doInvisible,
+                   csArray<T*> &list)
+    {
+        for(size_t i = 0; i < cell->entries.GetSize(); i++)
+        {
+            Entry* entry = cell->entries[i];
+            if((entry->pos - pos).SquaredNorm() > sqRadius)
+                continue;
+
+            if(!doInvisible)
+            {
+                iMeshWrapper* mesh = entry->object->GetMeshWrapper();
+                if(mesh && mesh->GetFlags().Check(CS_ENTITY_INVISIBLE))
+                    continue;
+            }
+
+            list.Push(entry->object);
+        }
+    }
+
+    void QuerySector(iSector* sector, const csVector3 &pos, InstanceID instance, float radius,
+                     bool doInvisible, csArray<T*> &list)
+    {
+        SectorGrids* sectorGrids = sectors.Get(csPtrKey<iSector>(sector), NULL);
+        if(!sectorGrids)
+            return;
+
+        if(instance == INSTANCE_ALL)
+        {
+            typename csHash<Grid*, InstanceID>::GlobalIterator gridIter(sectorGrids->instances.GetIterator());
+            while(gridIter.HasNext())
+            {
+                QueryGrid(gridIter.Next(), pos, radius, doInvisible, list);
+            }
+            return;
+        }
+
+        Grid* grid = sectorGrids->instances.Get(instance, NULL);
+        if(grid)
+        {
+            QueryGrid(grid, pos, radius, doInvisible, list);
+        }
+
+        Grid* allGrid = sectorGrids->instances.Get(INSTANCE_ALL, NULL);
+        if(allGrid)
+        {
+            QueryGrid(allGrid, pos, radius, doInvisible, list);
+        }
+    }
+
+    float cellSize;
+    float invCellSize;
+    size_t cellCount;
+    psWorld* world;
+
+    csHash<Entry*, csPtrKey<T> > entries;
+    csHash<SectorGrids*, csPtrKey<iSector> > sectors;
+};
+
+/**
+ * Keeps a spatial grid up to date with the movable of one object.
+ *
+ * All movement of a mesh, whatever code path it comes from, ends up in
+ * iMovable::UpdateMove() so this is the one place to catch it.
+ *
+ * T is the entity class, it has to provide GetInstance().
+ */
+template<class T>
+class psSpatialGridListener : public scfImplementation1<psSpatialGridListener<T>, iMovableListener>
+{
+public:
+    psSpatialGridListener(T* owner, psSpatialGrid<T>* index)
+        : scfImplementation1<psSpatialGridListener<T>, iMovableListener>(this)
+    {
+        this->owner = owner;
+        this->index = index;
+    }
+
+    virtual ~psSpatialGridListener()
+    {
+    }
+
+    virtual void MovableChanged(iMovable* movable)
+    {
+        iSector* sector = NULL;
+        if(movable->GetSectors()->GetCount())
+        {
+            sector = movable->GetSectors()->Get(0);
+        }
+
+        index->Update(owner, sector, movable->GetPosition(), owner->GetInstance());
+    }
+
+    virtual void MovableDestroyed(iMovable* movable)
+    {
+        index->Remove(owner);
+    }
+
+private:
+    T* owner;                               ///< Object using the mesh.
+    psSpatialGrid<T>* index;               ///< Grid the object is kept in.
+};
+
+/** @} */
+
+#endif
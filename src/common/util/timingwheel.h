@@ -0,0 +1,333 @@
+/*
+ * timingwheel.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+#ifndef __TIMINGWHEEL_H__
+#define __TIMINGWHEEL_H__
+
+#include <cstypes.h>
+#include <csutil/sysfunc.h>
+
+/**
+ * \addtogroup common_util
+ * @{ */
+
+/// Number of levels of the timing wheel, enough for the range of csTicks
+#define TIMING_WHEEL_LEVELS 4
+/// Slots per level of the timing wheel
+#define TIMING_WHEEL_SLOTS 256
+#define TIMING_WHEEL_BITS 8
+
+/**
+ * Doubly linked list of events, a slot of the timing wheel.
+ */
+template<class T>
+struct psTimingList
+{
+    T* head;
+    T* tail;
+};
+
+/**
+ * Hierarchical timing wheel of intrusively linked events.
+ *
+ * The first level has a slot for each of the next 256 ticks, each following
+ * level has 256 slots covering 256 slots of the level below. When the first
+ * level has gone round, the next slot of the second level is spread over it
+ * and so on. Adding and removing an event are O(1).
+ *
+ * Events whose time has come are moved to the due list, in the order of
+ * their trigger time. The wheel does not own the events.
+ *
+ * T has to provide the members triggerticks, next, prev and list, which are
+ * only touched by the wheel while the event is on it.
+ */
+template<class T>
+class psTimingWheel
+{
+public:
+    psTimingWheel(csTicks time)
+    {
+        for(int level = 0; level < TIMING_WHEEL_LEVELS; level++)
+        {
+            for(int slot = 0; slot < TIMING_WHEEL_SLOTS; slot++)
+            {
+                wheel[level][slot].head = NULL;
+                wheel[level][slot].tail = NULL;
+            }
+        }
+        due.head = NULL;
+        due.tail = NULL;
+        this->time = time;
+        count = 0;
+    }
+
+    /// Ticks the wheel has been advanced to.
+    csTicks GetTime() const
+    {
+        return time;
+    }
+
+    /// Move the wheel to another time, only allowed while it is empty.
+    void SetTime(csTicks time)
+    {
+        CS_ASSERT(!count);
+        this->time = time;
+    }
+
+    /// Events on the wheel and in the due list.
+    size_t GetCount() const
+    {
+        return count;
+    }
+
+    /// Check if an event is due.
+    bool HasDue() const
+    {
+        return due.head != NULL;
+    }
+
+    /**
+     * Put an event in the slot of its trigger time. Events not later than
+     * the time of the wheel go to the due list right away.
+     */
+    void Insert(T* event)
+    {
+        int32 delta = (int32) (event->triggerticks - time);
+        if(delta <= 0)
+        {
+            InsertDue(event);
+            return;
+        }
+
+        // Pick the lowest level whose slots still cover the time to go
+        int level = 0;
+        while(level < TIMING_WHEEL_LEVELS - 1 && (uint32) delta >> (TIMING_WHEEL_BITS * (level + 1)))
+        {
+            level++;
+        }
+
+        size_t slot = (event->triggerticks >> (TIMING_WHEEL_BITS * level)) & (TIMING_WHEEL_SLOTS - 1);
+        Append(wheel[level][slot], event);
+    }
+
+    /// Take an event off the wheel or the due list.
+    void Remove(T* event)
+    {
+        psTimingList<T>* list = event->list;
+        if(event->prev)
+        {
+            event->prev->next = event->next;
+        }
+        else
+        {
+            list->head = event->next;
+        }
+        if(event->next)
+        {
+            event->next->prev = event->prev;
+        }
+        else
+        {
+            list->tail = event->prev;
+        }
+        event->next = NULL;
+        event->prev = NULL;
+        event->list = NULL;
+        count--;
+    }
+
+    /// Take the first due event off the wheel, NULL if none is due.
+    T* PopDue()
+    {
+        T* event = due.head;
+        if(event)
+        {
+            Remove(event);
+        }
+        return event;
+    }
+
+    /// Advance the wheel by one tick and move the events of that tick to the due list.
+    void Advance()
+    {
+        time++;
+        if(!(time & (TIMING_WHEEL_SLOTS - 1)))
+        {
+            Cascade(1);
+        }
+
+        psTimingList<T> &slot = wheel[0][time & (TIMING_WHEEL_SLOTS - 1)];
+        while(slot.head)
+        {
+            T* event = slot.head;
+            Remove(event);
+            Append(due, event);
+        }
+    }
+
+    /**
+     * Get the ticks to the next time Advance() has something to do, up to
+     * limit. This is the next tick with events or a cascade.
+     */
+    csTicks NextEventIn(csTicks limit) const
+    {
+        if(due.head)
+        {
+            return 0;
+        }
+
+        for(csTicks ticks = 1; ticks < limit; ticks++)
+        {
+            csTicks next = time + ticks;
+
+            // Wake up when the next level cascades as well
+            if(!(next & (TIMING_WHEEL_SLOTS - 1)) || wheel[0][next & (TIMING_WHEEL_SLOTS - 1)].head)
+            {
+                return ticks;
+            }
+        }
+        return limit;
+    }
+
+    /// Take all events off the wheel and delete them.
+    void DeleteAll()
+    {
+        for(int level = 0; level < TIMING_WHEEL_LEVELS; level++)
+        {
+            for(int slot = 0; slot < TIMING_WHEEL_SLOTS; slot++)
+            {
+                while(wheel[level][slot].head)
+                {
+                    T* event = wheel[level][slot].head;
+                    Remove(event);
+                    delete event;
+                }
+            }
+        }
+        while(due.head)
+        {
+            T* event = due.head;
+            Remove(event);
+            delete event;
+        }
+    }
+
+    /// Get a slot of the wheel, used to check where an event went.
+    const psTimingList<T> &GetSlot(int level, size_t slot) const
+    {
+        return wheel[level][slot];
+    }
+
+    /// Get the list of due events.
+    const psTimingList<T> &GetDue() const
+    {
+        return due;
+    }
+
+private:
+    psTimingList<T> wheel[TIMING_WHEEL_LEVELS][TIMING_WHEEL_SLOTS];
+    psTimingList<T> due;            ///< Events to trigger now
+    csTicks time;                   ///< Ticks the wheel has been advanced to
+    size_t count;                   ///< Events in the wheel and the due list
+
+    /// Spread the current slot of a level over the levels below.
+    void Cascade(int level)
+    {
+        size_t slot = (time >> (TIMING_WHEEL_BITS * level)) & (TIMING_WHEEL_SLOTS - 1);
+
+        // Higher levels first, their events may end up in this slot
+        if(!slot && level < TIMING_WHEEL_LEVELS - 1)
+        {
+            Cascade(level + 1);
+        }
+
+        psTimingList<T> &list = wheel[level][slot];
+        while(list.head)
+        {
+            T* event = list.head;
+            Remove(event);
+            Insert(event);
+        }
+    }
+
+    /// Add an event to the end of a list.
+    void Append(psTimingList<T> &list, T* event)
+    {
+        event->list = &list;
+        event->next = NULL;
+        event->prev = list.tail;
+        if(list.tail)
+        {
+            list.tail->next = event;
+        }
+        else
+        {
+            list.head = event;
+        }
+        list.tail = event;
+        count++;
+    }
+
+    /// Add an event to the due list after the events due before it.
+    void InsertDue(T* event)
+    {
+        // Usually the event goes to the end, only events inserted late have
+        // to go before events of later ticks.
+        T* before = due.tail;
+        while(before && (int32) (event->triggerticks - before->triggerticks) < 0)
+        {
+            before = before->prev;
+        }
+
+        if(!before)
+        {
+            event->list = &due;
+            event->prev = NULL;
+            event->next = due.head;
+            if(due.head)
+            {
+                due.head->prev = event;
+            }
+            else
+            {
+                due.tail = event;
+            }
+            due.head = event;
+            count++;
+            return;
+        }
+
+        event->list = &due;
+        event->prev = before;
+        event->next = before->next;
+        if(before->next)
+        {
+            before->next->prev = event;
+        }
+        else
+        {
+            due.tail = event;
+        }
+        before->next = event;
+        count++;
+    }
+};
+
+/** @} */
+
+#endif
@@ -0,0 +1,237 @@
+/*
+ * timingwheel_unittest.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/timingwheel.h"
+
+//=============================================================================
+// Library Includes
+//=============================================================================
+#include <gtest/gtest.h>
+#include <csutil/array.h>
+
+struct TestEvent
+{
+    csTicks triggerticks;
+    TestEvent* next;
+    TestEvent* prev;
+    psTimingList<TestEvent>* list;
+
+    TestEvent(csTicks ticks)
+        : triggerticks(ticks), next(NULL), prev(NULL), list(NULL)
+    {
+    }
+};
+
+typedef psTimingWheel<TestEvent> TestWheel;
+
+/// Advance the wheel up to a time, recording the events due and when they were taken.
+static void RunUntil(TestWheel &wheel, csTicks until, csArray<TestEvent*> &fired, csArray<csTicks> &firedAt)
+{
+    while(true)
+    {
+        TestEvent* event = wheel.PopDue();
+        while(event)
+        {
+            fired.Push(event);
+            firedAt.Push(wheel.GetTime());
+            event = wheel.PopDue();
+        }
+
+        if(wheel.GetTime() == until)
+            break;
+        wheel.Advance();
+    }
+}
+
+TEST(TimingWheelTest, InsertIntoEachLevel)
+{
+    TestWheel wheel(0);
+
+    TestEvent tick(1);
+    TestEvent second(300);
+    TestEvent minute(70000);
+    TestEvent hours(0x01000005);
+
+    wheel.Insert(&tick);
+    wheel.Insert(&second);
+    wheel.Insert(&minute);
+    wheel.Insert(&hours);
+
+    EXPECT_EQ(wheel.GetCount(), (size_t)4);
+    EXPECT_EQ(tick.list, &wheel.GetSlot(0, 1));
+    EXPECT_EQ(second.list, &wheel.GetSlot(1, 1));
+    EXPECT_EQ(minute.list, &wheel.GetSlot(2, 1));
+    EXPECT_EQ(hours.list, &wheel.GetSlot(3, 1));
+    EXPECT_FALSE(wheel.HasDue());
+
+    wheel.Remove(&tick);
+    wheel.Remove(&second);
+    wheel.Remove(&minute);
+    wheel.Remove(&hours);
+    EXPECT_EQ(wheel.GetCount(), (size_t)0);
+}
+
+TEST(TimingWheelTest, CascadeOnLevelWrap)
+{
+    TestWheel wheel(0);
+    TestEvent event(300);
+    wheel.Insert(&event);
+
+    csArray<TestEvent*> fired;
+    csArray<csTicks> firedAt;
+    RunUntil(wheel, 255, fired, firedAt);
+    EXPECT_EQ(fired.GetSize(), (size_t)0);
+    EXPECT_EQ(event.list, &wheel.GetSlot(1, 1));
+
+    // The first level wraps, the second level slot is spread over it
+    wheel.Advance();
+    EXPECT_EQ(event.list, &wheel.GetSlot(0, 300 & (TIMING_WHEEL_SLOTS - 1)));
+
+    RunUntil(wheel, 400, fired, firedAt);
+    ASSERT_EQ(fired.GetSize(), (size_t)1);
+    EXPECT_EQ(firedAt[0], (csTicks)300);
+}
+
+TEST(TimingWheelTest, AdvanceAcrossFullWrap)
+{
+    // Start short of the csTicks wrap, the last event cascades down from the top level
+    TestWheel wheel(0xFFFFFF00);
+
+    TestEvent events[] =
+    {
+        TestEvent(0xFFFFFF10),
+        TestEvent(0xFFFFFFFF),
+        TestEvent(0),
+        TestEvent(0x10),
+        TestEvent(0x1000),
+        TestEvent(0x01000020)
+    };
+    const size_t count = sizeof(events) / sizeof(events[0]);
+
+    // Inserted in reverse order, they still come out in the order of their time
+    for(size_t i = count; i-- > 0;)
+        wheel.Insert(&events[i]);
+    EXPECT_EQ(events[5].list, &wheel.GetSlot(3, 1));
+
+    csArray<TestEvent*> fired;
+    csArray<csTicks> firedAt;
+    RunUntil(wheel, 0x01000100, fired, firedAt);
+
+    ASSERT_EQ(fired.GetSize(), count);
+    for(size_t i = 0; i < count; i++)
+    {
+        EXPECT_EQ(fired[i], &events[i]);
+        EXPECT_EQ(firedAt[i], events[i].triggerticks);
+    }
+    EXPECT_EQ(wheel.GetCount(), (size_t)0);
+}
+
+TEST(TimingWheelTest, Cancel)
+{
+    TestWheel wheel(0);
+    TestEvent first(10);
+    TestEvent cancelled(10);
+    TestEvent later(500);
+
+    wheel.Insert(&first);
+    wheel.Insert(&cancelled);
+    wheel.Insert(&later);
+
+    wheel.Remove(&cancelled);
+    wheel.Remove(&later);
+    EXPECT_EQ(wheel.GetCount(), (size_t)1);
+    EXPECT_EQ(cancelled.list, (psTimingList<TestEvent>*)NULL);
+
+    csArray<TestEvent*> fired;
+    csArray<csTicks> firedAt;
+    RunUntil(wheel, 600, fired, firedAt);
+    ASSERT_EQ(fired.GetSize(), (size_t)1);
+    EXPECT_EQ(fired[0], &first);
+}
+
+TEST(TimingWheelTest, Reschedule)
+{
+    TestWheel wheel(0);
+    TestEvent event(10);
+    wheel.Insert(&event);
+
+    wheel.Remove(&event);
+    event.triggerticks = 700;
+    wheel.Insert(&event);
+    EXPECT_EQ(event.list, &wheel.GetSlot(1, 2));
+
+    csArray<TestEvent*> fired;
+    csArray<csTicks> firedAt;
+    RunUntil(wheel, 699, fired, firedAt);
+    EXPECT_EQ(fired.GetSize(), (size_t)0);
+
+    RunUntil(wheel, 800, fired, firedAt);
+    ASSERT_EQ(fired.GetSize(), (size_t)1);
+    EXPECT_EQ(firedAt[0], (csTicks)700);
+}
+
+TEST(TimingWheelTest, InsertedLate)
+{
+    TestWheel wheel(1000);
+    TestEvent due(1005);
+    wheel.Insert(&due);
+    for(int i = 0; i < 5; i++)
+        wheel.Advance();
+    EXPECT_EQ(due.list, &wheel.GetDue());
+
+    // Events already late go to the due list before the events due after them
+    TestEvent late(990);
+    TestEvent now(1005);
+    TestEvent lessLate(995);
+    wheel.Insert(&late);
+    wheel.Insert(&now);
+    wheel.Insert(&lessLate);
+    EXPECT_EQ(now.list, &wheel.GetDue());
+
+    EXPECT_EQ(wheel.PopDue(), &late);
+    EXPECT_EQ(wheel.PopDue(), &lessLate);
+    EXPECT_EQ(wheel.PopDue(), &due);
+    EXPECT_EQ(wheel.PopDue(), &now);
+    EXPECT_EQ(wheel.PopDue(), (TestEvent*)NULL);
+    EXPECT_EQ(wheel.GetCount(), (size_t)0);
+}
+
+TEST(TimingWheelTest, NextEventIn)
+{
+    TestWheel wheel(0);
+    EXPECT_EQ(wheel.NextEventIn(250), (csTicks)250);
+
+    // Wakes up for the cascade at the wrap of the first level
+    EXPECT_EQ(wheel.NextEventIn(1000), (csTicks)256);
+
+    TestEvent event(40);
+    wheel.Insert(&event);
+    EXPECT_EQ(wheel.NextEventIn(250), (csTicks)40);
+
+    for(int i = 0; i < 40; i++)
+        wheel.Advance();
+    EXPECT_TRUE(wheel.HasDue());
+    EXPECT_EQ(wheel.NextEventIn(250), (csTicks)0);
+    EXPECT_EQ(wheel.PopDue(), &event);
+}
@@ -48,6 +48,7 @@
 #include "util/location.h"
 #include "util/strutil.h"
 #include "util/eventmanager.h"
+#include "util/pspathnetwork.h"
 
 #include "engine/psworld.h"
 
@@ -416,6 +417,38 @@ int com_setbuffer(const char* line)
     return 0;
 }
 
+int com_routecache(const char* line)
+{
+    psPathNetwork* pathNetwork = npcclient->GetPathNetwork();
+    if(!pathNetwork)
+    {
+        CPrintf(CON_CMDOUTPUT, "No path network loaded.\n");
+        return 0;
+    }
+
+    WordArray words(line,false);
+    if(words.GetCount() && words[0] == "clear")
+    {
+        pathNetwork->InvalidateRoutes();
+        CPrintf(CON_CMDOUTPUT, "Route cache cleared.\n");
+        return 0;
+    }
+
+    psRouteCache::Stats stats;
+    pathNetwork->GetRouteCache().GetStats(stats);
+
+    uint64 lookups = stats.hits + stats.misses;
+    CPrintf(CON_CMDOUTPUT, "Routes cached    : %zu of %zu\n", stats.entries, stats.capacity);
+    CPrintf(CON_CMDOUTPUT, "Hits             : %llu\n", (unsigned long long) stats.hits);
+    CPrintf(CON_CMDOUTPUT, "Misses           : %llu\n", (unsigned long long) stats.misses);
+    CPrintf(CON_CMDOUTPUT, "Hit rate         : %.1f%%\n", lookups ? 100.0 * stats.hits / lookups : 0.0);
+    CPrintf(CON_CMDOUTPUT, "Not cacheable    : %llu\n", (unsigned long long) stats.uncached);
+    CPrintf(CON_CMDOUTPUT, "Evictions        : %llu\n", (unsigned long long) stats.evictions);
+    CPrintf(CON_CMDOUTPUT, "Invalidations    : %llu\n", (unsigned long long) stats.invalidations);
+
+    return 0;
+}
+
 int com_setlog(const char* line)
 {
     if(!*line)
@@ -522,6 +555,7 @@ const COMMAND commands[] =
     { "list",         false, com_list,         "List entities ( list [char|ent|loc|npc|path|race|recipe|tribe|warpspace|waypoint] <filter> )" },
     { "print",        false, com_print,        "List all behaviors/hate of 1 NPC"},
     { "quit",         true,  com_quit,         "Makes the npc client exit"},
+    { "routecache",   false, com_routecache,   "Show the route cache hit rate ( routecache [clear] )"},
     { "setbuffer",    false, com_setbuffer,    "Set a npc buffer"},
     { "setlog",       false, com_setlog,       "Set server log" },
     { "setmaxfile",   false, com_setmaxfile,   "Set maximum message class for output file"},
@@ -192,6 +192,26 @@ void gemNPCObject::SetPosition(csVector3 &pos, iSector* sector, InstanceID* inst
     }
 }
 
+void gemNPCObject::SetInstance(InstanceID instance)
+{
+    if(this->instance == instance)
+        return;
+
+    this->instance = instance;
+
+    // Move the object to the grid of the new instance.
+    iMeshWrapper* mesh = pcmesh ? pcmesh->GetMesh() : NULL;
+    if(mesh)
+    {
+        iSector* sector = NULL;
+        if(mesh->GetMovable()->GetSectors()->GetCount())
+        {
+            sector = mesh->GetMovable()->GetSectors()->Get(0);
+        }
+        psNPCClient::npcclient->GetSpatialIndex()->Update(this, sector, mesh->GetMovable()->GetPosition(), instance);
+    }
+}
+
 iMeshWrapper* gemNPCObject::GetMeshWrapper()
 {
     return pcmesh->GetMesh();
@@ -159,10 +159,7 @@ public:
     }
 
     virtual void SetPosition(csVector3 &pos, iSector* sector = NULL, InstanceID* instance = NULL);
-    virtual void SetInstance(InstanceID instance)
-    {
-        this->instance = instance;
-    }
+    virtual void SetInstance(InstanceID instance);
     virtual InstanceID GetInstance()
     {
         return instance;
@@ -642,6 +642,7 @@ void NetworkManager::HandlePathNetwork(MsgEntry* me)
             if(wp)
             {
                 wp->Adjust(msg.position, msg.sector);
+                pathNetwork->InvalidateRoutes();
 
                 Debug3(LOG_NET, 0, "Adjusted waypoint %d to %s.\n",
                        msg.id, toString(msg.position, msg.sector).GetDataSafe());
@@ -729,6 +730,7 @@ void NetworkManager::HandlePathNetwork(MsgEntry* me)
             if(wp)
             {
                 wp->SetFlag(msg.string, msg.enable);
+                pathNetwork->InvalidateRoutes();
 
                 Debug4(LOG_NET, 0, "Set flag %s for waypoint %d to %s.\n",
                        msg.string.GetDataSafe(), msg.id, msg.enable?"TRUE":"FALSE");
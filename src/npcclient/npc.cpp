@@ -1061,9 +1061,8 @@ void NPC::ClearState()
     disabled = false;
 }
 
-///TODO: The next 3 functions are exactly the same except a line in the code, maybe figure out a better way to handle this?
-
-gemNPCActor* NPC::GetNearestActor(float range, csVector3 &destPosition, iSector* &destSector, float &destRange)
+gemNPCActor* NPC::GetNearest(float range, csVector3 &destPosition, iSector* &destSector, float &destRange,
+                             bool npcs, bool players)
 {
     csVector3 loc;
     iSector*  sector;
@@ -1071,140 +1070,71 @@ gemNPCActor* NPC::GetNearestActor(float range, csVector3 &destPosition, iSector*
     psGameObject::GetPosition(GetActor(), loc, sector);
 
     csArray<gemNPCActor*> nearlist = npcclient->FindNearbyActors(sector, loc, range);
-    if(nearlist.GetSize() > 0)
-    {
-        gemNPCActor* nearestEnt = NULL;
-        csVector3    nearestLoc;
-        iSector*     nearestSector = NULL;
+    if(nearlist.GetSize() == 0)
+        return NULL;
 
-        float nearestRange=range;
+    csArray<gemNPCActor*> candidates;
+    csArray<csVector3>    positions;
+    csArray<iSector*>     sectors;
+    candidates.SetCapacity(nearlist.GetSize());
+    positions.SetCapacity(nearlist.GetSize());
+    sectors.SetCapacity(nearlist.GetSize());
 
-        for(size_t i=0; i<nearlist.GetSize(); i++)
-        {
-            gemNPCActor* ent = nearlist[i];
+    for(size_t i=0; i<nearlist.GetSize(); i++)
+    {
+        gemNPCActor* ent = nearlist[i];
 
-            // Filter own NPC actor
-            if(ent == GetActor())
-                continue;
+        // Filter own NPC actor
+        if(ent == GetActor())
+            continue;
 
-            csVector3 loc2;
-            iSector* sector2;
-            psGameObject::GetPosition(ent, loc2, sector2);
+        if(ent->GetNPC() ? !npcs : !players)
+            continue;
 
-            float dist = world->Distance(loc, sector, loc2, sector2);
-            if(dist < nearestRange)
-            {
-                nearestRange  = dist;
-                nearestEnt    = ent;
-                nearestLoc    = loc2;
-                nearestSector = sector2;
-            }
-        }
-        if(nearestEnt)
-        {
-            destPosition = nearestLoc;
-            destSector   = nearestSector;
-            destRange    = nearestRange;
-            return nearestEnt;
-        }
-    }
-    return NULL;
-}
+        csVector3 loc2;
+        iSector* sector2;
+        psGameObject::GetPosition(ent, loc2, sector2);
 
-gemNPCActor* NPC::GetNearestNPC(float range, csVector3 &destPosition, iSector* &destSector, float &destRange)
-{
-    csVector3 loc;
-    iSector*  sector;
+        candidates.Push(ent);
+        positions.Push(loc2);
+        sectors.Push(sector2);
+    }
 
-    psGameObject::GetPosition(GetActor(), loc, sector);
+    csArray<float> distances;
+    world->Distance(loc, sector, positions, sectors, distances);
 
-    csArray<gemNPCActor*> nearlist = npcclient->FindNearbyActors(sector, loc, range);
-    if(nearlist.GetSize() > 0)
+    size_t nearest = SIZET_NOT_FOUND;
+    float nearestRange = range;
+    for(size_t i=0; i<candidates.GetSize(); i++)
     {
-        gemNPCActor* nearestEnt = NULL;
-        csVector3    nearestLoc;
-        iSector*     nearestSector = NULL;
-
-        float nearestRange=range;
-
-        for(size_t i=0; i<nearlist.GetSize(); i++)
-        {
-            gemNPCActor* ent = nearlist[i];
-
-            // Filter own NPC actor, and all players
-            if(ent == GetActor() || !ent->GetNPC())
-                continue;
-
-            csVector3 loc2;
-            iSector* sector2;
-            psGameObject::GetPosition(ent, loc2, sector2);
-
-            float dist = world->Distance(loc, sector, loc2, sector2);
-            if(dist < nearestRange)
-            {
-                nearestRange  = dist;
-                nearestEnt    = ent;
-                nearestLoc    = loc2;
-                nearestSector = sector2;
-            }
-        }
-        if(nearestEnt)
+        if(distances[i] < nearestRange)
         {
-            destPosition = nearestLoc;
-            destSector   = nearestSector;
-            destRange    = nearestRange;
-            return nearestEnt;
+            nearestRange = distances[i];
+            nearest      = i;
         }
     }
-    return NULL;
+    if(nearest == SIZET_NOT_FOUND)
+        return NULL;
+
+    destPosition = positions[nearest];
+    destSector   = sectors[nearest];
+    destRange    = nearestRange;
+    return candidates[nearest];
 }
 
-gemNPCActor* NPC::GetNearestPlayer(float range, csVector3 &destPosition, iSector* &destSector, float &destRange)
+gemNPCActor* NPC::GetNearestActor(float range, csVector3 &destPosition, iSector* &destSector, float &destRange)
 {
-    csVector3 loc;
-    iSector*  sector;
-
-    psGameObject::GetPosition(GetActor(), loc, sector);
-
-    csArray<gemNPCActor*> nearlist = npcclient->FindNearbyActors(sector, loc, range);
-    if(nearlist.GetSize() > 0)
-    {
-        gemNPCActor* nearestEnt = NULL;
-        csVector3    nearestLoc;
-        iSector*     nearestSector = NULL;
-
-        float nearestRange=range;
-
-        for(size_t i=0; i<nearlist.GetSize(); i++)
-        {
-            gemNPCActor* ent = nearlist[i];
-
-            // Filter own NPC actor, and all NPCs
-            if(ent == GetActor() || ent->GetNPC())
-                continue;
+    return GetNearest(range, destPosition, destSector, destRange, true, true);
+}
 
-            csVector3 loc2;
-            iSector* sector2;
-            psGameObject::GetPosition(ent, loc2, sector2);
+gemNPCActor* NPC::GetNearestNPC(float range, csVector3 &destPosition, iSector* &destSector, float &destRange)
+{
+    return GetNearest(range, destPosition, destSector, destRange, true, false);
+}
 
-            float dist = world->Distance(loc, sector, loc2, sector2);
-            if(dist < nearestRange)
-            {
-                nearestRange  = dist;
-                nearestEnt    = ent;
-                nearestLoc    = loc2;
-                nearestSector = sector2;
-            }
-        }
-        if(nearestEnt)
-        {
-            destPosition = nearestLoc;
-            destSector   = nearestSector;
-            destRange    = nearestRange;
-            return nearestEnt;
-        }
-    }
-    return NULL;
+gemNPCActor* NPC::GetNearestPlayer(float range, csVector3 &destPosition, iSector* &destSector, float &destRange)
+{
+    return GetNearest(range, destPosition, destSector, destRange, false, true);
 }
 
 
@@ -620,6 +620,17 @@ public:
     bool ContainAutoMemorizeType(const csString &type);
 
 private:
+    /**
+     * Return the nearest actor within the given range, measured with the
+     * batch psWorld::Distance. Used by GetNearestActor, GetNearestNPC and
+     * GetNearestPlayer.
+     *
+     * @param npcs Include the NPCs
+     * @param players Include the players
+     */
+    gemNPCActor* GetNearest(float range, csVector3 &destPosition, iSector* &destSector, float &destRange,
+                            bool npcs, bool players);
+
     /**
      * Callback function to report local debug.
      */
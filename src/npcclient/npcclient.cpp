@@ -104,9 +104,6 @@ psNPCClient::psNPCClient() : serverconsole(NULL)
     database      = NULL;
     network       = NULL;
     tick_counter  = 0;
-    current_long_range_perception_index = 0;
-    current_long_range_perception_loc_index = 0;
-    current_tribe_home_perception_index = 0;
     gameMinute = gameHour = gameDay = gameMonth = gameYear = 0;
     gameTimeUpdated = 0;
 }
@@ -227,6 +224,7 @@ bool psNPCClient::Initialize(iObjectRegistry* object_reg,const char* _host, cons
         exit(1);
     }
     world->Initialize(object_reg);
+    spatialIndex.SetWorld(world);
 
     if(!LoadNPCTypes())
     {
@@ -931,6 +929,7 @@ bool psNPCClient::LoadPathNetwork()
     }
 
     pathNetwork = new psPathNetwork();
+    pathNetwork->GetRouteCache().SetCapacity(configmanager->GetInt("PlaneShift.NPCClient.RouteCacheSize", 1024));
     return pathNetwork->Load(engine, db, world);
 }
 
@@ -1161,12 +1160,49 @@ psPath* psNPCClient::FindPath(const char* name)
 void psNPCClient::RegisterReaction(NPC* npc, Reaction* reaction)
 {
     allReactions.Put(reaction->GetEventType(), npc);
+
+    csHash<size_t, csPtrKey<NPC> >* counts = reactionCounts.GetElementPointer(reaction->GetEventType());
+    if(!counts)
+    {
+        reactionCounts.Put(reaction->GetEventType(), csHash<size_t, csPtrKey<NPC> >());
+        counts = reactionCounts.GetElementPointer(reaction->GetEventType());
+    }
+    counts->PutUnique(npc, counts->Get(npc, 0) + 1);
 }
 
 void psNPCClient::TriggerEvent(Perception* pcpt, float maxRange,
                                csVector3* basePos, iSector* baseSector,
                                bool sameSector)
 {
+    csHash<size_t, csPtrKey<NPC> >* counts = reactionCounts.GetElementPointer(pcpt->GetName());
+    if(!counts)
+    {
+        notUsedReactions.PushSmart(pcpt->GetName());
+        return;
+    }
+
+    if(maxRange > 0.0 && basePos && baseSector)
+    {
+        // Only the actors near the base position can be in range, look them
+        // up instead of checking the range of every NPC with the reaction.
+        csArray<gemNPCObject*> nearby;
+        spatialIndex.FindNearby(baseSector, *basePos, INSTANCE_ALL, maxRange, true, nearby);
+        for(size_t i = 0; i < nearby.GetSize(); i++)
+        {
+            NPC* npc = nearby[i]->GetNPC();
+            if(!npc || npc->IsDisabled())
+                continue;
+
+            // Trigger as many times as the NPC registered the reaction
+            size_t count = counts->Get(npc, 0);
+            while(count--)
+            {
+                npc->TriggerEvent(pcpt, maxRange, basePos, baseSector, sameSector);
+            }
+        }
+        return;
+    }
+
     bool foundUser = false;
 
     // Only trigger NPCs that have this percpetion type registered as a reaction.
@@ -1962,22 +1998,7 @@ void psNPCClient::HandleDeath(NPC* who)
 
 void psNPCClient::PerceptProximityItems()
 {
-    //
-    // Note: The follwing method could skeep checking a item for
-    // an iteraction. This because fast delete is used to remove
-    // items from list and than a item on the end might be moved right
-    // into the space just checked.
-    //
-
-    int size = (int)all_gem_items.GetSize();
-    if(!size) return;  // Nothing to do if no items
-
-    int check_count = 50; // We only check 50 items each time. This number has to be tuned
-    if(check_count > size)
-    {
-        // If not more than check_count items don't check them more than once :)
-        check_count = size;
-    }
+    if(all_gem_items.IsEmpty()) return;  // Nothing to do if no items
 
     csList<NPC*> npcList;
     {
@@ -2005,22 +2026,45 @@ void psNPCClient::PerceptProximityItems()
         }
     }
 
-    while(check_count--)
+    // The bounding box of the long range perception reaches to its corners
+    float searchRadius = LONG_RANGE_PERCEPTION * sqrtf(3.0f);
+
+    csArray<gemNPCObject*> nearby;
+    csList<NPC*>::Iterator iter(npcList);
+    while(iter.HasNext())
     {
-        current_long_range_perception_index++;
-        if(current_long_range_perception_index >= (int)all_gem_items.GetSize())
-        {
-            current_long_range_perception_index = 0;
-        }
+        NPC* npc = iter.Next();
 
-        gemNPCItem* item = all_gem_items[current_long_range_perception_index];
+        // skip disabled NPCs
+        if(npc->IsDisabled())
+            continue;
+
+        if(npc->GetActor() == NULL)
+            continue;
 
-        if(item && item->IsPickable())
+        iSector* npc_sector;
+        csVector3 npc_pos;
+        psGameObject::GetPosition(npc->GetActor(), npc_pos, npc_sector);
+
+        nearby.Empty();
+        spatialIndex.FindNearby(npc_sector, npc_pos, INSTANCE_ALL, searchRadius, true, nearby);
+        for(size_t i = 0; i < nearby.GetSize(); i++)
         {
+            gemNPCItem* item = dynamic_cast<gemNPCItem*>(nearby[i]);
+            if(!item || !item->IsPickable())
+                continue;
+
             iSector* item_sector;
             csVector3 item_pos;
             psGameObject::GetPosition(item,item_pos,item_sector);
 
+            // Only percept for items in same sector, NPC will probably not see a item
+            // in other sectors.
+            if(npc_sector != item_sector)
+            {
+                continue;
+            }
+
             // Use bounding boxes to check within perception range. This
             // is faster than using the distance.
             csBox3 bboxLong;
@@ -2033,47 +2077,23 @@ void psNPCClient::PerceptProximityItems()
             bboxPersonal.AddBoundingVertex(item_pos-csVector3(PERSONAL_RANGE_PERCEPTION));
             bboxPersonal.AddBoundingVertexSmart(item_pos+csVector3(PERSONAL_RANGE_PERCEPTION));
 
-            csList<NPC*>::Iterator iter(npcList);
-            while(iter.HasNext())
+            if(npc_pos < bboxLong)
             {
-                NPC* npc = iter.Next();
-
-                // skip disabled NPCs
-                if(npc->IsDisabled())
-                    continue;
-
-                if(npc->GetActor() == NULL)
-                    continue;
-
-                iSector* npc_sector;
-                csVector3 npc_pos;
-                psGameObject::GetPosition(npc->GetActor(), npc_pos, npc_sector);
-
-                // Only percept for items in same sector, NPC will probably not see a item
-                // in other sectors.
-                if(npc_sector != item_sector)
-                {
-                    continue;
-                }
-
-                if(npc_pos < bboxLong)
+                if(npc_pos < bboxShort)
                 {
-                    if(npc_pos < bboxShort)
+                    if(npc_pos < bboxPersonal)
                     {
-                        if(npc_pos < bboxPersonal)
-                        {
-                            ItemPerception pcpt_adjacent("item adjacent", item);
-                            npc->TriggerEvent(&pcpt_adjacent);
-                            continue;
-                        }
-                        ItemPerception pcpt_nearby("item nearby", item);
-                        npc->TriggerEvent(&pcpt_nearby);
+                        ItemPerception pcpt_adjacent("item adjacent", item);
+                        npc->TriggerEvent(&pcpt_adjacent);
                         continue;
                     }
-                    ItemPerception pcpt_sensed("item sensed", item);
-                    npc->TriggerEvent(&pcpt_sensed);
+                    ItemPerception pcpt_nearby("item nearby", item);
+                    npc->TriggerEvent(&pcpt_nearby);
                     continue;
                 }
+                ItemPerception pcpt_sensed("item sensed", item);
+                npc->TriggerEvent(&pcpt_sensed);
+                continue;
             }
         }
     }
@@ -2081,27 +2101,12 @@ void psNPCClient::PerceptProximityItems()
 
 void psNPCClient::PerceptProximityLocations()
 {
-
+    // Each location only looks up the NPCs near it in the spatial index,
+    // so all of them are checked every time.
     int size = locationManager->GetNumberOfLocations();
-
-    if(!size) return;  // Nothing to do if no items
-
-    int check_count = 50; // We only check 50 items each time. This number has to be tuned
-    if(check_count > size)
+    for(int i = 0; i < size; i++)
     {
-        // If not more than check_count items don't check them more than once :)
-        check_count = size;
-    }
-
-    while(check_count--)
-    {
-        current_long_range_perception_loc_index++;
-        if(current_long_range_perception_loc_index >= size)
-        {
-            current_long_range_perception_loc_index = 0;
-        }
-
-        Location* location = locationManager->GetLocation(current_long_range_perception_loc_index);
+        Location* location = locationManager->GetLocation(i);
 
         LocationPerception pcpt_sensed("location sensed", location->type->name, location, engine);
 
@@ -2113,32 +2118,29 @@ void psNPCClient::PerceptProximityLocations()
 
 void psNPCClient::PerceptProximityTribeHome()
 {
-    int size = (int)all_gem_actors.GetSize();
+    if(all_gem_actors.IsEmpty()) return;  // Nothing to do if no actors
 
-    if(!size) return;  // Nothing to do if no items
-
-    int check_count = 50; // We only check 50 items each time. This number has to be tuned
-    if(check_count > size)
-    {
-        // If not more than check_count items don't check them more than once :)
-        check_count = size;
-    }
-
-    while(check_count--)
+    // Find the tribe homes each actor is within, in the order of the tribes.
+    csHash<csArray<Tribe*>, csPtrKey<gemNPCActor> > withinTribes;
+    csArray<gemNPCObject*> nearby;
+    for(size_t i=0; i<tribes.GetSize(); i++)
     {
-        current_tribe_home_perception_index++;
-        if(current_tribe_home_perception_index >= size)
-        {
-            current_tribe_home_perception_index = 0;
-        }
+        Tribe* tribe = tribes[i];
 
-        gemNPCActor* actor = all_gem_actors[current_tribe_home_perception_index];
-        bool within = false;
+        csVector3 home;
+        float radius;
+        iSector* homeSector = NULL;
+        tribe->GetHome(home, radius, homeSector);
+        if(!homeSector)
+            continue;
 
-        // Now we have an actor, check that actor for each tribe.
-        for(size_t i=0; i<tribes.GetSize(); i++)
+        nearby.Empty();
+        spatialIndex.FindNearby(homeSector, home, INSTANCE_ALL, radius, true, nearby);
+        for(size_t j = 0; j < nearby.GetSize(); j++)
         {
-            Tribe* tribe = tribes[i];
+            gemNPCActor* actor = dynamic_cast<gemNPCActor*>(nearby[j]);
+            if(!actor)
+                continue;
 
             csVector3 position;
             iSector* sector;
@@ -2146,21 +2148,41 @@ void psNPCClient::PerceptProximityTribeHome()
 
             if(tribe->CheckWithinBoundsTribeHome(NULL, position, sector))
             {
-                within = true;
-                if(actor->SetWithinTribe(tribe))
+                csArray<Tribe*>* actorTribes = withinTribes.GetElementPointer(actor);
+                if(!actorTribes)
                 {
-                    NPC* npc = actor->GetNPC();
-                    if(npc)
-                    {
-                        // Percept the NPC that it has entered a tribe home
-                        Perception pcpt_entering("tribe_home:entering");
-                        npc->TriggerEvent(&pcpt_entering);
-                    }
+                    withinTribes.Put(actor, csArray<Tribe*>());
+                    actorTribes = withinTribes.GetElementPointer(actor);
+                }
+                actorTribes->PushSmart(tribe);
+            }
+        }
+    }
+
+    for(size_t a=0; a<all_gem_actors.GetSize(); a++)
+    {
+        gemNPCActor* actor = all_gem_actors[a];
+        csArray<Tribe*>* actorTribes = withinTribes.GetElementPointer(actor);
+        bool within = actorTribes != NULL;
 
-                    // Percept all members of the tribe that an actor has entered the tribe home
-                    Perception pcpt_entered("tribe_home:actor_entered");
-                    tribe->TriggerEvent(&pcpt_entered);
+        // Now we have an actor, check that actor for each tribe home it is within.
+        for(size_t i = 0; actorTribes && i < actorTribes->GetSize(); i++)
+        {
+            Tribe* tribe = actorTribes->Get(i);
+
+            if(actor->SetWithinTribe(tribe))
+            {
+                NPC* npc = actor->GetNPC();
+                if(npc)
+                {
+                    // Percept the NPC that it has entered a tribe home
+                    Perception pcpt_entering("tribe_home:entering");
+                    npc->TriggerEvent(&pcpt_entering);
                 }
+
+                // Percept all members of the tribe that an actor has entered the tribe home
+                Perception pcpt_entered("tribe_home:actor_entered");
+                tribe->TriggerEvent(&pcpt_entered);
             }
         }
         if(!within)
@@ -2291,24 +2313,7 @@ csArray<gemNPCObject*> psNPCClient::FindNearbyEntities(iSector* sector, const cs
 {
     csArray<gemNPCObject*> list;
 
-    csRef<iMeshWrapperIterator> obj_it =  engine->GetNearbyMeshes(sector, pos, radius);
-    while(obj_it->HasNext())
-    {
-        iMeshWrapper* m = obj_it->Next();
-        if(!doInvisible)
-        {
-            bool invisible = m->GetFlags().Check(CS_ENTITY_INVISIBLE);
-            if(invisible)
-                continue;
-        }
-
-        gemNPCObject* object = FindAttachedObject(m->QueryObject());
-
-        if(object)
-        {
-            list.Push(object);
-        }
-    }
+    spatialIndex.FindNearby(sector, pos, INSTANCE_ALL, radius, doInvisible, list);
 
     return list;
 }
@@ -2317,18 +2322,11 @@ csArray<gemNPCActor*> psNPCClient::FindNearbyActors(iSector* sector, const csVec
 {
     csArray<gemNPCActor*> list;
 
-    csRef<iMeshWrapperIterator> obj_it =  engine->GetNearbyMeshes(sector, pos, radius);
-    while(obj_it->HasNext())
+    csArray<gemNPCObject*> nearby;
+    spatialIndex.FindNearby(sector, pos, INSTANCE_ALL, radius, doInvisible, nearby);
+    for(size_t i = 0; i < nearby.GetSize(); i++)
     {
-        iMeshWrapper* m = obj_it->Next();
-        if(!doInvisible)
-        {
-            bool invisible = m->GetFlags().Check(CS_ENTITY_INVISIBLE);
-            if(invisible)
-                continue;
-        }
-
-        gemNPCActor* actor = dynamic_cast<gemNPCActor*>(FindAttachedObject(m->QueryObject()));
+        gemNPCActor* actor = dynamic_cast<gemNPCActor*>(nearby[i]);
 
         if(actor)
         {
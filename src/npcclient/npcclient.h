@@ -43,6 +43,7 @@ struct iCollideSystem;
 #include "util/pspath.h"
 #include "util/pspathnetwork.h"
 #include "util/mathscript.h"
+#include "util/spatialgrid.h"
 
 #include "tools/celhpf.h"
 
@@ -320,7 +321,9 @@ public:
      * Sends a perception to all npcs.
      *
      * If macRange is greather than 0.0 only npcs within that range
-     * of the base position will be triggered.
+     * of the base position will be triggered. The npcs near the base
+     * position are then found with the spatial index instead of checking
+     * the range of every npc with the reaction.
      *
      * \sa NPC::TriggerEvent Tribe::TriggerEvent
      *
@@ -547,6 +550,14 @@ public:
         return world;
     }
 
+    /**
+     * Returns the spatial index of all the actors and items.
+     */
+    psSpatialGrid<gemNPCObject>* GetSpatialIndex()
+    {
+        return &spatialIndex;
+    }
+
     iEngine*  GetEngine()
     {
         return engine;
@@ -748,6 +759,9 @@ protected:
     /**
      * Find all items that are close to NPC's and percept the
      * NPC.
+     *
+     * Each NPC with an item reaction looks up the items around it in
+     * the spatial index, so all items are checked every time.
      */
     void PerceptProximityItems();
 
@@ -759,6 +773,9 @@ protected:
 
     /**
      * Find all actors that are in a tribe home and percept tribe and actor if it is an NPC.
+     *
+     * The actors within each tribe home are looked up in the spatial index,
+     * so all actors are checked every time.
      */
     void PerceptProximityTribeHome();
 
@@ -785,6 +802,7 @@ protected:
     csPDelArray<NPC>                npcs;
     csArray<DeferredNPC>            npcsDeferred;
     csPDelArray<Tribe>              tribes;
+    psSpatialGrid<gemNPCObject>     spatialIndex;     ///< Declared before the objects, which leave it when deleted.
     csHash<gemNPCObject*, EID>      all_gem_objects_by_eid;
     csHash<gemNPCObject*, PID>      all_gem_objects_by_pid;
     csPDelArray<gemNPCObject>       all_gem_objects;
@@ -795,6 +813,8 @@ protected:
 
     csHash<NPC*,csString>           allReactions;     ///< Hash of all registered reactions.
     csArray<csString>               notUsedReactions; ///< List of not matched reactions.
+    /// Times each NPC registered each reaction, to find the npcs with a reaction from the spatial index.
+    csHash<csHash<size_t, csPtrKey<NPC> >, csString> reactionCounts;
 
     csRef<iCollideSystem>           cdsys;
 
@@ -805,11 +825,6 @@ protected:
     /// Counter used to start events at every nth client tick
     unsigned int                    tick_counter;
 
-    /// Counters used to distribute load regarding perception generation
-    int                             current_long_range_perception_index;
-    int                             current_long_range_perception_loc_index;
-    int                             current_tribe_home_perception_index;
-
     // Game Time
     int                             gameMinute;
     int                             gameHour;
@@ -33,6 +33,8 @@
 //=============================================================================
 #include "npcmesh.h"
 #include "npcclient.h"
+#include "util/spatialgrid.h"
+#include "gem.h"
 
 npcMesh::npcMesh(iObjectRegistry* objreg, gemNPCObject* owner, psNPCClient* super)
 {
@@ -41,6 +43,10 @@ npcMesh::npcMesh(iObjectRegistry* objreg, gemNPCObject* owner, psNPCClient* supe
     gem = super;
 
     engine = csQueryRegistry<iEngine>(objectReg);
+    if(gem)
+    {
+        moveListener.AttachNew(new psSpatialGridListener<gemNPCObject>(owner, super->GetSpatialIndex()));
+    }
 }
 
 npcMesh::~npcMesh()
@@ -94,6 +100,7 @@ bool npcMesh::SetMesh(const char* factoryName, const char* fileName)
         if(gem)
         {
             gem->AttachObject(mesh->QueryObject(), gemOwner);
+            mesh->GetMovable()->AddListener(moveListener);
         }
         result = true;
     }
@@ -116,6 +123,8 @@ void npcMesh::SetMesh(iMeshWrapper* newMesh)
         if(gem)
         {
             gem->AttachObject(newMesh->QueryObject(), gemOwner);
+            newMesh->GetMovable()->AddListener(moveListener);
+            moveListener->MovableChanged(newMesh->GetMovable());
         }
     }
 }
@@ -126,6 +135,8 @@ void npcMesh::RemoveMesh()
     {
         if(gem)
         {
+            mesh->GetMovable()->RemoveListener(moveListener);
+            gem->GetSpatialIndex()->Remove(gemOwner);
             gem->UnattachObject(mesh->QueryObject(), gemOwner);
         }
         engine->RemoveObject(mesh);
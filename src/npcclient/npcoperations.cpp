@@ -5421,6 +5421,34 @@ bool WanderOperation::WanderRouteFilter::Filter(const Waypoint* waypoint) const
               (!parent->groundValid || waypoint->ground == parent->ground)));
 }
 
+bool WanderOperation::WanderRouteFilter::GetCacheKey(uint32 &key) const
+{
+    // One bit for each entry below, in order: bit 2n is set if waypoint
+    // flag n is checked and bit 2n+1 if the value it must have is true.
+    bool flags[] =
+    {
+        parent->undergroundValid, parent->underground,
+        parent->underwaterValid,  parent->underwater,
+        parent->privValid,        parent->priv,
+        parent->pubValid,         parent->pub,
+        parent->cityValid,        parent->city,
+        parent->indoorValid,      parent->indoor,
+        parent->pathValid,        parent->path,
+        parent->roadValid,        parent->road,
+        parent->groundValid,      parent->ground
+    };
+
+    key = 0;
+    for(size_t i = 0; i < sizeof(flags)/sizeof(flags[0]); i++)
+    {
+        if(flags[i])
+        {
+            key |= 1 << i;
+        }
+    }
+    return true;
+}
+
 bool WanderOperation::StartMoveTo(NPC* npc, psPathPoint* point)
 {
     float dummyAngle;
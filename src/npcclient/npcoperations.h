@@ -1723,6 +1723,7 @@ protected:
     public:
         WanderRouteFilter(WanderOperation*  parent):parent(parent) {};
         virtual bool Filter(const Waypoint* waypoint) const;
+        virtual bool GetCacheKey(uint32 &key) const;
     protected:
         WanderOperation*  parent;
     };
@@ -20,12 +20,16 @@
 
 #include <psconfig.h>
 #include <csutil/stringarray.h>
+#include <iutil/cfgmgr.h>
 
 #include "util/log.h"
 #include "util/consoleout.h"
 
 #include "dal.h"
 
+#include <mysqld_error.h>
+#include <errmsg.h>
+
 // SCF definitions
 
 CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
@@ -75,28 +79,37 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         mysql_options(conn_check, MYSQL_OPT_RECONNECT, &my_true);
     #endif
 
-    #ifdef USE_DELAY_QUERY
-        dqm.AttachNew(new DelayedQueryManager(host, port, database, user, pwd));
-        dqmThread.AttachNew(new Thread(dqm));
-        dqmThread->Start();
-        dqmThread->SetPriority(THREAD_PRIO_HIGH);
-    #endif
+        csRef<iConfigManager> config = csQueryRegistry<iConfigManager>(objectReg);
+        if(config->GetBool("Planeshift.Database.DelayedQuery.Enabled", false))
+        {
+            dqm.AttachNew(new DelayedQueryManager(new DelayedQueryConnection(host, port, database, user, pwd),
+                          config->GetInt("Planeshift.Database.DelayedQuery.HighWater", DELAYED_QUERY_HIGH_WATER),
+                          config->GetInt("Planeshift.Database.DelayedQuery.TransactionSize", DELAYED_QUERY_TRANSACTION_SIZE),
+                          config->GetStr("Planeshift.Database.DelayedQuery.SpillFile", "")));
+            dqmThread.AttachNew(new Thread(dqm));
+            dqmThread->Start();
+            dqmThread->SetPriority(THREAD_PRIO_HIGH);
+        }
 
         return (conn == conn_check);
     }
 
     bool psMysqlConnection::Close()
     {
+        // Run all the delayed statements before shutting down
+        if(dqm)
+        {
+            dqm->Stop();
+            dqmThread->Wait();
+            dqm.Invalidate();
+            dqmThread.Invalidate();
+        }
+
         mysql_close(conn);
         conn = NULL;
 
-    #ifdef USE_DELAY_QUERY
         mysql_thread_end();
 
-        dqm->Stop();
-        dqmThread->Stop();
-    #endif
-
         mysql_library_end();
         return true;
     }
@@ -125,17 +138,19 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
     unsigned long psMysqlConnection::CommandPump(const char *sql,...)
     {
-    #ifdef USE_DELAY_QUERY
-        csString querystr;
-        va_list args;
+        if(dqm)
+        {
+            csString querystr;
+            va_list args;
 
-        va_start(args, sql);
-        querystr.FormatV(sql, args);
-        va_end(args);
-        dqm->Push(querystr);
+            va_start(args, sql);
+            querystr.FormatV(sql, args);
+            va_end(args);
+            dqm->Push(querystr);
+
+            return 1;
+        }
 
-        return 1;
-    #else
         psStopWatch timer;
         csString querystr;
         va_list args;
@@ -160,13 +175,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
             //csString status;
             //status.Format("%s, %d", querystr.GetData(), timer.Stop());
             //logcsv->Write(CSV_SQL, status);
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             return (unsigned long) mysql_affected_rows(conn);
         }
         else
             return QUERY_FAILED;
-
-    #endif
     }
 
     unsigned long psMysqlConnection::Command(const char *sql,...)
@@ -191,7 +204,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             return (unsigned long) mysql_affected_rows(conn);
         }
         else
@@ -220,7 +233,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             iResultSet *rs = new psResultSet(conn);
             return rs;
         }
@@ -250,7 +263,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             psResultSet *rs = new psResultSet(conn);
 
             if (rs->Count())
@@ -412,15 +425,27 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
     const char* psMysqlConnection::DumpProfile()
     {
         profileDump = profs.Dump();
+        if(dqm)
+            profileDump.Append(dqm->Dump());
         return profileDump;
     }
 
     void psMysqlConnection::ResetProfile()
     {
         profs.Reset();
+        if(dqm)
+            dqm->ResetProfile();
         profileDump.Empty();
     }
 
+    csString psMysqlConnection::ExportProfile()
+    {
+        csString profileExport = profs.Export();
+        if(dqm)
+            profileExport.Append(dqm->Export());
+        return profileExport;
+    }
+
     iRecord* psMysqlConnection::NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line)
     {
         return new dbUpdate(conn, table, idfield, count, logcsv, file, line);
@@ -441,6 +466,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
             row.SetMaxFields(fields);
             row.SetResultSet(rs);
 
+            MYSQL_FIELD *fieldinfo = mysql_fetch_fields(rs);
+            for (unsigned long i = 0; i < fields; i++)
+            {
+                columns.Add(fieldinfo[i].name, i);
+            }
+            row.SetColumns(&columns);
+
             current = (unsigned long) -1;
         }
         else
@@ -492,28 +524,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
     const char *psResultRow::operator[](const char *fieldname)
     {
-        MYSQL_FIELD *field;
         CS_ASSERT(fieldname);
         CS_ASSERT(max); // trying to access when no fields returned in row! probably empty resultset.
 
-        int i;
-
-        for ( i=last_index; (field=mysql_fetch_field(rs)); i++)
+        int i = columns ? columns->Find(fieldname) : -1;
+        if (i >= 0 && i < max)
         {
-            if (field->name && !strcasecmp(field->name,fieldname))
-            {
-                last_index = i+1;
-                return rr[i];
-            }
-        }
-        mysql_field_seek(rs, 0);
-        for (i=0; (i<last_index) && (field=mysql_fetch_field(rs)); i++)
-        {
-            if (field->name && !strcasecmp(field->name,fieldname))
-            {
-                last_index = i+1;
-                return rr[i];
-            }
+            return rr[i];
         }
         CPrintf(CON_BUG, "Could not find field %s!. Exiting.\n",fieldname);
         CS_ASSERT(false);
@@ -743,14 +760,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         return prepared;
     }
 
-
-    #ifdef USE_DELAY_QUERY
-
-    DelayedQueryManager::DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd)
+    DelayedQueryConnection::DelayedQueryConnection(const char *host, unsigned int port, const char *database,
+                                                   const char *user, const char *pwd)
     {
-        start=end=0;
-        m_Close = false;
+        m_conn = NULL;
         m_host = csString(host);
         m_port = port;
         m_db = csString(database);
@@ -758,23 +771,16 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         m_pwd = csString(pwd);
     }
 
-    void DelayedQueryManager::Stop()
-    {
-        m_Close = true;
-        datacondition.NotifyOne();
-        CS::Threading::Thread::Yield();
-    }
-
-    void DelayedQueryManager::Run()
+    bool DelayedQueryConnection::Connect()
     {
         mysql_thread_init();
-        MYSQL *conn=mysql_init(NULL);
-        printf("Starting secondary connection with params: %s %s %s %d", m_host.GetData(), m_user.GetData(), m_db.GetData(), m_port);
-        m_conn = mysql_real_connect(conn,m_host,m_user,m_pwd,m_db,m_port,NULL,CLIENT_FOUND_ROWS);
-        if (!m_conn)
+        m_conn = mysql_init(NULL);
+        if(!mysql_real_connect(m_conn,m_host,m_user,m_pwd,m_db,m_port,NULL,CLIENT_FOUND_ROWS))
         {
-            printf("Failed to connect to database: Error: %s\n", mysql_error(conn));
-            return;
+            m_error = mysql_error(m_conn);
+            mysql_close(m_conn);
+            m_conn = NULL;
+            return false;
         }
 
         my_bool my_true = true;
@@ -783,42 +789,32 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         mysql_options(m_conn, MYSQL_OPT_RECONNECT, &my_true);
     #endif
 
-        psStopWatch timer;
-        while(!m_Close)
-        {
-            CS::Threading::MutexScopedLock lock(mutex);
-            datacondition.Wait(mutex);
-            while (start != end)
-            {
-                csString currQuery;
-                {
-                    CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-                    currQuery = arr[end];
-                    end = (end+1) % THREADED_BUFFER_SIZE;
-                }
-                timer.Start();
-                if (!mysql_query(m_conn, currQuery))
-                    profs.AddSQLTime(currQuery, timer.Stop());
-            }
-        }
-        mysql_close(m_conn);
-        mysql_thread_end();
+        return true;
     }
 
-    void DelayedQueryManager::Push(csString query)
+    bool DelayedQueryConnection::Execute(const char* sql)
     {
-        {
-            CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-            size_t tstart = (start+1) % THREADED_BUFFER_SIZE;
-            if (tstart == end)
-            {
-                return;
-            }
-            arr[start] = query;
-            start = tstart;
-        }
-        datacondition.NotifyOne();
+        return mysql_query(m_conn, sql) == 0;
+    }
+
+    const char* DelayedQueryConnection::GetLastError()
+    {
+        return m_conn ? mysql_error(m_conn) : m_error.GetData();
+    }
+
+    bool DelayedQueryConnection::FailureKeepsTransaction()
+    {
+        // Most errors only undo the failed statement, a deadlock or a lost
+        // connection ends the whole transaction
+        unsigned int error = mysql_errno(m_conn);
+        return error != ER_LOCK_DEADLOCK && error != CR_SERVER_GONE_ERROR && error != CR_SERVER_LOST;
+    }
+
+    void DelayedQueryConnection::Disconnect()
+    {
+        mysql_close(m_conn);
+        m_conn = NULL;
+        mysql_thread_end();
     }
-    #endif
 }
 CS_PLUGIN_NAMESPACE_END(dbmysql)
@@ -22,6 +22,8 @@
 #include <csutil/csstring.h>
 #include "util/stringarray.h"
 #include "util/dbprofile.h"
+#include "util/delayedquery.h"
+#include "util/columnindex.h"
 
 using namespace CS::Threading;
 
@@ -29,33 +31,29 @@ struct iObjectRegistry;
 
 CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 {
-    #ifdef USE_DELAY_QUERY
-    #define THREADED_BUFFER_SIZE 300
-    class DelayedQueryManager : public CS::Threading::Runnable
+    /**
+     * The connection the DelayedQueryManager runs the statements on.
+     */
+    class DelayedQueryConnection : public iDelayedQueryConnection
     {
     public:
-        DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd);
-
-        virtual void Run ();
-        void Push(csString query);
-        void Stop();
+        DelayedQueryConnection(const char *host, unsigned int port, const char *database,
+                               const char *user, const char *pwd);
+
+        virtual bool Connect();
+        virtual bool Execute(const char* sql);
+        virtual const char* GetLastError();
+        virtual bool FailureKeepsTransaction();
+        virtual void Disconnect();
     private:
         MYSQL* m_conn;
-        csString arr[THREADED_BUFFER_SIZE];
-        size_t start, end;
-        CS::Threading::Mutex mutex;
-        CS::Threading::RecursiveMutex mutexArray;
-        CS::Threading::Condition datacondition;
-        bool m_Close;
-        psDBProfiles profs;
+        csString m_error;
         csString m_host;
         unsigned int m_port;
         csString m_db;
         csString m_user;
         csString m_pwd;
     };
-    #endif
 
     class psMysqlConnection : public scfImplementation2<psMysqlConnection, iComponent, iDataConnection>
     {
@@ -105,14 +103,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
 
         virtual const char* DumpProfile();
         virtual void ResetProfile();
+        virtual csString ExportProfile();
         
         iRecord* NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line);
         iRecord* NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line);
 
-    #ifdef USE_DELAY_QUERY    
         csRef<DelayedQueryManager> dqm;
         csRef<Thread> dqmThread;
-    #endif    
     };
 
 
@@ -122,18 +119,19 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         MYSQL_ROW rr;
         MYSQL_RES *rs;
         int max;
-        int last_index;
+        const ColumnIndex *columns;
 
     public:
         psResultRow()
         {
             rr = NULL;
             rs = NULL;
-            last_index=0;
+            columns = NULL;
         };
 
         void SetMaxFields(int fields)  {    max = fields;   };
         void SetResultSet(void* resultsettoken);
+        void SetColumns(const ColumnIndex *index)  {    columns = index;    };
 
         int Fetch(int row);
 
@@ -165,6 +163,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbmysql)
         MYSQL_RES *rs;
         unsigned long rows, fields, current;
         psResultRow  row;
+        ColumnIndex  columns;  ///< Built once, used by the rows to find the fields by name
 
     public:
         psResultSet(MYSQL *conn);
@@ -20,18 +20,13 @@
 
 #include <psconfig.h>
 #include <csutil/stringarray.h>
+#include <iutil/cfgmgr.h>
 
 #include "util/log.h"
 #include "util/consoleout.h"
 
 #include "dal.h"
 
-
-//not implemented
-#ifdef USE_DELAY_QUERY
-#undef USE_DELAY_QUERY
-#endif
-
 // SCF definitions
 
 CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
@@ -71,7 +66,8 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         dbConnectString.Format("host=%s dbname=%s user=%s password=%s", host, database, user, pwd);
         if(port)
         {
-            dbConnectString.Append("port=");
+            // The keywords are separated by spaces
+            dbConnectString.Append(" port=");
             dbConnectString += port;
         }
 
@@ -80,18 +76,32 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
             return false;
 
         stmtNum = 0;
-    #ifdef USE_DELAY_QUERY
-        dqm.AttachNew(new DelayedQueryManager(host, port, database, user, pwd));
-        dqmThread.AttachNew(new Thread(dqm));
-        dqmThread->Start();
-        dqmThread->SetPriority(THREAD_PRIO_HIGH);
-    #endif
+        csRef<iConfigManager> config = csQueryRegistry<iConfigManager>(objectReg);
+        if(config->GetBool("Planeshift.Database.DelayedQuery.Enabled", false))
+        {
+            dqm.AttachNew(new DelayedQueryManager(new DelayedQueryConnection(dbConnectString),
+                          config->GetInt("Planeshift.Database.DelayedQuery.HighWater", DELAYED_QUERY_HIGH_WATER),
+                          config->GetInt("Planeshift.Database.DelayedQuery.TransactionSize", DELAYED_QUERY_TRANSACTION_SIZE),
+                          config->GetStr("Planeshift.Database.DelayedQuery.SpillFile", "")));
+            dqmThread.AttachNew(new Thread(dqm));
+            dqmThread->Start();
+            dqmThread->SetPriority(THREAD_PRIO_HIGH);
+        }
 
         return true;
     }
 
     bool psMysqlConnection::Close()
     {
+        // Run all the delayed statements before shutting down
+        if(dqm)
+        {
+            dqm->Stop();
+            dqmThread->Wait();
+            dqm.Invalidate();
+            dqmThread.Invalidate();
+        }
+
         //waits for postgresql to complete and close.
         if(conn)
         {
@@ -130,17 +140,19 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
     unsigned long psMysqlConnection::CommandPump(const char *sql,...)
     {
         
-    #ifdef USE_DELAY_QUERY
-        csString querystr;
-        va_list args;
+        if(dqm)
+        {
+            csString querystr;
+            va_list args;
 
-        va_start(args, sql);
-        querystr.FormatV(sql, args);
-        va_end(args);
-        dqm->Push(querystr);
+            va_start(args, sql);
+            querystr.FormatV(sql, args);
+            va_end(args);
+            dqm->Push(querystr);
+
+            return 1;
+        }
 
-        return 1;
-    #else
         psStopWatch timer;
         csString querystr;
         va_list args;
@@ -167,7 +179,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
             //csString status;
             //status.Format("%s, %d", querystr.GetData(), timer.Stop());
             //logcsv->Write(CSV_SQL, status);
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             lastRow = PQoidValue(res);
             const char *const RowsStr = PQcmdTuples(res);
             return (unsigned long) (RowsStr[0] ? atoi(RowsStr) : 0);
@@ -177,8 +189,6 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
             PQclear(res);
             return QUERY_FAILED;
         }
-
-    #endif
     }
 
     unsigned long psMysqlConnection::Command(const char *sql,...)
@@ -205,7 +215,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             lastRow = PQoidValue(res);
             const char *const RowsStr = PQcmdTuples(res);
             return (unsigned long) (RowsStr[0] ? atoi(RowsStr) : 0);
@@ -242,7 +252,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             iResultSet *rs = new psResultSet(res);
             return rs;
         }
@@ -278,7 +288,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             iResultSet *rs = new psResultSet(res);
 
             if (rs->Count())
@@ -440,15 +450,27 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
     const char* psMysqlConnection::DumpProfile()
     {
         profileDump = profs.Dump();
+        if(dqm)
+            profileDump.Append(dqm->Dump());
         return profileDump;
     }
 
     void psMysqlConnection::ResetProfile()
     {
         profs.Reset();
+        if(dqm)
+            dqm->ResetProfile();
         profileDump.Empty();
     }
 
+    csString psMysqlConnection::ExportProfile()
+    {
+        csString profileExport = profs.Export();
+        if(dqm)
+            profileExport.Append(dqm->Export());
+        return profileExport;
+    }
+
     iRecord* psMysqlConnection::NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line)
     {
         return new dbUpdate(conn, &stmtNum, table, idfield, count, logcsv, file, line);
@@ -467,6 +489,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         row.SetMaxFields(fields);
         row.SetResultSet(rs);
 
+        for (unsigned long i = 0; i < fields; i++)
+        {
+            columns.Add(PQfname(rs, i), i);
+        }
+        row.SetColumns(&columns);
+
         current = (unsigned long) -1;
 
     }
@@ -528,20 +556,12 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         CS_ASSERT(fieldname);
         CS_ASSERT(max); // trying to access when no fields returned in row! probably empty resultset.
       
-        for (int i=0; i < max; i++)
+        int i = columns ? columns->Find(fieldname) : -1;
+        if (i >= 0 && i < max)
         {
-            if (!strcasecmp(PQfname(rs,i),fieldname))
-            {
-                return PQgetvalue(rs, rowNum, i);
-            }
+            return PQgetvalue(rs, rowNum, i);
         }
 
-        //looks like this is bugged in pq library. trips in things like numColumns.
-        /*int column = PQfnumber(rs, fieldname);
-        printf("%s\n", PQgetvalue(rs, rowNum, column));
-        if(column != -1)
-            return PQgetvalue(rs, rowNum, column);*/
-
         CPrintf(CON_BUG, "Could not find field %s!. Exiting.\n",fieldname);
         CS_ASSERT(false);
         return ""; // Illegal name.
@@ -787,82 +807,48 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbpostgresql)
         return prepared;
     }
 
-    //NOT IMPLEMENTED
-    #ifdef USE_DELAY_QUERY
-
-    DelayedQueryManager::DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd)
-    {
-        /*start=end=0;
-        m_Close = false;
-        m_host = csString(host);
-        m_port = port;
-        m_db = csString(database);
-        m_user = csString(user);
-        m_pwd = csString(pwd);*/
-    }
-
-    void DelayedQueryManager::Stop()
+    DelayedQueryConnection::DelayedQueryConnection(const char *connectString)
     {
-        /*m_Close = true;
-        datacondition.NotifyOne();
-        CS::Threading::Thread::Yield();*/
+        m_conn = NULL;
+        m_connectString = csString(connectString);
     }
 
-    void DelayedQueryManager::Run()
+    bool DelayedQueryConnection::Connect()
     {
-        /*mysql_thread_init();
-        MYSQL *conn=mysql_init(NULL);
-        printf("Starting secondary connection with params: %s %s %s %d", m_host.GetData(), m_user.GetData(), m_db.GetData(), m_port);
-        m_conn = mysql_real_connect(conn,m_host,m_user,m_pwd,m_db,m_port,NULL,CLIENT_FOUND_ROWS);
-        if (!m_conn)
+        m_conn = PQconnectdb(m_connectString);
+        if(!m_conn || (PQstatus(m_conn) == CONNECTION_BAD))
         {
-            printf("Failed to connect to database: Error: %s\n", mysql_error(conn));
-            return;
+            m_error = m_conn ? PQerrorMessage(m_conn) : "out of memory";
+            PQfinish(m_conn);
+            m_conn = NULL;
+            return false;
         }
+        return true;
+    }
 
-        my_bool my_true = true;
+    bool DelayedQueryConnection::Execute(const char* sql)
+    {
+        PGresult *res = PQexec(m_conn, sql);
+        bool result = (res && PQresultStatus(res) != PGRES_FATAL_ERROR);
+        PQclear(res);
+        return result;
+    }
 
-    #if MYSQL_VERSION_ID >= 50000
-        mysql_options(m_conn, MYSQL_OPT_RECONNECT, &my_true);
-    #endif
+    const char* DelayedQueryConnection::GetLastError()
+    {
+        return m_conn ? PQerrorMessage(m_conn) : m_error.GetData();
+    }
 
-        psStopWatch timer;
-        while(!m_Close)
-        {
-            CS::Threading::MutexScopedLock lock(mutex);
-            datacondition.Wait(mutex);
-            while (start != end)
-            {
-                csString currQuery;
-                {
-                    CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-                    currQuery = arr[end];
-                    end = (end+1) % THREADED_BUFFER_SIZE;
-                }
-                timer.Start();
-                if (!mysql_query(m_conn, currQuery))
-                    profs.AddSQLTime(currQuery, timer.Stop());
-            }
-        }
-        mysql_close(m_conn);
-        mysql_thread_end();*/
+    bool DelayedQueryConnection::FailureKeepsTransaction()
+    {
+        // Any error aborts the whole transaction
+        return false;
     }
 
-    void DelayedQueryManager::Push(csString query)
-    {/*
-        {
-            CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-            size_t tstart = (start+1) % THREADED_BUFFER_SIZE;
-            if (tstart == end)
-            {
-                return;
-            }
-            arr[start] = query;
-            start = tstart;
-        }
-        datacondition.NotifyOne();*/
+    void DelayedQueryConnection::Disconnect()
+    {
+        PQfinish(m_conn);
+        m_conn = NULL;
     }
-    #endif
 }
 CS_PLUGIN_NAMESPACE_END(dbpostgresql)
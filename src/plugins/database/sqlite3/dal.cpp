@@ -20,17 +20,13 @@
 
 #include <psconfig.h>
 #include <csutil/stringarray.h>
+#include <iutil/cfgmgr.h>
 
 #include "util/log.h"
 #include "util/consoleout.h"
 
 #include "dal.h"
 
-//not implemented
-#ifdef USE_DELAY_QUERY
-#undef USE_DELAY_QUERY
-#endif
-
 // SCF definitions
 CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
 {
@@ -67,18 +63,36 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         if(sqlite3_open(database, &conn) != SQLITE_OK)
             return false;
 
-    #ifdef USE_DELAY_QUERY
-        dqm.AttachNew(new DelayedQueryManager(host, port, database, user, pwd));
-        dqmThread.AttachNew(new Thread(dqm));
-        dqmThread->Start();
-        dqmThread->SetPriority(THREAD_PRIO_HIGH);
-    #endif
+        // Wait for the other connections to the file, like the delayed query
+        // thread, instead of failing
+        sqlite3_busy_timeout(conn, SQLITE_BUSY_TIMEOUT);
+
+        csRef<iConfigManager> config = csQueryRegistry<iConfigManager>(objectReg);
+        if(config->GetBool("Planeshift.Database.DelayedQuery.Enabled", false))
+        {
+            dqm.AttachNew(new DelayedQueryManager(new DelayedQueryConnection(database),
+                          config->GetInt("Planeshift.Database.DelayedQuery.HighWater", DELAYED_QUERY_HIGH_WATER),
+                          config->GetInt("Planeshift.Database.DelayedQuery.TransactionSize", DELAYED_QUERY_TRANSACTION_SIZE),
+                          config->GetStr("Planeshift.Database.DelayedQuery.SpillFile", "")));
+            dqmThread.AttachNew(new Thread(dqm));
+            dqmThread->Start();
+            dqmThread->SetPriority(THREAD_PRIO_HIGH);
+        }
 
         return true;
     }
 
     bool psMysqlConnection::Close()
     {
+        // Run all the delayed statements before shutting down
+        if(dqm)
+        {
+            dqm->Stop();
+            dqmThread->Wait();
+            dqm.Invalidate();
+            dqmThread.Invalidate();
+        }
+
         //waits for sqlite to complete and close.
         if(conn)
         {
@@ -110,17 +124,19 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
     unsigned long psMysqlConnection::CommandPump(const char *sql,...)
     {
         
-    #ifdef USE_DELAY_QUERY
-        csString querystr;
-        va_list args;
+        if(dqm)
+        {
+            csString querystr;
+            va_list args;
 
-        va_start(args, sql);
-        querystr.FormatV(sql, args);
-        va_end(args);
-        dqm->Push(querystr);
+            va_start(args, sql);
+            querystr.FormatV(sql, args);
+            va_end(args);
+            dqm->Push(querystr);
+
+            return 1;
+        }
 
-        return 1;
-    #else
         psStopWatch timer;
         csString querystr;
         va_list args;
@@ -145,13 +161,11 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
             //csString status;
             //status.Format("%s, %d", querystr.GetData(), timer.Stop());
             //logcsv->Write(CSV_SQL, status);
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             return (unsigned long) sqlite3_changes(conn);
         }
         else
             return QUERY_FAILED;
-
-    #endif
     }
 
     unsigned long psMysqlConnection::Command(const char *sql,...)
@@ -176,7 +190,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             return (unsigned long) sqlite3_changes(conn);
         }
         else
@@ -209,7 +223,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             iResultSet *rs = new psResultSet(result, rows, columns);
             return rs;
         }
@@ -244,7 +258,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
                 if(logcsv)
                     logcsv->Write(CSV_STATUS, status);
             }
-            profs.AddSQLTime(querystr, timer.Stop());
+            profs.AddSQLTime(sql, querystr, timer.StopMicro());
             iResultSet *rs = new psResultSet(result, rows, columns);
 
             if (rs->Count())
@@ -402,15 +416,27 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
     const char* psMysqlConnection::DumpProfile()
     {
         profileDump = profs.Dump();
+        if(dqm)
+            profileDump.Append(dqm->Dump());
         return profileDump;
     }
 
     void psMysqlConnection::ResetProfile()
     {
         profs.Reset();
+        if(dqm)
+            dqm->ResetProfile();
         profileDump.Empty();
     }
 
+    csString psMysqlConnection::ExportProfile()
+    {
+        csString profileExport = profs.Export();
+        if(dqm)
+            profileExport.Append(dqm->Export());
+        return profileExport;
+    }
+
     iRecord* psMysqlConnection::NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line)
     {
         return new dbUpdate(conn, table, idfield, count, logcsv, file, line);
@@ -431,6 +457,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
             row.SetMaxFields(columns);
             row.SetResultSet(rs);
 
+            // The first row of the table holds the column names
+            for (int i = 0; i < columns; i++)
+            {
+                columnIndex.Add(rs[i], i);
+            }
+            row.SetColumns(&columnIndex);
+
             current = (unsigned long) -1;
         }
         else
@@ -493,12 +526,10 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         CS_ASSERT(fieldname);
         CS_ASSERT(max); // trying to access when no fields returned in row! probably empty resultset.
 
-        for (int i=0; i <= max; i++)
+        int i = columns ? columns->Find(fieldname) : -1;
+        if (i >= 0 && i < max)
         {
-            if (rs[i] && !strcasecmp(rs[i],fieldname))
-            {
-                return rs[max+(rowNum*max)+i];
-            }
+            return rs[max+(rowNum*max)+i];
         }
 
         CPrintf(CON_BUG, "Could not find field %s!. Exiting.\n",fieldname);
@@ -719,81 +750,48 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         return prepared;
     }
 
-    //NOT IMPLEMENTED
-    #ifdef USE_DELAY_QUERY
-
-    DelayedQueryManager::DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd)
+    DelayedQueryConnection::DelayedQueryConnection(const char *database)
     {
-        /*start=end=0;
-        m_Close = false;
-        m_host = csString(host);
-        m_port = port;
+        m_conn = NULL;
         m_db = csString(database);
-        m_user = csString(user);
-        m_pwd = csString(pwd);*/
-    }
-
-    void DelayedQueryManager::Stop()
-    {
-        /*m_Close = true;
-        datacondition.NotifyOne();
-        CS::Threading::Thread::Yield();*/
     }
 
-    void DelayedQueryManager::Run()
+    bool DelayedQueryConnection::Connect()
     {
-        /*mysql_thread_init();
-        MYSQL *conn=mysql_init(NULL);
-        printf("Starting secondary connection with params: %s %s %s %d", m_host.GetData(), m_user.GetData(), m_db.GetData(), m_port);
-        m_conn = mysql_real_connect(conn,m_host,m_user,m_pwd,m_db,m_port,NULL,CLIENT_FOUND_ROWS);
-        if (!m_conn)
+        if(sqlite3_open(m_db, &m_conn) != SQLITE_OK)
         {
-            printf("Failed to connect to database: Error: %s\n", mysql_error(conn));
-            return;
+            m_error = sqlite3_errmsg(m_conn);
+            sqlite3_close(m_conn);
+            m_conn = NULL;
+            return false;
         }
 
-        my_bool my_true = true;
+        // The main connection uses the same file
+        sqlite3_busy_timeout(m_conn, SQLITE_BUSY_TIMEOUT);
+        return true;
+    }
 
-    #if MYSQL_VERSION_ID >= 50000
-        mysql_options(m_conn, MYSQL_OPT_RECONNECT, &my_true);
-    #endif
+    bool DelayedQueryConnection::Execute(const char* sql)
+    {
+        return sqlite3_exec(m_conn, sql, NULL, NULL, NULL) == SQLITE_OK;
+    }
 
-        psStopWatch timer;
-        while(!m_Close)
-        {
-            CS::Threading::MutexScopedLock lock(mutex);
-            datacondition.Wait(mutex);
-            while (start != end)
-            {
-                csString currQuery;
-                {
-                    CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-                    currQuery = arr[end];
-                    end = (end+1) % THREADED_BUFFER_SIZE;
-                }
-                timer.Start();
-                if (!mysql_query(m_conn, currQuery))
-                    profs.AddSQLTime(currQuery, timer.Stop());
-            }
-        }
-        mysql_close(m_conn);
-        mysql_thread_end();*/
+    const char* DelayedQueryConnection::GetLastError()
+    {
+        return m_conn ? sqlite3_errmsg(m_conn) : m_error.GetData();
     }
 
-    void DelayedQueryManager::Push(csString query)
-    {/*
-        {
-            CS::Threading::RecursiveMutexScopedLock lock(mutexArray);
-            size_t tstart = (start+1) % THREADED_BUFFER_SIZE;
-            if (tstart == end)
-            {
-                return;
-            }
-            arr[start] = query;
-            start = tstart;
-        }
-        datacondition.NotifyOne();*/
+    bool DelayedQueryConnection::FailureKeepsTransaction()
+    {
+        // A failed statement is undone on its own, but a full disk, an I/O
+        // error, running out of memory or a busy database may roll back the
+        // whole transaction. SQLite is back in autocommit mode when it did.
+        return sqlite3_get_autocommit(m_conn) == 0;
+    }
+
+    void DelayedQueryConnection::Disconnect()
+    {
+        while(sqlite3_close(m_conn) != SQLITE_OK);
+        m_conn = NULL;
     }
-    #endif
 }CS_PLUGIN_NAMESPACE_END(dbsqlite3)
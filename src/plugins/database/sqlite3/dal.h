@@ -35,6 +35,8 @@
 #include <csutil/csstring.h>
 #include "util/stringarray.h"
 #include "util/dbprofile.h"
+#include "util/delayedquery.h"
+#include "util/columnindex.h"
 
 using namespace CS::Threading;
 
@@ -42,33 +44,27 @@ struct iObjectRegistry;
 
 CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
 {
-    #ifdef USE_DELAY_QUERY
-    #define THREADED_BUFFER_SIZE 300
-    class DelayedQueryManager : public CS::Threading::Runnable
+    /// Milliseconds a connection waits for the other one to release the file
+    #define SQLITE_BUSY_TIMEOUT 10000
+
+    /**
+     * The connection the DelayedQueryManager runs the statements on.
+     */
+    class DelayedQueryConnection : public iDelayedQueryConnection
     {
     public:
-        DelayedQueryManager(const char *host, unsigned int port, const char *database,
-                                  const char *user, const char *pwd);
+        DelayedQueryConnection(const char *database);
 
-        virtual void Run ();
-        void Push(csString query);
-        void Stop();
+        virtual bool Connect();
+        virtual bool Execute(const char* sql);
+        virtual const char* GetLastError();
+        virtual bool FailureKeepsTransaction();
+        virtual void Disconnect();
     private:
         sqlite3* m_conn;
-        csString arr[THREADED_BUFFER_SIZE];
-        size_t start, end;
-        CS::Threading::Mutex mutex;
-        CS::Threading::RecursiveMutex mutexArray;
-        CS::Threading::Condition datacondition;
-        bool m_Close;
-        psDBProfiles profs;
-        csString m_host;
-        unsigned int m_port;
+        csString m_error;
         csString m_db;
-        csString m_user;
-        csString m_pwd;
     };
-    #endif
 
     class psMysqlConnection : public scfImplementation2<psMysqlConnection, iComponent, iDataConnection>
     {
@@ -117,14 +113,13 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
 
         virtual const char* DumpProfile();
         virtual void ResetProfile();
+        virtual csString ExportProfile();
         
         iRecord* NewUpdatePreparedStatement(const char* table, const char* idfield, unsigned int count, const char* file, unsigned int line);
         iRecord* NewInsertPreparedStatement(const char* table, unsigned int count, const char* file, unsigned int line);
 
-    #ifdef USE_DELAY_QUERY    
         csRef<DelayedQueryManager> dqm;
         csRef<Thread> dqmThread;
-    #endif    
     };
 
 
@@ -134,16 +129,19 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         int rowNum;
         char **rs;
         int max;
+        const ColumnIndex *columns;
 
     public:
         psResultRow()
         {
             rowNum = 0;
             rs = NULL;
+            columns = NULL;
         };
 
         void SetMaxFields(int fields)  {    max = fields;   };
         void SetResultSet(void* resultsettoken);
+        void SetColumns(const ColumnIndex *index)  {    columns = index;    };
 
         int Fetch(int row);
 
@@ -175,6 +173,7 @@ CS_PLUGIN_NAMESPACE_BEGIN(dbsqlite3)
         char **rs;
         unsigned long rows, fields, current;
         psResultRow  row;
+        ColumnIndex  columnIndex;  ///< Built once, used by the rows to find the fields by name
 
     public:
         psResultSet(char **result, int rows, int columns);
@@ -56,6 +56,7 @@
 #include "icachedobject.h"
 #include "advicemanager.h"
 #include "commandmanager.h"
+#include "netmanager.h"
 
 class CachedAuthMessage : public iCachedObject
 {
@@ -377,6 +378,7 @@ void AuthenticationServer::HandleAuthent(MsgEntry* me, Client* notused)
     }
 
     client->SetSecurityLevel(acctinfo->securitylevel);
+    client->SetNetCapabilities(msg.capabilities);
 
     if(csGetTicks() - start > 500)
     {
@@ -535,7 +537,11 @@ void AuthenticationServer::HandleDisconnect(MsgEntry* me,Client* client)
     // Check if this client is allowed to disconnect or if the
     // zombie state should be set
     if(!client->AllowDisconnect())
+    {
+        // Let the network thread disconnect the zombie once it may
+        psserver->GetNetManager()->CheckLinkDeadSoon(client->GetClientNum());
         return;
+    }
 
     psserver->RemovePlayer(me->clientnum, "Your client has disconnected. If you are seeing this message a connection error has likely occurred.");
 }
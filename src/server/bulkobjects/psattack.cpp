@@ -54,6 +54,40 @@
 //=============================================================================
 #include "psquestprereqops.h"
 
+// The script variables of every attack, their IDs are requested only once
+static const MathVarName latencyVar("Latency");
+static const MathVarName distanceVar("Distance");
+static const MathVarName resultVar("Result");
+static const MathVarName actorVar("Actor");
+static const MathVarName weaponVar("Weapon");
+static const MathVarName phyDrainVar("PhyDrain");
+static const MathVarName mntDrainVar("MntDrain");
+static const MathVarName attackerVar("Attacker");
+static const MathVarName targetVar("Target");
+static const MathVarName origTargetVar("OrigTarget");
+static const MathVarName attackWeaponVar("AttackWeapon");
+static const MathVarName attackWeaponSecondaryVar("AttackWeaponSecondary");
+static const MathVarName targetWeaponVar("TargetWeapon");
+static const MathVarName targetWeaponSecondaryVar("TargetWeaponSecondary");
+static const MathVarName attackLocationItemVar("AttackLocationItem");
+static const MathVarName diffXVar("DiffX");
+static const MathVarName diffYVar("DiffY");
+static const MathVarName diffZVar("DiffZ");
+static const MathVarName relatedStatVar("RelatedStat");
+static const MathVarName rangeVar("Range");
+static const MathVarName badRangeVar("BadRange");
+static const MathVarName badAngleVar("BadAngle");
+static const MathVarName missedVar("Missed");
+static const MathVarName dodgedVar("Dodged");
+static const MathVarName blockedVar("Blocked");
+static const MathVarName finalDamageVar("FinalDamage");
+static const MathVarName blockingWeaponVar("BlockingWeapon");
+static const MathVarName armorVar("Armor");
+static const MathVarName armorVsWeaponVar("ArmorVsWeapon");
+static const MathVarName weaponDecayVar("WeaponDecay");
+static const MathVarName blockingDecayVar("BlockingDecay");
+static const MathVarName armorDecayVar("ArmorDecay");
+
 /**********************************************************************************************************/
 
 psAttack::psAttack() :
@@ -141,10 +175,10 @@ bool psAttack::Attack(gemActor* attacker, gemActor* target, INVENTORY_SLOT_NUMBE
     }
 
     MathEnvironment env;
-    env.Define("Latency", latency);
-    env.Define("Distance", dist);
+    env.Define(latencyVar, latency);
+    env.Define(distanceVar, dist);
     attackDelay->Evaluate(&env);
-    MathVar* result = env.Lookup("Result");
+    MathVar* result = env.Lookup(resultVar);
     csTicks delay = (csTicks)result->GetRoundValue();
 
     psCombatAttackGameEvent* event =
@@ -207,13 +241,13 @@ void psAttack::Affect(psCombatAttackGameEvent* event)
     {
         // Input the stamina data
         MathEnvironment env;
-        env.Define("Actor", event->GetAttacker());
-        env.Define("Weapon", weapon);
+        env.Define(actorVar, event->GetAttacker());
+        env.Define(weaponVar, weapon);
 
         (void) psserver->GetCacheManager()->GetStaminaCombat()->Evaluate(&env);
 
-        MathVar* PhyDrain = env.Lookup("PhyDrain");
-        MathVar* MntDrain = env.Lookup("MntDrain");
+        MathVar* PhyDrain = env.Lookup(phyDrainVar);
+        MathVar* MntDrain = env.Lookup(mntDrainVar);
 
         // stop the attack if the attacker has no stamina left
         if((attacker_data->GetStamina(true) < PhyDrain->GetValue()) ||
@@ -438,22 +472,22 @@ int psAttack::CalculateAttack(psCombatAttackGameEvent* event, psItem* subWeapon)
     }
 
     MathEnvironment& env(event->env);
-    env.Define("Attacker",              attacker);
-    env.Define("Target",                target);
-    env.Define("OrigTarget",            target);
-    env.Define("AttackWeapon",          event->GetWeapon());
-    env.Define("AttackWeaponSecondary", subWeapon);
-    env.Define("TargetWeapon",          target_data->Inventory().GetEffectiveWeaponInSlot(event->GetWeaponSlot(), true));
-    env.Define("TargetWeaponSecondary", target_data->Inventory().GetEffectiveWeaponInSlot(otherHand, true));
-    env.Define("AttackLocationItem",    target_data->Inventory().GetEffectiveArmorInSlot(event->AttackLocation));
-    env.Define("DiffX",                 diff.x ? diff.x : 0.00001F); // force minimal value
-    env.Define("DiffY",                 diff.y ? diff.y : 0.00001F); // force minimal value
-    env.Define("DiffZ",                 diff.z ? diff.z : 0.00001F); // force minimal value
-    env.Define("RelatedStat", type ?
+    env.Define(attackerVar,              attacker);
+    env.Define(targetVar,                target);
+    env.Define(origTargetVar,            target);
+    env.Define(attackWeaponVar,          event->GetWeapon());
+    env.Define(attackWeaponSecondaryVar, subWeapon);
+    env.Define(targetWeaponVar,          target_data->Inventory().GetEffectiveWeaponInSlot(event->GetWeaponSlot(), true));
+    env.Define(targetWeaponSecondaryVar, target_data->Inventory().GetEffectiveWeaponInSlot(otherHand, true));
+    env.Define(attackLocationItemVar,    target_data->Inventory().GetEffectiveArmorInSlot(event->AttackLocation));
+    env.Define(diffXVar,                 diff.x ? diff.x : 0.00001F); // force minimal value
+    env.Define(diffYVar,                 diff.y ? diff.y : 0.00001F); // force minimal value
+    env.Define(diffZVar,                 diff.z ? diff.z : 0.00001F); // force minimal value
+    env.Define(relatedStatVar, type ?
                attacker_data->GetSkillRank(type->related_stat).Current() : 0);
 
     float range = attackRange ? attackRange->Evaluate(&env) : 0.0;
-    env.Define("Range", range);
+    env.Define(rangeVar, range);
 
     (void) damage_script->Evaluate(&env);
 
@@ -463,12 +497,12 @@ int psAttack::CalculateAttack(psCombatAttackGameEvent* event, psItem* subWeapon)
         env.DumpAllVars();
     }
 
-    MathVar* badrange = env.Lookup("BadRange");    // BadRange = Target is too far away
-    MathVar* badangle = env.Lookup("BadAngle");    // BadAngle = Attacker doesn't aim at enemy
-    MathVar* missed   = env.Lookup("Missed");      // Missed   = Attack missed the enemy
-    MathVar* dodged   = env.Lookup("Dodged");      // Dodged   = Attack dodged  by enemy
-    MathVar* blocked  = env.Lookup("Blocked");     // Blocked  = Attack blocked by enemy
-    MathVar* damage   = env.Lookup("FinalDamage"); // Actual damage done, if any
+    MathVar* badrange = env.Lookup(badRangeVar);    // BadRange = Target is too far away
+    MathVar* badangle = env.Lookup(badAngleVar);    // BadAngle = Attacker doesn't aim at enemy
+    MathVar* missed   = env.Lookup(missedVar);      // Missed   = Attack missed the enemy
+    MathVar* dodged   = env.Lookup(dodgedVar);      // Dodged   = Attack dodged  by enemy
+    MathVar* blocked  = env.Lookup(blockedVar);     // Blocked  = Attack blocked by enemy
+    MathVar* damage   = env.Lookup(finalDamageVar); // Actual damage done, if any
 
     if(badrange && badrange->GetValue() < 0.0)
         return ATTACK_OUTOFRANGE;
@@ -489,7 +523,7 @@ int psAttack::CalculateAttack(psCombatAttackGameEvent* event, psItem* subWeapon)
 void psAttack::AffectTarget(gemActor* target, psCombatAttackGameEvent* event, int attack_result)
 {
     // Redefine the target
-    event->env.Define("Target", target);
+    event->env.Define(targetVar, target);
 
     gemActor* attacker = event->GetAttacker();
     psCharacter* attacker_data = attacker->GetCharacterData();
@@ -515,17 +549,17 @@ void psAttack::AffectTarget(gemActor* target, psCombatAttackGameEvent* event, in
         ArmorVsWeapon = ArmorVsWeapon > 1.0F ? 1.0F : ArmorVsWeapon < 0.0F ? 0.0F : ArmorVsWeapon;
 
         MathEnvironment& env(event->env);
-        env.Define("Weapon", weapon);                             // weapon used in the attack
-        env.Define("BlockingWeapon", blockingWeapon);             // weapon that blocked the attack
-        env.Define("Armor", struckArmor);                         // armor hit
-        env.Define("ArmorVsWeapon", ArmorVsWeapon);               // armor vs weapon effectiveness
-        env.Define("Blocked", (attack_result == ATTACK_BLOCKED)); // identifies whether this attack was blocked
+        env.Define(weaponVar, weapon);                             // weapon used in the attack
+        env.Define(blockingWeaponVar, blockingWeapon);             // weapon that blocked the attack
+        env.Define(armorVar, struckArmor);                         // armor hit
+        env.Define(armorVsWeaponVar, ArmorVsWeapon);               // armor vs weapon effectiveness
+        env.Define(blockedVar, (attack_result == ATTACK_BLOCKED)); // identifies whether this attack was blocked
 
         (void) psserver->GetCacheManager()->GetCalcDecay()->Evaluate(&env);
 
-        weaponDecay = env.Lookup("WeaponDecay");
-        blockDecay  = env.Lookup("BlockingDecay");
-        armorDecay  = env.Lookup("ArmorDecay");
+        weaponDecay = env.Lookup(weaponDecayVar);
+        blockDecay  = env.Lookup(blockingDecayVar);
+        armorDecay  = env.Lookup(armorDecayVar);
     }
 
     switch(attack_result)
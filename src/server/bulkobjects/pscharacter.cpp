@@ -62,6 +62,7 @@
 // Local Includes
 //=============================================================================
 #include "pscharacterloader.h"
+#include "psitemsaver.h"
 #include "psglyph.h"
 #include "psquest.h"
 #include "dictionary.h"
@@ -74,6 +75,7 @@
 #include "adminmanager.h"
 #include "scripting.h"
 #include "pscharquestmgr.h"
+#include "pscharacterqueries.h"
 
 // The sizes and scripts need balancing.  For now, maxSize is disabled.
 #define ENABLE_MAX_CAPACITY 0
@@ -81,6 +83,33 @@
 
 const char* psCharacter::characterTypeName[] = { "player", "npc", "pet", "mount", "mountpet" };
 
+// The script variables of the combat and progression scripts run for every
+// attack and practice, their IDs are requested only once
+static const MathVarName actorVar("Actor");
+static const MathVarName characterVar("Character");
+static const MathVarName resultVar("Result");
+static const MathVarName zCostVar("ZCost");
+static const MathVarName yCostVar("YCost");
+static const MathVarName zCostNextVar("ZCostNext");
+static const MathVarName yCostNextVar("YCostNext");
+static const MathVarName practicePointsVar("PracticePoints");
+static const MathVarName modifierVar("Modifier");
+static const MathVarName expVar("Exp");
+static const MathVarName weaponVar("Weapon");
+static const MathVarName phyDrainVar("PhyDrain");
+static const MathVarName mntDrainVar("MntDrain");
+static const MathVarName heavyPointsVar("HeavyPoints");
+static const MathVarName mediumPointsVar("MediumPoints");
+static const MathVarName lightPointsVar("LightPoints");
+static const MathVarName baseCostVar("BaseCost");
+static const MathVarName skillRankVar("SkillRank");
+static const MathVarName skillIDVar("SkillID");
+static const MathVarName practiceFactorVar("PracticeFactor");
+static const MathVarName mentalFactorVar("MentalFactor");
+static const MathVarName physicalVar("Physical");
+static const MathVarName maxManaVar("MaxMana");
+static const MathVarName maxHPVar("MaxHP");
+
 //-----------------------------------------------------------------------------
 
 
@@ -176,6 +205,10 @@ psCharacter::psCharacter() : inventory(this),
 
 psCharacter::~psCharacter()
 {
+    // Queued item saves need the owner, write them before it is gone
+    if(psServer::CharacterLoader.GetItemSaver())
+        psServer::CharacterLoader.GetItemSaver()->Capture(this);
+
     if(guildinfo)
         guildinfo->Disconnect(this);
 
@@ -205,7 +238,7 @@ void psCharacter::SetActor(gemActor* newActor)
     }
 }
 
-bool psCharacter::Load(iResultRow &row)
+bool psCharacter::Load(iResultRow &row, iDataConnection* connection)
 {
 
     // TODO:  Link in account ID?
@@ -309,7 +342,7 @@ bool psCharacter::Load(iResultRow &row)
     overrideMaxHp = GetMaxHP().Base();
     overrideMaxMana = GetMaxMana().Base();
 
-    if(!LoadSkills(use_id))
+    if(!LoadSkills(use_id, connection))
     {
         Error2("Cannot load skills for Character %s. Character loading failed.", ShowID(pid));
         return false;
@@ -404,7 +437,7 @@ bool psCharacter::Load(iResultRow &row)
     timeconnected        = row.GetUInt32("time_connected_sec");
     startTimeThisSession = csGetTicks();
 
-    if(!LoadTraits(use_id))
+    if(!LoadTraits(use_id, connection))
     {
         Error2("Cannot load traits for Character %s. Character loading failed.", ShowID(pid));
         return false;
@@ -421,7 +454,7 @@ bool psCharacter::Load(iResultRow &row)
     // This data is loaded only if it's a player, not an NPC
     if(!IsNPC() && !IsPet())
     {
-        if(!questManager.LoadQuestAssignments())
+        if(!questManager.LoadQuestAssignments(connection))
         {
             Error2("Cannot load quest assignments for Character %s. Character loading failed.", ShowID(pid));
             return false;
@@ -446,7 +479,7 @@ bool psCharacter::Load(iResultRow &row)
     {
         // This has a master npc template, so load character specific items
         // from the master npc.
-        if(!inventory.Load(use_id))
+        if(!inventory.Load(use_id, connection))
         {
             Error2("Cannot load character specific items for Character %s. Character loading failed.", ShowID(pid));
             return false;
@@ -454,7 +487,7 @@ bool psCharacter::Load(iResultRow &row)
     }
     else
     {
-        inventory.Load();
+        inventory.Load(connection);
     }
 
     if(csGetTicks() - start > 500)
@@ -464,18 +497,18 @@ bool psCharacter::Load(iResultRow &row)
                       csGetTicks() - start, ShowID(pid), __FILE__, __LINE__);
         psserver->GetLogCSV()->Write(CSV_STATUS, status);
     }
-    if(!LoadRelationshipInfo(pid))  // Buddies, Marriage Info, Familiars
+    if(!LoadRelationshipInfo(pid, connection))  // Buddies, Marriage Info, Familiars
     {
         return false;
     }
 
     factions = new FactionSet(NULL, psserver->GetCacheManager()->GetFactionHash());
-    if(!LoadFactions(pid))
+    if(!LoadFactions(pid, connection))
     {
         return false;
     }
 
-    if(!LoadVariables(use_id))
+    if(!LoadVariables(use_id, connection))
     {
         return false;
     }
@@ -491,7 +524,7 @@ bool psCharacter::Load(iResultRow &row)
     // Load merchant info
     csRef<psMerchantInfo> merchant;
     merchant.AttachNew(new psMerchantInfo());
-    if(merchant->Load(use_id))
+    if(merchant->Load(use_id, connection))
     {
         merchantInfo = merchant;
     }
@@ -506,7 +539,7 @@ bool psCharacter::Load(iResultRow &row)
     // Load trainer info
     csRef<psTrainerInfo> trainer;
     trainer.AttachNew(new psTrainerInfo());
-    if(trainer->Load(use_id))
+    if(trainer->Load(use_id, connection))
     {
         trainerInfo = trainer;
     }
@@ -518,7 +551,7 @@ bool psCharacter::Load(iResultRow &row)
                       csGetTicks() - start, ShowID(pid), __FILE__, __LINE__);
         psserver->GetLogCSV()->Write(CSV_STATUS, status);
     }
-    if(!LoadSpells(use_id))
+    if(!LoadSpells(use_id, connection))
     {
         Error2("Cannot load spells for Character %s. Character loading failed.", ShowID(pid));
         return false;
@@ -570,7 +603,7 @@ bool psCharacter::QuickLoad(iResultRow &row, bool noInventory)
     {
         SetRaceInfo(raceinfo);
 
-        if(!LoadTraits(pid))
+        if(!LoadTraits(pid, db))
         {
             Error2("Cannot load traits for Character %s.", ShowID(pid));
             return false;
@@ -583,11 +616,11 @@ bool psCharacter::QuickLoad(iResultRow &row, bool noInventory)
     return true;
 }
 
-bool psCharacter::LoadRelationshipInfo(PID pid)
+bool psCharacter::LoadRelationshipInfo(PID pid, iDataConnection* connection)
 {
     // To reduce number of queries load all releationships types and sorte them out in the later load functions.
-    Result has_a(db->Select("SELECT a.*, b.name AS \"buddy_name\" FROM character_relationships a, characters b WHERE a.character_id = %u AND a.related_id = b.id order by a.character_id", pid.Unbox()));
-    Result of_a(db->Select("SELECT a.*, b.name AS \"buddy_name\" FROM character_relationships a, characters b WHERE a.related_id = %u AND a.character_id = b.id order by a.related_id", pid.Unbox()));
+    Result has_a(connection->Select(CHARACTER_RELATIONSHIPS_QUERY, pid.Unbox()));
+    Result of_a(connection->Select(CHARACTER_RELATED_QUERY, pid.Unbox()));
 
     if(!LoadFamiliar(has_a, of_a))
     {
@@ -641,9 +674,9 @@ void psCharacter::UpdateFactions()
     }
 }
 
-bool psCharacter::LoadFactions(PID pid)
+bool psCharacter::LoadFactions(PID pid, iDataConnection* connection)
 {
-    Result factions(db->Select("SELECT faction_id, value from character_factions where character_id = %u", pid.Unbox()));
+    Result factions(connection->Select(CHARACTER_FACTIONS_QUERY, pid.Unbox()));
 
     if(factions.IsValid())
     {
@@ -681,9 +714,9 @@ void psCharacter::UpdateVariables()
     }
 }
 
-bool psCharacter::LoadVariables(PID pid)
+bool psCharacter::LoadVariables(PID pid, iDataConnection* connection)
 {
-    Result variables(db->Select("SELECT name, value from character_variables where character_id = %u", pid.Unbox()));
+    Result variables(connection->Select(CHARACTER_VARIABLES_QUERY, pid.Unbox()));
 
     if(variables.IsValid())
     {
@@ -696,9 +729,9 @@ bool psCharacter::LoadVariables(PID pid)
     return true;
 }
 
-void psCharacter::LoadIntroductions()
+void psCharacter::LoadIntroductions(iDataConnection* connection)
 {
-    Result r = db->Select("SELECT * FROM introductions WHERE charid=%d", pid.Unbox());
+    Result r = connection->Select(CHARACTER_INTRODUCTIONS_QUERY, pid.Unbox());
     if(r.IsValid())
     {
         for(unsigned long i = 0; i < r.Count(); i++)
@@ -873,10 +906,10 @@ double psCharacter::GetPetElapsedTime() const
     return petElapsedTime;
 }
 
-bool psCharacter::LoadSpells(PID use_id)
+bool psCharacter::LoadSpells(PID use_id, iDataConnection* connection)
 {
     // Load spells in asc since we use push to create the spell list.
-    Result spells(db->Select("SELECT * FROM player_spells WHERE player_id=%u ORDER BY spell_slot ASC", use_id.Unbox()));
+    Result spells(connection->Select(CHARACTER_SPELLS_QUERY, use_id.Unbox()));
     if(spells.IsValid())
     {
         int i,count=spells.Count();
@@ -897,10 +930,10 @@ bool psCharacter::LoadSpells(PID use_id)
         return false;
 }
 
-bool psCharacter::LoadSkills(PID use_id)
+bool psCharacter::LoadSkills(PID use_id, iDataConnection* connection)
 {
     // Load skills
-    Result skillResult(db->Select("SELECT * FROM character_skills WHERE character_id=%u", use_id.Unbox()));
+    Result skillResult(connection->Select(CHARACTER_SKILLS_QUERY, use_id.Unbox()));
 
     for(size_t z = 0; z < psserver->GetCacheManager()->GetSkillAmount(); z++)
     {
@@ -928,10 +961,10 @@ bool psCharacter::LoadSkills(PID use_id)
     return true;
 }
 
-bool psCharacter::LoadTraits(PID use_id)
+bool psCharacter::LoadTraits(PID use_id, iDataConnection* connection)
 {
     // Load traits
-    Result traits(db->Select("SELECT * FROM character_traits WHERE character_id=%u", use_id.Unbox()));
+    Result traits(connection->Select(CHARACTER_TRAITS_QUERY, use_id.Unbox()));
     if(traits.IsValid())
     {
         unsigned int i;
@@ -1277,15 +1310,15 @@ unsigned int psCharacter::CalculateAddExperience(PSSKILL skill, unsigned int pra
     if(practicePoints > 0)
     {
         MathEnvironment env;
-        env.Define("ZCost", skills.Get(skill).zCost);
-        env.Define("YCost", skills.Get(skill).yCost);
-        env.Define("ZCostNext", skills.Get(skill).zCostNext);
-        env.Define("YCostNext", skills.Get(skill).yCostNext);
-        env.Define("Character", this);
-        env.Define("PracticePoints", practicePoints);
-        env.Define("Modifier", modifier);
+        env.Define(zCostVar, skills.Get(skill).zCost);
+        env.Define(yCostVar, skills.Get(skill).yCost);
+        env.Define(zCostNextVar, skills.Get(skill).zCostNext);
+        env.Define(yCostNextVar, skills.Get(skill).yCostNext);
+        env.Define(characterVar, this);
+        env.Define(practicePointsVar, practicePoints);
+        env.Define(modifierVar, modifier);
         (void) psserver->GetCacheManager()->GetExpSkillCalc()->Evaluate(&env);
-        unsigned int experiencePoints = env.Lookup("Exp")->GetRoundValue();
+        unsigned int experiencePoints = env.Lookup(expVar)->GetRoundValue();
 
         if(GetActor()->GetClient()->GetSecurityLevel() >= GM_DEVELOPER)
         {
@@ -1772,13 +1805,13 @@ void psCharacter::CombatDrain(int slot)
         return;
 
     MathEnvironment env;
-    env.Define("Actor", GetActor());
-    env.Define("Weapon", weapon);
+    env.Define(actorVar, GetActor());
+    env.Define(weaponVar, weapon);
 
     (void) psserver->GetCacheManager()->GetStaminaCombat()->Evaluate(&env);
 
-    MathVar* phyDrain = env.Lookup("PhyDrain");
-    MathVar* mntDrain = env.Lookup("MntDrain");
+    MathVar* phyDrain = env.Lookup(phyDrainVar);
+    MathVar* mntDrain = env.Lookup(mntDrainVar);
     if(!phyDrain || !mntDrain)
     {
         Error1("Failed to evaluate MathScript >StaminaCombat<.");
@@ -2142,14 +2175,14 @@ float psCharacter::GetDodgeValue()
     MathEnvironment env;
 
     // Add actor to manipulate and points to calculate.
-    env.Define("Actor", this);
-    env.Define("HeavyPoints", heavy_p);
-    env.Define("MediumPoints", med_p);
-    env.Define("LightPoints", light_p);
+    env.Define(actorVar, this);
+    env.Define(heavyPointsVar, heavy_p);
+    env.Define(mediumPointsVar, med_p);
+    env.Define(lightPointsVar, light_p);
 
     (void) psserver->GetCacheManager()->GetDodgeValueCalc()->Evaluate(&env);
 
-    return env.Lookup("Result")->GetValue();
+    return env.Lookup(resultVar)->GetValue();
 }
 
 /**
@@ -2885,18 +2918,18 @@ void Skill::CalculateCosts(psCharacter* user)
     }
 
     MathEnvironment env;
-    env.Define("BaseCost",       info->baseCost);
-    env.Define("SkillRank",      rank.Base());
-    env.Define("SkillID",        info->id);
-    env.Define("PracticeFactor", info->practice_factor);
-    env.Define("MentalFactor",   info->mental_factor);
-    env.Define("Actor",          user);
+    env.Define(baseCostVar,       info->baseCost);
+    env.Define(skillRankVar,      rank.Base());
+    env.Define(skillIDVar,        info->id);
+    env.Define(practiceFactorVar, info->practice_factor);
+    env.Define(mentalFactorVar,   info->mental_factor);
+    env.Define(actorVar,          user);
 
     (void) script->Evaluate(&env);
 
-    MathVar* yCostVar = env.Lookup("YCost");
-    MathVar* zCostVar = env.Lookup("ZCost");
-    if(!yCostVar || !zCostVar)
+    MathVar* yCostResult = env.Lookup(yCostVar);
+    MathVar* zCostResult = env.Lookup(zCostVar);
+    if(!yCostResult || !zCostResult)
     {
         Error4("Failed to evaluate MathScript >%s< to calculate skill cost of %d (%s).",
                info->costScript.GetData(), info->id, info->name.GetData());
@@ -2904,15 +2937,15 @@ void Skill::CalculateCosts(psCharacter* user)
     }
 
     // Get the output
-    yCost = yCostVar->GetRoundValue();
-    zCost = zCostVar->GetRoundValue();
+    yCost = yCostResult->GetRoundValue();
+    zCost = zCostResult->GetRoundValue();
 
     //calculate the next level costs. Used by the CalculateAddExperience.
-    env.Define("SkillRank",      rank.Base()+1);
+    env.Define(skillRankVar,      rank.Base()+1);
     script->Evaluate(&env);
 
-    yCostNext = yCostVar->GetRoundValue();
-    zCostNext = zCostVar->GetRoundValue();
+    yCostNext = yCostResult->GetRoundValue();
+    zCostNext = zCostResult->GetRoundValue();
 
     /*
         // Make sure the y values is clamped to the cost.  Otherwise Practice may always
@@ -3003,19 +3036,19 @@ void psCharacter::SetSkillRank(PSSKILL which, unsigned int rank)
 unsigned int psCharacter::GetCharLevel(bool physical)
 {
     MathEnvironment env;
-    env.Define("Actor", this);
-    env.Define("Physical", (physical ? 1 : 0));
+    env.Define(actorVar, this);
+    env.Define(physicalVar, (physical ? 1 : 0));
 
     (void) psserver->GetCacheManager()->GetCharLevelGet()->Evaluate(&env);
 
-    return env.Lookup("Result")->GetRoundValue();
+    return env.Lookup(resultVar)->GetRoundValue();
 }
 
 //This function recalculates Hp, Mana, and Stamina when needed (char creation, combats, training sessions)
 void psCharacter::RecalculateStats()
 {
     MathEnvironment env; // safe enough to reuse...and faster...
-    env.Define("Actor", this);
+    env.Define(actorVar, this);
 
     if(overrideMaxMana)
     {
@@ -3024,7 +3057,7 @@ void psCharacter::RecalculateStats()
     else
     {
         (void) psserver->GetCacheManager()->GetMaxManaScript()->Evaluate(&env);
-        MathVar* maxMana = env.Lookup("MaxMana");
+        MathVar* maxMana = env.Lookup(maxManaVar);
         if(maxMana)
         {
             GetMaxMana().SetBase(maxMana->GetValue());
@@ -3042,7 +3075,7 @@ void psCharacter::RecalculateStats()
     else
     {
         (void) psserver->GetCacheManager()->GetMaxHPScript()->Evaluate(&env);
-        MathVar* maxHP = env.Lookup("MaxHP");
+        MathVar* maxHP = env.Lookup(maxHPVar);
         GetMaxHP().SetBase(maxHP->GetValue());
     }
 
@@ -79,6 +79,7 @@ struct psTrait;
 class psWorkGameEvent;
 
 struct Result;
+struct iDataConnection;
 struct Faction;
 
 /**
@@ -668,7 +669,13 @@ public:
 
     virtual ~psCharacter();
 
-    bool Load(iResultRow &row);
+    /**
+     * Load the character from its row in the characters table.
+     *
+     * @param connection Runs the selects of the character, the main
+     *                   connection or one answering prefetched results.
+     */
+    bool Load(iResultRow &row, iDataConnection* connection);
 
     bool IsStatue()
     {
@@ -814,7 +821,7 @@ public:
     /// Load the bare minimum to know what this character is looks like
     bool QuickLoad(iResultRow &row, bool noInventory);
 
-    void LoadIntroductions();
+    void LoadIntroductions(iDataConnection* connection);
 
     void LoadActiveSpells();
     void AddSpell(psSpell* spell);
@@ -1685,16 +1692,16 @@ public:
 
 protected:
 
-    bool LoadSpells(PID use_id);
+    bool LoadSpells(PID use_id, iDataConnection* connection);
     bool LoadAdvantages(PID use_id);
-    bool LoadSkills(PID use_id);
-    bool LoadTraits(PID use_id);
-    bool LoadRelationshipInfo(PID pid);
+    bool LoadSkills(PID use_id, iDataConnection* connection);
+    bool LoadTraits(PID use_id, iDataConnection* connection);
+    bool LoadRelationshipInfo(PID pid, iDataConnection* connection);
     bool LoadBuddies(Result &myBuddy, Result &buddyOf);
     bool LoadMarriageInfo(Result &result);
     bool LoadFamiliar(Result &pet, Result &owner);
     /// Helper function which loads the factions from the database.
-    bool LoadFactions(PID pid);
+    bool LoadFactions(PID pid, iDataConnection* connection);
     /// Helper function which saves the factions to the database.
     void UpdateFactions();
 
@@ -1702,7 +1709,7 @@ protected:
      * Helper function which loads the character variables from the database.
      * @return TRUE always. bool was used for consistancy.
      */
-    bool LoadVariables(PID pid);
+    bool LoadVariables(PID pid, iDataConnection* connection);
 
     /**
      * Helper function which saves the character variables to the database.
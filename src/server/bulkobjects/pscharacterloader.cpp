@@ -31,6 +31,7 @@
 //=============================================================================
 #include "util/log.h"
 #include "util/gameevent.h"
+#include "util/eventmanager.h"
 #include "util/psdatabase.h"
 
 #include "rpgrules/factions.h"
@@ -60,14 +61,20 @@
 #include "client.h"
 #include "psserverchar.h"
 #include "marriagemanager.h"
+#include "pscharacterprefetcher.h"
+#include "pscharacterqueries.h"
+#include "psitemsaver.h"
 
 psCharacterLoader::psCharacterLoader()
+    :prefetcher(NULL),itemSaver(NULL),asyncLoads(0),asyncBuildTime(0)
 {
 }
 
 
 psCharacterLoader::~psCharacterLoader()
 {
+    StopAsyncLoading();
+    StopItemSaver();
 }
 
 bool psCharacterLoader::Initialize()
@@ -151,7 +158,7 @@ psCharacter** psCharacterLoader::LoadAllNPCCharacterData(psSectorInfo* sector,in
     for(i=0; i<npcs.Count(); i++)
     {
         charlist[count]=new psCharacter();
-        if(!charlist[count]->Load(npcs[i]))
+        if(!charlist[count]->Load(npcs[i], db))
         {
             delete charlist[count];
             charlist[count]=NULL;
@@ -164,6 +171,15 @@ psCharacter** psCharacterLoader::LoadAllNPCCharacterData(psSectorInfo* sector,in
 }
 
 psCharacter* psCharacterLoader::LoadCharacterData(PID pid, bool forceReload)
+{
+    psCharacter* chardata = LoadCachedCharacterData(pid, forceReload);
+    if(chardata)
+        return chardata;
+
+    return LoadCharacterFromDB(pid, db);
+}
+
+psCharacter* psCharacterLoader::LoadCachedCharacterData(PID pid, bool forceReload)
 {
     //if (!forceReload)
     //{
@@ -190,11 +206,127 @@ psCharacter* psCharacterLoader::LoadCharacterData(PID pid, bool forceReload)
     }
     //}
 
+    return NULL;
+}
+
+void psCharacterLoader::LoadCharacterDataAsync(PID pid, bool forceReload, iCharacterLoadCallback* callback)
+{
+    psCharacter* chardata = LoadCachedCharacterData(pid, forceReload);
+    if(chardata || !prefetcher)
+    {
+        if(!chardata)
+            chardata = LoadCharacterFromDB(pid, db);
+
+        callback->CharacterLoaded(pid, chardata);
+        delete callback;
+        return;
+    }
+
+    FlushItems(pid);
+    prefetcher->Queue(new psCharacterPrefetch(pid, callback));
+}
+
+void psCharacterLoader::PrefetchCharacterData(PID pid, iCharacterLoadCallback* callback)
+{
+    if(!prefetcher)
+    {
+        callback->CharacterLoaded(pid, LoadCharacterFromDB(pid, db));
+        delete callback;
+        return;
+    }
+
+    FlushItems(pid);
+    prefetcher->Queue(new psCharacterPrefetch(pid, callback));
+}
+
+void psCharacterLoader::FinishLoadCharacterData(psCharacterPrefetch* prefetch)
+{
+    csMicroTicks start = csGetMicroTicks();
+
+    // The selects of the character are answered from the prefetched results,
+    // anything else run while loading still goes to db.
+    csRef<psPrefetchedConnection> connection;
+    connection.AttachNew(new psPrefetchedConnection(db, prefetch));
+
+    psCharacter* chardata = LoadCharacterFromDB(prefetch->pid, connection);
+
+    csMicroTicks buildTime = csGetMicroTicks() - start;
+    asyncLoads++;
+    asyncBuildTime += buildTime;
+
+    Debug5(LOG_CACHE, prefetch->pid.Unbox(), "Loaded %s with %u prefetched queries in %u us, %u ms after the request.",
+           ShowID(prefetch->pid), connection->GetHits(), (unsigned int)buildTime, csGetTicks() - prefetch->queued);
+
+    PID pid = prefetch->pid;
+    iCharacterLoadCallback* callback = prefetch->callback;
+    prefetch->callback = NULL;
+    delete prefetch;
+
+    callback->CharacterLoaded(pid, chardata);
+    delete callback;
+}
+
+bool psCharacterLoader::StartAsyncLoading(iObjectRegistry* objreg, int threads, const char* host, unsigned int port,
+                                          const char* user, const char* pwd, const char* database)
+{
+    StopAsyncLoading();
+
+    prefetcher = new psCharacterPrefetcher();
+    if(!prefetcher->Start(objreg, threads, host, port, user, pwd, database))
+    {
+        delete prefetcher;
+        prefetcher = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void psCharacterLoader::StopAsyncLoading()
+{
+    delete prefetcher;
+    prefetcher = NULL;
+}
+
+bool psCharacterLoader::StartItemSaver(iObjectRegistry* objreg, csTicks interval, const char* host, unsigned int port,
+                                       const char* user, const char* pwd, const char* database)
+{
+    StopItemSaver();
+
+    itemSaver = new psItemSaver();
+    if(!itemSaver->Start(objreg, interval, host, port, user, pwd, database))
+    {
+        delete itemSaver;
+        itemSaver = NULL;
+        return false;
+    }
 
-    // Now load from the database if not found in cache
+    return true;
+}
+
+void psCharacterLoader::StopItemSaver()
+{
+    // Items saved from now on are written at once
+    psItemSaver* saver = itemSaver;
+    itemSaver = NULL;
+    delete saver;
+}
+
+void psCharacterLoader::FlushItems(PID pid)
+{
+    if(itemSaver)
+    {
+        itemSaver->FlushCharacter(pid);
+    }
+}
+
+psCharacter* psCharacterLoader::LoadCharacterFromDB(PID pid, iDataConnection* connection)
+{
     csTicks start = csGetTicks();
 
-    Result result(db->Select("SELECT * FROM characters WHERE id=%u", pid.Unbox()));
+    FlushItems(pid);
+
+    Result result(connection->Select(CHARACTER_QUERY, pid.Unbox()));
 
     if(!result.IsValid())
     {
@@ -224,7 +356,7 @@ psCharacter* psCharacterLoader::LoadCharacterData(PID pid, bool forceReload)
         psserver->GetLogCSV()->Write(CSV_STATUS, status);
     }
     // Read basic stats
-    if(!chardata->Load(result[0]))
+    if(!chardata->Load(result[0], connection))
     {
         if(csGetTicks() - start > 500)
         {
@@ -246,7 +378,7 @@ psCharacter* psCharacterLoader::LoadCharacterData(PID pid, bool forceReload)
         psserver->GetLogCSV()->Write(CSV_STATUS, status);
     }
 
-    chardata->LoadIntroductions();
+    chardata->LoadIntroductions(connection);
 
     return chardata;
 }
@@ -254,6 +386,9 @@ psCharacter* psCharacterLoader::LoadCharacterData(PID pid, bool forceReload)
 
 psCharacter* psCharacterLoader::QuickLoadCharacterData(PID pid, bool noInventory)
 {
+    if(!noInventory)
+        FlushItems(pid);
+
     Result result(db->Select("SELECT id, name, lastname, racegender_id FROM characters WHERE id=%u LIMIT 1", pid.Unbox()));
 
     if(!result.IsValid() || result.Count() < 1)
@@ -859,7 +994,11 @@ void psSaveCharEvent::DeleteObjectCallback(iDeleteNotificationObject* object)
         this->actor->UnregisterCallback(this);
 
     this->actor = NULL;
-    SetValid(false);
+
+    // Take the event off the queue now rather than keeping it until it is
+    // due, this deletes it. It can't be cancelled while it is triggered.
+    if(!psserver->GetEventManager()->Cancel(this))
+        SetValid(false);
 }
 
 
@@ -26,6 +26,7 @@
 //=============================================================================
 // Crystal Space Includes
 //=============================================================================
+#include <csutil/sysfunc.h>
 
 //=============================================================================
 // Project Includes
@@ -43,6 +44,10 @@
 
 class csMutex;
 class psCharacterList;
+class psCharacterPrefetch;
+class psCharacterPrefetcher;
+class psItemSaver;
+class iCharacterLoadCallback;
 class psSectorInfo;
 class psCharacter;
 class psItem;
@@ -121,6 +126,89 @@ public:
      */
     psCharacter* LoadCharacterData(PID pid, bool forceReload);
 
+    /**
+     * Loads data for a character without blocking the main thread for the database.
+     *
+     * The queries are run by the workers started with StartAsyncLoading() and
+     * the character is built in the main thread when they are done. Characters
+     * found in the cache, or all of them if the workers aren't running, are
+     * handed to the callback before this returns.
+     *
+     * @param pid The unique ID of the character to load data for.
+     * @param forceReload Ignores (and empties) the cache if set to true.
+     * @param callback Called in the main thread with the loaded character. Owned by the loader.
+     */
+    void LoadCharacterDataAsync(PID pid, bool forceReload, iCharacterLoadCallback* callback);
+
+    /**
+     * Loads a character from the database through the workers, ignoring the cache.
+     *
+     * @see LoadCharacterDataAsync()
+     */
+    void PrefetchCharacterData(PID pid, iCharacterLoadCallback* callback);
+
+    /**
+     * Loads a character from the database, ignoring the cache.
+     *
+     * @param connection Runs the selects of the character, db or a
+     *                   psPrefetchedConnection answering them from a prefetch.
+     * @return Pointer to a newly created psCharacter object, or NULL if the data could not be loaded.
+     */
+    psCharacter* LoadCharacterFromDB(PID pid, iDataConnection* connection);
+
+    /**
+     * Builds a character from the results fetched by a worker and hands it to the callback.
+     *
+     * Called in the main thread by psCharacterPrefetchEvent. The prefetch is deleted.
+     */
+    void FinishLoadCharacterData(psCharacterPrefetch* prefetch);
+
+    /**
+     * Start the workers loading characters for LoadCharacterDataAsync().
+     *
+     * @param threads The number of workers, each with its own database connection.
+     * @return false if the workers couldn't connect to the database.
+     */
+    bool StartAsyncLoading(iObjectRegistry* objreg, int threads, const char* host, unsigned int port,
+                           const char* user, const char* pwd, const char* database);
+
+    /// Stop the workers, characters loaded afterwards block the main thread again.
+    void StopAsyncLoading();
+
+    /// Get the workers or NULL if they aren't running.
+    psCharacterPrefetcher* GetPrefetcher()
+    {
+        return prefetcher;
+    }
+
+    /**
+     * Start writing the saves of existing items in the background.
+     *
+     * @param interval Milliseconds the saves of an item are collected.
+     * @return false if the writer couldn't connect to the database.
+     */
+    bool StartItemSaver(iObjectRegistry* objreg, csTicks interval, const char* host, unsigned int port,
+                        const char* user, const char* pwd, const char* database);
+
+    /// Write the queued item saves and save items at once from then on.
+    void StopItemSaver();
+
+    /// Get the item saver or NULL if it isn't running.
+    psItemSaver* GetItemSaver()
+    {
+        return itemSaver;
+    }
+
+    /**
+     * Get the number of characters built from prefetched results and the
+     * time the main thread spent building them.
+     */
+    void GetAsyncLoadStats(uint64 &loads, csMicroTicks &buildTime) const
+    {
+        loads = asyncLoads;
+        buildTime = asyncBuildTime;
+    }
+
     /**
      * Load just enough of the character data to know what it looks like (for selection screen).
      */
@@ -212,6 +300,13 @@ public:
 
 private:
 
+    /**
+     * Take a character out of the cache.
+     *
+     * @return The cached character or NULL if it has to be loaded from the database.
+     */
+    psCharacter* LoadCachedCharacterData(PID pid, bool forceReload);
+
     bool ClearCharacterAdvantages(PID pid);
     bool SaveCharacterAdvantage(PID pid, unsigned int advantage_id);
     bool ClearCharacterSkills(PID pid);
@@ -223,6 +318,13 @@ private:
     bool ClearCharacterSpell(psCharacter* character);
     bool SaveCharacterSpell(psCharacter* character);
 
+    /// Write the queued saves of the items of a character before reading them.
+    void FlushItems(PID pid);
+
+    psCharacterPrefetcher* prefetcher;
+    psItemSaver* itemSaver;
+    uint64 asyncLoads;
+    csMicroTicks asyncBuildTime;
 };
 
 //-----------------------------------------------------------------------------
@@ -0,0 +1,327 @@
+/*
+ * pscharacterprefetcher.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <iutil/objreg.h>
+#include <iutil/plugin.h>
+#include <iutil/cfgmgr.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/log.h"
+#include "util/psdatabase.h"
+
+#include "../psserver.h"
+#include "../globals.h"
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "pscharacterprefetcher.h"
+#include "pscharacterloader.h"
+#include "pscharacterqueries.h"
+
+/**
+ * The selects run by psCharacterLoader::LoadCharacterFromDB() and the
+ * loaders called from psCharacter::Load(), in the order they are run.
+ */
+static const struct
+{
+    const char* query;
+    bool        master;     ///< Uses the id of the npc master template
+} characterQueries[] =
+{
+    { CHARACTER_SKILLS_QUERY, true },           // LoadSkills
+    { CHARACTER_TRAITS_QUERY, true },           // LoadTraits
+    { CHARACTER_QUESTS_QUERY, false },          // LoadQuestAssignments
+    { CHARACTER_ITEMS_QUERY, true },            // psCharacterInventory::Load
+    { CHARACTER_RELATIONSHIPS_QUERY, false },   // LoadRelationshipInfo
+    { CHARACTER_RELATED_QUERY, false },         // LoadRelationshipInfo
+    { CHARACTER_FACTIONS_QUERY, false },        // LoadFactions
+    { CHARACTER_VARIABLES_QUERY, true },        // LoadVariables
+    { CHARACTER_MERCHANT_QUERY, true },         // psMerchantInfo::Load
+    { CHARACTER_TRAINER_QUERY, true },          // psTrainerInfo::Load
+    { CHARACTER_SPELLS_QUERY, true },           // LoadSpells
+    { CHARACTER_INTRODUCTIONS_QUERY, false }    // LoadIntroductions
+};
+
+//-----------------------------------------------------------------------------
+
+psCharacterPrefetch::psCharacterPrefetch(PID pid, iCharacterLoadCallback* callback)
+    :pid(pid),callback(callback),fetched(0)
+{
+    queued = csGetTicks();
+}
+
+psCharacterPrefetch::~psCharacterPrefetch()
+{
+    delete callback;
+}
+
+//-----------------------------------------------------------------------------
+
+class psCharacterPrefetcher::Worker : public CS::Threading::Runnable
+{
+public:
+    Worker(psCharacterPrefetcher* parent, iDataConnection* connection, const char* host, unsigned int port,
+           const char* user, const char* pwd, const char* database)
+        :parent(parent),connection(connection),host(host),port(port),user(user),pwd(pwd),database(database)
+    {
+    }
+
+    virtual void Run()
+    {
+        // Connect from this thread so the database client sets up its
+        // per thread data here.
+        bool connected = connection->Initialize(host, port, database, user, pwd, LogCSV::GetSingletonPtr()) &&
+                         connection->IsValid();
+        if(!connected)
+        {
+            Error2("Character prefetch worker could not connect to the database: %s", connection->GetLastError());
+        }
+        parent->WorkerStarted(connected);
+        if(!connected)
+        {
+            return;
+        }
+
+        psCharacterPrefetch* prefetch;
+        while((prefetch = parent->WaitForWork()) != NULL)
+        {
+            Prefetch(connection, prefetch);
+            prefetch->fetched = csGetTicks();
+
+            // The event owns the prefetch from now on
+            psCharacterPrefetchEvent* event = new psCharacterPrefetchEvent(prefetch);
+            event->QueueEvent();
+        }
+
+        connection->Close();
+    }
+
+private:
+    psCharacterPrefetcher* parent;
+    csRef<iDataConnection> connection;
+    csString host;
+    unsigned int port;
+    csString user;
+    csString pwd;
+    csString database;
+};
+
+psCharacterPrefetcher::psCharacterPrefetcher()
+    :queueLength(0),stop(false),startsPending(0),workersConnected(0)
+{
+}
+
+psCharacterPrefetcher::~psCharacterPrefetcher()
+{
+    Stop();
+}
+
+bool psCharacterPrefetcher::Start(iObjectRegistry* objreg, int count, const char* host, unsigned int port,
+                                  const char* user, const char* pwd, const char* database)
+{
+    csRef<iPluginManager> pluginmgr = csQueryRegistry<iPluginManager>(objreg);
+    csRef<iConfigManager> configmanager = csQueryRegistry<iConfigManager>(objreg);
+    csString classId = configmanager->GetStr("System.Plugins.iDataConnection", "planeshift.database.mysql");
+
+    stop = false;
+    startsPending = 0;
+    workersConnected = 0;
+
+    for(int i = 0; i < count; i++)
+    {
+        // A new instance of the database plugin, not the one used by the main thread
+        csRef<iDataConnection> connection = csLoadPlugin<iDataConnection>(pluginmgr, classId);
+        if(!connection)
+        {
+            Error2("Could not load database plugin %s for the character prefetch.", classId.GetData());
+            break;
+        }
+
+        csRef<CS::Threading::Runnable> worker;
+        worker.AttachNew(new Worker(this, connection, host, port, user, pwd, database));
+        workers.Push(worker);
+
+        {
+            CS::Threading::MutexScopedLock lock(mutex);
+            startsPending++;
+        }
+
+        csRef<CS::Threading::Thread> thread;
+        thread.AttachNew(new CS::Threading::Thread(worker));
+        thread->Start();
+        threads.Push(thread);
+    }
+
+    // Wait for the workers to connect so the loads don't get queued to
+    // a pool that can't run them.
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        while(startsPending)
+        {
+            startCondition.Wait(mutex);
+        }
+    }
+
+    if(!workersConnected)
+    {
+        Stop();
+        return false;
+    }
+
+    return true;
+}
+
+void psCharacterPrefetcher::Stop()
+{
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        stop = true;
+        workCondition.NotifyAll();
+    }
+
+    for(size_t i = 0; i < threads.GetSize(); i++)
+    {
+        threads[i]->Wait();
+    }
+    threads.Empty();
+    workers.Empty();
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    while(!queue.IsEmpty())
+    {
+        delete queue.Front();
+        queue.PopFront();
+    }
+    queueLength = 0;
+    workersConnected = 0;
+}
+
+void psCharacterPrefetcher::Queue(psCharacterPrefetch* prefetch)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    queue.PushBack(prefetch);
+    queueLength++;
+    workCondition.NotifyOne();
+}
+
+size_t psCharacterPrefetcher::GetQueueLength()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    return queueLength;
+}
+
+size_t psCharacterPrefetcher::GetWorkerCount()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    return workersConnected;
+}
+
+void psCharacterPrefetcher::WorkerStarted(bool connected)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    if(connected)
+    {
+        workersConnected++;
+    }
+    startsPending--;
+    startCondition.NotifyAll();
+}
+
+psCharacterPrefetch* psCharacterPrefetcher::WaitForWork()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    while(!stop && queue.IsEmpty())
+    {
+        workCondition.Wait(mutex);
+    }
+
+    if(stop)
+    {
+        return NULL;
+    }
+
+    psCharacterPrefetch* prefetch = queue.Front();
+    queue.PopFront();
+    queueLength--;
+    return prefetch;
+}
+
+void psCharacterPrefetcher::Prefetch(iDataConnection* connection, psCharacterPrefetch* prefetch)
+{
+    unsigned int pid = prefetch->pid.Unbox();
+
+    csString query;
+    query.Format(CHARACTER_QUERY, pid);
+    iResultSet* character = connection->Select("%s", query.GetData());
+    if(!character)
+    {
+        // The main thread will run into the same error and report it
+        return;
+    }
+
+    // Without exactly one character there is nothing more to load
+    unsigned int master = 0;
+    bool found = (character->Count() == 1);
+    if(found)
+    {
+        master = (*character)[0].GetUInt32("npc_master_id");
+    }
+    prefetch->Add(query, character);
+
+    if(!found)
+    {
+        return;
+    }
+
+    for(size_t i = 0; i < sizeof(characterQueries)/sizeof(characterQueries[0]); i++)
+    {
+        query.Format(characterQueries[i].query, (characterQueries[i].master && master) ? master : pid);
+
+        iResultSet* result = connection->Select("%s", query.GetData());
+        if(result)
+        {
+            prefetch->Add(query, result);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+
+psCharacterPrefetchEvent::psCharacterPrefetchEvent(psCharacterPrefetch* prefetch)
+    :psGameEvent(0, 0, "psCharacterPrefetchEvent"),prefetch(prefetch)
+{
+}
+
+psCharacterPrefetchEvent::~psCharacterPrefetchEvent()
+{
+    delete prefetch;
+}
+
+void psCharacterPrefetchEvent::Trigger()
+{
+    psServer::CharacterLoader.FinishLoadCharacterData(prefetch);
+    prefetch = NULL;
+}
@@ -0,0 +1,165 @@
+/*
+ * pscharacterprefetcher.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __PSCHARACTERPREFETCHER_H__
+#define __PSCHARACTERPREFETCHER_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/hash.h>
+#include <csutil/list.h>
+#include <csutil/sysfunc.h>
+#include <csutil/refarr.h>
+#include <csutil/threading/thread.h>
+#include <csutil/threading/condition.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include <idal.h>      // Database Abstraction Layer Interface
+
+#include "util/gameevent.h"
+#include "util/prefetchedconnection.h"
+#include "util/psconst.h"
+
+class psCharacter;
+struct iObjectRegistry;
+
+/**
+ * \addtogroup bulkobjects
+ * @{ */
+
+/**
+ * Receives a character loaded with psCharacterLoader::LoadCharacterDataAsync().
+ */
+class iCharacterLoadCallback
+{
+public:
+    virtual ~iCharacterLoadCallback() {}
+
+    /**
+     * Called in the main thread when the character has been loaded. The
+     * callback is deleted afterwards.
+     *
+     * @param pid      The character asked for.
+     * @param chardata The loaded character owned by the callback from now
+     *                 on, or NULL if the character could not be loaded.
+     */
+    virtual void CharacterLoaded(PID pid, psCharacter* chardata) = 0;
+};
+
+/**
+ * The result sets fetched in advance for one character.
+ */
+class psCharacterPrefetch : public psPrefetchedResults
+{
+public:
+    psCharacterPrefetch(PID pid, iCharacterLoadCallback* callback);
+    virtual ~psCharacterPrefetch();
+
+    PID pid;
+    iCharacterLoadCallback* callback;
+    csTicks queued;           ///< When the load was asked for
+    csTicks fetched;          ///< When the worker was done with the queries
+};
+
+/**
+ * Pool of worker threads running the queries needed to load characters.
+ *
+ * Each worker has its own database connection. The workers only fetch the
+ * result sets, the psCharacter is built in the main thread from the results
+ * when the psCharacterPrefetchEvent is triggered. Building the character
+ * touches the caches, guilds and items of the server which are only safe
+ * to use from the main thread.
+ */
+class psCharacterPrefetcher
+{
+public:
+    psCharacterPrefetcher();
+    ~psCharacterPrefetcher();
+
+    /**
+     * Start the workers.
+     *
+     * @param threads The number of workers and database connections.
+     * @return false if no database connection could be created.
+     */
+    bool Start(iObjectRegistry* objreg, int threads, const char* host, unsigned int port,
+               const char* user, const char* pwd, const char* database);
+
+    /// Stop the workers, the prefetches still queued are dropped.
+    void Stop();
+
+    /// Queue a character to be prefetched by the next free worker.
+    void Queue(psCharacterPrefetch* prefetch);
+
+    /// Number of characters waiting for a worker.
+    size_t GetQueueLength();
+
+    /// Number of workers connected to the database.
+    size_t GetWorkerCount();
+
+private:
+    class Worker;
+    friend class Worker;
+
+    /**
+     * Wait for the next character to prefetch.
+     * @return NULL when the prefetcher is stopped.
+     */
+    psCharacterPrefetch* WaitForWork();
+
+    /// Called by each worker once it tried to connect to the database.
+    void WorkerStarted(bool connected);
+
+    /// Run all the queries of a character on the connection of a worker.
+    static void Prefetch(iDataConnection* connection, psCharacterPrefetch* prefetch);
+
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition workCondition;
+    CS::Threading::Condition startCondition;
+    csList<psCharacterPrefetch*> queue;
+    size_t queueLength;
+    bool stop;
+    size_t startsPending;       ///< Workers still connecting
+    size_t workersConnected;
+
+    csRefArray<CS::Threading::Runnable> workers;
+    csRefArray<CS::Threading::Thread> threads;
+};
+
+/**
+ * Hands a prefetched character back to the main thread.
+ */
+class psCharacterPrefetchEvent : public psGameEvent
+{
+public:
+    psCharacterPrefetchEvent(psCharacterPrefetch* prefetch);
+    virtual ~psCharacterPrefetchEvent();
+
+    virtual void Trigger();
+
+private:
+    psCharacterPrefetch* prefetch;
+};
+
+/** @} */
+
+#endif
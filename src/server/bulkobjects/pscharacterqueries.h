@@ -0,0 +1,43 @@
+/*
+ * pscharacterqueries.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __PSCHARACTERQUERIES_H__
+#define __PSCHARACTERQUERIES_H__
+
+/**
+ * The selects run when a character is loaded from the database. They are
+ * shared by the loaders and psCharacterPrefetcher, which answers them from
+ * the prefetch by their formatted text, so both sides have to use these.
+ * Each takes the id of the character, or of its npc master where noted.
+ */
+#define CHARACTER_QUERY                 "SELECT * FROM characters WHERE id=%u"
+#define CHARACTER_SKILLS_QUERY          "SELECT * FROM character_skills WHERE character_id=%u"      ///< Master id
+#define CHARACTER_TRAITS_QUERY          "SELECT * FROM character_traits WHERE character_id=%u"      ///< Master id
+#define CHARACTER_QUESTS_QUERY          "SELECT * FROM character_quests WHERE player_id=%u"
+#define CHARACTER_ITEMS_QUERY           "SELECT * FROM item_instances WHERE char_id_owner=%u AND location_in_parent != -1" ///< Master id
+#define CHARACTER_RELATIONSHIPS_QUERY   "SELECT a.*, b.name AS \"buddy_name\" FROM character_relationships a, characters b WHERE a.character_id = %u AND a.related_id = b.id order by a.character_id"
+#define CHARACTER_RELATED_QUERY         "SELECT a.*, b.name AS \"buddy_name\" FROM character_relationships a, characters b WHERE a.related_id = %u AND a.character_id = b.id order by a.related_id"
+#define CHARACTER_FACTIONS_QUERY        "SELECT faction_id, value from character_factions where character_id = %u"
+#define CHARACTER_VARIABLES_QUERY       "SELECT name, value from character_variables where character_id = %u" ///< Master id
+#define CHARACTER_MERCHANT_QUERY        "SELECT * from merchant_item_categories where player_id=%u" ///< Master id
+#define CHARACTER_TRAINER_QUERY         "SELECT * from trainer_skills where player_id=%u"           ///< Master id
+#define CHARACTER_SPELLS_QUERY          "SELECT * FROM player_spells WHERE player_id=%u ORDER BY spell_slot ASC" ///< Master id
+#define CHARACTER_INTRODUCTIONS_QUERY   "SELECT * FROM introductions WHERE charid=%u"
+
+#endif
@@ -54,6 +54,7 @@
 #include "adminmanager.h"
 #include "psmerchantinfo.h"
 #include "psraceinfo.h"
+#include "pscharacterqueries.h"
 
 psCharacterInventory::psCharacterInventory(psCharacter* ownr)
 {
@@ -247,9 +248,9 @@ void psCharacterInventory::UpdateEncumbrance()
     }
 }
 
-bool psCharacterInventory::Load()
+bool psCharacterInventory::Load(iDataConnection* connection)
 {
-    return Load(owner->GetPID());
+    return Load(owner->GetPID(), connection);
 }
 
 psItem* psCharacterInventory::GetItemFactory(psItemStats* stats)
@@ -268,7 +269,7 @@ psItem* psCharacterInventory::GetItemFactory(psItemStats* stats)
 }
 
 
-bool psCharacterInventory::Load(PID use_id)
+bool psCharacterInventory::Load(PID use_id, iDataConnection* connection)
 {
     doRestrictions = (owner->GetCharType() == PSCHARACTER_TYPE_PLAYER);
 
@@ -278,7 +279,7 @@ bool psCharacterInventory::Load(PID use_id)
         doRestrictions = false;
     }
 
-    Result items(db->Select("SELECT * FROM item_instances WHERE char_id_owner=%u AND location_in_parent != -1", use_id.Unbox()));
+    Result items(connection->Select(CHARACTER_ITEMS_QUERY, use_id.Unbox()));
     if(items.IsValid())
     {
         for(size_t x = 0; x < items.Count(); x++)
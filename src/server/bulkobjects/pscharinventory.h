@@ -44,6 +44,7 @@
 #include "psspell.h"
 
 struct iDocumentNode;
+struct iDataConnection;
 
 class MsgEntry;
 class psItemStats;
@@ -146,7 +147,7 @@ public:
     ~psCharacterInventory();
 
     /// Load the inventory for the owner.
-    bool Load();
+    bool Load(iDataConnection* connection);
 
     /**
      * Load the inventory using a particular ID.
@@ -155,9 +156,10 @@ public:
      * inventory as well as a common base one they need to load.
      *
      * @param id The key into the character table for the character who's inventory we should load.
+     * @param connection Runs the select of the items.
      * @return true if the inventory was loaded without error.
      */
-    bool Load(PID id);
+    bool Load(PID id, iDataConnection* connection);
 
     /**
      * Load the bare minimum to know what this character is looks like.
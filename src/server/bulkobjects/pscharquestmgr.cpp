@@ -37,6 +37,7 @@
 
 #include "pscharquestmgr.h"
 #include "pscharacter.h"
+#include "pscharacterqueries.h"
 
 //////////////////////////////////////////////////////////////////////////
 // QuestAssignment accessor functions to accommodate removal of csWeakRef better
@@ -574,14 +575,14 @@ bool psCharacterQuestManager::UpdateQuestAssignments(bool force_update)
 }
 
 
-bool psCharacterQuestManager::LoadQuestAssignments()
+bool psCharacterQuestManager::LoadQuestAssignments(iDataConnection* connection)
 {
     PID pid = owner->GetPID();
 
-    Result result(db->Select("SELECT * FROM character_quests WHERE player_id=%u", pid.Unbox()));
+    Result result(connection->Select(CHARACTER_QUESTS_QUERY, pid.Unbox()));
     if(!result.IsValid())
     {
-        Error3("Could not load quest assignments for character %u. Error was: %s", pid.Unbox(), db->GetLastError());
+        Error3("Could not load quest assignments for character %u. Error was: %s", pid.Unbox(), connection->GetLastError());
         return false;
     }
 
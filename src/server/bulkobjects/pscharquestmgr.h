@@ -37,6 +37,7 @@
 
 
 class gemObject;
+struct iDataConnection;
 
 #define PSQUEST_DELETE   'D'
 #define PSQUEST_ASSIGNED 'A'
@@ -103,8 +104,9 @@ public:
     /** Load the quests from the database.
     *   Make sure that the owner has a valid PID before loading because it uses that to
     *   figure out what to load.
+    *   @param connection Runs the select of the quests.
     */
-    bool LoadQuestAssignments();
+    bool LoadQuestAssignments(iDataConnection* connection);
 
     /** Check to see if a quest is assigned.
     *
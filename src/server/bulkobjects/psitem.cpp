@@ -57,6 +57,7 @@
 #include "psitem.h"
 #include "pscharacter.h"
 #include "pscharacterloader.h"
+#include "psitemsaver.h"
 #include "pssectorinfo.h"
 #include "pstrade.h"
 #include "psmerchantinfo.h"
@@ -139,7 +140,7 @@ void psItem::operator delete(void* releasePtr)
     itempool.CallFromDelete((psItem*)releasePtr);
 }
 
-psItem::psItem() : transformationEvent(NULL), gItem(NULL), pendingsave(false), loaded(false)
+psItem::psItem() : transformationEvent(NULL), gItem(NULL), pendingsave(false), savedColumns(NULL), loaded(false)
 {
     int i;
 
@@ -211,6 +212,13 @@ psItem::~psItem()
         Error2("Item %s is being deleted while in use!", GetName());
     }
 
+    // A queued save still has to be written
+    if(pendingsave && psServer::CharacterLoader.GetItemSaver())
+    {
+        psServer::CharacterLoader.GetItemSaver()->Capture(this);
+    }
+    delete savedColumns;
+
     //remove the itemModifiers class as it's no more needed
     delete itemModifiers;
 
@@ -576,7 +584,13 @@ void psItem::Save(bool children)
 #endif
 
         pendingsave = true;
-        Commit(children);
+
+        // New items are inserted at once, the callers need their id
+        psItemSaver* saver = psServer::CharacterLoader.GetItemSaver();
+        if(saver && uid != 0 && uid != ID_DONT_SAVE_ITEM)
+            saver->Queue(this);
+        else
+            Commit(children);
     }
 
 #if SAVE_DEBUG
@@ -665,25 +679,63 @@ void psItem::Commit(bool children)
     }
 
     targetQuery->Reset();
+    AddColumns(targetQuery);
+
+    if(GetUID()==0)
+    {
+        //printf("Saving item %s through SQL Insert\n",GetName() );
+
+        // Insert to item_instances and set the ID to the new ID that the db gives us
+        if(targetQuery->Execute(0))
+        {
+            item_quality_original = item_quality;
+            SetUID(db->GetLastInsertID());
+            //saves the creative data in the instance if any as we need an uid for it to work and we have it
+            //only now
+            if(creativeStats.creativeType != PSITEMSTATS_CREATIVETYPE_NONE)
+                creativeStats.SaveCreation(uid);
+        }
+        else
+            Error2("Failed to insert item instance!\nError: %s", db->GetLastError());
 
-    targetQuery->AddField("char_id_owner", owning_character ? owning_character->GetPID().Unbox() : 0);
-    targetQuery->AddField("char_id_guardian", guardingCharacterID.Unbox());
-    targetQuery->AddField("stack_count",GetStackCount());
-    targetQuery->AddField("item_quality",GetItemQuality());
-    targetQuery->AddField("crafted_quality",GetMaxItemQuality());
-    targetQuery->AddField("decay_resistance",GetDecayResistance());
+
+    }
+    else
+    {
+        // Existing Item, update
+        //printf("Saving item %d (%s owned by %s) through SQL Update\n", GetUID(), GetName(), owning_character? owning_character->GetCharName():"no one" );
+
+        // Save this entry
+
+        if(!targetQuery->Execute(GetUID()))
+        {
+            Error3("Failed to save item instance %u!\nError: %s", GetUID(), db->GetLastError());
+        }
+        else
+            item_quality_original = item_quality;
+    }
+}
+
+void psItem::AddColumns(iRecord* record)
+{
+    record->AddField("char_id_owner", owning_character ? owning_character->GetPID().Unbox() : 0);
+    record->AddField("char_id_guardian", guardingCharacterID.Unbox());
+    record->AddField("stack_count",GetStackCount());
+    record->AddField("item_quality",GetItemQuality());
+    record->AddField("crafted_quality",GetMaxItemQuality());
+    record->AddField("decay_resistance",GetDecayResistance());
 
     // Crafter ID
     if(GetIsCrafterIDValid())
-        targetQuery->AddField("creator_mark_id", GetCrafterID().Unbox());
+        record->AddField("creator_mark_id", GetCrafterID().Unbox());
     else
-        targetQuery->AddFieldNull("creator_mark_id");
+        record->AddFieldNull("creator_mark_id");
 
     // Guild ID
     if(GetIsGuildIDValid())
-        targetQuery->AddField("guild_mark_id",GetGuildID());
+        record->AddField("guild_mark_id",GetGuildID());
     else
-        targetQuery->AddFieldNull("guild_mark_id");
+        record->AddFieldNull("guild_mark_id");
 
     // Flags
     csString flagString;
@@ -776,21 +828,21 @@ void psItem::Commit(bool children)
         flagString.Append("IDENTIFIABLE");
     }
 
-    targetQuery->AddField("flags",flagString.GetData());
+    record->AddField("flags",flagString.GetData());
 
     // item_stats_id_standard - base stats if non unique, unique stats if unique
-    targetQuery->AddField("item_stats_id_standard",GetBaseStats()->GetUID());
+    record->AddField("item_stats_id_standard",GetBaseStats()->GetUID());
 
     // Container stuff
     if(!parent_item_InstanceID)   // if not in container
     {
-        targetQuery->AddFieldNull("parent_item_id");  // id of object containing this one
-        targetQuery->AddField("location_in_parent",loc_in_parent);  // slot number, or -1 if out in the world
+        record->AddFieldNull("parent_item_id");  // id of object containing this one
+        record->AddField("location_in_parent",loc_in_parent);  // slot number, or -1 if out in the world
     }
     else // in container
     {
-        targetQuery->AddField("parent_item_id",parent_item_InstanceID);
-        targetQuery->AddField("location_in_parent",loc_in_parent);
+        record->AddField("parent_item_id",parent_item_InstanceID);
+        record->AddField("location_in_parent",loc_in_parent);
     }
 
 
@@ -803,25 +855,25 @@ void psItem::Commit(bool children)
 
     if(!sectorinfo || parent_item_InstanceID)
     {
-        targetQuery->AddFieldNull("loc_x");
-        targetQuery->AddFieldNull("loc_y");
-        targetQuery->AddFieldNull("loc_z");
-        targetQuery->AddFieldNull("loc_xrot");
-        targetQuery->AddFieldNull("loc_yrot");
-        targetQuery->AddFieldNull("loc_zrot");
-        targetQuery->AddFieldNull("loc_sector_id");
+        record->AddFieldNull("loc_x");
+        record->AddFieldNull("loc_y");
+        record->AddFieldNull("loc_z");
+        record->AddFieldNull("loc_xrot");
+        record->AddFieldNull("loc_yrot");
+        record->AddFieldNull("loc_zrot");
+        record->AddFieldNull("loc_sector_id");
     }
     else  // Item is not held or in something; must be in the world
     {
         if(sectorinfo)
         {
-            targetQuery->AddField("loc_x",locx);
-            targetQuery->AddField("loc_y",locy);
-            targetQuery->AddField("loc_z",locz);
-            targetQuery->AddField("loc_xrot",locxrot);
-            targetQuery->AddField("loc_yrot",locyrot);
-            targetQuery->AddField("loc_zrot",loczrot);
-            targetQuery->AddField("loc_sector_id",sectorinfo->uid);
+            record->AddField("loc_x",locx);
+            record->AddField("loc_y",locy);
+            record->AddField("loc_z",locz);
+            record->AddField("loc_xrot",locxrot);
+            record->AddField("loc_yrot",locyrot);
+            record->AddField("loc_zrot",loczrot);
+            record->AddField("loc_sector_id",sectorinfo->uid);
         }
         else  //  Item is nowhere; cannot be saved
         {
@@ -830,8 +882,8 @@ void psItem::Commit(bool children)
         }
     }
 
-    targetQuery->AddField("lock_str",GetLockStrength());
-    targetQuery->AddField("lock_skill",GetLockpickSkill());
+    record->AddField("lock_str",GetLockStrength());
+    record->AddField("lock_skill",GetLockpickSkill());
 
     // push openableLocks
     csString openableLocksString;
@@ -849,53 +901,19 @@ void psItem::Commit(bool children)
             openableLocksString.Append(tmp);
         }
     }
-    targetQuery->AddField("openable_locks", openableLocksString);
-    targetQuery->AddField("loc_instance", instance);
+    record->AddField("openable_locks", openableLocksString);
+    record->AddField("loc_instance", instance);
 
-    targetQuery->AddField("item_name", item_name);
-    targetQuery->AddField("item_description", item_description);
+    record->AddField("item_name", item_name);
+    record->AddField("item_description", item_description);
 
-    targetQuery->AddField("charges",GetCharges());
+    record->AddField("charges",GetCharges());
 
 
     //saves the modifiers applied to this item. for now 3 due to how the schema is done.
-    targetQuery->AddField("prefix",modifierIds.Get(psGMSpawnMods::ITEM_PREFIX));
-    targetQuery->AddField("suffix",modifierIds.Get(psGMSpawnMods::ITEM_SUFFIX));
-    targetQuery->AddField("adjective",modifierIds.Get(psGMSpawnMods::ITEM_ADJECTIVE));
-
-    if(GetUID()==0)
-    {
-        //printf("Saving item %s through SQL Insert\n",GetName() );
-
-        // Insert to item_instances and set the ID to the new ID that the db gives us
-        if(targetQuery->Execute(0))
-        {
-            item_quality_original = item_quality;
-            SetUID(db->GetLastInsertID());
-            //saves the creative data in the instance if any as we need an uid for it to work and we have it
-            //only now
-            if(creativeStats.creativeType != PSITEMSTATS_CREATIVETYPE_NONE)
-                creativeStats.SaveCreation(uid);
-        }
-        else
-            Error2("Failed to insert item instance!\nError: %s", db->GetLastError());
-
-
-    }
-    else
-    {
-        // Existing Item, update
-        //printf("Saving item %d (%s owned by %s) through SQL Update\n", GetUID(), GetName(), owning_character? owning_character->GetCharName():"no one" );
-
-        // Save this entry
-
-        if(!targetQuery->Execute(GetUID()))
-        {
-            Error3("Failed to save item instance %u!\nError: %s", GetUID(), db->GetLastError());
-        }
-        else
-            item_quality_original = item_quality;
-    }
+    record->AddField("prefix",modifierIds.Get(psGMSpawnMods::ITEM_PREFIX));
+    record->AddField("suffix",modifierIds.Get(psGMSpawnMods::ITEM_SUFFIX));
+    record->AddField("adjective",modifierIds.Get(psGMSpawnMods::ITEM_ADJECTIVE));
 }
 
 void psItem::ForceSaveIfNew()
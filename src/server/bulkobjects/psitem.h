@@ -23,6 +23,7 @@
 // Crystal Space Includes
 //=============================================================================
 #include <csutil/array.h>
+#include <csutil/stringarray.h>
 #include <csgeom/vector3.h>
 #include <csutil/weakreferenced.h>
 
@@ -435,6 +436,9 @@ private:
      */
     void Commit(bool children = false);
 
+    /// Add the columns of the item_instances row of this item to a statement.
+    void AddColumns(iRecord* record);
+
     /**
      * ItemQuality for items that decay changes so often, writing every change to the db
      * is overly onerous.  Also, any loss of data due to server crashes benefits the player
@@ -443,8 +447,8 @@ private:
      */
     void UpdateItemQuality(uint32 id, float qual);
 
-    /// Commit() is called primarily from psDelaySave::Trigger()
-    friend class psDelaySave;
+    /// Queued saves are written by the psItemSaver
+    friend class psItemSaver;
 
     /**
      * Holds a custom item name. Can be empty.
@@ -475,7 +479,7 @@ public:
      */
     virtual bool Load(iResultRow &row);
 
-    /** Queues this item to be saved to the database.  (DB action will be executed after 500ms)
+    /** Queues this item to be saved to the database.  (DB action will be executed with the next flush of the psItemSaver)
      *  Call this after EVERY change of a persistant property, and the system
      *  will ensure that any sequence of changes will result in only one DB hit.
      */
@@ -1247,6 +1251,9 @@ private:
 
     bool pendingsave;
 
+    /// The columns as last written by the psItemSaver, NULL before that
+    csStringArray* savedColumns;
+
     float rarity;
 
     /** Calculates the rarity of an item based on its modifiers
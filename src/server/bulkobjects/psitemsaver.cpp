@@ -0,0 +1,785 @@
+/*
+ * psitemsaver.cpp
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#include <psconfig.h>
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <iutil/objreg.h>
+#include <iutil/plugin.h>
+#include <iutil/cfgmgr.h>
+#include <csutil/sysfunc.h>
+#include <csgeom/math.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include "util/log.h"
+#include "util/eventmanager.h"
+#include "util/psdatabase.h"
+
+#include "../psserver.h"
+#include "../globals.h"
+
+//=============================================================================
+// Local Includes
+//=============================================================================
+#include "psitemsaver.h"
+#include "psitem.h"
+#include "pscharacter.h"
+
+/// Rows of one UPDATE statement
+#define ROWS_PER_STATEMENT 100
+
+/// Times a batch is written before its rows are given up
+#define WRITE_ATTEMPTS 3
+
+/// Milliseconds the writer waits before writing a failed batch again
+#define RETRY_DELAY 1000
+
+//-----------------------------------------------------------------------------
+
+psItemRecord::psItemRecord(iDataConnection* db)
+    :db(db)
+{
+}
+
+void psItemRecord::AddField(const char* fname, float fValue)
+{
+    // %g would print nan or inf, which are no SQL values
+    if(!CS::IsFinite(fValue))
+    {
+        fValue = 0.0f;
+    }
+
+    csString value;
+    value.Format("%.9g", fValue);
+    names.Push(fname);
+    values.Push(value);
+}
+
+void psItemRecord::AddField(const char* fname, int iValue)
+{
+    csString value;
+    value.Format("%d", iValue);
+    names.Push(fname);
+    values.Push(value);
+}
+
+void psItemRecord::AddField(const char* fname, unsigned int uiValue)
+{
+    csString value;
+    value.Format("%u", uiValue);
+    names.Push(fname);
+    values.Push(value);
+}
+
+void psItemRecord::AddField(const char* fname, unsigned short usValue)
+{
+    AddField(fname, (unsigned int)usValue);
+}
+
+void psItemRecord::AddField(const char* fname, const char* sValue)
+{
+    csString escape;
+    db->Escape(escape, sValue ? sValue : "");
+
+    csString value;
+    value.Format("'%s'", escape.GetData());
+    names.Push(fname);
+    values.Push(value);
+}
+
+void psItemRecord::AddFieldNull(const char* fname)
+{
+    names.Push(fname);
+    values.Push("NULL");
+}
+
+bool psItemRecord::Execute(uint32 /*uid*/)
+{
+    return false;
+}
+
+void psItemRecord::Reset()
+{
+    names.Empty();
+    values.Empty();
+}
+
+//-----------------------------------------------------------------------------
+
+class psItemSaver::Writer : public CS::Threading::Runnable
+{
+public:
+    Writer(psItemSaver* parent, iDataConnection* connection, const char* host, unsigned int port,
+           const char* user, const char* pwd, const char* database)
+        :parent(parent),connection(connection),host(host),port(port),user(user),pwd(pwd),database(database)
+    {
+    }
+
+    virtual void Run()
+    {
+        // Connect from this thread so the database client sets up its
+        // per thread data here.
+        bool connected = connection->Initialize(host, port, database, user, pwd, LogCSV::GetSingletonPtr()) &&
+                         connection->IsValid();
+        if(!connected)
+        {
+            Error2("Item saver could not connect to the database: %s", connection->GetLastError());
+        }
+        parent->WriterStarted(connected);
+        if(!connected)
+        {
+            return;
+        }
+
+        Batch* batch;
+        while((batch = parent->WaitForBatch()) != NULL)
+        {
+            // The statements only set values, writing the rows which made it
+            // before the failure once more does no harm
+            int attempt = 1;
+            while(!parent->Write(connection, batch) && attempt < WRITE_ATTEMPTS && parent->WaitToRetry())
+            {
+                attempt++;
+            }
+            parent->Written(batch);
+        }
+
+        connection->Close();
+    }
+
+private:
+    psItemSaver* parent;
+    csRef<iDataConnection> connection;
+    csString host;
+    unsigned int port;
+    csString user;
+    csString pwd;
+    csString database;
+};
+
+psItemSaver::psItemSaver()
+    :interval(0),event(NULL),captured(NULL),generation(1),ownerColumn(csArrayItemNotFound),
+     guardianColumn(csArrayItemNotFound),written(0),writing(0),waiting(0),stop(false),starting(false),connected(false)
+{
+    memset(&stats, 0, sizeof(stats));
+}
+
+psItemSaver::~psItemSaver()
+{
+    Stop();
+}
+
+bool psItemSaver::Start(iObjectRegistry* objreg, csTicks flushInterval, const char* host, unsigned int port,
+                        const char* user, const char* pwd, const char* database)
+{
+    Stop();
+
+    csRef<iPluginManager> pluginmgr = csQueryRegistry<iPluginManager>(objreg);
+    csRef<iConfigManager> configmanager = csQueryRegistry<iConfigManager>(objreg);
+    csString classId = configmanager->GetStr("System.Plugins.iDataConnection", "planeshift.database.mysql");
+
+    // A new instance of the database plugin, not the one used by the main thread
+    csRef<iDataConnection> connection = csLoadPlugin<iDataConnection>(pluginmgr, classId);
+    if(!connection)
+    {
+        Error2("Could not load database plugin %s for the item saver.", classId.GetData());
+        return false;
+    }
+
+    interval = flushInterval;
+    stop = false;
+    starting = true;
+    connected = false;
+
+    writer.AttachNew(new Writer(this, connection, host, port, user, pwd, database));
+    thread.AttachNew(new CS::Threading::Thread(writer));
+    thread->Start();
+
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        while(starting)
+        {
+            doneCondition.Wait(mutex);
+        }
+    }
+
+    if(!connected)
+    {
+        thread->Wait();
+        thread.Invalidate();
+        writer.Invalidate();
+        return false;
+    }
+
+    Schedule();
+    return true;
+}
+
+void psItemSaver::Stop()
+{
+    if(!thread)
+    {
+        return;
+    }
+
+    if(event)
+    {
+        event->SetValid(false);
+        event = NULL;
+    }
+
+    // Everything queued goes out before the writer stops
+    Flush();
+
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        stop = true;
+        workCondition.NotifyAll();
+        retryCondition.NotifyAll();
+    }
+
+    thread->Wait();
+    thread.Invalidate();
+    writer.Invalidate();
+
+    // The writer writes all the batches before stopping, unless it never
+    // connected. Whatever is left goes out with the main connection.
+    csArray<Batch*> left;
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        while(!batches.IsEmpty())
+        {
+            left.Push(batches.Front());
+            batches.PopFront();
+        }
+    }
+    for(size_t i = 0; i < left.GetSize(); i++)
+    {
+        Write(db, left[i]);
+        Written(left[i]);
+    }
+
+    WriteFailed();
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    if(!failed.IsEmpty())
+    {
+        Error2("Item saver stopped with %zu rows not written.", failed.GetSize());
+    }
+    failed.Empty();
+    inFlight.DeleteAll();
+    writing = 0;
+}
+
+void psItemSaver::Schedule()
+{
+    event = new psItemSaveEvent(this, interval);
+    psserver->GetEventManager()->Push(event);
+}
+
+void psItemSaver::Queue(psItem* item)
+{
+    queued.Add(item);
+    stats.saves++;
+}
+
+void psItemSaver::Capture(psItem* item)
+{
+    if(queued.Delete(item))
+    {
+        CaptureItem(item);
+    }
+}
+
+void psItemSaver::Capture(psCharacter* owner)
+{
+    csArray<psItem*> items;
+    csSet<csPtrKey<psItem> >::GlobalIterator iter(queued.GetIterator());
+    while(iter.HasNext())
+    {
+        psItem* item = iter.Next();
+        if(item->GetOwningCharacter() == owner)
+        {
+            items.Push(item);
+        }
+    }
+
+    for(size_t i = 0; i < items.GetSize(); i++)
+    {
+        queued.Delete(items[i]);
+        CaptureItem(items[i]);
+    }
+}
+
+void psItemSaver::CaptureItem(psItem* item)
+{
+    if(!item->pendingsave)
+    {
+        return;
+    }
+    item->pendingsave = false;
+
+    if(!item->loaded || item->GetUID() == 0 || item->GetUID() == ID_DONT_SAVE_ITEM)
+    {
+        return;
+    }
+
+    // Escaped with the main connection, the items only live in the main thread
+    psItemRecord record(db);
+    item->AddColumns(&record);
+
+    if(columnNames.IsEmpty())
+    {
+        CS_ASSERT(record.names.GetSize() <= COLUMN_DIFF_MAX_COLUMNS);
+        columnNames = record.names;
+        ownerColumn = columnNames.Find("char_id_owner");
+        guardianColumn = columnNames.Find("char_id_guardian");
+    }
+    CS_ASSERT(record.names.GetSize() == columnNames.GetSize());
+
+    // Nothing known about the row before the first save, write all of it
+    csStringArray* saved = item->savedColumns;
+
+    Row row;
+    row.uid = item->GetUID();
+    row.columns = DiffColumns(saved, record.values, row.values);
+
+    item->item_quality_original = item->item_quality;
+
+    if(!row.columns)
+    {
+        stats.unchanged++;
+        return;
+    }
+
+    // The row moves the item away from the old owner and to the new one,
+    // both see it in the right place after FlushCharacter()
+    size_t columns[] = { ownerColumn, guardianColumn };
+    for(size_t i = 0; i < sizeof(columns)/sizeof(columns[0]); i++)
+    {
+        if(columns[i] == csArrayItemNotFound)
+        {
+            continue;
+        }
+        if(saved)
+        {
+            TouchCharacter(saved->Get(columns[i]));
+        }
+        TouchCharacter(record.values[columns[i]]);
+    }
+
+    if(!saved)
+    {
+        item->savedColumns = new csStringArray;
+    }
+    *item->savedColumns = record.values;
+
+    // Kept until the row is written, to write it again if the writer gives up
+    InFlight pending;
+    pending.values = record.values;
+    pending.generation = generation;
+    inFlight.PutUnique(row.uid, pending);
+
+    if(!captured)
+    {
+        captured = new Batch;
+        captured->generation = generation;
+        captured->written = false;
+    }
+    stats.rows++;
+    stats.columns += row.values.GetSize();
+    AddRow(captured, row);
+}
+
+void psItemSaver::AddRow(Batch* batch, const Row &row)
+{
+    size_t* index = batch->index.GetElementPointer(row.uid);
+    if(!index)
+    {
+        batch->index.Put(row.uid, batch->rows.Push(row));
+        return;
+    }
+
+    // The item was captured twice before a flush, the rows would be written
+    // in any order. Write all the columns with the latest values instead.
+    Row &old = batch->rows[*index];
+    old.values.Empty();
+    old.columns = DiffColumns(NULL, inFlight.GetElementPointer(row.uid)->values, old.values);
+}
+
+void psItemSaver::Requeue(Batch* batch, const csArray<uint32> &uids, bool touch)
+{
+    for(size_t i = 0; i < uids.GetSize(); i++)
+    {
+        InFlight* pending = inFlight.GetElementPointer(uids[i]);
+        if(!pending)
+        {
+            continue;
+        }
+
+        Row row;
+        row.uid = uids[i];
+        row.columns = DiffColumns(NULL, pending->values, row.values);
+        pending->generation = batch->generation;
+
+        size_t* index = batch->index.GetElementPointer(row.uid);
+        if(index)
+        {
+            batch->rows[*index] = row;
+        }
+        else
+        {
+            batch->index.Put(row.uid, batch->rows.Push(row));
+        }
+
+        if(touch)
+        {
+            if(ownerColumn != csArrayItemNotFound)
+            {
+                TouchCharacter(pending->values[ownerColumn]);
+            }
+            if(guardianColumn != csArrayItemNotFound)
+            {
+                TouchCharacter(pending->values[guardianColumn]);
+            }
+        }
+        stats.requeued++;
+    }
+}
+
+void psItemSaver::WriteFailed()
+{
+    Batch batch;
+    batch.generation = generation;
+    batch.written = false;
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        Requeue(&batch, failed, false);
+        failed.Empty();
+    }
+
+    if(batch.rows.IsEmpty())
+    {
+        return;
+    }
+
+    // Once, the main thread doesn't wait between attempts. Rows still not
+    // written are queued again with the next flush.
+    if(!Write(db, &batch))
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        for(size_t i = 0; i < batch.rows.GetSize(); i++)
+        {
+            failed.Push(batch.rows[i].uid);
+        }
+    }
+}
+
+void psItemSaver::TouchCharacter(const char* pid)
+{
+    uint32 id = strtoul(pid, NULL, 10);
+    if(id)
+    {
+        lastWrite.PutUnique(id, generation);
+    }
+}
+
+void psItemSaver::Flush()
+{
+    csArray<uint32> requeue;
+    uint32 done;
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        requeue = failed;
+        failed.Empty();
+        done = written;
+    }
+
+    csArray<psItem*> items;
+    csSet<csPtrKey<psItem> >::GlobalIterator iter(queued.GetIterator());
+    while(iter.HasNext())
+    {
+        items.Push(iter.Next());
+    }
+    queued.DeleteAll();
+
+    for(size_t i = 0; i < items.GetSize(); i++)
+    {
+        CaptureItem(items[i]);
+    }
+
+    // The rows the writer gave up on go out again, after the items captured
+    // above so they carry their latest values
+    if(!requeue.IsEmpty())
+    {
+        if(!captured)
+        {
+            captured = new Batch;
+            captured->generation = generation;
+            captured->written = false;
+        }
+        Requeue(captured, requeue, true);
+    }
+
+    // Forget the values of the items with their last row written
+    csArray<uint32> forgetItems;
+    csHash<InFlight, uint32>::GlobalIterator pending(inFlight.GetIterator());
+    while(pending.HasNext())
+    {
+        uint32 uid;
+        InFlight &item = pending.Next(uid);
+        if(item.generation <= done)
+        {
+            forgetItems.Push(uid);
+        }
+    }
+    for(size_t i = 0; i < forgetItems.GetSize(); i++)
+    {
+        inFlight.DeleteAll(forgetItems[i]);
+    }
+
+    if(!captured)
+    {
+        return;
+    }
+
+    Debug3(LOG_CACHE, 0, "Item saver writing %zu rows of generation %u.", captured->rows.GetSize(), generation);
+
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+        writing += captured->rows.GetSize();
+        batches.PushBack(captured);
+        workCondition.NotifyOne();
+    }
+    captured = NULL;
+    generation++;
+
+    // Forget the characters with all their rows written
+    csArray<uint32> forget;
+    csHash<uint32, uint32>::GlobalIterator touched(lastWrite.GetIterator());
+    while(touched.HasNext())
+    {
+        uint32 pid;
+        uint32 last = touched.Next(pid);
+        if(last <= done)
+        {
+            forget.Push(pid);
+        }
+    }
+    for(size_t i = 0; i < forget.GetSize(); i++)
+    {
+        lastWrite.DeleteAll(forget[i]);
+    }
+}
+
+void psItemSaver::FlushCharacter(PID pid)
+{
+    Flush();
+
+    uint32 last = lastWrite.Get(pid.Unbox(), 0);
+    if(!last)
+    {
+        return;
+    }
+
+    csTicks start = csGetTicks();
+    {
+        CS::Threading::MutexScopedLock lock(mutex);
+
+        // The writer stops waiting between attempts while we wait
+        waiting++;
+        retryCondition.NotifyAll();
+        while(written < last && thread)
+        {
+            doneCondition.Wait(mutex);
+        }
+        waiting--;
+    }
+    lastWrite.DeleteAll(pid.Unbox());
+
+    // The rows the writer gave up on, which may be the ones of this character
+    WriteFailed();
+
+    Debug3(LOG_CACHE, pid.Unbox(), "Waited %u ms for the items of %s to be written.", csGetTicks() - start, ShowID(pid));
+}
+
+void psItemSaver::GetStats(Stats &result)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    result = stats;
+    result.queued = queued.GetSize();
+    result.writing = writing;
+}
+
+void psItemSaver::WriterStarted(bool writerConnected)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    connected = writerConnected;
+    starting = false;
+    doneCondition.NotifyAll();
+}
+
+bool psItemSaver::WaitToRetry()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    if(!waiting && !stop)
+    {
+        retryCondition.Wait(mutex, RETRY_DELAY);
+    }
+
+    // The main thread writes the rows given up on once it is done waiting
+    return !waiting && !stop;
+}
+
+psItemSaver::Batch* psItemSaver::WaitForBatch()
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+
+    // The batches left are written before stopping
+    while(!stop && batches.IsEmpty())
+    {
+        workCondition.Wait(mutex);
+    }
+
+    if(batches.IsEmpty())
+    {
+        return NULL;
+    }
+
+    Batch* batch = batches.Front();
+    batches.PopFront();
+    return batch;
+}
+
+bool psItemSaver::Write(iDataConnection* connection, Batch* batch)
+{
+    // Group the rows changing the same columns
+    csArray<uint32> masks;
+    for(size_t i = 0; i < batch->rows.GetSize(); i++)
+    {
+        masks.Push(batch->rows[i].columns);
+    }
+    csArray<uint32> groupColumns;
+    csArray<csArray<size_t> > groupRows;
+    GroupByColumns(masks, groupColumns, groupRows);
+
+    size_t statements = 0;
+    bool ok = (connection->Command("BEGIN") != QUERY_FAILED);
+
+    for(size_t group = 0; ok && group < groupColumns.GetSize(); group++)
+    {
+        csArray<size_t> &rows = groupRows[group];
+        for(size_t first = 0; ok && first < rows.GetSize(); first += ROWS_PER_STATEMENT)
+        {
+            size_t last = (rows.GetSize() - first > ROWS_PER_STATEMENT) ? first + ROWS_PER_STATEMENT : rows.GetSize();
+
+            // UPDATE item_instances SET a = CASE id WHEN 1 THEN .. WHEN 2 THEN .. ELSE a END, b = ..
+            //   WHERE id IN (1,2)
+            csString sql("UPDATE item_instances SET ");
+            size_t value = 0;
+            for(size_t column = 0; column < columnNames.GetSize(); column++)
+            {
+                if(!(groupColumns[group] & (1u << column)))
+                {
+                    continue;
+                }
+
+                if(value)
+                {
+                    sql.Append(", ");
+                }
+                sql.AppendFmt("%s = CASE id", columnNames[column]);
+                for(size_t i = first; i < last; i++)
+                {
+                    Row &row = batch->rows[rows[i]];
+                    sql.AppendFmt(" WHEN %u THEN %s", row.uid, row.values[value]);
+                }
+                sql.AppendFmt(" ELSE %s END", columnNames[column]);
+                value++;
+            }
+
+            sql.Append(" WHERE id IN (");
+            for(size_t i = first; i < last; i++)
+            {
+                sql.AppendFmt(i == first ? "%u" : ",%u", batch->rows[rows[i]].uid);
+            }
+            sql.Append(")");
+
+            ok = (connection->Command("%s", sql.GetData()) != QUERY_FAILED);
+            statements++;
+        }
+    }
+
+    if(ok)
+    {
+        ok = (connection->Command("COMMIT") != QUERY_FAILED);
+    }
+    if(!ok)
+    {
+        Error4("Item saver failed to write %zu rows: %s\nQuery: %s", batch->rows.GetSize(),
+               connection->GetLastError(), connection->GetLastQuery());
+        // item_instances is MyISAM, the statements run before stay written
+        connection->Command("ROLLBACK");
+    }
+
+    CS::Threading::MutexScopedLock lock(mutex);
+    stats.statements += statements;
+    stats.transactions++;
+    if(!ok)
+    {
+        stats.failures++;
+    }
+    batch->written = ok;
+    return ok;
+}
+
+void psItemSaver::Written(Batch* batch)
+{
+    CS::Threading::MutexScopedLock lock(mutex);
+    if(!batch->written)
+    {
+        Error2("Item saver gave up writing %zu rows, they are written again with the next flush.",
+               batch->rows.GetSize());
+        for(size_t i = 0; i < batch->rows.GetSize(); i++)
+        {
+            failed.Push(batch->rows[i].uid);
+        }
+    }
+    writing -= batch->rows.GetSize();
+    written = batch->generation;
+    doneCondition.NotifyAll();
+
+    delete batch;
+}
+
+//-----------------------------------------------------------------------------
+
+psItemSaveEvent::psItemSaveEvent(psItemSaver* saver, csTicks interval)
+    :psGameEvent(0, interval, "psItemSaveEvent"),saver(saver)
+{
+}
+
+void psItemSaveEvent::Trigger()
+{
+    saver->Flush();
+    saver->Schedule();
+}
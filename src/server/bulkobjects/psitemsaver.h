@@ -0,0 +1,284 @@
+/*
+ * psitemsaver.h
+ *
+ * Copyright (C) 2013 Atomic Blue (info@planeshift.it, http://www.atomicblue.org)
+ *
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation (version 2 of the License)
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+
+#ifndef __PSITEMSAVER_H__
+#define __PSITEMSAVER_H__
+
+//=============================================================================
+// Crystal Space Includes
+//=============================================================================
+#include <csutil/array.h>
+#include <csutil/hash.h>
+#include <csutil/list.h>
+#include <csutil/set.h>
+#include <csutil/stringarray.h>
+#include <csutil/threading/thread.h>
+#include <csutil/threading/mutex.h>
+#include <csutil/threading/condition.h>
+
+//=============================================================================
+// Project Includes
+//=============================================================================
+#include <idal.h>      // Database Abstraction Layer Interface
+
+#include "util/gameevent.h"
+#include "util/columndiff.h"
+#include "util/psconst.h"
+
+class psItem;
+class psCharacter;
+class psItemSaveEvent;
+struct iObjectRegistry;
+
+/**
+ * \addtogroup bulkobjects
+ * @{ */
+
+/**
+ * Collects the columns psItem::AddColumns() sets as SQL literals instead of
+ * binding them to a prepared statement.
+ */
+class psItemRecord : public iRecord
+{
+public:
+    psItemRecord(iDataConnection* db);
+
+    virtual void AddField(const char* fname, float fValue);
+    virtual void AddField(const char* fname, int iValue);
+    virtual void AddField(const char* fname, unsigned int uiValue);
+    virtual void AddField(const char* fname, unsigned short usValue);
+    virtual void AddField(const char* fname, const char* sValue);
+    virtual void AddFieldNull(const char* fname);
+
+    /// Not a statement, nothing to execute.
+    virtual bool Execute(uint32 uid);
+
+    virtual void Reset();
+
+    csStringArray names;
+    csStringArray values;       ///< Quoted and escaped where needed
+
+private:
+    iDataConnection* db;        ///< Only used to escape strings
+};
+
+/*   Design notes:
+ *
+ *  psItem::Save() used to write the whole row of the item at once, with
+ *  the main thread waiting for the database. Items are saved after nearly
+ *  every change, a stack moved around the inventory is saved a few times a
+ *  second.
+ *
+ *  Items which already have an id are now queued here instead. Every flush
+ *  interval the main thread compares the columns of each queued item with
+ *  the ones written last time and only hands the changed ones to a writer
+ *  thread with its own database connection. Any number of saves of an item
+ *  between two flushes end up as one row. The writer groups the rows
+ *  changing the same columns into multi row UPDATE statements. The
+ *  statements of a flush are sent between BEGIN and COMMIT, but
+ *  item_instances is MyISAM so a failure leaves the ones run before it
+ *  written. The statements only set values, so a failed batch is simply
+ *  written again a few times. If it still fails, the main thread queues
+ *  its rows again with the next flush, in full and with the latest values
+ *  of their items, until they are written.
+ *
+ *  New items are still inserted by psItem::Commit() at once, their callers
+ *  need the id. Rows are only updated, never inserted, so an item deleted
+ *  from the database meanwhile stays deleted.
+ *
+ *  Consistency:
+ *  1) Items being deleted, and all the items of a character being deleted,
+ *     are captured before they are gone and written with the next flush.
+ *  2) FlushCharacter() is called before a character is loaded from the
+ *     database. It writes everything queued and waits for the rows touching
+ *     the items of that character, so a character logging out and back in,
+ *     or items given to a character who is offline, are never read stale.
+ *     The writer doesn't wait between attempts while a character waits,
+ *     the rows it gives up on are written by the main thread at once.
+ *  3) Stop() writes everything queued and is called before the database is
+ *     closed at shutdown. The rows the writer gave up on are written by
+ *     the main thread.
+ */
+class psItemSaver
+{
+public:
+    psItemSaver();
+    ~psItemSaver();
+
+    /**
+     * Start the writer thread.
+     *
+     * @param interval Milliseconds the saves of an item are collected.
+     * @return false if the writer couldn't connect to the database.
+     */
+    bool Start(iObjectRegistry* objreg, csTicks interval, const char* host, unsigned int port,
+               const char* user, const char* pwd, const char* database);
+
+    /// Write everything queued and stop the writer.
+    void Stop();
+
+    /// Queue an item with an id to be written with the next flush.
+    void Queue(psItem* item);
+
+    /// Capture the queued save of an item being deleted.
+    void Capture(psItem* item);
+
+    /// Capture the queued saves of all the items of a character being deleted.
+    void Capture(psCharacter* owner);
+
+    /// Hand the changes of all queued items to the writer.
+    void Flush();
+
+    /**
+     * Flush and wait until the rows touching the items owned or guarded by
+     * a character are written.
+     */
+    void FlushCharacter(PID pid);
+
+    /// Counters since the saver was created
+    struct Stats
+    {
+        uint64 saves;           ///< Items queued
+        uint64 unchanged;       ///< Items saved without any column changed
+        uint64 rows;            ///< Rows handed to the writer
+        uint64 columns;         ///< Columns in those rows
+        uint64 statements;      ///< UPDATE statements run by the writer
+        uint64 transactions;
+        uint64 failures;        ///< Attempts to write a batch which failed
+        uint64 requeued;        ///< Rows given up by the writer and written again
+        size_t queued;          ///< Items waiting for the next flush
+        size_t writing;         ///< Rows waiting for the writer
+    };
+
+    void GetStats(Stats &stats);
+
+private:
+    class Writer;
+    friend class Writer;
+    friend class psItemSaveEvent;
+
+    /// The changed columns of one item
+    struct Row
+    {
+        uint32 uid;
+        uint32 columns;         ///< Bit per column of columnNames
+        csStringArray values;   ///< The changed columns only
+    };
+
+    /// The rows of one flush
+    struct Batch
+    {
+        csArray<Row> rows;
+        csHash<size_t, uint32> index;  ///< Of the row of each item by uid
+        uint32 generation;
+        bool written;           ///< Set by the last attempt to write it
+    };
+
+    /// The values of an item handed to the writer and maybe not written yet
+    struct InFlight
+    {
+        csStringArray values;   ///< All the columns, as of the last capture
+        uint32 generation;      ///< Of the last batch with a row of the item
+    };
+
+    /// Push the event of the next flush.
+    void Schedule();
+
+    /// Add the changed columns of an item to the batch being captured.
+    void CaptureItem(psItem* item);
+
+    /// Remember that the rows captured so far touch this character.
+    void TouchCharacter(const char* pid);
+
+    /// Add a row to a batch, replacing the row of the same item if there is one.
+    void AddRow(Batch* batch, const Row &row);
+
+    /**
+     * Add full rows with the latest values of items to a batch.
+     *
+     * @param touch Remember the characters touched, for the batches
+     *              handed to the writer.
+     */
+    void Requeue(Batch* batch, const csArray<uint32> &uids, bool touch);
+
+    /// Write the rows given up by the writer with the main connection.
+    void WriteFailed();
+
+    /// Called by the writer between attempts, false if it should give up.
+    bool WaitToRetry();
+
+    /// Wait for the next batch, NULL when stopped.
+    Batch* WaitForBatch();
+
+    /// Write a batch on the connection of the writer, false if it failed.
+    bool Write(iDataConnection* connection, Batch* batch);
+
+    /// Called by the writer when it is done with a batch, written or not.
+    void Written(Batch* batch);
+
+    /// Called by the writer once it tried to connect to the database.
+    void WriterStarted(bool connected);
+
+    csTicks interval;
+    psItemSaveEvent* event;
+    csSet<csPtrKey<psItem> > queued;
+    Batch* captured;            ///< Rows captured since the last flush
+    uint32 generation;          ///< Of the batch being captured
+    csHash<uint32, uint32> lastWrite;  ///< Last generation touching a character by pid
+    csHash<InFlight, uint32> inFlight; ///< By uid, forgotten once their batch is written
+    csStringArray columnNames;
+    size_t ownerColumn;
+    size_t guardianColumn;
+
+    CS::Threading::Mutex mutex;
+    CS::Threading::Condition workCondition;
+    CS::Threading::Condition doneCondition;
+    CS::Threading::Condition retryCondition;
+    csList<Batch*> batches;
+    csArray<uint32> failed;     ///< Uids of the rows given up by the writer
+    uint32 written;             ///< Generation of the last batch written
+    size_t writing;
+    size_t waiting;             ///< Characters waiting in FlushCharacter()
+    bool stop;
+    bool starting;
+    bool connected;
+
+    csRef<CS::Threading::Runnable> writer;
+    csRef<CS::Threading::Thread> thread;
+
+    Stats stats;
+};
+
+/**
+ * Flushes the psItemSaver periodically.
+ */
+class psItemSaveEvent : public psGameEvent
+{
+public:
+    psItemSaveEvent(psItemSaver* saver, csTicks interval);
+
+    virtual void Trigger();
+
+private:
+    psItemSaver* saver;
+};
+
+/** @} */
+
+#endif
@@ -36,13 +36,14 @@
 // Local Includes
 //=============================================================================
 #include "psmerchantinfo.h"
+#include "pscharacterqueries.h"
 
 
-bool psMerchantInfo::Load(PID pid)
+bool psMerchantInfo::Load(PID pid, iDataConnection* connection)
 {
     bool is_merchant = false;
 
-    Result merchant_categories(db->Select("SELECT * from merchant_item_categories where player_id=%u", pid.Unbox()));
+    Result merchant_categories(connection->Select(CHARACTER_MERCHANT_QUERY, pid.Unbox()));
     if(merchant_categories.IsValid())
     {
         int i;
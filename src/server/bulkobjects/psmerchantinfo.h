@@ -60,9 +60,10 @@ public:
      * merchant item categories for the character.
      *
      * @param pid The characterid to check.
+     * @param connection Runs the select of the categories.
      * @return Return true if the character is a merchant.
      */
-    bool Load(PID pid);
+    bool Load(PID pid, iDataConnection* connection);
 
     psItemCategory* FindCategory(int id);
     psItemCategory* FindCategory(const csString &name);
@@ -36,6 +36,7 @@
 // Local Includes
 //=============================================================================
 #include "pstrainerinfo.h"
+#include "pscharacterqueries.h"
 
 /**
  * A character is defined to be a trainer if there are
@@ -43,11 +44,11 @@
  *
  * @return Return true if the character is a trainer.
  */
-bool psTrainerInfo::Load(PID pid)
+bool psTrainerInfo::Load(PID pid, iDataConnection* connection)
 {
     bool isTrainer = false;
 
-    Result trainerSkills(db->Select("SELECT * from trainer_skills where player_id=%u", pid.Unbox()));
+    Result trainerSkills(connection->Select(CHARACTER_TRAINER_QUERY, pid.Unbox()));
     if(trainerSkills.IsValid())
     {
         int i,count=trainerSkills.Count();
@@ -35,6 +35,7 @@
 #include "psskills.h"
 
 class psSkillInfo;
+struct iDataConnection;
 
 struct psTrainerSkill
 {
@@ -48,7 +49,7 @@ struct psTrainerSkill
 class psTrainerInfo : public csRefCount
 {
 public:
-    bool Load(PID pid);
+    bool Load(PID pid, iDataConnection* connection);
     /// determines if the player can train this skill
     bool CanTrainSkill(PSSKILL skill, unsigned int rank, float faction);
 
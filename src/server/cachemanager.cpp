@@ -380,7 +380,8 @@ void CacheManager::UnloadAll()
         while(it.HasNext())
         {
             CachedObject* newCachedObject = it.Next();
-            newCachedObject->event->CancelEvent();
+            if(!psserver->GetEventManager()->Cancel(newCachedObject->event))
+                newCachedObject->event->CancelEvent();
             newCachedObject->object->ProcessCacheTimeout();
             newCachedObject->object->DeleteSelf();
             delete newCachedObject;
@@ -4169,7 +4170,9 @@ iCachedObject* CacheManager::RemoveFromCache(const char* name)
     CachedObject* oldRecord = generic_object_cache.Get(name, NULL);
     if(oldRecord)
     {
-        oldRecord->event->CancelEvent();
+        // Drop the expire event right away unless it is the one removing the object
+        if(!psserver->GetEventManager()->Cancel(oldRecord->event))
+            oldRecord->event->CancelEvent();
         generic_object_cache.DeleteAll(oldRecord->name);
         iCachedObject* save = oldRecord->object;
         delete oldRecord;
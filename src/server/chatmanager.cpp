@@ -153,12 +153,13 @@ void ChatManager::HandleChatMessage(MsgEntry* me, Client* client)
 
                 csArray<uint32_t> subscribers = channelSubscribers.GetAll(msg.channelID);
                 csArray<PublishDestination> destArray;
+                csRef<ChatLine> line = gemActor::FormatChatMessage(client->GetActor()->GetFirstName(), newMsg);
                 for(size_t i = 0; i < subscribers.GetSize(); i++)
                 {
                     destArray.Push(PublishDestination(subscribers[i], NULL, 0, 0));
                     Client* target = psserver->GetConnections()->Find(subscribers[i]);
                     if(target && target->IsReady())
-                        target->GetActor()->LogChatMessage(client->GetActor()->GetFirstName(), newMsg);
+                        target->GetActor()->LogChatLine(line);
                 }
 
                 newMsg.Multicast(destArray, 0, PROX_LIST_ANY_RANGE);
@@ -439,12 +440,13 @@ void ChatManager::SendServerChannelMessage(psChatMessage &msg, uint32_t channelI
 {
     csArray<uint32_t> subscribers = channelSubscribers.GetAll(channelID);
     csArray<PublishDestination> destArray;
+    csRef<ChatLine> line = gemActor::FormatChatMessage("Server Admin", msg);
     for(size_t i = 0; i < subscribers.GetSize(); i++)
     {
         destArray.Push(PublishDestination(subscribers[i], NULL, 0, 0));
         Client* target = psserver->GetConnections()->Find(subscribers[i]);
         if(target && target->IsReady())
-            target->GetActor()->LogChatMessage("Server Admin", msg);
+            target->GetActor()->LogChatLine(line);
     }
 
     msg.Multicast(destArray, 0, PROX_LIST_ANY_RANGE);
@@ -459,12 +461,14 @@ void ChatManager::SendShout(Client* c, psChatMessage &msg)
         csArray<PublishDestination> &clients = c->GetActor()->GetMulticastClients();
         newMsg.Multicast(clients, 0, PROX_LIST_ANY_RANGE);
 
-        // The message is saved to the chat history of all the clients around
+        // The message is saved to the chat history of all the clients around,
+        // they all keep a reference to the same line
+        csRef<ChatLine> line = gemActor::FormatChatMessage(c->GetActor()->GetFirstName(), newMsg);
         for(size_t i = 0; i < clients.GetSize(); i++)
         {
             Client* target = psserver->GetConnections()->Find(clients[i].client);
             if(target && target->IsReady())
-                target->GetActor()->LogChatMessage(c->GetActor()->GetFirstName(), newMsg);
+                target->GetActor()->LogChatLine(line);
         }
     }
     else
@@ -496,12 +500,14 @@ void ChatManager::SendSay(uint32_t clientNum, gemActor* actor, psChatMessage &ms
     csArray<PublishDestination> &clients = actor->GetMulticastClients();
     newMsg.Multicast(clients, 0, range);
 
-    // The message is saved to the chat history of all the clients around (PS#2789)
+    // The message is saved to the chat history of all the clients around (PS#2789),
+    // they all keep a reference to the same line
+    csRef<ChatLine> line = gemActor::FormatChatMessage(actor->GetFirstName(), newMsg);
     for(size_t i = 0; i < clients.GetSize(); i++)
     {
         Client* target = psserver->GetConnections()->Find(clients[i].client);
         if(target && clients[i].dist < range)
-            target->GetActor()->LogChatMessage(actor->GetFirstName(), newMsg);
+            target->GetActor()->LogChatLine(line);
     }
 }
 
@@ -531,6 +537,7 @@ void ChatManager::SendGuild(const csString &sender, EID senderEID, psGuildInfo*
 {
     ClientIterator iter(*psserver->GetConnections());
     psGuildMember* member;
+    csRef<ChatLine> line = gemActor::FormatChatMessage(sender.GetData(), msg);
 
     while(iter.HasNext())
     {
@@ -543,7 +550,7 @@ void ChatManager::SendGuild(const csString &sender, EID senderEID, psGuildInfo*
         psChatMessage newMsg(client->GetClientNum(), senderEID, sender, 0, msg.sText, msg.iChatType, msg.translate);
         newMsg.SendMessage();
         // The message is saved to the chat history of all the clients in the same guild (PS#2789)
-        client->GetActor()->LogChatMessage(sender.GetData(), msg);
+        client->GetActor()->LogChatLine(line);
     }
 }
 
@@ -580,6 +587,7 @@ void ChatManager::SendAlliance(const csString &sender, EID senderEID, psGuildAll
 {
     ClientIterator iter(*psserver->GetConnections());
     psGuildMember* member;
+    csRef<ChatLine> line = gemActor::FormatChatMessage(sender.GetData(), msg);
 
     while(iter.HasNext())
     {
@@ -592,7 +600,7 @@ void ChatManager::SendAlliance(const csString &sender, EID senderEID, psGuildAll
         psChatMessage newMsg(client->GetClientNum(), senderEID, sender, 0, msg.sText, msg.iChatType, msg.translate);
         newMsg.SendMessage();
         // The message is saved to the chat history of all the clients in the same alliance (PS#2789)
-        client->GetActor()->LogChatMessage(sender.GetData(), msg);
+        client->GetActor()->LogChatLine(line);
     }
 }
 
@@ -604,9 +612,10 @@ void ChatManager::SendGroup(Client* client, psChatMessage &msg)
         psChatMessage newMsg(0, client->GetActor()->GetEID(), client->GetName(), 0, msg.sText, msg.iChatType, msg.translate);
         group->Broadcast(newMsg.msg);
         // Save chat message to grouped clients' history (PS#2789)
+        csRef<ChatLine> line = gemActor::FormatChatMessage(client->GetActor()->GetFirstName(), newMsg);
         for(size_t i=0; i<group->GetMemberCount(); i++)
         {
-            group->GetMember(i)->LogChatMessage(client->GetActor()->GetFirstName(), newMsg);
+            group->GetMember(i)->LogChatLine(line);
         }
     }
     else
@@ -634,8 +643,9 @@ void ChatManager::SendTell(psChatMessage &msg, const char* who,Client* client,Cl
     cmsg2.SendMessage();
 
     // Save to both actors' chat history (PS#2789)
-    client->GetActor()->LogChatMessage(who, msg);
-    target->GetActor()->LogChatMessage(who, msg);
+    csRef<ChatLine> line = gemActor::FormatChatMessage(who, msg);
+    client->GetActor()->LogChatLine(line);
+    target->GetActor()->LogChatLine(line);
 }
 
 NpcResponse* ChatManager::CheckNPCEvent(Client* client,csString &triggerText,gemNPC* &target)
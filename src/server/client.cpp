@@ -41,6 +41,7 @@
 //=============================================================================
 #include "usermanager.h"
 #include "client.h"
+#include "clients.h"
 #include "psserver.h"
 #include "playergroup.h"
 #include "globals.h"
@@ -53,9 +54,9 @@
 #include "adminmanager.h"
 
 Client::Client()
-    : accumulatedLag(0), zombie(false), zombietimeout(0), 
+    : accumulatedLag(0), clientSet(NULL), zombie(false), zombietimeout(0), 
       allowedToDisconnect(true), ready(false),
-      accountID(0), playerID(0), securityLevel(0), superclient(false),
+      accountID(0), playerID(0), securityLevel(0), superclient(false), netCapabilities(0),
       name(""), waypointPathIndex(0), pathPath(NULL), selectedLocationID(0),
       cheatMask(NO_CHEAT)
 {
@@ -269,6 +270,7 @@ bool Client::IsMyPet(gemActor* other) const
 void Client::SetName(const char* n)
 {
     name = n;
+    UpdateIndexes();
 }
 
 const char* Client::GetName()
@@ -291,6 +293,15 @@ void Client::SetActor(gemActor* myactor)
     {
         allowedToDisconnect = true;
     }
+
+    // The name is the one of the character now
+    UpdateIndexes();
+}
+
+void Client::UpdateIndexes()
+{
+    if(clientSet)
+        clientSet->UpdateIndexes(this);
 }
 
 psCharacter* Client::GetCharacterData()
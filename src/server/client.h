@@ -31,6 +31,7 @@
 //=============================================================================
 #include "net/netbase.h"
 #include "util/psconst.h"
+#include "util/drqueue.h"
 #include "bulkobjects/buffable.h"
 
 //=============================================================================
@@ -38,6 +39,7 @@
 //=============================================================================
 
 class Client;
+class ClientConnectionSet;
 class psCharacter;
 class gemObject;
 class gemActor;
@@ -216,6 +218,7 @@ public:
     void SetAccountID(AccountID id)
     {
         accountID = id;
+        UpdateIndexes();
     }
 
     /// The player number for this client.
@@ -226,6 +229,7 @@ public:
     void SetPID(PID id)
     {
         playerID = id;
+        UpdateIndexes();
     }
 
     int GetExchangeID()
@@ -296,6 +300,22 @@ public:
         return (!superclient);
     }
 
+    /// The NetCapabilities the client asked for when it authenticated
+    void SetNetCapabilities(uint32_t caps)
+    {
+        netCapabilities = caps;
+    }
+    bool HasNetCapability(uint32_t cap) const
+    {
+        return (netCapabilities & cap) != 0;
+    }
+
+    /// The compact dead reckoning waiting for the next world update tick.
+    psDRQueue &GetDRQueue()
+    {
+        return drQueue;
+    }
+
     /**
      * Return a string representing the ip address of this client.
      */
@@ -501,6 +521,18 @@ public:
     }
 
 protected:
+    friend class ClientConnectionSet;
+
+    /// Let the ClientConnectionSet index the new name, player id or account id
+    void UpdateIndexes();
+
+    /// The set the client was added to, NULL once it is marked to be deleted
+    ClientConnectionSet* clientSet;
+
+    /// The keys the client is indexed by in the ClientConnectionSet
+    csString indexedName;
+    PID indexedPID;
+    AccountID indexedAccountID;
 
     /**
      * A zombie client is a client where the player has disconnected, but
@@ -538,6 +570,8 @@ protected:
     PID playerID;
     int  securityLevel;
     bool superclient;
+    uint32_t netCapabilities;
+    psDRQueue drQueue;
     csArray<gemNPC*> listeningNpc;
     csString name;
 
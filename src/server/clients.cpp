@@ -56,7 +56,7 @@ bool SockAddress::operator< (const SockAddress &other) const
 }
 
 
-ClientConnectionSet::ClientConnectionSet():addrHash(307),hash(307)
+ClientConnectionSet::ClientConnectionSet():addrHash(307),hash(307),nameHash(307),pidHash(307),accountHash(307)
 {
 }
 
@@ -101,6 +101,8 @@ Client* ClientConnectionSet::Add(LPSOCKADDR_IN addr)
     CS::Threading::RecursiveMutexScopedLock lock(mutex);
     addrHash.PutUnique(SockAddress(client->GetAddress()), client);
     hash.Put(client->GetClientNum(), client);
+    client->clientSet = this;
+    UpdateIndexes(client);
     return client;
 }
 
@@ -113,9 +115,39 @@ void ClientConnectionSet::MarkDelete(Client* client)
         Bug2("Couldn't delete client %d, it was never added!", clientid);
 
     hash.DeleteAll(clientid);
+
+    {
+        CS::Threading::ScopedWriteLock indexLock(indexMutex);
+        RemoveIndexes(client);
+        client->clientSet = NULL;
+    }
+
     toDelete.Push(client);
 }
 
+void ClientConnectionSet::UpdateIndexes(Client* client)
+{
+    csString name(client->GetName());
+    name.Downcase();
+
+    CS::Threading::ScopedWriteLock lock(indexMutex);
+    RemoveIndexes(client);
+
+    client->indexedName = name;
+    client->indexedPID = client->GetPID();
+    client->indexedAccountID = client->GetAccountID();
+    nameHash.Put(client->indexedName, client);
+    pidHash.Put(client->indexedPID, client);
+    accountHash.Put(client->indexedAccountID, client);
+}
+
+void ClientConnectionSet::RemoveIndexes(Client* client)
+{
+    nameHash.Delete(client->indexedName, client);
+    pidHash.Delete(client->indexedPID, client);
+    accountHash.Delete(client->indexedAccountID, client);
+}
+
 void ClientConnectionSet::SweepDelete()
 {
     CS::Threading::RecursiveMutexScopedLock lock(mutex);
@@ -184,50 +216,36 @@ Client* ClientConnectionSet::Find(const char* name)
         return NULL;
     }
 
-    CS::Threading::RecursiveMutexScopedLock lock(mutex);
-    AddressHash::GlobalIterator it(addrHash.GetIterator());
-    Client* p = NULL;
-    while(it.HasNext())
-    {
-        p = it.Next();
-        if(!p->GetName())
-            continue;
-
-        if(!strcasecmp(p->GetName(), name))
-            break;
-        p = NULL;
-    }
-
-    if(p && p->IsReady())
-        return p;
-    else
-        return NULL;
-}
-
-Client* ClientConnectionSet::FindPlayer(PID playerID)
-{
-    CS::Threading::RecursiveMutexScopedLock lock(mutex);
-    AddressHash::GlobalIterator it(addrHash.GetIterator());
+    csString key(name);
+    key.Downcase();
 
+    CS::Threading::ScopedReadLock lock(indexMutex);
+    csHash<Client*, csString>::Iterator it(nameHash.GetIterator(key));
     while(it.HasNext())
     {
         Client* p = it.Next();
-        if(p->GetPID() == playerID)
+        if(p->IsReady())
             return p;
     }
 
     return NULL;
 }
 
+Client* ClientConnectionSet::FindPlayer(PID playerID)
+{
+    CS::Threading::ScopedReadLock lock(indexMutex);
+    return pidHash.Get(playerID, NULL);
+}
+
 Client* ClientConnectionSet::FindAccount(AccountID accountID, uint32_t excludeClient)
 {
-    CS::Threading::RecursiveMutexScopedLock lock(mutex);
-    AddressHash::GlobalIterator it(addrHash.GetIterator());
+    CS::Threading::ScopedReadLock lock(indexMutex);
+    csHash<Client*, AccountID>::Iterator it(accountHash.GetIterator(accountID));
 
     while(it.HasNext())
     {
         Client* p = it.Next();
-        if(p->GetAccountID() == accountID && p->GetClientNum() != excludeClient)
+        if(p->GetClientNum() != excludeClient)
             return p;
     }
 
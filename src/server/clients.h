@@ -21,6 +21,7 @@
 
 #include <csutil/hash.h>
 #include <csutil/threading/thread.h>
+#include <csutil/threading/rwmutex.h>
 
 #include "client.h"
 
@@ -54,6 +55,12 @@ template<> class csHashComputer<SockAddress> :
  * This class is a list of several CLient objects, it's designed for finding
  * clients very fast based on their clientnum or their IP address.
  * This class is also threadsafe now
+ *
+ * Clients are also indexed by their name, player id and account id. The
+ * Client calls UpdateIndexes() whenever one of them changes. These indexes
+ * have a read/write lock of their own, so the chat and the GM commands
+ * looking players up don't wait for the network thread holding the mutex
+ * of the address hash.
  */
 class ClientConnectionSet
 {
@@ -67,6 +74,14 @@ protected:
     csPDelArray<Client> toDelete;
     CS::Threading::RecursiveMutex mutex;
 
+    csHash<Client*, csString> nameHash;     ///< By lower case Client::GetName()
+    csHash<Client*, PID> pidHash;
+    csHash<Client*, AccountID> accountHash;
+    CS::Threading::ReadWriteMutex indexMutex; ///< Protects the three hashes above
+
+    /// Remove the client from the name, pid and account indexes, with indexMutex held.
+    void RemoveIndexes(Client* client);
+
 public:
     ClientConnectionSet();
     ~ClientConnectionSet();
@@ -81,6 +96,9 @@ public:
     // Mark this client as ready to be deleted
     void MarkDelete(Client* client);
 
+    /// Index the client again after its name, player id or account id changed
+    void UpdateIndexes(Client* client);
+
     /// Count the number of clients connected, including superclients
     size_t Count(void) const;
 
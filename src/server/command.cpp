@@ -35,6 +35,7 @@
 #include <iutil/cfgmgr.h>
 #include <csutil/csstring.h>
 #include <csutil/md5.h>
+#include <csutil/sysfunc.h>
 #include <iutil/stringarray.h>
 #include <iengine/collection.h>
 #include <iengine/engine.h>
@@ -43,12 +44,16 @@
 #include "util/serverconsole.h"
 #include "util/eventmanager.h"
 #include "net/messages.h"
+#include "net/netprofile.h"
 #include "globals.h"
 #include "psserver.h"
 #include "cachemanager.h"
 #include "playergroup.h"
 #include "netmanager.h"
 #include "util/strutil.h"
+#include "util/bufferpool.h"
+#include "util/asynclog.h"
+#include "util/mathscript.h"
 #include "gem.h"
 #include "invitemanager.h"
 #include "entitymanager.h"
@@ -71,6 +76,8 @@
 #include "bulkobjects/psnpcdialog.h"
 
 #include "bulkobjects/pscharacterloader.h"
+#include "bulkobjects/pscharacterprefetcher.h"
+#include "bulkobjects/psitemsaver.h"
 #include "bulkobjects/psnpcloader.h"
 #include "bulkobjects/psaccountinfo.h"
 #include "bulkobjects/pstrainerinfo.h"
@@ -268,11 +275,46 @@ int com_setmaxfile(const char* arg)
 int com_netprofile(const char*)
 {
     psNetMsgProfiles* profs = psserver->GetNetManager()->GetProfs();
+    psMsgHandlerProfiles* handlerProfs = psserver->GetEventManager()->GetHandlerProfs();
     csString dumpstr = profs->Dump();
+    dumpstr += "\n";
+    dumpstr += handlerProfs->Dump();
     csRef<iFile> file = psserver->vfs->Open("/this/netprofile.txt",VFS_FILE_WRITE);
     file->Write(dumpstr, dumpstr.Length());
     CPrintf(CON_CMDOUTPUT, "Net profile dumped to netprofile.txt\n");
     profs->Reset();
+    handlerProfs->Reset();
+    return 0;
+}
+
+int com_metrics(const char*)
+{
+    csString dumpstr = psserver->ExportMetrics();
+    csRef<iFile> file = psserver->vfs->Open("/this/metrics.txt",VFS_FILE_WRITE);
+    file->Write(dumpstr, dumpstr.Length());
+    CPrintf(CON_CMDOUTPUT, "Metrics dumped to metrics.txt\n");
+    return 0;
+}
+
+int com_poolstats(const char*)
+{
+    csArray<BufferPool::Stats> stats;
+    BufferPool::GetStats(stats);
+
+    CPrintf(CON_CMDOUTPUT, "Message and packet buffer pools:\n");
+    CPrintf(CON_CMDOUTPUT, "%8s %12s %12s %10s %10s\n", "Size", "Hits", "Misses", "In use", "Highwater");
+    for(size_t i = 0; i < stats.GetSize(); i++)
+    {
+        csString size;
+        if(stats[i].blockSize)
+            size.Format("%zu", stats[i].blockSize);
+        else
+            size = "heap";
+
+        CPrintf(CON_CMDOUTPUT, "%8s %12llu %12llu %10lld %10zu\n", size.GetData(),
+                (unsigned long long) stats[i].hits, (unsigned long long) stats[i].misses,
+                (long long) stats[i].inUse, stats[i].highWater);
+    }
     return 0;
 }
 
@@ -527,6 +569,91 @@ int com_maplist(const char*)
     return 0;
 }
 
+static int CompareEventStats(const psEventTypeStats &a, const psEventTypeStats &b)
+{
+    return strcmp(a.type.GetDataSafe(), b.type.GetDataSafe());
+}
+
+int com_eventstats(const char* arg)
+{
+    WordArray words(arg);
+    csString filter = words[0];
+
+    csArray<psEventTypeStats> stats;
+    psserver->GetEventManager()->GetEventStats(stats);
+    stats.Sort(CompareEventStats);
+
+    const csTicks limits[EVENT_LATE_BUCKETS] = EVENT_LATE_LIMITS;
+    csString header;
+    header.Format("%-32s %9s %9s %9s %8s  late:", "Type", "Queued", "Fired", "Cancelled", "Pending");
+    for(int i = 0; i < EVENT_LATE_BUCKETS; i++)
+    {
+        csString bucket;
+        if(i < EVENT_LATE_BUCKETS - 1)
+            bucket.Format("<%u", limits[i]);
+        else
+            bucket.Format(">=%u", limits[i - 1]);
+        header.AppendFmt(" %6s", bucket.GetData());
+    }
+    CPrintf(CON_CMDOUTPUT ,COL_GREEN "%s\n" COL_NORMAL, header.GetData());
+
+    for(size_t i = 0; i < stats.GetSize(); i++)
+    {
+        const psEventTypeStats &type = stats[i];
+        if(!filter.IsEmpty() && type.type.FindStr(filter) == (size_t)-1)
+            continue;
+
+        csString line;
+        line.Format("%-32s %9d %9d %9d %8d       ", type.type.GetDataSafe(), type.queued, type.fired,
+                    type.cancelled, type.queued - type.fired - type.cancelled);
+        for(int j = 0; j < EVENT_LATE_BUCKETS; j++)
+        {
+            line.AppendFmt(" %6d", type.late[j]);
+        }
+        CPrintf(CON_CMDOUTPUT ,"%s\n", line.GetData());
+    }
+
+    return 0;
+}
+
+int com_itemsaver(const char*)
+{
+    psItemSaver* saver = psServer::CharacterLoader.GetItemSaver();
+    if(!saver)
+    {
+        CPrintf(CON_CMDOUTPUT ,"The item saver is not running, items are saved at once.\n");
+        return 0;
+    }
+
+    psItemSaver::Stats stats;
+    saver->GetStats(stats);
+
+    CPrintf(CON_CMDOUTPUT ,"Saves queued       : %llu (%zu waiting for the next flush)\n",
+            (unsigned long long)stats.saves, stats.queued);
+    CPrintf(CON_CMDOUTPUT ,"Saves unchanged    : %llu\n", (unsigned long long)stats.unchanged);
+    CPrintf(CON_CMDOUTPUT ,"Rows written       : %llu (%zu waiting for the writer), %.1f columns per row\n",
+            (unsigned long long)stats.rows, stats.writing, stats.rows ? (float)stats.columns / stats.rows : 0.0f);
+    CPrintf(CON_CMDOUTPUT ,"Statements         : %llu in %llu transactions, %llu failed\n",
+            (unsigned long long)stats.statements, (unsigned long long)stats.transactions,
+            (unsigned long long)stats.failures);
+    CPrintf(CON_CMDOUTPUT ,"Rows requeued      : %llu\n", (unsigned long long)stats.requeued);
+    return 0;
+}
+
+int com_logstats(const char*)
+{
+    AsyncLog::Stats stats;
+    AsyncLog::GetStats(stats);
+
+    CPrintf(CON_CMDOUTPUT ,"Log records written : %llu (%llu bytes) in %llu batches, at most %zu per batch\n",
+            (unsigned long long)stats.records, (unsigned long long)stats.bytes,
+            (unsigned long long)stats.batches, stats.maxBatch);
+    CPrintf(CON_CMDOUTPUT ,"Files rotated       : %llu\n", (unsigned long long)stats.rotations);
+    CPrintf(CON_CMDOUTPUT ,"Records dropped     : %llu\n", (unsigned long long)stats.dropped);
+    CPrintf(CON_CMDOUTPUT ,"Records on the heap : %llu\n", (unsigned long long)stats.heapRecords);
+    return 0;
+}
+
 int com_dumpwarpspace(const char*)
 {
     EntityManager::GetSingleton().GetWorld()->DumpWarpCache();
@@ -534,6 +661,703 @@ int com_dumpwarpspace(const char*)
 }
 
 
+/**
+ * Bare gemObject used to populate a sector for the benchmark commands.
+ */
+class gemBenchmarkObject : public gemObject
+{
+public:
+    gemBenchmarkObject(const char* name, InstanceID instance, iSector* sector, const csVector3 &pos)
+        : gemObject(EntityManager::GetSingleton().GetGEM(), EntityManager::GetSingletonPtr(),
+                    psserver->GetCacheManager(), name, "nullmesh", instance, sector, pos, 0.0f, 0)
+    {
+    }
+
+    virtual const char* GetObjectType()
+    {
+        return "Benchmark object";
+    }
+};
+
+int com_benchnearby(const char* arg)
+{
+    const char* syntax = "benchnearby <sector> [actors] [radius]";
+
+    WordArray words(arg);
+    if(words.GetCount() < 1)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Syntax: %s\n", syntax);
+        return 0;
+    }
+
+    iSector* sector = EntityManager::GetSingleton().GetEngine()->FindSector(words[0]);
+    if(!sector)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Could not find that sector.\nSyntax: %s\n", syntax);
+        return 0;
+    }
+
+    int count = words.GetCount() > 1 ? words.GetInt(1) : 2000;
+    float radius = words.GetCount() > 2 ? words.GetFloat(2) : DEF_PROX_DIST;
+    if(count <= 0 || radius <= 0.0f)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Actors and radius must be > 0.\nSyntax: %s\n", syntax);
+        return 0;
+    }
+
+    GEMSupervisor* gem = EntityManager::GetSingleton().GetGEM();
+
+    // Spread the actors with about the density of a crowded town, 16m2 per actor.
+    float side = sqrtf((float)count * 16.0f);
+    csArray<gemObject*> actors;
+    for(int i = 0; i < count; i++)
+    {
+        csVector3 pos(psserver->GetRandomRange(0.0f, side), 0.0f, psserver->GetRandomRange(0.0f, side));
+        csString name;
+        name.Format("bench%d", i);
+        actors.Push(new gemBenchmarkObject(name, 0, sector, pos));
+    }
+
+    size_t meshFound = 0;
+    csMicroTicks start = csGetMicroTicks();
+    for(size_t i = 0; i < actors.GetSize(); i++)
+    {
+        meshFound += gem->FindNearbyMeshEntities(sector, actors[i]->GetPosition(), 0, radius, true).GetSize();
+    }
+    csMicroTicks meshTime = csGetMicroTicks() - start;
+
+    size_t gridFound = 0;
+    start = csGetMicroTicks();
+    for(size_t i = 0; i < actors.GetSize(); i++)
+    {
+        gridFound += gem->FindNearbyEntities(sector, actors[i]->GetPosition(), 0, radius, true).GetSize();
+    }
+    csMicroTicks gridTime = csGetMicroTicks() - start;
+
+    CPrintf(CON_CMDOUTPUT ,"%d actors in %s, radius %.1f, %.1f neighbours per query\n",
+            count, sector->QueryObject()->GetName(), radius, (float)gridFound / count);
+    CPrintf(CON_CMDOUTPUT ,"  mesh search  : %8.2f ms, %6.2f us per query, %zu found\n",
+            meshTime / 1000.0f, (float)meshTime / count, meshFound);
+    CPrintf(CON_CMDOUTPUT ,"  spatial grid : %8.2f ms, %6.2f us per query, %zu found\n",
+            gridTime / 1000.0f, (float)gridTime / count, gridFound);
+
+    for(size_t i = 0; i < actors.GetSize(); i++)
+    {
+        delete actors[i];
+    }
+
+    return 0;
+}
+
+/**
+ * Searches the nearby objects of the benchmark actors like the proximity tick.
+ */
+class BenchmarkProxJob : public iJobRange
+{
+public:
+    BenchmarkProxJob(csArray<gemObject*> &actors) : actors(actors)
+    {
+        found.SetSize(actors.GetSize(), 0);
+    }
+
+    virtual void Run(size_t begin, size_t end)
+    {
+        csArray<gemObject*> nearlist;
+        for(size_t i = begin; i < end; i++)
+        {
+            nearlist.Empty();
+            actors[i]->FindProxCandidates(nearlist, true);
+            found[i] = nearlist.GetSize();
+        }
+    }
+
+    size_t GetFound()
+    {
+        size_t total = 0;
+        for(size_t i = 0; i < found.GetSize(); i++)
+        {
+            total += found[i];
+        }
+        return total;
+    }
+
+private:
+    csArray<gemObject*> &actors;
+    csArray<size_t> found;
+};
+
+int com_benchtick(const char* arg)
+{
+    const char* syntax = "benchtick [actors] [sectors] [ticks]";
+
+    WordArray words(arg);
+    int count = words.GetCount() > 0 ? words.GetInt(0) : 3000;
+    int sectorCount = words.GetCount() > 1 ? words.GetInt(1) : 20;
+    int ticks = words.GetCount() > 2 ? words.GetInt(2) : 10;
+    if(count <= 0 || sectorCount <= 0 || ticks <= 0)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Actors, sectors and ticks must be > 0.\nSyntax: %s\n", syntax);
+        return 0;
+    }
+
+    iSectorList* sectors = EntityManager::GetSingleton().GetEngine()->GetSectors();
+    if(sectorCount > sectors->GetCount())
+    {
+        sectorCount = sectors->GetCount();
+    }
+    if(!sectorCount)
+    {
+        CPrintf(CON_CMDOUTPUT ,"No sectors loaded.\n");
+        return 0;
+    }
+
+    GEMSupervisor* gem = EntityManager::GetSingleton().GetGEM();
+    JobSystem* jobs = gem->GetJobSystem();
+
+    // Deal the actors to the sectors with the density of a crowded town, 16m2 per actor.
+    float side = sqrtf((float)count / sectorCount * 16.0f);
+    csArray<gemObject*> actors;
+    for(int i = 0; i < count; i++)
+    {
+        csVector3 pos(psserver->GetRandomRange(0.0f, side), 0.0f, psserver->GetRandomRange(0.0f, side));
+        csString name;
+        name.Format("bench%d", i);
+        actors.Push(new gemBenchmarkObject(name, 0, sectors->Get(i % sectorCount), pos));
+    }
+
+    BenchmarkProxJob serial(actors);
+    csMicroTicks start = csGetMicroTicks();
+    for(int t = 0; t < ticks; t++)
+    {
+        serial.Run(0, actors.GetSize());
+    }
+    csMicroTicks serialTime = csGetMicroTicks() - start;
+
+    JobSystem::Stats before;
+    jobs->GetStats(before);
+
+    BenchmarkProxJob parallel(actors);
+    start = csGetMicroTicks();
+    for(int t = 0; t < ticks; t++)
+    {
+        jobs->ParallelFor(actors.GetSize(), parallel);
+    }
+    csMicroTicks parallelTime = csGetMicroTicks() - start;
+
+    JobSystem::Stats after;
+    jobs->GetStats(after);
+
+    CPrintf(CON_CMDOUTPUT ,"%d actors in %d sectors, %.1f neighbours per actor, %d ticks\n",
+            count, sectorCount, (float)serial.GetFound() / count, ticks);
+    CPrintf(CON_CMDOUTPUT ,"  main thread  : %8.2f ms per tick\n", serialTime / 1000.0f / ticks);
+    CPrintf(CON_CMDOUTPUT ,"  %2zu + 1 threads: %8.2f ms per tick, %llu jobs, %llu stolen\n",
+            after.threads, parallelTime / 1000.0f / ticks,
+            (unsigned long long)(after.jobs - before.jobs), (unsigned long long)(after.steals - before.steals));
+    if(serial.GetFound() != parallel.GetFound())
+    {
+        CPrintf(CON_CMDOUTPUT ,"  found %zu neighbours in the main thread but %zu with the threads!\n",
+                serial.GetFound(), parallel.GetFound());
+    }
+
+    for(size_t i = 0; i < actors.GetSize(); i++)
+    {
+        delete actors[i];
+    }
+
+    return 0;
+}
+
+int com_benchmulticast(const char* arg)
+{
+    const char* syntax = "benchmulticast [connections] [size] [repeat]";
+
+    WordArray words(arg);
+    int count = words.GetCount() > 0 ? words.GetInt(0) : 200;
+    int size = words.GetCount() > 1 ? words.GetInt(1) : 100;
+    int repeat = words.GetCount() > 2 ? words.GetInt(2) : 100;
+    if(count <= 0 || size <= 0 || size > (int)MAX_MESSAGE_SIZE || repeat <= 0)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Connections and repeat must be > 0, size must be 1 to %u.\nSyntax: %s\n",
+                MAX_MESSAGE_SIZE, syntax);
+        return 0;
+    }
+
+    NetManager* net = psserver->GetNetManager();
+
+    // Queues that are never handed to the network thread, they only collect the packets.
+    int fragments = size / (MAXPACKETSIZE - sizeof(psNetPacket)) + 1;
+    csArray<csRef<NetPacketQueueRefCount> > queues;
+    for(int i = 0; i < count; i++)
+    {
+        csRef<NetPacketQueueRefCount> queue;
+        queue.AttachNew(new NetPacketQueueRefCount(fragments + 1));
+        queues.Push(queue);
+    }
+
+    csRef<MsgEntry> msg;
+    msg.AttachNew(new MsgEntry(size, PRIORITY_LOW));
+    msg->SetType(MSGTYPE_PING);
+    memset(msg->bytes->payload, 0, size);
+
+    csMicroTicks copyTime = 0;
+    csMicroTicks sharedTime = 0;
+    for(int r = 0; r < repeat; r++)
+    {
+        csMicroTicks start = csGetMicroTicks();
+        for(int i = 0; i < count; i++)
+        {
+            msg->clientnum = i;
+            net->NetBase::SendMessage(msg, queues[i]);
+        }
+        copyTime += csGetMicroTicks() - start;
+
+        // Release the packets outside of the timed sections
+        for(int i = 0; i < count; i++)
+        {
+            csRef<psNetPacketEntry> pkt;
+            while((pkt = queues[i]->Get()))
+                continue;
+        }
+
+        start = csGetMicroTicks();
+        csRef<psNetPacketPayload> payload;
+        payload.AttachNew(new psNetPacketPayload(msg->bytes));
+        for(int i = 0; i < count; i++)
+        {
+            msg->clientnum = i;
+            net->NetBase::SendMessage(msg, queues[i], payload);
+        }
+        sharedTime += csGetMicroTicks() - start;
+
+        // Release the packets outside of the timed sections
+        for(int i = 0; i < count; i++)
+        {
+            csRef<psNetPacketEntry> pkt;
+            while((pkt = queues[i]->Get()))
+                continue;
+        }
+    }
+
+    CPrintf(CON_CMDOUTPUT ,"%d byte message to %d connections, %d fragment(s), %d times\n",
+            size, count, fragments, repeat);
+    CPrintf(CON_CMDOUTPUT ,"  copy per connection : %8.2f ms, %6.3f us per connection\n",
+            copyTime / 1000.0f, (float)copyTime / (count * repeat));
+    CPrintf(CON_CMDOUTPUT ,"  shared payload      : %8.2f ms, %6.3f us per connection\n",
+            sharedTime / 1000.0f, (float)sharedTime / (count * repeat));
+
+    return 0;
+}
+
+#ifdef NET_HAVE_BATCHED_IO
+/// Opens a non blocking UDP socket bound to a free loopback port
+static SOCKET OpenLoopbackSocket(SOCKADDR_IN &addr)
+{
+    SOCKET sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if(sock < 0)
+        return sock;
+
+    unsigned long arg = 1;
+    SOCK_IOCTL(sock, FIONBIO, &arg);
+
+    memset(&addr, 0, sizeof(SOCKADDR_IN));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = 0;
+    socklen_t len = sizeof(SOCKADDR_IN);
+    if(bind(sock, (LPSOCKADDR) &addr, len) < 0 || getsockname(sock, (LPSOCKADDR) &addr, &len) < 0)
+    {
+        SOCK_CLOSE(sock);
+        return -1;
+    }
+    return sock;
+}
+#endif
+
+int com_benchnetio(const char* arg)
+{
+#ifdef NET_HAVE_BATCHED_IO
+    const char* syntax = "benchnetio [packets] [size]";
+
+    WordArray words(arg);
+    int count = words.GetCount() > 0 ? words.GetInt(0) : 100000;
+    int size = words.GetCount() > 1 ? words.GetInt(1) : 200;
+    if(count <= 0 || size <= 0 || size > MAXPACKETSIZE)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Packets must be > 0, size must be 1 to %d.\nSyntax: %s\n", MAXPACKETSIZE, syntax);
+        return 0;
+    }
+
+    SOCKADDR_IN fromAddr, toAddr;
+    SOCKET from = OpenLoopbackSocket(fromAddr);
+    SOCKET to = OpenLoopbackSocket(toAddr);
+    if(from < 0 || to < 0)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Could not open the loopback sockets.\n");
+        if(from >= 0)
+            SOCK_CLOSE(from);
+        if(to >= 0)
+            SOCK_CLOSE(to);
+        return 0;
+    }
+
+    char* data = (char*) BufferPool::Alloc(MAXPACKETSIZE);
+    memset(data, 0, MAXPACKETSIZE);
+
+    // Packets are sent in bursts of one batch so the receive buffer never overflows
+    int burst = NET_IO_BATCH_SIZE;
+
+    // select + recvfrom and sendto per packet like NetBase without the batched backend
+    uint64 selectSyscalls = 0;
+    int selectReceived = 0;
+    csMicroTicks start = csGetMicroTicks();
+    for(int sent = 0; sent < count; sent += burst)
+    {
+        int n = csMin(burst, count - sent);
+        for(int i = 0; i < n; i++)
+        {
+            SOCK_SENDTO(from, data, size, 0, (LPSOCKADDR) &toAddr, sizeof(SOCKADDR_IN));
+            selectSyscalls++;
+        }
+        for(int i = 0; i < n; i++)
+        {
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(to, &set);
+            struct timeval timeout = { 0, 100000 };
+            selectSyscalls++;
+            if(SOCK_SELECT(to + 1, &set, NULL, NULL, &timeout) < 1)
+                break;
+
+            SOCKADDR_IN addr;
+            socklen_t len = sizeof(SOCKADDR_IN);
+            selectSyscalls++;
+            if(SOCK_RECVFROM(to, data, MAXPACKETSIZE, 0, (LPSOCKADDR) &addr, &len) > 0)
+                selectReceived++;
+        }
+    }
+    csMicroTicks selectTime = csGetMicroTicks() - start;
+
+    // epoll + recvmmsg/sendmmsg
+    psNetBatchedIO sender;
+    psNetBatchedIO receiver;
+    sender.Open(from, 0);
+    receiver.Open(to, 0);
+
+    int batchedReceived = 0;
+    start = csGetMicroTicks();
+    for(int sent = 0; sent < count; sent += burst)
+    {
+        int n = csMin(burst, count - sent);
+        for(int i = 0; i < n; i++)
+        {
+            sender.Send(&toAddr, data, size);
+        }
+        sender.Flush();
+
+        int received = 0;
+        while(received < n)
+        {
+            SOCKADDR_IN addr;
+            if(receiver.Receive(&addr, data, 100) <= 0)
+                break;
+            received++;
+        }
+        batchedReceived += received;
+    }
+    csMicroTicks batchedTime = csGetMicroTicks() - start;
+    uint64 batchedSyscalls = sender.GetSyscalls() + receiver.GetSyscalls();
+
+    sender.Close();
+    receiver.Close();
+    SOCK_CLOSE(from);
+    SOCK_CLOSE(to);
+    BufferPool::Free(data);
+
+    CPrintf(CON_CMDOUTPUT ,"%d packets of %d bytes over loopback\n", count, size);
+    CPrintf(CON_CMDOUTPUT ,"  select/sendto  : %10.0f packets/s, %5.2f syscalls/packet, %d received\n",
+            selectReceived * 1000000.0 / csMax(selectTime, (csMicroTicks)1),
+            (double)selectSyscalls / count, selectReceived);
+    CPrintf(CON_CMDOUTPUT ,"  epoll/mmsg     : %10.0f packets/s, %5.2f syscalls/packet, %d received\n",
+            batchedReceived * 1000000.0 / csMax(batchedTime, (csMicroTicks)1),
+            (double)batchedSyscalls / count, batchedReceived);
+#else
+    CPrintf(CON_CMDOUTPUT ,"Batched network I/O is not available on this platform.\n");
+#endif
+    return 0;
+}
+
+/**
+ * One run of com_benchlogin.
+ *
+ * The loads on the workers come back through events handled by the main
+ * thread, so the run can't wait for them. The callback of the last load
+ * prints the report instead.
+ */
+class BenchmarkLogin : public csRefCount
+{
+public:
+    BenchmarkLogin(int count)
+        :count(count),done(0),loaded(0),start(0),loadsBefore(0),buildBefore(0)
+    {
+    }
+
+    /// Start the loads on the workers
+    void Start(const csArray<PID> &pids)
+    {
+        psServer::CharacterLoader.GetAsyncLoadStats(loadsBefore, buildBefore);
+        start = csGetMicroTicks();
+        for(int i = 0; i < count; i++)
+        {
+            psServer::CharacterLoader.PrefetchCharacterData(pids[i % pids.GetSize()], new Callback(this));
+        }
+    }
+
+private:
+    /// Counts the characters loaded
+    class Callback : public iCharacterLoadCallback
+    {
+    public:
+        Callback(BenchmarkLogin* bench)
+            :bench(bench)
+        {
+        }
+
+        virtual void CharacterLoaded(PID /*pid*/, psCharacter* chardata)
+        {
+            bench->Loaded(chardata != NULL);
+            delete chardata;
+        }
+
+    private:
+        csRef<BenchmarkLogin> bench;
+    };
+
+    void Loaded(bool ok)
+    {
+        done++;
+        if(ok)
+            loaded++;
+
+        if(done < count)
+            return;
+
+        csMicroTicks asyncTime = csGetMicroTicks() - start;
+
+        uint64 loads;
+        csMicroTicks buildTime;
+        psServer::CharacterLoader.GetAsyncLoadStats(loads, buildTime);
+        buildTime -= buildBefore;
+
+        psCharacterPrefetcher* prefetcher = psServer::CharacterLoader.GetPrefetcher();
+        CPrintf(CON_CMDOUTPUT ,"  %zu workers   : %8.2f ms, %8.2f ms main thread, %d loaded\n",
+                prefetcher ? prefetcher->GetWorkerCount() : 0, asyncTime / 1000.0f, buildTime / 1000.0f, loaded);
+    }
+
+    int count;
+    int done;
+    int loaded;
+    csMicroTicks start;
+    uint64 loadsBefore;
+    csMicroTicks buildBefore;
+};
+
+/**
+ * Runs com_benchlogin in the main thread, the console may have a thread of
+ * its own and the loads use the main database connection.
+ */
+class BenchmarkLoginEvent : public psGameEvent
+{
+public:
+    BenchmarkLoginEvent(int count)
+        :psGameEvent(0, 0, "BenchmarkLoginEvent"),count(count)
+    {
+    }
+
+    virtual void Trigger()
+    {
+        // Players not online, used over and over if there are not enough of them
+        csArray<PID> pids;
+        Result result(db->Select("SELECT id FROM characters WHERE character_type=0 LIMIT %d", count));
+        if(result.IsValid())
+        {
+            for(unsigned long i = 0; i < result.Count(); i++)
+            {
+                PID pid(result[i].GetUInt32("id"));
+                if(!psserver->GetNetManager()->GetConnections()->FindPlayer(pid))
+                    pids.Push(pid);
+            }
+        }
+        if(pids.IsEmpty())
+        {
+            CPrintf(CON_CMDOUTPUT ,"No offline player characters to load.\n");
+            return;
+        }
+
+        // Everything in the main thread like before
+        csMicroTicks start = csGetMicroTicks();
+        int syncLoaded = 0;
+        for(int i = 0; i < count; i++)
+        {
+            psCharacter* chardata = psServer::CharacterLoader.LoadCharacterFromDB(pids[i % pids.GetSize()], db);
+            if(chardata)
+                syncLoaded++;
+            delete chardata;
+        }
+        csMicroTicks syncTime = csGetMicroTicks() - start;
+
+        CPrintf(CON_CMDOUTPUT ,"%d logins of %zu characters\n", count, pids.GetSize());
+        CPrintf(CON_CMDOUTPUT ,"  main thread : %8.2f ms, %d loaded\n",
+                syncTime / 1000.0f, syncLoaded);
+
+        if(!psServer::CharacterLoader.GetPrefetcher())
+        {
+            CPrintf(CON_CMDOUTPUT ,"The character loader threads are not running.\n");
+            return;
+        }
+
+        // The queries on the workers, the characters built when the main
+        // thread runs the events. Reported once the last one is built.
+        csRef<BenchmarkLogin> bench;
+        bench.AttachNew(new BenchmarkLogin(count));
+        bench->Start(pids);
+    }
+
+private:
+    int count;
+};
+
+int com_benchlogin(const char* arg)
+{
+    const char* syntax = "benchlogin [logins]";
+
+    WordArray words(arg);
+    int count = words.GetCount() > 0 ? words.GetInt(0) : 500;
+    if(count <= 0)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Logins must be > 0.\nSyntax: %s\n", syntax);
+        return 0;
+    }
+
+    BenchmarkLoginEvent* event = new BenchmarkLoginEvent(count);
+    event->QueueEvent();
+
+    return 0;
+}
+
+/// Stands in for the characters and items given to the scripts by com_benchmath
+class BenchmarkScriptable : public iScriptableVar
+{
+public:
+    virtual double GetProperty(MathEnvironment* /*env*/, const char* /*ptr*/)
+    {
+        return 1.0;
+    }
+
+    virtual double CalcFunction(MathEnvironment* /*env*/, const char* /*functionName*/, const double* /*params*/)
+    {
+        return 1.0;
+    }
+
+    virtual const char* ToString()
+    {
+        return "benchmark";
+    }
+};
+
+int com_benchmath(const char* arg)
+{
+    const char* syntax = "benchmath [evaluations] [script]";
+
+    WordArray words(arg);
+    int count = words.GetCount() > 0 ? words.GetInt(0) : 100000;
+    csString name = words.GetCount() > 1 ? words.GetTail(1) : csString("Calculate Damage");
+    if(count <= 0)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Evaluations must be > 0.\nSyntax: %s\n", syntax);
+        return 0;
+    }
+
+    MathScript* script = psserver->GetMathScriptEngine()->FindScript(name);
+    if(!script)
+    {
+        CPrintf(CON_CMDOUTPUT ,"Could not find the script %s.\nSyntax: %s\n", name.GetData(), syntax);
+        return 0;
+    }
+
+    // Every input is given an object, numbers read from it are just NaN
+    csArray<MathVarID> inputs;
+    script->GetInputs(inputs);
+    csArray<csString> inputNames;
+    for(size_t i = 0; i < inputs.GetSize(); i++)
+    {
+        inputNames.Push(MathScriptEngine::GetVariableName(inputs[i]));
+    }
+    BenchmarkScriptable object;
+
+    // The baseline, how most callers use the scripts: a new environment and
+    // the variables defined by name for each evaluation. Each name is looked
+    // up in the shared name table under its lock.
+    csMicroTicks start = csGetMicroTicks();
+    for(int n = 0; n < count; n++)
+    {
+        MathEnvironment env;
+        for(size_t i = 0; i < inputNames.GetSize(); i++)
+        {
+            env.Define(inputNames[i], &object);
+        }
+        script->Evaluate(&env);
+    }
+    csMicroTicks namedTime = csGetMicroTicks() - start;
+
+    // How the combat and progression code uses them: a new environment with
+    // the variables defined by the IDs it requested once.
+    start = csGetMicroTicks();
+    for(int n = 0; n < count; n++)
+    {
+        MathEnvironment env;
+        for(size_t i = 0; i < inputs.GetSize(); i++)
+        {
+            env.Define(inputs[i], &object);
+        }
+        script->Evaluate(&env);
+    }
+    csMicroTicks cachedTime = csGetMicroTicks() - start;
+
+    // The same environment for all the evaluations with the variables bound
+    // once, the evaluations don't allocate anything once the script has
+    // defined its own variables.
+    start = csGetMicroTicks();
+    {
+        MathEnvironment env;
+        csArray<MathVar*> vars;
+        for(size_t i = 0; i < inputs.GetSize(); i++)
+        {
+            env.Define(inputNames[i], &object);
+            vars.Push(env.Lookup(inputs[i]));
+        }
+
+        for(int n = 0; n < count; n++)
+        {
+            for(size_t i = 0; i < vars.GetSize(); i++)
+            {
+                vars[i]->SetObject(&object);
+            }
+            script->Evaluate(&env);
+        }
+    }
+    csMicroTicks idTime = csGetMicroTicks() - start;
+
+    CPrintf(CON_CMDOUTPUT ,"%d evaluations of %s, %zu inputs\n", count, name.GetData(), inputs.GetSize());
+    CPrintf(CON_CMDOUTPUT ,"  by name, new environment : %8.2f ms, %10.0f evaluations/s\n",
+            namedTime / 1000.0f, count * 1000000.0 / csMax(namedTime, (csMicroTicks)1));
+    CPrintf(CON_CMDOUTPUT ,"  by ID, new environment   : %8.2f ms, %10.0f evaluations/s\n",
+            cachedTime / 1000.0f, count * 1000000.0 / csMax(cachedTime, (csMicroTicks)1));
+    CPrintf(CON_CMDOUTPUT ,"  bound, same environment  : %8.2f ms, %10.0f evaluations/s\n",
+            idTime / 1000.0f, count * 1000000.0 / csMax(idTime, (csMicroTicks)1));
+
+    return 0;
+}
+
 int com_loadmap(const char* mapname)
 {
     if(!strcmp(mapname, ""))
@@ -2552,7 +3376,12 @@ const COMMAND commands[] =
     { "lock",      false, com_lock,      "Tells server to stop accepting connections"},
     { "maplist",   true, com_maplist,   "List all mounted maps"},
     { "dumpwarpspace",   true, com_dumpwarpspace,   "Dump the warp space table"},
+    { "itemsaver", true, com_itemsaver, "Shows how many item saves were coalesced and written by the item saver"},
+    { "eventstats", true, com_eventstats, "Shows the queued, fired and cancelled events and how late they fired per event type ( eventstats [type] )"},
+    { "logstats",  true, com_logstats,  "Shows how many log records were written, rotated and dropped by the log writer thread"},
     { "netprofile", true, com_netprofile, "shows network profile info" },
+    { "metrics", true, com_metrics, "Writes the profiles as served to a metrics collector to metrics.txt" },
+    { "poolstats", true, com_poolstats, "shows the hits, misses and high-water marks of the message buffer pools" },
     { "quit",      true, com_quit,      "[minutes] Makes the server exit immediately or after the specified amount of minutes"},
     { "ready",     false, com_ready,     "Tells server to start accepting connections"},
     { "sectors",   true, com_sectors,   "Display all sectors" },
@@ -2611,6 +3440,15 @@ const COMMAND commands[] =
     { "rain",      true, com_rain,      "Forces it to start or stop raining in a sector"},
     { "lschannel", true, com_lschannel, "Lists all the channels in the server"},
     { "randomloot",false,com_randomloot,"Generates random loot"},
+
+    // benchmark commands
+    { "-- Benchmark commands",  true, NULL, "------------------------------------------------" },
+    { "benchnearby", false, com_benchnearby, "Compares the mesh and grid nearby entity searches ( benchnearby <sector> [actors] [radius] )" },
+    { "benchtick", false, com_benchtick, "Compares the proximity searches of a tick in the main thread and on the job threads ( benchtick [actors] [sectors] [ticks] )" },
+    { "benchmulticast", false, com_benchmulticast, "Compares copying and sharing the bytes of a message sent to many connections ( benchmulticast [connections] [size] [repeat] )" },
+    { "benchnetio", false, com_benchnetio, "Compares select/sendto and epoll/mmsg UDP throughput over loopback ( benchnetio [packets] [size] )" },
+    { "benchmath", false, com_benchmath, "Measures the evaluations per second of a math script ( benchmath [evaluations] [script] )" },
+    { "benchlogin", false, com_benchlogin, "Compares loading characters in the main thread and in the loader threads ( benchlogin [logins] )" },
     { 0, 0, 0, 0 }
 };
 
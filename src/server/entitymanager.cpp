@@ -55,6 +55,7 @@
 #include "engine/linmove.h"
 
 #include "bulkobjects/pscharacterloader.h"
+#include "bulkobjects/pscharacterprefetcher.h"
 #include "bulkobjects/psraceinfo.h"
 #include "bulkobjects/psitem.h"
 #include "bulkobjects/psactionlocationinfo.h"
@@ -157,6 +158,8 @@ bool EntityManager::Initialize(iObjectRegistry* object_reg,
     gameWorld = new psWorld();
     gameWorld->Initialize(object_reg);
 
+    gem->GetSpatialIndex()->SetWorld(gameWorld);
+
     return true;
 }
 
@@ -588,6 +591,11 @@ int EntityManager::CalculateFamiliarAffinity(psCharacter* chardata, size_t type,
 bool EntityManager::CreatePlayer(Client* client)
 {
     psCharacter* chardata=psServer::CharacterLoader.LoadCharacterData(client->GetPID(),true);
+    return CreatePlayer(client, chardata);
+}
+
+bool EntityManager::CreatePlayer(Client* client, psCharacter* chardata)
+{
     if(chardata==NULL)
     {
         CPrintf(CON_ERROR, "Couldn't load character for %s!\n", ShowID(client->GetPID()));
@@ -662,6 +670,9 @@ bool EntityManager::CreatePlayer(Client* client)
 
 bool EntityManager::DeletePlayer(Client* client)
 {
+    // A character still being loaded is dropped when it comes back
+    loadingPlayers.Cancel(client->GetClientNum());
+
     gemActor* actor = client->GetActor();
     if(actor && actor->GetCharacterData()!=NULL)
     {
@@ -1085,21 +1096,77 @@ void EntityManager::SendMovementInfo(MsgEntry* me, Client* client)
 //        client->GetActor()->UpdateAllSpeedModifiers();
 }
 
+/**
+ * Hands the character loaded for a player entering the world back to the
+ * entity manager.
+ */
+class psPlayerLoadCallback : public iCharacterLoadCallback
+{
+public:
+    psPlayerLoadCallback(EntityManager* entitymanager, uint32_t clientnum)
+        :entitymanager(entitymanager),clientnum(clientnum)
+    {
+    }
+
+    virtual void CharacterLoaded(PID pid, psCharacter* chardata)
+    {
+        entitymanager->PlayerLoaded(clientnum, pid, chardata);
+    }
+
+private:
+    EntityManager* entitymanager;
+    uint32_t clientnum;
+};
+
 void EntityManager::HandleWorld(MsgEntry* me, Client* client)
 {
-    if(!client->GetActor() && !CreatePlayer(client))
+    if(client->GetActor())
+    {
+        SendWorld(client);
+        return;
+    }
+
+    // The character is already being loaded for this client
+    if(!loadingPlayers.Start(client->GetClientNum(), client->GetPID()))
+    {
+        return;
+    }
+
+    // The actor is created by PlayerLoaded() once the database is done with
+    // the character, maybe before this returns.
+    psServer::CharacterLoader.LoadCharacterDataAsync(client->GetPID(), true,
+            new psPlayerLoadCallback(this, client->GetClientNum()));
+}
+
+void EntityManager::PlayerLoaded(uint32_t clientnum, PID pid, psCharacter* chardata)
+{
+    // The client may have left or picked another character meanwhile
+    Client* client = clients->FindAny(clientnum);
+    if(!loadingPlayers.Finish(clientnum, pid) || !client || client->GetPID() != pid || client->GetActor())
+    {
+        Debug2(LOG_CONNECTIONS, clientnum, "Dropping character %s loaded for a client no longer waiting for it.", ShowID(pid));
+        delete chardata;
+        return;
+    }
+
+    if(!CreatePlayer(client, chardata))
     {
         Error1("Error while creating player in world!");
         return;
     }
 
+    SendWorld(client);
+}
+
+void EntityManager::SendWorld(Client* client)
+{
     // Client needs to know the starting position of the player when the world loads.
     csVector3 pos;
     float     yrot;
     iSector* isector;
     client->GetActor()->GetPosition(pos,yrot,isector);
 
-    psPersistWorld mesg(me->clientnum, pos, isector->QueryObject()->GetName());
+    psPersistWorld mesg(client->GetClientNum(), pos, isector->QueryObject()->GetName());
     mesg.SendMessage();
 
     // Send the world time and weather here too
@@ -1187,6 +1254,15 @@ bool EntityManager::RemoveActor(gemObject* actor)
                                            actor->GetMulticastClients(),
                                            0,PROX_LIST_ANY_RANGE);
 
+    // The clients won't be sent its dead reckoning anymore
+    csArray<PublishDestination> &multi = actor->GetMulticastClients();
+    for(size_t i = 0; i < multi.GetSize(); i++)
+    {
+        Client* client = clients->Find(multi[i].client);
+        if(client)
+            client->GetDRQueue().Forget(actor->GetEID());
+    }
+
     // also notify superclients
     psserver->GetNPCManager()->RemoveEntity(msg.msg);
 
@@ -27,6 +27,7 @@
 // Project Includes
 //=============================================================================
 #include "util/gameevent.h"
+#include "util/pendingloads.h"
 #include "util/psconst.h"
 #include "util/singleton.h"
 
@@ -98,8 +99,23 @@ public:
     iSector* FindSector(const char* name);
 
     bool CreatePlayer(Client* client);
+
+    /**
+     * Create the actor of a player from a character already loaded.
+     *
+     * @param chardata The character of the client, owned by the actor from now on.
+     */
+    bool CreatePlayer(Client* client, psCharacter* chardata);
     bool DeletePlayer(Client* client);
 
+    /**
+     * Called when the character asked for by HandleWorld() has been loaded.
+     *
+     * Creates the actor and sends the world to the client, unless the client
+     * left meanwhile.
+     */
+    void PlayerLoaded(uint32_t clientnum, PID pid, psCharacter* chardata);
+
     PID CopyNPCFromDatabase(PID master_id, float x, float y, float z, float angle, const csString &sector, InstanceID instance, const char* firstName = NULL, const char* lastName = NULL);
     EID CreateNPC(PID npcID, bool updateProxList = true, bool alwaysWatching = false);
     EID CreateNPC(psCharacter* chardata, bool updateProxList = true, bool alwaysWatching = false);
@@ -179,6 +195,9 @@ protected:
 
     bool SendActorList(Client* client);
 
+    /// Send the starting position, time and weather to a client with an actor.
+    void SendWorld(Client* client);
+
 
     void CreateMovementInfoMsg();
     void LoadFamiliarTypes();
@@ -199,6 +218,8 @@ protected:
     psWorld* gameWorld;
 
     psMovementInfoMessage* moveinfomsg;
+
+    psPendingLoads loadingPlayers;      ///< Clients waiting for their character to be loaded
 };
 
 class psEntityEvent : public psGameEvent
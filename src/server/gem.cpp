@@ -65,6 +65,7 @@
 
 #include "net/npcmessages.h"
 #include "net/message.h"
+#include "net/netpacket.h"
 #include "net/msghandler.h"
 
 #include "engine/psworld.h"
@@ -110,8 +111,8 @@
 
 /// Minimum size for the history buffer. old lines are not removed when this size is reached.
 #define CHAT_HISTORY_MINIMUM_SIZE 20
-/// Lifetime of a chat history line, in ticks
-#define CHAT_HISTORY_LIFETIME 300000 // 5 minutes
+/// Lifetime of a chat history line, in seconds as it is compared with time(0)
+#define CHAT_HISTORY_LIFETIME 300 // 5 minutes
 
 //-----------------------------------------------------------------------------
 
@@ -121,6 +122,140 @@ psGemServerMeshAttach::psGemServerMeshAttach(gemObject* objectToAttach) : scfImp
 }
 
 
+//-----------------------------------------------------------------------------
+
+const int PROX_UPDATE_INTERVAL = 100;  //msec
+
+/**
+ * Updates the proxlists queued by moving objects.
+ */
+class psProxUpdateTick : public psGameEvent
+{
+public:
+    psProxUpdateTick(GEMSupervisor* gem)
+        : psGameEvent(0,PROX_UPDATE_INTERVAL,"psProxUpdateTick"),gem(gem)
+    {
+    }
+
+    virtual void Trigger()
+    {
+        gem->ProxUpdateTick();
+    }
+
+private:
+    GEMSupervisor* gem;
+};
+
+const int WORLD_UPDATE_INTERVAL = 50;  //msec
+
+/**
+ * Sends the dead reckoning queued for the clients.
+ */
+class psWorldUpdateTick : public psGameEvent
+{
+public:
+    psWorldUpdateTick(GEMSupervisor* gem)
+        : psGameEvent(0,WORLD_UPDATE_INTERVAL,"psWorldUpdateTick"),gem(gem)
+    {
+    }
+
+    virtual void Trigger()
+    {
+        gem->WorldUpdateTick();
+    }
+
+private:
+    GEMSupervisor* gem;
+};
+
+/**
+ * Searches the nearby objects of a range of the queued objects.
+ */
+class ProxCandidatesJob : public iJobRange
+{
+public:
+    struct Result
+    {
+        bool update;
+        csArray<gemObject*> nearlist;
+    };
+
+    ProxCandidatesJob(csArray<gemObject*> &objects, csArray<Result> &results)
+        : objects(objects),results(results)
+    {
+    }
+
+    virtual void Run(size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            results[i].update = objects[i]->FindProxCandidates(results[i].nearlist);
+        }
+    }
+
+private:
+    csArray<gemObject*> &objects;
+    csArray<Result> &results;
+};
+
+/**
+ * Finds the actors that moved enough to be sent to the superclients.
+ */
+class EntityPosJob : public iJobRange
+{
+public:
+    struct Result
+    {
+        bool send;
+        csVector3 pos;
+        iSector* sector;
+        InstanceID instance;
+    };
+
+    EntityPosJob(csArray<gemObject*> &objects, csArray<Result> &results, csTicks now)
+        : now(now),objects(objects),results(results)
+    {
+    }
+
+    virtual void Run(size_t begin, size_t end)
+    {
+        for(size_t i = begin; i < end; i++)
+        {
+            gemObject* obj = objects[i];
+            Result &result = results[i];
+            result.send = false;
+
+            gemActor* actor = dynamic_cast<gemActor*>(obj);
+            // FIXME: Now only distribute players, this should
+            //        be modify to send all actors exepct
+            //        NPCs controlled by the receving superclient.
+            if(!actor || !actor->GetClient())
+                continue;
+
+            csVector3 pos2;
+            float yrot;
+            InstanceID oldInstance;
+            csTicks last;
+            obj->GetPosition(result.pos,yrot,result.sector);
+            result.instance = obj->GetInstance();
+            obj->GetLastSuperclientPos(pos2,oldInstance,last);
+
+            float dist2 = (result.pos - pos2).SquaredNorm();
+
+            csTicks time = now - last;
+
+            // We need to filter some to prevent overloading the network
+            result.send = (dist2 > 1.0) || (dist2 > .04 && time > 2000) || (result.instance != oldInstance);
+        }
+    }
+
+    csTicks now;
+
+private:
+    csArray<gemObject*> &objects;
+    csArray<Result> &results;
+};
+
 //-----------------------------------------------------------------------------
 
 GEMSupervisor* gemObject::cel = NULL;
@@ -146,10 +281,26 @@ GEMSupervisor::GEMSupervisor(iObjectRegistry* objreg,
     Subscribe(&GEMSupervisor::HandleStatsMessage,MSGTYPE_STATS, REQUIRE_READY_CLIENT);
 
     engine = csQueryRegistry<iEngine> (psserver->GetObjectReg());
+
+    proxTick = new psProxUpdateTick(this);
+    psserver->GetEventManager()->Push(proxTick);
+
+    // Bytes per second to each client, spread over the ticks and kept to
+    // one packet per tick
+    size_t budget = psserver->GetConfig()->GetInt("PlaneShift.Server.WorldUpdate.Budget", 16000);
+    size_t packet = MAXPACKETSIZE - sizeof(psNetPacket) - sizeof(psMessageBytes) - DR_RECORDS_HEADER_SIZE;
+    worldUpdateBudget = csMin(budget * WORLD_UPDATE_INTERVAL / 1000, packet);
+
+    worldUpdateTick = new psWorldUpdateTick(this);
+    psserver->GetEventManager()->Push(worldUpdateTick);
 }
 
 GEMSupervisor::~GEMSupervisor()
 {
+    proxTick->SetValid(false);
+    worldUpdateTick->SetValid(false);
+    jobs.Stop();
+
     // Slow but safe method of deleting.
     size_t count = entities_by_eid.GetSize();
     while(count > 0)
@@ -254,6 +405,10 @@ void GEMSupervisor::RemoveEntity(gemObject* which)
     entities_by_eid.Delete(which->GetEID(), which);
     Debug3(LOG_CELPERSIST,0,"Entity <%s, %s> removed from supervisor.\n", which->GetName(), ShowID(which->GetEID()));
 
+    if(proxQueued.Delete(which))
+    {
+        proxQueue.Delete(which);
+    }
 }
 
 void GEMSupervisor::RemovePlayerFromLootables(PID playerID)
@@ -434,6 +589,88 @@ void GEMSupervisor::UpdateAllStats()
     }
 }
 
+void GEMSupervisor::QueueProxUpdate(gemObject* obj)
+{
+    if(!proxQueued.Contains(obj))
+    {
+        proxQueued.Add(obj);
+        proxQueue.Push(obj);
+    }
+}
+
+void GEMSupervisor::UpdateQueuedProxLists()
+{
+    if(proxQueue.IsEmpty())
+        return;
+
+    // Objects queued while the lists are updated wait for the next tick
+    csArray<gemObject*> objects;
+    proxQueue.TransferTo(objects);
+    proxQueued.DeleteAll();
+
+    // The searches only read the positions and the spatial index, they
+    // run on all threads. Updating the lists changes the lists of the
+    // nearby objects and sends messages, that is left to this thread.
+    csArray<ProxCandidatesJob::Result> results;
+    results.SetSize(objects.GetSize());
+
+    ProxCandidatesJob job(objects, results);
+    jobs.ParallelFor(objects.GetSize(), job);
+
+    for(size_t i = 0; i < objects.GetSize(); i++)
+    {
+        if(results[i].update)
+        {
+            objects[i]->ApplyProxCandidates(results[i].nearlist);
+        }
+    }
+}
+
+void GEMSupervisor::ProxUpdateTick()
+{
+    UpdateQueuedProxLists();
+
+    proxTick = new psProxUpdateTick(this);
+    psserver->GetEventManager()->Push(proxTick);
+}
+
+void GEMSupervisor::QueueWorldUpdate(uint32_t clientnum)
+{
+    if(!worldUpdateQueued.Contains(clientnum))
+    {
+        worldUpdateQueued.Add(clientnum);
+        worldUpdateQueue.Push(clientnum);
+    }
+}
+
+void GEMSupervisor::WorldUpdateTick()
+{
+    csArray<uint32_t> clientnums;
+    worldUpdateQueue.TransferTo(clientnums);
+    worldUpdateQueued.DeleteAll();
+
+    ClientConnectionSet* clients = psserver->GetConnections();
+    for(size_t i = 0; i < clientnums.GetSize(); i++)
+    {
+        Client* client = clients->Find(clientnums[i]);
+        if(!client || client->GetDRQueue().IsEmpty())
+            continue;
+
+        csArray<psDRRecord> records;
+        size_t bytes = client->GetDRQueue().Collect(worldUpdateBudget, records);
+
+        psWorldUpdateMessage msg(client->GetClientNum(), records, bytes, psserver->GetNetManager()->GetAccessPointers());
+        msg.SendMessage();
+
+        // The far entities left over go with the next tick
+        if(!client->GetDRQueue().IsEmpty())
+            QueueWorldUpdate(client->GetClientNum());
+    }
+
+    worldUpdateTick = new psWorldUpdateTick(this);
+    psserver->GetEventManager()->Push(worldUpdateTick);
+}
+
 void GEMSupervisor::GetPlayerObjects(PID playerID, csArray<gemObject*> &list)
 {
     csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
@@ -451,53 +688,47 @@ void GEMSupervisor::GetPlayerObjects(PID playerID, csArray<gemObject*> &list)
 
 void GEMSupervisor::GetAllEntityPos(csArray<psAllEntityPosMessage> &update)
 {
+    csArray<gemObject*> objects;
     csHash<gemObject*, EID>::GlobalIterator iter(entities_by_eid.GetIterator());
+    while(iter.HasNext())
+    {
+        gemObject* obj = iter.Next();
+        if(obj->GetPID().IsValid())
+        {
+            objects.Push(obj);
+        }
+    }
 
-    csTicks now = csGetTicks();
+    // Filter the objects that moved enough on all threads, the messages
+    // are filled in this thread afterwards.
+    csArray<EntityPosJob::Result> results;
+    results.SetSize(objects.GetSize());
+
+    EntityPosJob job(objects, results, csGetTicks());
+    jobs.ParallelFor(objects.GetSize(), job);
+
+    size_t next = 0;
 
     // Loop as long as we need to send more messages.
-    while(iter.HasNext())
+    while(next < results.GetSize())
     {
         psAllEntityPosMessage msg;
         msg.SetLength(ALLENTITYPOS_MAX_AMOUNT,0); // Set a message length limit
 
         // Fill the message
         int count_actual = 0;
-        while(iter.HasNext())
+        while(next < results.GetSize())
         {
-            gemObject* obj = iter.Next();
-            if(obj->GetPID().IsValid())
+            EntityPosJob::Result &result = results[next];
+            gemObject* obj = objects[next];
+            next++;
+
+            if(result.send)
             {
-                gemActor* actor = dynamic_cast<gemActor*>(obj);
-                // FIXME: Now only distribute players, this should
-                //        be modify to send all actors exepct
-                //        NPCs controlled by the receving superclient.
-                if(actor && actor->GetClient())
-                {
-                    csVector3 pos,pos2;
-                    float yrot;
-                    InstanceID instance,oldInstance;
-                    iSector* sector;
-                    csTicks last;
-                    obj->GetPosition(pos,yrot,sector);
-                    instance = obj->GetInstance();
-                    obj->GetLastSuperclientPos(pos2,oldInstance,last);
-
-                    float dist2 = (pos.x - pos2.x) * (pos.x - pos2.x) +
-                                  (pos.y - pos2.y) * (pos.y - pos2.y) +
-                                  (pos.z - pos2.z) * (pos.z - pos2.z);
-
-                    csTicks time = now - last;
-
-                    // We need to filter some to prevent overloading the network
-                    if((dist2 > 1.0) || (dist2 > .04 && time > 2000) || (instance != oldInstance))
-                    {
-                        count_actual++;
-                        msg.Add(obj->GetEID(), pos, sector, obj->GetInstance(),
-                                cacheManager->GetMsgStrings());
-                        obj->SetLastSuperclientPos(pos,instance,now);
-                    }
-                }
+                count_actual++;
+                msg.Add(obj->GetEID(), result.pos, result.sector, result.instance,
+                        cacheManager->GetMsgStrings());
+                obj->SetLastSuperclientPos(result.pos,result.instance,job.now);
             }
             if(count_actual == ALLENTITYPOS_MAX_AMOUNT) //we reached message limit so we break out of here
                 break;
@@ -551,6 +782,15 @@ csArray<gemObject*> GEMSupervisor::FindNearbyEntities(iSector* sector, const csV
 {
     csArray<gemObject*> list;
 
+    spatialIndex.FindNearby(sector, pos, instance, radius, doInvisible, list);
+
+    return list;
+}
+
+csArray<gemObject*> GEMSupervisor::FindNearbyMeshEntities(iSector* sector, const csVector3 &pos, InstanceID instance, float radius, bool doInvisible)
+{
+    csArray<gemObject*> list;
+
     csRef<iMeshWrapperIterator> obj_it =  engine->GetNearbyMeshes(sector, pos, radius);
     while(obj_it->HasNext())
     {
@@ -705,6 +945,22 @@ const char* gemObject::GetName()
     return name;
 }
 
+void gemObject::SetInstance(InstanceID newInstance)
+{
+    if(worldInstance == newInstance)
+        return;
+
+    worldInstance = newInstance;
+
+    // Move the object to the grid of the new instance.
+    iMeshWrapper* mesh = GetMeshWrapper();
+    if(mesh)
+    {
+        iSector* sector = GetSector();
+        cel->GetSpatialIndex()->Update(this, sector, mesh->GetMovable()->GetPosition(), worldInstance);
+    }
+}
+
 void gemObject::SetName(const char* n)
 {
     name = n;
@@ -831,30 +1087,49 @@ bool gemObject::InitProximityList(float radius,int clientnum)
 
 void gemObject::UpdateProxList(bool force)
 {
-#ifdef PSPROXDEBUG
-    psString log;
-#endif
+    csArray<gemObject*> nearlist;
+    if(FindProxCandidates(nearlist, force))
+    {
+        ApplyProxCandidates(nearlist, force);
+    }
+}
 
+bool gemObject::FindProxCandidates(csArray<gemObject*> &nearlist, bool force)
+{
     if(!force && !proxlist->CheckUpdateRequired())   // This allows updates only if moved some way away
-        return;
+        return false;
 
+    // Find nearby entities
+    const csVector3 &pos = GetPosition();
+    iSector* sector = GetSector();
+
+    cel->GetSpatialIndex()->FindNearby(sector, pos, GetInstance(), prox_distance_current, true, nearlist);
+    return true;
+}
+
+void gemObject::ApplyProxCandidates(csArray<gemObject*> &nearlist, bool force)
+{
 #ifdef PSPROXDEBUG
+    psString log;
     log.AppendFmt("Generating proxlist for %s\n", GetName());
     //proxlist->DebugDumpContents();
 #endif
 
-    // Find nearby entities
     const csVector3 &pos = GetPosition();
     iSector* sector = GetSector();
 
     csTicks time = csGetTicks();
 
-    csArray<gemObject*> nearlist = cel->FindNearbyEntities(sector,pos,GetInstance(),prox_distance_current, true);
-
     //CPrintf(CON_SPAM, "\nUpdating proxlist for %s\n--------------------------\n",GetName());
 
-    // Cycle through list and add any entities
-    // that represent players to the proximity subscription list.
+    // The update is done as a diff against the current relations. Walking
+    // the nearby objects touches the relations that are still valid and
+    // collects the ones that entered, what is left untouched afterwards has
+    // left. Network traffic is only generated from the collected diffs, once
+    // all the lists are consistent again.
+    csArray<gemObject*> enteredMine;    // Objects to send to our client
+    csArray<gemObject*> enteredTheirs;  // Clients to send ourself to
+
     size_t count = nearlist.GetSize();
     size_t player_count = 0;
 
@@ -886,10 +1161,7 @@ void gemObject::UpdateProxList(bool force)
 #endif
                 if(GetClientID()!=0)
                 {
-#ifdef PSPROXDEBUG
-                    log.AppendFmt("-%s sent to client %s\n",nearobj->GetName(),GetName());
-#endif
-                    nearobj->Send(GetClientID(),false,false);
+                    enteredMine.Push(nearobj);
                     player_count++;
                 }
             }
@@ -919,10 +1191,7 @@ void gemObject::UpdateProxList(bool force)
 #endif
                 if(nearobj->GetClientID()!=0)
                 {
-#ifdef PSPROXDEBUG
-                    log.AppendFmt("Big send -%s sent to client %s\n",GetName(),nearobj->GetName());
-#endif
-                    Send(nearobj->GetClientID(),false,false);
+                    enteredTheirs.Push(nearobj);
                 }
             }
         }
@@ -960,59 +1229,84 @@ void gemObject::UpdateProxList(bool force)
         }
     }
 
-    // Now remove those that should be no more connected to out object
+    // Now find those that should be no more connected to our object
 
-    gemObject* obj;
+    csArray<gemObject*> leftMine;       // Objects to remove from our client
+    csArray<gemObject*> leftTheirs;     // Clients to remove ourself from
 
-    size_t debug_count = 0;
     if(GetClientID() != 0)
     {
-        while(proxlist->GetUntouched_ObjectThatIWatch(obj))
+        proxlist->GetUntouchedObjectsThatIWatch(leftMine);
+        for(size_t i = 0; i < leftMine.GetSize(); i++)
         {
-            debug_count++;
-#ifdef PSPROXDEBUG
-            log.AppendFmt("-removing %s from client %s\n",obj->GetName(),GetName());
-#endif
-            CS_ASSERT(obj != this);
-
-            //               csVector3 pos; float yrot; iSector *sector;
-            //               obj->GetPosition(pos,yrot,sector);
-            //                CPrintf(CON_SPAM, "Removing %s at (%1.2f, %1.2f, %1.2f) in sector %s.\n",obj->GetName(),pos.x,pos.y,pos.z,sector->QueryObject()->GetName() );
+            CS_ASSERT(leftMine[i] != this);
+            proxlist->EndWatching(leftMine[i]);
+        }
+    }
 
-            psRemoveObject remove(GetClientID(), obj->GetEID());
-            remove.SendMessage();
-            proxlist->EndWatching(obj);
+    proxlist->GetUntouchedObjectsThatWatchMe(leftTheirs);
+    for(size_t i = 0; i < leftTheirs.GetSize(); i++)
+    {
+        gemObject* obj = leftTheirs[i];
+        if(obj->GetClientID() != 0)
+        {
+            CS_ASSERT(obj != this);
+            obj->GetProxList()->EndWatching(this);
         }
     }
 
-    if(csGetTicks() - time > 500 || player_count > 100)
+    // Flush the diffs, removals first so clients free the entities before
+    // new ones arrive.
+    for(size_t i = 0; i < leftMine.GetSize(); i++)
     {
-        csString status;
-        status.Format("Warning: Spent %u time getting untouched objects in proxlist for %s, %zu nearby entities, distance %g, location: %g %g %g %s!",
-                      csGetTicks() - time, GetName(), player_count, prox_distance_current, pos.x, pos.y, pos.z, (const char*)sector->QueryObject()->GetName());
-        psserver->GetLogCSV()->Write(CSV_STATUS, status);
+#ifdef PSPROXDEBUG
+        log.AppendFmt("-removing %s from client %s\n",leftMine[i]->GetName(),GetName());
+#endif
+        psRemoveObject remove(GetClientID(), leftMine[i]->GetEID());
+        remove.SendMessage();
+        if(GetClient())
+            GetClient()->GetDRQueue().Forget(leftMine[i]->GetEID());
     }
 
-    while(proxlist->GetUntouched_ObjectThatWatchesMe(obj))
+    for(size_t i = 0; i < leftTheirs.GetSize(); i++)
     {
+        gemObject* obj = leftTheirs[i];
         if(obj->GetClientID() != 0)
         {
 #ifdef PSPROXDEBUG
             log.AppendFmt("-removing %s from client %s\n",GetName(),obj->GetName());
 #endif
-            CS_ASSERT(obj != this);
             psRemoveObject msg(obj->GetClientID(), eid);
             msg.SendMessage();
-            obj->GetProxList()->EndWatching(this);
+            if(obj->GetClient())
+                obj->GetClient()->GetDRQueue().Forget(eid);
         }
     }
 
+    for(size_t i = 0; i < enteredMine.GetSize(); i++)
+    {
+#ifdef PSPROXDEBUG
+        log.AppendFmt("-%s sent to client %s\n",enteredMine[i]->GetName(),GetName());
+#endif
+        enteredMine[i]->Send(GetClientID(),false,false);
+    }
+
+    for(size_t i = 0; i < enteredTheirs.GetSize(); i++)
+    {
+#ifdef PSPROXDEBUG
+        log.AppendFmt("Big send -%s sent to client %s\n",GetName(),enteredTheirs[i]->GetName());
+#endif
+        Send(enteredTheirs[i]->GetClientID(),false,false);
+    }
+
     if(csGetTicks() - time > 500 || player_count > 100)
     {
         csString status;
-        status.Format("Warning: Spent %u time touching entities in proxlist for %s,"
-                      " counted %zu nearby entities, %zu untouched objects that it watches, distance %g!",
-                      csGetTicks() - time, GetName(), player_count, debug_count, prox_distance_current);
+        status.Format("Warning: Spent %u time updating proxlist for %s,"
+                      " counted %zu nearby entities, %zu entered, %zu left, distance %g, location: %g %g %g %s!",
+                      csGetTicks() - time, GetName(), player_count,
+                      enteredMine.GetSize() + enteredTheirs.GetSize(), leftMine.GetSize() + leftTheirs.GetSize(),
+                      prox_distance_current, pos.x, pos.y, pos.z, (const char*)sector->QueryObject()->GetName());
         psserver->GetLogCSV()->Write(CSV_STATUS, status);
     }
 
@@ -3268,7 +3562,6 @@ bool gemActor::AddChatReport(gemActor* reporter)
     activeReports++;
 
     csString cssBuffer("");
-    csString cssTempLine("");
 
     if(activeReports == 1)
     {
@@ -3285,9 +3578,10 @@ bool gemActor::AddChatReport(gemActor* reporter)
         // One file per user
         csString cssFilename = csString().Format("/this/logs/report_chat_%s.log", GetFirstName());
 
-        logging_chat_file = vfs->Open(cssFilename.GetData(), VFS_FILE_APPEND);
-        if(!logging_chat_file)
+        logging_chat_file.AttachNew(new VfsLogFile(vfs, cssFilename.GetData()));
+        if(!logging_chat_file->IsOpen())
         {
+            logging_chat_file = NULL;
             Error1("Error, could not open log file to append.");
             activeReports = 0;
             return false;
@@ -3311,23 +3605,19 @@ bool gemActor::AddChatReport(gemActor* reporter)
         cssBuffer.AppendFmt("Total time connected is %1.1f hours.\n", (GetCharacterData()->GetTimeConnected() / 3600.0f));
         cssBuffer.AppendFmt("================================================================\n");
         // Write existing chat history
-        size_t length = chatHistory.GetSize();
-        for(size_t i=0; i<length; i++)
+        for(size_t i=0; i<chatHistory.GetSize(); i++)
         {
-            chatHistory[i].GetLogLine(cssTempLine);
-            cssBuffer += cssTempLine;
+            cssBuffer += chatHistory.Get(i)->GetLogLine();
         }
-        chatHistory.DeleteRange(0, length-1); //we don't want to relog again these.
+        chatHistory.Empty(); //we don't want to relog again these.
     }
 
     // Add /report line
-    ChatHistoryEntry cheReport(csString().Format("-- At this point player got reported by %s --", reporter->GetName()).GetData());
-    cheReport.GetLogLine(cssTempLine);
-    cssBuffer += cssTempLine;
+    ChatLine cheReport(csString().Format("-- At this point player got reported by %s --", reporter->GetName()).GetData());
+    cssBuffer += cheReport.GetLogLine();
 
     // Write the data to the file
-    logging_chat_file->Write(cssBuffer.GetData(), cssBuffer.Length());
-    logging_chat_file->Flush(); // flush
+    AsyncLog::Write(logging_chat_file, cssBuffer.GetData());
 
     return true; // been there, done that
 }
@@ -3342,16 +3632,20 @@ void gemActor::RemoveChatReport()
         // so we terminate logging and close the file.
         Notify2(LOG_ANY, "Logging of chat messages for '%s' stopped -\n", ShowID(pid));
 
-        csString cssBuffer("================================================================\n\n");
-        logging_chat_file->Write(cssBuffer.GetData(), cssBuffer.Length());
-        logging_chat_file->Flush();
+        AsyncLog::Write(logging_chat_file, "================================================================\n\n");
 
-        // This should close the file.
+        // This closes the file once the queued lines are written.
         logging_chat_file = 0;
     }
 }
 
 bool gemActor::LogChatMessage(const char* who, const psChatMessage &msg)
+{
+    csRef<ChatLine> line = FormatChatMessage(who, msg);
+    return LogChatLine(line);
+}
+
+csPtr<ChatLine> gemActor::FormatChatMessage(const char* who, const psChatMessage &msg)
 {
     csString cssLine("");
 
@@ -3383,9 +3677,9 @@ bool gemActor::LogChatMessage(const char* who, const psChatMessage &msg)
             cssLine.Format("Auction from %s: %s", who, msg.sText.GetData());
             break;
         default:
-            return false; // We do not log any other chat types.
+            return csPtr<ChatLine>(NULL); // We do not log any other chat types.
     }
-    return LogLine(cssLine.GetData());
+    return csPtr<ChatLine>(new ChatLine(cssLine.GetData()));
 }
 
 bool gemActor::LogSystemMessage(const char* szLine)
@@ -3395,28 +3689,28 @@ bool gemActor::LogSystemMessage(const char* szLine)
 
 bool gemActor::LogLine(const char* szLine)
 {
-    // Add to chat history
-    ChatHistoryEntry cheNew(szLine);
+    csRef<ChatLine> line;
+    line.AttachNew(new ChatLine(szLine));
+    return LogChatLine(line);
+}
+
+bool gemActor::LogChatLine(ChatLine* line)
+{
+    if(!line)
+        return false;
 
     if(!IsLoggingChat())  // Check if we're logging. If not, store the message in the history and bail out.
     {
-        chatHistory.Push(cheNew);
+        chatHistory.Push(line);
 
         // Maintain history
-        time_t check = time(0) - CHAT_HISTORY_LIFETIME;
-        // We delete lines older than current time + CHAT_HISTORY_LIFETIME
+        // We delete lines older than CHAT_HISTORY_LIFETIME
         // if the history size is not lowest than the minimum
-        while((chatHistory.GetSize()>CHAT_HISTORY_MINIMUM_SIZE) &&
-                chatHistory.Get(0)._time < check)
-        {
-            chatHistory.DeleteIndex(0);
-        }
+        chatHistory.Expire(time(0) - CHAT_HISTORY_LIFETIME, CHAT_HISTORY_MINIMUM_SIZE);
         return false;
     }
 
-    csString cssLine("");
-    cheNew.GetLogLine(cssLine); // Get a log-writtable line
-    logging_chat_file->Write(cssLine.GetData(), cssLine.Length()); // Write to the file
+    AsyncLog::Write(logging_chat_file, line->GetLogLine()); // Queue for the file
     return true; // The line was written to a file, so return true.
 }
 
@@ -3758,7 +4052,7 @@ void gemActor::SetDefaults(bool player)
 
 void gemActor::SetInstance(InstanceID worldInstance)
 {
-    this->worldInstance = worldInstance;
+    gemObject::SetInstance(worldInstance);
 }
 
 void gemActor::Teleport(const char* sectorName, const csVector3 &pos, float yrot, InstanceID instance, int32_t loadDelay, csString background, csVector2 point1, csVector2 point2, csString widget)
@@ -4079,7 +4373,43 @@ void gemActor::MulticastDRUpdate()
     psDRMessage drmsg(0, eid, on_ground, movementMode, DRcounter,
                       pos,yrot,sector, "", vel,worldVel,ang_vel,
                       psserver->GetNetManager()->GetAccessPointers());
-    drmsg.Multicast(GetMulticastClients(),0,PROX_LIST_ANY_RANGE);
+
+    psDRSnapshot snapshot;
+    bool quantized = snapshot.Quantize(pos, vel, worldVel, ang_vel, yrot, movementMode, on_ground);
+    MulticastDR(drmsg.msg, quantized ? &snapshot : NULL, DRcounter, sector, 0);
+}
+
+void gemActor::MulticastDR(MsgEntry* legacy, const psDRSnapshot* snapshot, uint8_t counter, iSector* sector, uint32_t except)
+{
+    csArray<PublishDestination> &multi = GetMulticastClients();
+    ClientConnectionSet* clients = psserver->GetConnections();
+
+    csString sectorName = sector ? sector->QueryObject()->GetName() : "";
+
+    csArray<PublishDestination> legacyMulti;
+    bool compact = false;
+    for(size_t i = 0; i < multi.GetSize(); i++)
+    {
+        if(multi[i].client == except)
+            continue;
+
+        Client* client = snapshot ? clients->Find(multi[i].client) : NULL;
+        if(!client || !client->IsReady() || !client->HasNetCapability(NETCAPS_COMPACT_DR))
+        {
+            legacyMulti.Push(multi[i]);
+            continue;
+        }
+        compact = true;
+
+        client->GetDRQueue().Push(eid, counter, *snapshot, sectorName, multi[i].dist);
+        cel->QueueWorldUpdate(multi[i].client);
+    }
+
+    // Most of the time no client asks for the compact updates
+    if(!compact)
+        psserver->GetEventManager()->Multicast(legacy, multi, except, PROX_LIST_ANY_RANGE);
+    else if(legacyMulti.GetSize())
+        psserver->GetEventManager()->Multicast(legacy, legacyMulti, except, PROX_LIST_ANY_RANGE);
 }
 
 void gemActor::ForcePositionUpdate(int32_t loadDelay, csString background, csVector2 point1, csVector2 point2, csString widget)
@@ -4608,28 +4938,6 @@ bool gemActor::InsideGuardedArea(gemObject* object)
 }
 
 
-/* gemActor::ChatHistoryEntry function implementations */
-
-/// ChatHistoryEntry(const char*, time_t = 0)
-/// Info: Constructor. When no time is given, current time is used.
-gemActor::ChatHistoryEntry::ChatHistoryEntry(const char* szLine, time_t t)
-    : _time(t?t:time(0)), _line(szLine) {}
-
-/// void GetLogLine(csString&) const
-/// Info: Prepends a string representation of the time to this chat line
-/// so it can be written to a log file. The resulting line is
-/// written to 'line' argument (reference).
-/// Note: this function also applies \n to the line end.
-void gemActor::ChatHistoryEntry::GetLogLine(csString &line) const
-{
-    tm* gmtm = gmtime(&_time);
-    csString cssTime = csString().Format("%d-%02d-%02d %02d:%02d:%02d",
-                                         gmtm->tm_year+1900, gmtm->tm_mon+1, gmtm->tm_mday,
-                                         gmtm->tm_hour, gmtm->tm_min, gmtm->tm_sec);
-    line.Format("[%s] %s\n", cssTime.GetData(), _line.GetData());
-}
-
-
 //--------------------------------------------------------------------------------------
 
 gemNPC::gemNPC(GEMSupervisor* gemsupervisor, CacheManager* cachemanager,
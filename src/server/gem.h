@@ -31,6 +31,7 @@
 #include <csutil/csobject.h>
 #include <csutil/csstring.h>
 #include <csutil/hash.h>
+#include <csutil/set.h>
 #include <csutil/weakreferenced.h>
 
 //=============================================================================
@@ -42,6 +43,10 @@
 
 #include "util/gameevent.h"
 #include "util/consoleout.h"
+#include "util/asynclog.h"
+#include "util/chathistory.h"
+#include "util/jobsystem.h"
+#include "util/spatialgrid.h"
 
 #include "net/npcmessages.h"  // required for psNPCCommandsMessage::PerceptionType
 
@@ -78,6 +83,8 @@ class ClientConnectionSet;
 class PublishVector;
 class psLinearMovement;
 class gemMesh;
+class psProxUpdateTick;
+class psWorldUpdateTick;
 
 /**
  * \addtogroup server
@@ -196,6 +203,54 @@ public:
     void UpdateAllDR();
     void UpdateAllStats();
 
+    /** @name Proximity updates
+     */
+    ///@{
+    /**
+     * Queue an object to have its proxlist updated with the next tick.
+     *
+     * Used for the updates following movement. The nearby objects of all
+     * the queued objects are searched for at once on the threads of the
+     * job system, then the proxlists are updated one by one.
+     */
+    void QueueProxUpdate(gemObject* obj);
+
+    /**
+     * Update the proxlists of all the queued objects.
+     *
+     * Called by ProxUpdateTick().
+     */
+    void UpdateQueuedProxLists();
+
+    /**
+     * Get the job system used to spread the work of a tick over threads.
+     */
+    JobSystem* GetJobSystem()
+    {
+        return &jobs;
+    }
+
+    /// Called by the proximity tick, updates the queue and schedules the next tick.
+    void ProxUpdateTick();
+    ///@}
+
+    /** @name World updates
+     */
+    ///@{
+    /**
+     * Queue a client to be sent its pending dead reckoning with the next
+     * world update tick, see psDRQueue.
+     */
+    void QueueWorldUpdate(uint32_t clientnum);
+
+    /**
+     * Send each queued client one psWorldUpdateMessage within its byte
+     * budget and schedule the next tick. Clients with updates left over
+     * stay queued.
+     */
+    void WorldUpdateTick();
+    ///@}
+
     void GetAllEntityPos(csArray<psAllEntityPosMessage> &msgs);
     int  CountManagedNPCs(AccountID superclientID);
     void FillNPCList(MsgEntry* msg, AccountID superclientID);
@@ -263,6 +318,8 @@ public:
     /**
      * Create a list of all nearby gem objects.
      *
+     * The search is done in the spatial index of the supervisor.
+     *
      * @param sector The sector to check in.
      * @param pos The starting position
      * @param instance The instance ID for the starting point
@@ -273,6 +330,23 @@ public:
      */
     csArray<gemObject*> FindNearbyEntities(iSector* sector, const csVector3 &pos, InstanceID instance, float radius, bool doInvisible = false);
 
+    /**
+     * Create a list of all nearby gem objects using the CS engine.
+     *
+     * Same as FindNearbyEntities but walks the nearby meshes of the engine
+     * and looks up the attached object of each. Kept to verify and
+     * benchmark the spatial index against.
+     */
+    csArray<gemObject*> FindNearbyMeshEntities(iSector* sector, const csVector3 &pos, InstanceID instance, float radius, bool doInvisible = false);
+
+    /**
+     * Get the spatial index of all gemObjects with a mesh in a sector.
+     */
+    psSpatialGrid<gemObject>* GetSpatialIndex()
+    {
+        return &spatialIndex;
+    }
+
     /**
      * Create a list of all gem objects in a sector.
      *
@@ -297,6 +371,17 @@ protected:
 
     uint32              nextEID;             ///< The next ID available for an object.
 
+    psSpatialGrid<gemObject> spatialIndex;  ///< Grid of all objects per sector and instance.
+
+    csArray<gemObject*> proxQueue;           ///< Objects waiting for a proxlist update
+    csSet<csPtrKey<gemObject> > proxQueued;  ///< The objects in proxQueue
+    psProxUpdateTick*   proxTick;            ///< The next proximity tick
+
+    csArray<uint32_t>   worldUpdateQueue;    ///< Clients with pending dead reckoning
+    csSet<uint32_t>     worldUpdateQueued;   ///< The clients in worldUpdateQueue
+    psWorldUpdateTick*  worldUpdateTick;     ///< The next world update tick
+    size_t              worldUpdateBudget;   ///< Bytes of records per client and tick
+    JobSystem           jobs;                ///< Threads for the parallel phases of a tick
 
     csRef<iEngine> engine;                   ///< Stored here to save expensive csQueryRegistry calls
 };
@@ -385,10 +470,7 @@ public:
     const char* GetName();
     void SetName(const char* n);
 
-    void SetInstance(InstanceID newInstance)
-    {
-        worldInstance = newInstance;
-    }
+    void SetInstance(InstanceID newInstance);
     InstanceID  GetInstance()
     {
         return worldInstance;
@@ -504,6 +586,27 @@ public:
      */
     void UpdateProxList(bool force = false);
 
+    /**
+     * Find the objects the proxlist has to be updated with.
+     *
+     * This is the first half of UpdateProxList(). It only reads the state
+     * shared with other objects, so it may run for many objects at once.
+     *
+     * @param nearlist Receives the objects in range.
+     * @param force    Search even if the object didn't move.
+     * @return false if the object didn't move enough to need an update.
+     */
+    bool FindProxCandidates(csArray<gemObject*> &nearlist, bool force = false);
+
+    /**
+     * Update the proxlist from the objects found by FindProxCandidates().
+     *
+     * This is the second half of UpdateProxList(). It changes the proxlists
+     * of the nearby objects and sends the entities that entered or left the
+     * range to the clients, so it must only run in the main thread.
+     */
+    void ApplyProxCandidates(csArray<gemObject*> &nearlist, bool force = false);
+
     /**
      *
      */
@@ -1207,39 +1310,19 @@ protected:
     // for details on current /report implementation
     // check PS#2789.
 
-    /// Info: Stores a chat history element.
-    struct ChatHistoryEntry
-    {
-        /// Info: Time this line was said.
-        time_t _time;
-
-        /// Info: Actual text. (Preformated depending on chat type)
-        csString _line;
-
-        /// Info: Constructor. When no time is given, current time is used.
-        ChatHistoryEntry(const char* szLine, time_t t = 0);
-
-        /** Prepends a string representation of the time to this chat line
-          * so it can be written to a log file. The resulting line is
-          * written to 'line' argument (reference).
-          * Note: this function also applies \n to the line end.
-          */
-        void GetLogLine(csString &line) const;
-    };
-
     /// unsigned int activeReports
     /// Info: Total /report commands filed against this
     /// player that are still active (logging).
     unsigned int activeReports;
 
-    /// csArray<ChatHistoryEntry> chatHistory
-    /// Info: Chat history for this player.
+    /// ChatHistory chatHistory
+    /// Info: Chat history for this player, the lines are shared with the other listeners.
     /// A chat line stays in history for CHAT_HISTORY_LIFETIME (defined in gem.cpp).
-    csArray<ChatHistoryEntry> chatHistory;
+    ChatHistory chatHistory;
 
-    /// csRef<iFile> logging_chat_file
-    /// Info: log file handle.
-    csRef<iFile> logging_chat_file;
+    /// csRef<AsyncLogFile> logging_chat_file
+    /// Info: log file handle, written by the AsyncLog.
+    csRef<AsyncLogFile> logging_chat_file;
 
     /**
      * Determines the right size and height for the collider for the sprite
@@ -1518,6 +1601,26 @@ public:
      */
     bool LogChatMessage(const char* who, const psChatMessage &msg);
 
+    /**
+     * Formats a chat message the way it's kept in the chat history.
+     *
+     * Format it once and give it to LogChatLine() for each listener.
+     *
+     * @param[in] who The name of the character who sent this message
+     * @param[in] msg The chat message
+     * @return The line, or NULL if this type of chat isn't logged
+     */
+    static csPtr<ChatLine> FormatChatMessage(const char* who, const psChatMessage &msg);
+
+    /**
+     * Adds a line formatted by FormatChatMessage() to the history and
+     * optionally to the log file.
+     *
+     * @param[in] line The line, may be NULL
+     * @return Returns true if the line was written to the log file
+     */
+    bool LogChatLine(ChatLine* line);
+
     /**
      * @brief Saves a system message to this actor's chat history and logs it to
      * a file, if there are active reports.
@@ -1550,6 +1653,18 @@ public:
 
     bool SetDRData(psDRMessage &drmsg);
     void MulticastDRUpdate();
+
+    /**
+     * Send a dead reckoning update to the clients around. For those asking
+     * for NETCAPS_COMPACT_DR it is queued to go in their next world update,
+     * the others get the psDRMessage.
+     *
+     * @param legacy The psDRMessage.
+     * @param snapshot The update quantized, NULL if it doesn't fit: the
+     *                 psDRMessage is sent to all.
+     * @param except A client not to send it to.
+     */
+    void MulticastDR(MsgEntry* legacy, const psDRSnapshot* snapshot, uint8_t counter, iSector* sector, uint32_t except);
     virtual void ForcePositionUpdate(int32_t loadDelay = 0, csString background = "", csVector2 point1 = 0, csVector2 point2 = 0, csString widget = "");
 
     using gemObject::RegisterCallback;
@@ -24,6 +24,7 @@
 #include "iengine/engine.h"
 #include "iengine/mesh.h"
 #include "iengine/movable.h"
+#include "iengine/sector.h"
 #include "iutil/vfs.h"
 #include "iutil/objreg.h"
 #include "imap/loader.h"
@@ -33,6 +34,7 @@
 //=============================================================================
 #include "gemmesh.h"
 #include "gem.h"
+#include "util/spatialgrid.h"
 
 gemMesh::gemMesh(iObjectRegistry* objreg, gemObject* owner, GEMSupervisor* super)
 {
@@ -41,6 +43,7 @@ gemMesh::gemMesh(iObjectRegistry* objreg, gemObject* owner, GEMSupervisor* super
     gem = super;
 
     engine = csQueryRegistry<iEngine>(objectReg);
+    moveListener.AttachNew(new psSpatialGridListener<gemObject>(owner, super->GetSpatialIndex()));
 }
 
 gemMesh::~gemMesh()
@@ -91,6 +94,7 @@ bool gemMesh::SetMesh(const char* factoryName, const char* fileName)
     {
         mesh = engine->CreateMeshWrapper(mesh_fact ,factoryName);
         gem->AttachObject(mesh->QueryObject(), gemOwner);
+        mesh->GetMovable()->AddListener(moveListener);
         result = true;
     }
 
@@ -110,6 +114,8 @@ void gemMesh::SetMesh(iMeshWrapper* newMesh)
     if(newMesh)
     {
         gem->AttachObject(newMesh->QueryObject(), gemOwner);
+        newMesh->GetMovable()->AddListener(moveListener);
+        moveListener->MovableChanged(newMesh->GetMovable());
     }
 }
 
@@ -117,6 +123,8 @@ void gemMesh::RemoveMesh()
 {
     if(mesh)
     {
+        mesh->GetMovable()->RemoveListener(moveListener);
+        gem->GetSpatialIndex()->Remove(gemOwner);
         gem->UnattachObject(mesh->QueryObject(), gemOwner);
         engine->RemoveObject(mesh);
         mesh = 0;
@@ -26,6 +26,7 @@
 #include "cstypes.h"
 #include "csutil/scf.h"
 #include "csutil/weakref.h"
+#include "iengine/movable.h"
 
 //=============================================================================
 // Crystal Space Forward Definitions
@@ -128,6 +129,8 @@ private:
     GEMSupervisor* gem;                     ///< Object controller.
 
     gemObject* gemOwner;                    ///< gemObject using this mesh.
+
+    csRef<iMovableListener> moveListener; ///< Updates the spatial index when the mesh moves.
 };
 
 /** @} */
@@ -28,6 +28,7 @@
 #include "util/pserror.h"
 #include "util/serverconsole.h"
 #include "util/eventmanager.h"
+#include "util/linkcheck.h"
 
 #include "net/message.h"
 #include "net/messages.h"
@@ -59,26 +60,17 @@
 class DelayedMessageSendEvent : public psGameEvent
 {
 protected:
-    bool valid;
     csRef<MsgEntry> myMsg;
 
 public:
     DelayedMessageSendEvent(int delayticks,MsgEntry* msg)
         : psGameEvent(0, delayticks, "DelayedMessageSendEvent")
     {
-        valid = true;
         myMsg = msg;
     }
-    void CancelEvent()
-    {
-        valid = false;
-    }
     virtual void Trigger()
     {
-        if(valid)
-        {
-            psserver->GetNetManager()->SendMessage(myMsg);
-        }
+        psserver->GetNetManager()->SendMessage(myMsg);
     }
 };
 
@@ -238,13 +230,13 @@ bool NetManager::HandleUnknownClient(LPSOCKADDR_IN addr, MsgEntry* me)
     // This is for the accept message that will be sent back
     me->clientnum = client->GetClientNum();
 
+    linkChecks.Schedule(client->GetClientNum(), csGetTicks() + timeout);
+
     return true;
 }
 
 void NetManager::CheckResendPkts()
 {
-    // NOTE: Globaliterators on csHash do not retrieve keys contiguously.
-    csHash<csRef<psNetPacketEntry>, PacketKey>::GlobalIterator it(awaitingack.GetIterator());
     csRef<psNetPacketEntry> pkt;
     csArray<csRef<psNetPacketEntry> > pkts;
     csArray<Connection*> resentConnections;
@@ -255,13 +247,9 @@ void NetManager::CheckResendPkts()
     csTicks currenttime = csGetTicks();
     unsigned int resentCount = 0;
 
-    while(it.HasNext())
-    {
-        pkt = it.Next();
-        // Check the connection packet timeout
-        if(pkt->timestamp + csMin((csTicks)PKTMAXRTO, pkt->RTO) < currenttime)
-            pkts.Push(pkt);
-    }
+    // Only the packets with an expired timeout come out of the resend queue
+    GetExpiredPackets(currenttime, pkts);
+
     for(size_t i = 0; i < pkts.GetSize(); i++)
     {
 #ifdef PACKETDEBUG
@@ -273,7 +261,7 @@ void NetManager::CheckResendPkts()
         csRef<NetPacketQueueRefCount> outqueue = clients.FindQueueAny(pkt->clientnum);
         if(!outqueue)
         {
-            awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt);
+            RemoveAwaitingAck(pkt);
             continue;
         }
 
@@ -283,7 +271,11 @@ void NetManager::CheckResendPkts()
             if(resentConnections.Find(connection) == csArrayItemNotFound)
                 resentConnections.Push(connection);
             if(fullConnections.Find(connection) != csArrayItemNotFound)
+            {
+                // Still expired, so it comes up again with the next check
+                ScheduleResend(pkt);
                 continue;
+            }
             // This indicates a bug in the netcode.
             if(pkt->RTO == 0)
             {
@@ -314,11 +306,13 @@ void NetManager::CheckResendPkts()
 
             if(packet->offset == 0)
             {
-                psMessageBytes* msg = (psMessageBytes*) packet->data;
+                // The data may be in a payload shared with other clients
+                const psMessageBytes* msg = (const psMessageBytes*) pkt->GetPacketData();
                 type = msg->type;
             }
             Error4("Queue full. Could not add packet with clientnum %d type %s ID %d.\n", pkt->clientnum, type == 0 ? "Fragment" : (const char*)  GetMsgTypeName(type), pkt->packet->pktid);
             fullConnections.Push(connection);
+            ScheduleResend(pkt);
             continue;
         }
 
@@ -334,7 +328,7 @@ void NetManager::CheckResendPkts()
         //printf("pkt=%p, pkt->packet=%p\n",pkt,pkt->packet);
         // take out of awaiting ack pool.
         // This does NOT delete the pkt mem block itself.
-        if(!awaitingack.Delete(PacketKey(pkt->clientnum, pkt->packet->pktid), pkt))
+        if(!RemoveAwaitingAck(pkt))
         {
 #ifdef PACKETDEBUG
             Debug2(LOG_NET,"No packet in ack queue :%d\n", pkt->packet->pktid);
@@ -445,6 +439,23 @@ bool NetManager::SendMessage(MsgEntry* me)
     return sendresult;
 }
 
+bool NetManager::SendMessage(MsgEntry* me, psNetPacketPayload* payload)
+{
+    csRef<NetPacketQueueRefCount> outqueue = clients.FindQueueAny(me->clientnum);
+    if(!outqueue)
+        return false;
+
+    // Same order as in SendMessage(), add the packets before adding the queue to the senders.
+    bool sendresult = NetBase::SendMessage(me, outqueue, payload);
+
+    if(!senders.Add(outqueue))
+    {
+        Error1("Senderlist Full!");
+    }
+
+    return sendresult;
+}
+
 // This function is the network thread
 // Thread: Network
 void NetManager::Run()
@@ -564,7 +575,10 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
             newmsg.AttachNew(new MsgEntry(me));
             newmsg->msgid = GetRandomID();
 
-            // Message is copied again into packet sections, so we can reuse same one.
+            // The bytes are copied once and shared by the packets of all the clients.
+            csRef<psNetPacketPayload> payload;
+            payload.AttachNew(new psNetPacketPayload(newmsg->bytes));
+
             ClientIterator i(clients);
 
             while(i.HasNext())
@@ -588,7 +602,7 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
                     continue;
 
                 newmsg->clientnum = p->GetClientNum();
-                SendMessage(newmsg);
+                SendMessage(newmsg, payload);
             }
 
             CHECK_FINAL_DECREF(newmsg, "BroadcastMsg");
@@ -608,7 +622,10 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
             newmsg.AttachNew(new MsgEntry(me));
             newmsg->msgid = GetRandomID();
 
-            // Message is copied again into packet sections, so we can reuse same one.
+            // The bytes are copied once and shared by the packets of all the members.
+            csRef<psNetPacketPayload> payload;
+            payload.AttachNew(new psNetPacketPayload(newmsg->bytes));
+
             ClientIterator i(clients);
 
             while(i.HasNext())
@@ -617,7 +634,7 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
                 if(p->GetGuildID() == guildID)
                 {
                     newmsg->clientnum = p->GetClientNum();
-                    SendMessage(newmsg);
+                    SendMessage(newmsg, payload);
                 }
             }
 
@@ -639,8 +656,9 @@ void NetManager::Broadcast(MsgEntry* me, int scope, int guildID)
             pkt.AttachNew(new psNetPacketEntry(me->priority, newmsg->clientnum,
                                                0, 0, (uint32_t) newmsg->bytes->GetTotalSize(),
                                                (uint16_t) newmsg->bytes->GetTotalSize(), newmsg->bytes));
-            // this will also delete the pkt
-            SendFinalPacket(pkt);
+            // this will also delete the pkt, sent directly as this may be
+            // called outside of the network thread
+            SendFinalPacket(pkt, true);
 
             CHECK_FINAL_DECREF(newmsg, "FinalPacket");
             break;
@@ -664,6 +682,9 @@ Client* NetManager::GetAnyClient(int cnum)
 
 void NetManager::Multicast(MsgEntry* me, const csArray<PublishDestination> &multi, uint32_t except, float range)
 {
+    // Created with the first recipient, the bytes are then shared by the packets of all the recipients.
+    csRef<psNetPacketPayload> payload;
+
     for(size_t i=0; i<multi.GetSize(); i++)
     {
         if(multi[i].client==except)   // skip the exception client to avoid circularity
@@ -674,8 +695,11 @@ void NetManager::Multicast(MsgEntry* me, const csArray<PublishDestination> &mult
         {
             if(range == 0 || multi[i].dist < range)
             {
+                if(!payload)
+                    payload.AttachNew(new psNetPacketPayload(me->bytes));
+
                 me->clientnum = multi[i].client;
-                SendMessage(me);      // This copies the mem block, so we can reuse.
+                SendMessage(me, payload);
             }
         }
     }
@@ -687,69 +711,69 @@ void NetManager::CheckLinkDead()
 {
     csTicks currenttime = csGetTicks();
 
-    csArray<uint32_t> checkedClients;
-    Client* pClient = NULL;
-
     // Delete all clients marked for deletion already
     clients.SweepDelete();
 
-    while(true)
     {
-        pClient = NULL;
+        CS::Threading::MutexScopedLock lock(linkCheckMutex);
+        for(size_t i = 0; i < linkCheckRequests.GetSize(); i++)
+            linkChecks.Schedule(linkCheckRequests[i], currenttime - 1);
+        linkCheckRequests.Empty();
+    }
 
-        // Put the iterator in a limited scope so we don't hold on to the lock which may cause deadlock
-        {
-            ClientIterator i(clients);
+    // Packets received since a client was scheduled don't reschedule it,
+    // its last packet time is looked at when it comes up.
+    csArray<uint32_t> due;
+    linkChecks.PopExpired(currenttime, due);
 
-            while(i.HasNext())
-            {
-                Client* candidate = i.Next();
+    for(size_t i = 0; i < due.GetSize(); i++)
+    {
+        Client* pClient = clients.FindAny(due[i]);
 
-                // Skip if already seen
-                if(checkedClients.FindSortedKey(csArrayCmp<uint32_t, uint32_t> (candidate->GetClientNum())) != csArrayItemNotFound)
-                    continue;
+        // Disconnected meanwhile
+        if(!pClient)
+            continue;
 
-                checkedClients.InsertSorted(candidate->GetClientNum());
-                pClient = candidate;
-                break;
-            }
-        }
+        Connection* connection = pClient->GetConnection();
 
-        // No more clients to check so break
-        if(!pClient)
-            break;
+        LinkCheckClient state;
+        state.lastRecvPacketTime = connection->lastRecvPacketTime;
+        state.heartbeat = connection->heartbeat;
+        state.zombie = pClient->IsZombie();
+        state.zombieAllowDisconnect = state.zombie && pClient->ZombieAllowDisconnect();
+        state.allowDisconnect = pClient->AllowDisconnect();
 
-        // Shortcut here so zombies may immediately disconnect
-        if(pClient->IsZombie() && pClient->ZombieAllowDisconnect())
+        csTicks next;
+        switch(CheckLink(state, currenttime, timeout, LINKCHECK, next))
         {
-            /* This simulates receipt of this message from the client
-             ** without any network access, so that disconnection logic
-             ** is all in one place.
-             */
-            psDisconnectMessage discon(pClient->GetClientNum(), 0, "You should not see this.");
-            if(discon.valid)
-            {
-                Connection* connection = pClient->GetConnection();
-                HandleCompletedMessage(discon.msg, connection, NULL,NULL);
-            }
-            else
+            case LINKCHECK_ZOMBIE:
             {
-                Bug2("Failed to create valid psDisconnectMessage for client id %u.\n", pClient->GetClientNum());
+                /* This simulates receipt of this message from the client
+                 ** without any network access, so that disconnection logic
+                 ** is all in one place.
+                 */
+                psDisconnectMessage discon(pClient->GetClientNum(), 0, "You should not see this.");
+                if(discon.valid)
+                {
+                    HandleCompletedMessage(discon.msg, connection, NULL,NULL);
+                }
+                else
+                {
+                    Bug2("Failed to create valid psDisconnectMessage for client id %u.\n", pClient->GetClientNum());
+                }
+                continue;
             }
-        }
-        else if(pClient->GetConnection()->lastRecvPacketTime+timeout < currenttime)
-        {
-            if(pClient->GetConnection()->heartbeat < 10 && pClient->GetConnection()->lastRecvPacketTime+timeout * 10 > currenttime)
+
+            case LINKCHECK_HEARTBEAT:
             {
                 psHeartBeatMsg ping(pClient->GetClientNum());
                 Broadcast(ping.msg, NetBase::BC_FINALPACKET);
-                pClient->GetConnection()->heartbeat++;
+                connection->heartbeat++;
+                break;
             }
-            else
-            {
-                if(!pClient->AllowDisconnect())
-                    continue;
 
+            case LINKCHECK_LINKDEAD:
+            {
                 csString ipAddr = pClient->GetIPAddress();
 
                 csString status;
@@ -763,15 +787,24 @@ void NetManager::CheckLinkDead()
                 psDisconnectMessage discon(pClient->GetClientNum(), 0, "You are linkdead.");
                 if(discon.valid)
                 {
-                    Connection* connection = pClient->GetConnection();
                     HandleCompletedMessage(discon.msg, connection, NULL,NULL);
+                    continue;
                 }
-                else
-                {
-                    Bug2("Failed to create valid psDisconnectMessage for client id %u.\n", pClient->GetClientNum());
-                }
+                Bug2("Failed to create valid psDisconnectMessage for client id %u.\n", pClient->GetClientNum());
+                break;
             }
+
+            case LINKCHECK_WAIT:
+                break;
         }
+
+        linkChecks.Schedule(pClient->GetClientNum(), next);
     }
 }
 
+void NetManager::CheckLinkDeadSoon(uint32_t clientnum)
+{
+    CS::Threading::MutexScopedLock lock(linkCheckMutex);
+    linkCheckRequests.Push(clientnum);
+}
+
@@ -29,6 +29,7 @@
 // Project Includes
 //=============================================================================
 #include "net/netbase.h"
+#include "util/deadlinequeue.h"
 
 //=============================================================================
 // Local Includes
@@ -120,9 +121,21 @@ public:
      *
      * This is called periodicly to detect linkdead clients. If it finds a
      * link dead client then it will delete the client's connection.
+     *
+     * Only the clients whose check is due are looked at. A client is due
+     * when no packet was received from it for the timeout. Clients being
+     * sent heartbeats and zombies are due at every call.
      */
     void CheckLinkDead(void);
 
+    /**
+     * Check the client with the next CheckLinkDead().
+     *
+     * Called from the server thread when a client became a zombie, so it is
+     * disconnected as soon as it is allowed to.
+     */
+    void CheckLinkDeadSoon(uint32_t clientnum);
+
     /**
      * Gets a list of all connected clients.
      *
@@ -160,6 +173,19 @@ public:
      */
     virtual bool SendMessage(MsgEntry* me);
 
+    /**
+     * Sends the given message to the client listed in the message using
+     * the bytes of the shared payload.
+     *
+     * Used to send the same message to many clients without copying the
+     * bytes for each of them.
+     *
+     * @param me      The message, only the header information is used.
+     * @param payload The bytes of the message shared by all recipients.
+     * @return Returns success or faliure.
+     */
+    bool SendMessage(MsgEntry* me, psNetPacketPayload* payload);
+
     /**
      * Queues the message for sending later, so the calling classes don't have
      * to all manage this themselves.
@@ -224,6 +250,13 @@ private:
     /// list of connected clients
     ClientConnectionSet clients;
 
+    /// Client numbers by the time CheckLinkDead() has to look at them, network thread only
+    DeadlineQueue linkChecks;
+
+    /// Client numbers passed to CheckLinkDeadSoon()
+    csArray<uint32_t> linkCheckRequests;
+    CS::Threading::Mutex linkCheckMutex;
+
     /// UDP port the server binds to
     int port;
 
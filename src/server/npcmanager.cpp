@@ -1013,7 +1013,7 @@ void NPCManager::HandleCommandList(MsgEntry* me,Client* client)
                     actor->SetDRData(drmsg);
 
                     // Now multicast to other clients
-                    actor->UpdateProxList();
+                    gemSupervisor->QueueProxUpdate(actor);
                     actor->MulticastDRUpdate();
 
                     if(drmsg.vel.y < -20 || drmsg.pos.y < -1000)                   //NPC has fallen down
@@ -1694,7 +1694,7 @@ void NPCManager::HandleCommandList(MsgEntry* me,Client* client)
                 if(controlled->GetClient())
                     controlled->GetClient()->SetCheatMask(MOVE_CHEAT, true); // Tell paladin one of these is OK.
 
-                controlled->UpdateProxList();
+                gemSupervisor->QueueProxUpdate(controlled);
                 controlled->MulticastDRUpdate();
                 controlled->ForcePositionUpdate();
                 controlled->BroadcastTargetStatDR(entityManager->GetClients());
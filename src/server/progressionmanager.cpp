@@ -238,11 +238,15 @@ void ProgressionManager::AllocateKillDamage(gemActor* deadActor, int exp)
         int final = 0;
         if(exp <= 0) //use automatically generated experience if exp doesn't have a valid value
         {
+            static const MathVarName killerVar("Killer");
+            static const MathVarName deadActorVar("DeadActor");
+            static const MathVarName expVar("Exp");
+
             MathEnvironment env;
-            env.Define("Killer",    attacker);
-            env.Define("DeadActor", deadActor);
+            env.Define(killerVar,    attacker);
+            env.Define(deadActorVar, deadActor);
             calc_dynamic_experience->Evaluate(&env);
-            final = env.Lookup("Exp")->GetValue();
+            final = env.Lookup(expVar)->GetValue();
         }
         else
         {
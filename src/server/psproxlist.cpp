@@ -78,6 +78,7 @@ ProximityList::ProximityList(iObjectRegistry* object_reg, gemObject* parent, Ent
     float rot;
     iSector* sector;
     firstFrame = true;
+    touchStamp = 1;
     self->GetPosition(oldPos, rot, sector);
     oldInstance = DEFAULT_INSTANCE;
 }
@@ -90,18 +91,19 @@ ProximityList::~ProximityList()
 
     while(objectsThatIWatch.GetSize())
     {
+        gemObject* obj = objectsThatIWatch.Pop();
 #ifdef PSPROXDEBUG
-        CPrintf(CON_DEBUG, "Unsubscribing from %s (%p).\n", objectsThatIWatch[0]->GetName(), this);
+        CPrintf(CON_DEBUG, "Unsubscribing from %s (%p).\n", obj->GetName(), this);
 #endif
 
-        objectsThatIWatch[0]->GetProxList()->RemoveWatcher(self);
-        objectsThatIWatch.DeleteIndex(0);
-        objectsThatIWatch_touched.DeleteIndex(0);
+        obj->GetProxList()->RemoveWatcher(self);
+        objectsThatIWatch_touched.Pop();
+        iWatchIndex.DeleteAll(csPtrKey<gemObject>(obj));
     }
 
     while(objectsThatWatchMe.GetSize())
     {
-        gemObject* obj = (gemObject*)objectsThatWatchMe.Get(0).object;
+        gemObject* obj = (gemObject*)objectsThatWatchMe.Top().object;
 #ifdef PSPROXDEBUG
         CPrintf(CON_DEBUG, "Unsubscribing from %s (%p).\n",obj->GetName(), this);
 #endif
@@ -159,7 +161,7 @@ void ProximityList::AddWatcher(gemObject* interestedObject, float range)
 {
     PublishDestination* pd;
 
-    uint index;
+    size_t index;
     pd = FindObjectThatWatchesMe(interestedObject, index);
     if(pd != NULL)
     {
@@ -170,8 +172,9 @@ void ProximityList::AddWatcher(gemObject* interestedObject, float range)
 
     destRangeTimer.Push(0);
     size_t i = objectsThatWatchMe.Push(PublishDestination(interestedObject->GetClientID(), interestedObject, 0, 100));
+    objectsThatWatchMe_touched.Push(touchStamp);
+    watchMeIndex.Put(csPtrKey<gemObject>(interestedObject), i);
     UpdatePublishDestRange(&objectsThatWatchMe[i], self, interestedObject, i, range);
-    objectsThatWatchMe_touched.Push(true);
 }
 
 bool ProximityList::EndMutualWatching(gemObject* fromobject)
@@ -192,39 +195,58 @@ bool ProximityList::StartWatching(gemObject* object, float range)
         return false;
     }
 
-    objectsThatIWatch.Push(object);
-    objectsThatIWatch_touched.Push(true);
+    size_t i = objectsThatIWatch.Push(object);
+    objectsThatIWatch_touched.Push(touchStamp);
+    iWatchIndex.Put(csPtrKey<gemObject>(object), i);
     object->GetProxList()->AddWatcher(self, range);
     return true;
 }
 
 void ProximityList::EndWatching(gemObject* object)
 {
-    for(size_t x = 0; x < objectsThatIWatch.GetSize(); x++)
+    const size_t* slot = iWatchIndex.GetElementPointer(csPtrKey<gemObject>(object));
+    if(!slot)
+        return;
+
+    size_t x = *slot;
+    iWatchIndex.DeleteAll(csPtrKey<gemObject>(object));
+
+    // Move the last relation into the hole
+    size_t last = objectsThatIWatch.GetSize() - 1;
+    if(x != last)
     {
-        if(objectsThatIWatch[x] == object)
-        {
-            objectsThatIWatch[x]->GetProxList()->RemoveWatcher(self);
-            objectsThatIWatch.DeleteIndex(x);
-            objectsThatIWatch_touched.DeleteIndex(x);
-            return;
-        }
+        objectsThatIWatch[x] = objectsThatIWatch[last];
+        objectsThatIWatch_touched[x] = objectsThatIWatch_touched[last];
+        iWatchIndex.PutUnique(csPtrKey<gemObject>(objectsThatIWatch[x]), x);
     }
+    objectsThatIWatch.Truncate(last);
+    objectsThatIWatch_touched.Truncate(last);
+
+    object->GetProxList()->RemoveWatcher(self);
 }
 
 void ProximityList::RemoveWatcher(gemObject* object)
 {
     // Remove the target's entity/client from our list
-    for(size_t x = 0; x < objectsThatWatchMe.GetSize(); x++)
+    const size_t* slot = watchMeIndex.GetElementPointer(csPtrKey<gemObject>(object));
+    if(!slot)
+        return;
+
+    size_t x = *slot;
+    watchMeIndex.DeleteAll(csPtrKey<gemObject>(object));
+
+    // Move the last relation into the hole
+    size_t last = objectsThatWatchMe.GetSize() - 1;
+    if(x != last)
     {
-        if(objectsThatWatchMe[x].object == object)
-        {
-            objectsThatWatchMe.DeleteIndex(x);
-            objectsThatWatchMe_touched.DeleteIndex(x);
-            destRangeTimer.DeleteIndex(x);
-            return;
-        }
+        objectsThatWatchMe[x] = objectsThatWatchMe[last];
+        objectsThatWatchMe_touched[x] = objectsThatWatchMe_touched[last];
+        destRangeTimer[x] = destRangeTimer[last];
+        watchMeIndex.PutUnique(csPtrKey<gemObject>((gemObject*)objectsThatWatchMe[x].object), x);
     }
+    objectsThatWatchMe.Truncate(last);
+    objectsThatWatchMe_touched.Truncate(last);
+    destRangeTimer.Truncate(last);
 }
 
 bool ProximityList::FindClient(uint32_t cnum)
@@ -241,40 +263,28 @@ bool ProximityList::FindClient(uint32_t cnum)
 
 bool ProximityList::FindObject(gemObject* object)
 {
-    for(size_t x = 0; x < objectsThatWatchMe.GetSize(); x++)
-    {
-        if(objectsThatWatchMe[x].object == object)
-        {
-            return true;
-        }
-    }
-    return false;
+    return watchMeIndex.Contains(csPtrKey<gemObject>(object));
 }
 
-PublishDestination* ProximityList::FindObjectThatWatchesMe(gemObject* object, uint &x)
+PublishDestination* ProximityList::FindObjectThatWatchesMe(gemObject* object, size_t &x)
 {
-    for(x = 0; x < objectsThatWatchMe.GetSize(); x++)
-    {
-        if(objectsThatWatchMe[x].object == object)
-        {
-            objectsThatWatchMe_touched[x] = true;
-            return &objectsThatWatchMe[x];
-        }
-    }
-    return NULL;
+    const size_t* slot = watchMeIndex.GetElementPointer(csPtrKey<gemObject>(object));
+    if(!slot)
+        return NULL;
+
+    x = *slot;
+    objectsThatWatchMe_touched[x] = touchStamp;
+    return &objectsThatWatchMe[x];
 }
 
 bool ProximityList::FindObjectThatIWatch(gemObject* object)
 {
-    for(size_t x = 0; x < objectsThatIWatch.GetSize(); x++)
-    {
-        if(objectsThatIWatch[x] == object)
-        {
-            objectsThatIWatch_touched[x] = true;
-            return true;
-        }
-    }
-    return false;
+    const size_t* slot = iWatchIndex.GetElementPointer(csPtrKey<gemObject>(object));
+    if(!slot)
+        return false;
+
+    objectsThatIWatch_touched[*slot] = touchStamp;
+    return true;
 }
 
 gemObject* ProximityList::FindObjectName(const char* name)
@@ -290,7 +300,7 @@ gemObject* ProximityList::FindObjectName(const char* name)
 }
 
 void ProximityList::UpdatePublishDestRange(PublishDestination* pd, gemObject* myself, gemObject* object,
-        uint objIdx, float newrange)
+        size_t objIdx, float newrange)
 {
     csArray<psNPCCommandsMessage::PerceptionType> pcpts;
 
@@ -367,14 +377,11 @@ void ProximityList::UpdatePublishDestRange(PublishDestination* pd, gemObject* my
 
 void ProximityList::TouchObjectThatWatchesMe(gemObject* object,float newrange)
 {
-    for(size_t x = 0; x < objectsThatWatchMe.GetSize(); x++)
+    size_t x;
+    PublishDestination* pd = FindObjectThatWatchesMe(object, x);
+    if(pd)
     {
-        if(objectsThatWatchMe[x].object == object)
-        {
-            objectsThatWatchMe_touched[x] = true;
-            UpdatePublishDestRange(&objectsThatWatchMe[x], self, object, x, newrange);
-            return;
-        }
+        UpdatePublishDestRange(pd, self, object, x, newrange);
     }
 }
 
@@ -400,40 +407,42 @@ bool ProximityList::CheckUpdateRequired()
 
 void ProximityList::ClearTouched()
 {
-    size_t objNum;
+    touchStamp++;
+
+    // On wrap around old stamps could look touched again, so reset them all.
+    if(touchStamp == 0)
+    {
+        size_t objNum;
 
-    for(objNum = 0; objNum < objectsThatWatchMe_touched.GetSize(); objNum++)
-        objectsThatWatchMe_touched[objNum] = false;
-    for(objNum = 0; objNum < objectsThatIWatch_touched.GetSize(); objNum++)
-        objectsThatIWatch_touched[objNum]  = false;
+        for(objNum = 0; objNum < objectsThatWatchMe_touched.GetSize(); objNum++)
+            objectsThatWatchMe_touched[objNum] = 0;
+        for(objNum = 0; objNum < objectsThatIWatch_touched.GetSize(); objNum++)
+            objectsThatIWatch_touched[objNum]  = 0;
+
+        touchStamp = 1;
+    }
 }
 
-bool ProximityList::GetUntouched_ObjectThatWatchesMe(gemObject* &object)
+void ProximityList::GetUntouchedObjectsThatWatchMe(csArray<gemObject*> &objects)
 {
     for(size_t x = 0; x < objectsThatWatchMe_touched.GetSize(); x++)
     {
-        if(!objectsThatWatchMe_touched[x])
+        if(objectsThatWatchMe_touched[x] != touchStamp)
         {
-            object = (gemObject*)objectsThatWatchMe[x].object;
-            objectsThatWatchMe_touched[x] = true;
-            return true;
+            objects.Push((gemObject*)objectsThatWatchMe[x].object);
         }
     }
-    return false;
 }
 
-bool ProximityList::GetUntouched_ObjectThatIWatch(gemObject* &object)
+void ProximityList::GetUntouchedObjectsThatIWatch(csArray<gemObject*> &objects)
 {
     for(size_t x = 0; x < objectsThatIWatch_touched.GetSize(); x++)
     {
-        if(!objectsThatIWatch_touched[x])
+        if(objectsThatIWatch_touched[x] != touchStamp)
         {
-            object = objectsThatIWatch[x];
-            objectsThatIWatch_touched[x] = true;
-            return true;
+            objects.Push(objectsThatIWatch[x]);
         }
     }
-    return false;
 }
 
 
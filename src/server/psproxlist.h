@@ -47,8 +47,14 @@ class EntityManager;
  *    - values in objectsThatIWatch  are unique
  *    - object X is in objectsThatWatchMe of object Y <===> object Y must be in objectsThatIWatch of X
  *    - objects with GetClientID()==0 have empty objectsThatIWatch
+ *    - watchMeIndex/iWatchIndex map every object to its slot in the arrays above
  *    - correspondence between objectsThatWatchMe and objectsThatWatchMe_touched
  *                             objectsThatIWatch  and objectsThatIWatch_touched
+ *
+ * The arrays are unordered, removal moves the last element into the hole so
+ * that all operations on a single relation are O(1). An entry is touched when
+ * its stamp equals touchStamp, so ClearTouched() is O(1) as well and only the
+ * untouched sweep at the end of an update walks our own lists once.
  */
 
 class ProximityList
@@ -60,8 +66,12 @@ protected:
     csArray<gemObject*>  objectsThatIWatch;           ///< What objects am I subscribed to myself?
     csArray<csTicks> destRangeTimer;       ///< Per-object timeout on dest range checks.
 
-    csArray<bool> objectsThatWatchMe_touched;
-    csArray<bool> objectsThatIWatch_touched;
+    csArray<uint32> objectsThatWatchMe_touched;
+    csArray<uint32> objectsThatIWatch_touched;
+    uint32 touchStamp;                     ///< Current stamp of touched entries
+
+    csHash<size_t, csPtrKey<gemObject> > watchMeIndex; ///< Slot of each object in objectsThatWatchMe
+    csHash<size_t, csPtrKey<gemObject> > iWatchIndex;  ///< Slot of each object in objectsThatIWatch
 
     int          clientnum;
     bool         firstFrame;
@@ -78,7 +88,7 @@ protected:
 
     bool IsNear(iSector* sector,csVector3 &pos,gemObject* object,float radius);
     bool FindObject(gemObject* object);
-    PublishDestination* FindObjectThatWatchesMe(gemObject* object, uint &x);
+    PublishDestination* FindObjectThatWatchesMe(gemObject* object, size_t &x);
     bool FindObjectThatIWatch(gemObject* object);
 
     void TouchObjectThatWatchesMe(gemObject* object,float newrange);
@@ -87,7 +97,7 @@ protected:
     void UpdatePublishDestRange(PublishDestination* pd,
                                 gemObject* myself,
                                 gemObject* object,
-                                uint objIdx,
+                                size_t objIdx,
                                 float newrange);
 
 public:
@@ -128,9 +138,23 @@ public:
     float RangeTo(gemObject* object, bool ignoreY = false, bool ignoreInstance = false);
     void DebugDumpContents(csString &out);
 
+    /**
+     * Mark all relations as untouched, done at the start of an update.
+     */
     void ClearTouched();
-    bool GetUntouched_ObjectThatWatchesMe(gemObject* &object);
-    bool GetUntouched_ObjectThatIWatch(gemObject* &object);
+
+    /**
+     * Append all objects watching us that weren't touched since ClearTouched().
+     *
+     * Together with the touches done while walking the nearby objects this
+     * gives the set of watchers that left our range.
+     */
+    void GetUntouchedObjectsThatWatchMe(csArray<gemObject*> &objects);
+
+    /**
+     * Append all objects we watch that weren't touched since ClearTouched().
+     */
+    void GetUntouchedObjectsThatIWatch(csArray<gemObject*> &objects);
 };
 
 #endif
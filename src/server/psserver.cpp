@@ -40,10 +40,12 @@
 #include "util/psdatabase.h"
 #include "util/eventmanager.h"
 #include "util/log.h"
+#include "util/asynclog.h"
 #include "util/consoleout.h"
 
 #include "net/msghandler.h"
 #include "net/messages.h"
+#include "net/netprofile.h"
 
 #include "bulkobjects/pscharacterloader.h"
 #include "bulkobjects/psitem.h"
@@ -148,6 +150,13 @@ psServer::psServer()
 
 psServer::~psServer()
 {
+    // The exporter reads the managers from its thread
+    if(metricsexporter)
+    {
+        metricsexporter->Stop();
+        metricsexporter = NULL;
+    }
+
     // Kick players from server
     if(netmanager)
     {
@@ -176,6 +185,8 @@ psServer::~psServer()
         NetManager::Destroy();
     }
 
+    CharacterLoader.StopAsyncLoading();
+
     delete economymanager;
     delete tutorialmanager;
     delete charmanager;
@@ -196,6 +207,9 @@ psServer::~psServer()
     delete minigamemanager;
     delete cachemanager;
     delete questmanager;
+
+    // The items deleted above were captured, write them before closing the database
+    CharacterLoader.StopItemSaver();
     delete database;
     delete logcsv;
     delete rng;
@@ -204,6 +218,9 @@ psServer::~psServer()
     delete intromanager;
     delete songManager;
     delete serverconsole;
+
+    // Write the log lines still queued
+    AsyncLog::Stop();
     /*
     PS_CHECK_REF_COUNT(guildmanager);
     PS_CHECK_REF_COUNT(questionmanager);
@@ -279,6 +296,9 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
     // Load the log settings
     LoadLogSettings();
 
+    // Write the log files from their own thread from now on
+    AsyncLog::Start();
+
     // Initialise the CSV logger
     logcsv = new LogCSV(configmanager, vfs);
 
@@ -400,6 +420,14 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
         return false;
     }
 
+    // Characters logging in are loaded by these workers, 0 loads them in the main thread
+    int loaderThreads = configmanager->GetInt("PlaneShift.Server.CharacterLoader.Threads", 2);
+    if(loaderThreads > 0 &&
+       !CharacterLoader.StartAsyncLoading(object_reg, loaderThreads, db_host, db_port, db_user, db_pass, db_name))
+    {
+        CPrintf(CON_WARNING, "Could not start the character loader threads, characters will be loaded in the main thread.\n");
+    }
+
     // Start Network Thread
 
     netmanager = NetManager::Create(cachemanager, MSGTYPE_PREAUTHENTICATE,MSGTYPE_NPCAUTHENT);
@@ -414,6 +442,20 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
         configmanager->GetInt("PlaneShift.Server.Port", 1243);
     Debug3(LOG_STARTUP,0,COL_BLUE "Listening on '%s' Port %d." COL_NORMAL,
            (const char*) serveraddr, port);
+
+    // Socket backend, the network thread starts processing after the bind
+    csString netio = configmanager->GetStr("PlaneShift.Server.Net.IO", "select");
+    if(netio.CompareNoCase("batched"))
+    {
+        if(netmanager->SetBatchedIO(true))
+        {
+            Debug1(LOG_STARTUP,0,"Using batched network I/O.");
+        }
+        else
+        {
+            CPrintf(CON_WARNING, "Batched network I/O is not available, using select.\n");
+        }
+    }
     if(!netmanager->Bind(serveraddr, port))
     {
         Error1("Failed to bind");
@@ -442,6 +484,26 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
 
     Debug1(LOG_STARTUP,0,"Started Event Manager Thread");
 
+    // Saves of existing items are collected this long and written by a thread, 0 writes them at once
+    int itemSaveInterval = configmanager->GetInt("PlaneShift.Server.ItemSaver.Interval", 500);
+    if(itemSaveInterval > 0 &&
+       !CharacterLoader.StartItemSaver(object_reg, itemSaveInterval, db_host, db_port, db_user, db_pass, db_name))
+    {
+        CPrintf(CON_WARNING, "Could not start the item saver thread, items will be saved in the main thread.\n");
+    }
+
+    // The profiles are served to a metrics collector on this loopback port, 0 doesn't serve them
+    int metricsPort = configmanager->GetInt("PlaneShift.Server.Metrics.Port", 0);
+    if(metricsPort > 0)
+    {
+        metricsexporter.AttachNew(new psMetricsExporter(this));
+        if(!metricsexporter->Start(metricsPort))
+        {
+            CPrintf(CON_WARNING, "Could not serve the metrics on port %d.\n", metricsPort);
+            metricsexporter = NULL;
+        }
+    }
+
     if(!progression->Initialize(object_reg))
     {
         Error1("Failed to start progression manager!");
@@ -465,6 +527,10 @@ bool psServer::Initialize(iObjectRegistry* object_reg)
 
     // Set up wiring for entitymanager
     GEMSupervisor* gem = new GEMSupervisor(object_reg,database, entitymanager, cachemanager);
+
+    // The read only phases of a tick are spread over these threads and the main thread
+    int jobThreads = configmanager->GetInt("PlaneShift.Server.Jobs.Threads", 3);
+    gem->GetJobSystem()->Start(jobThreads > 0 ? jobThreads : 0);
     psServerDR* psserverdr = new psServerDR(cachemanager, entitymanager);
     if(!entitymanager->Initialize(object_reg, GetConnections(), usermanager, gem, psserverdr, cachemanager))
     {
@@ -936,6 +1002,41 @@ ClientConnectionSet* psServer::GetConnections()
     return netmanager->GetConnections();
 }
 
+csString psServer::ExportMetrics()
+{
+    csString result;
+    result.Append(netmanager->GetProfs()->Export());
+    result.Append(db->ExportProfile());
+    result.Append(eventmanager->GetHandlerProfs()->Export());
+
+    // Fired events are bucketed by ticks late below a limit, exported as
+    // cumulative buckets of the last tick each one holds
+    csArray<psEventTypeStats> stats;
+    eventmanager->GetEventStats(stats);
+    const csTicks limits[EVENT_LATE_BUCKETS] = EVENT_LATE_LIMITS;
+    for(size_t i = 0; i < stats.GetSize(); i++)
+    {
+        const psEventTypeStats &type = stats[i];
+        const char* name = type.type.GetDataSafe();
+        result.AppendFmt("ps_event_queued{type=\"%s\"} %d\n", name, type.queued);
+        result.AppendFmt("ps_event_fired{type=\"%s\"} %d\n", name, type.fired);
+        result.AppendFmt("ps_event_cancelled{type=\"%s\"} %d\n", name, type.cancelled);
+
+        int32 late = 0;
+        for(int j = 0; j < EVENT_LATE_BUCKETS; j++)
+        {
+            late += type.late[j];
+            if(limits[j])
+                result.AppendFmt("ps_event_late_ticks_bucket{type=\"%s\",le=\"%u\"} %d\n", name, limits[j] - 1, late);
+            else
+                result.AppendFmt("ps_event_late_ticks_bucket{type=\"%s\",le=\"+Inf\"} %d\n", name, late);
+        }
+    }
+
+    result.AppendFmt("ps_clients_connected %zu\n", GetConnections()->Count());
+    return result;
+}
+
 /*-----------------Buddy List Management Functions-------------------------*/
 
 bool psServer::AddBuddy(PID self, PID buddy)
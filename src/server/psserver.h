@@ -32,6 +32,7 @@
 // Project Includes
 //=============================================================================
 #include "util/psconst.h"
+#include "net/metricsexporter.h"
 
 //=============================================================================
 // Local Includes
@@ -99,7 +100,7 @@ class  psQuitEvent;
  *
  * The main server class holding references to important server objects.
  */
-class psServer
+class psServer : public iMetricsSource
 {
 public:
 
@@ -358,6 +359,17 @@ public:
         return weathermanager;
     }
 
+    /**
+     * Returns the profiles of the network, the database, the message
+     * handlers and the events in the text format of a metrics collector.
+     *
+     * Called by the metrics exporter from its own thread and by the
+     * "metrics" console command. The network and database profiles take
+     * their own locks, the handler profiles are made up front and the
+     * event counters are read under the lock of the event manager.
+     */
+    virtual csString ExportMetrics();
+
     /**
      * Returns the Math Scripting Engine.
      *
@@ -836,6 +848,7 @@ protected:
     GMEventManager*                 gmeventManager;
     BankManager*                    bankmanager;
     HireManager*                    hiremanager;
+    csRef<psMetricsExporter>        metricsexporter;
 
     psQuitEvent* server_quit_event; ///< Used to keep track of the shut down event
 
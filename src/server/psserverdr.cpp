@@ -259,7 +259,7 @@ void psServerDR::HandleDeadReckoning(MsgEntry* me,Client* client)
     }
 
     //csTicks time = csGetTicks();
-    actor->UpdateProxList();
+    entityManager->GetGEM()->QueueProxUpdate(actor);
     /*
     if (csGetTicks() - time > 500)
     {
@@ -274,10 +274,11 @@ void psServerDR::HandleDeadReckoning(MsgEntry* me,Client* client)
     }
     */
 
-    // Now multicast to other clients
-    psserver->GetEventManager()->Multicast(me,
-                                           actor->GetMulticastClients(),
-                                           me->clientnum,PROX_LIST_ANY_RANGE);
+    // Now multicast to other clients, the message as it came or compact
+    psDRSnapshot snapshot;
+    bool quantized = snapshot.Quantize(drmsg.pos, drmsg.vel, drmsg.worldVel, drmsg.ang_vel, drmsg.yrot,
+                                       drmsg.mode, drmsg.on_ground);
+    actor->MulticastDR(me, quantized ? &snapshot : NULL, drmsg.counter, drmsg.sector, me->clientnum);
 
     paladin->CheckCollDetection(client, actor);
 